@@ -0,0 +1,434 @@
+// Benchmarks of the host side hot paths of NVISII.
+//
+// Each benchmark runs on synthetic data at several scales, without initializing the renderer, and
+// results are written as JSON so that runs can be compared against each other. Only nvisii_core is
+// linked, so the benchmarks also build with NVISII_CORE_ONLY.
+//
+// usage: nvisii_benchmarks [--filter <substring>] [--min-time <seconds>] [--output <path>]
+
+#include <nvisii/nvisii.h>
+#include <nvisii/utilities/dome_importance.h>
+#include <nvisii/utilities/light_tree.h>
+
+#include <devicecode/disney_bsdf.h>
+
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace nvisii;
+
+struct BenchmarkResult {
+    std::string name;
+    uint64_t scale;
+    uint32_t iterations;
+    double meanMs;
+    double minMs;
+    double maxMs;
+};
+
+struct Benchmark {
+    std::string name;
+    std::vector<uint64_t> scales;
+    /* Prepares an iteration at the given scale. Not timed. */
+    std::function<void(uint64_t)> setup;
+    /* The work being measured */
+    std::function<void(uint64_t)> body;
+    /* Releases whatever the iteration created. Not timed. */
+    std::function<void(uint64_t)> teardown;
+};
+
+static double minTimeSeconds = .5;
+static const uint32_t minIterations = 3;
+
+/* Runs a benchmark until both the minimum time and the minimum number of iterations have passed */
+static BenchmarkResult runBenchmark(const Benchmark &benchmark, uint64_t scale)
+{
+    BenchmarkResult result = {benchmark.name, scale, 0, 0.0, 1e30, 0.0};
+    double totalMs = 0.0;
+    while (result.iterations < minIterations || totalMs < minTimeSeconds * 1000.0) {
+        if (benchmark.setup) benchmark.setup(scale);
+        auto start = std::chrono::steady_clock::now();
+        benchmark.body(scale);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (benchmark.teardown) benchmark.teardown(scale);
+
+        totalMs += ms;
+        result.minMs = std::min(result.minMs, ms);
+        result.maxMs = std::max(result.maxMs, ms);
+        result.iterations++;
+    }
+    result.meanMs = totalMs / result.iterations;
+    return result;
+}
+
+/* Removes every component and clears the dirty lists, which the renderer would normally consume */
+static void resetScene()
+{
+    Entity::clearAll();
+    Transform::clearAll();
+    Material::clearAll();
+    Texture::clearAll();
+    Mesh::clearAll();
+    Camera::clearAll();
+    Light::clearAll();
+    Volume::clearAll();
+    Entity::updateComponents();
+    Transform::updateComponents();
+    Material::updateComponents();
+    Texture::updateComponents();
+    Mesh::updateComponents();
+    Camera::updateComponents();
+    Light::updateComponents();
+    Volume::updateComponents();
+}
+
+/* A width * height grid of vertices in the xy plane, with texture coordinates and two triangles per cell */
+static void makeGrid(uint32_t width, uint32_t height, std::vector<float> &positions, std::vector<float> &texcoords, std::vector<uint32_t> &indices)
+{
+    positions.clear(); texcoords.clear(); indices.clear();
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            float u = x / float(width - 1), v = y / float(height - 1);
+            positions.insert(positions.end(), {u, v, .1f * sinf(10.f * u) * cosf(10.f * v)});
+            texcoords.insert(texcoords.end(), {u, v});
+        }
+    }
+    for (uint32_t y = 0; y + 1 < height; ++y) {
+        for (uint32_t x = 0; x + 1 < width; ++x) {
+            uint32_t i = y * width + x;
+            indices.insert(indices.end(), {i, i + 1, i + width + 1, i, i + width + 1, i + width});
+        }
+    }
+}
+
+/* An RGBA image with some structure to it, so that encoders and importance maps have work to do */
+static std::vector<float> makeImage(uint32_t width, uint32_t height)
+{
+    std::vector<float> texels(size_t(width) * height * 4);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            float* t = &texels[(size_t(y) * width + x) * 4];
+            t[0] = .5f + .5f * sinf(x * .05f);
+            t[1] = .5f + .5f * cosf(y * .07f);
+            t[2] = float((x ^ y) & 255) / 255.f;
+            t[3] = 1.f;
+        }
+    }
+    return texels;
+}
+
+/* Small one sided emitters scattered through a cube, facing in all directions, as area lights would be */
+static std::vector<LightTreeEmitter> makeEmitters(uint64_t count, float offset)
+{
+    std::vector<LightTreeEmitter> emitters(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        float a = float(i) * .618034f + offset, b = float(i) * .754878f, c = float(i) * .569840f;
+        vec3 center = 10.f * vec3(glm::fract(a), glm::fract(b), glm::fract(c)) - 5.f;
+        emitters[i].bbmin = center - vec3(.05f);
+        emitters[i].bbmax = center + vec3(.05f);
+        emitters[i].axis = glm::normalize(vec3(sinf(a * 6.f), cosf(b * 6.f), sinf(c * 6.f) + .01f));
+        emitters[i].cosThetaO = 1.f;
+        emitters[i].cosThetaE = 0.f;
+        emitters[i].power = 1.f + float(i % 13);
+    }
+    return emitters;
+}
+
+static std::string componentName(const char* prefix, uint64_t i)
+{
+    return std::string(prefix) + std::to_string(i);
+}
+
+static std::vector<Benchmark> createBenchmarks()
+{
+    std::vector<Benchmark> benchmarks;
+
+    // StaticFactory create / get / remove, through the transform factory
+    benchmarks.push_back({"factory_create", {100, 1000, 10000},
+        nullptr,
+        [] (uint64_t n) { for (uint64_t i = 0; i < n; ++i) Transform::create(componentName("t", i)); },
+        [] (uint64_t) { resetScene(); }});
+    benchmarks.push_back({"factory_get", {100, 1000, 10000},
+        [] (uint64_t n) { for (uint64_t i = 0; i < n; ++i) Transform::create(componentName("t", i)); },
+        [] (uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                if (!Transform::get(componentName("t", i))) throw std::runtime_error("Error: missing transform");
+            }
+        },
+        [] (uint64_t) { resetScene(); }});
+    benchmarks.push_back({"factory_remove", {100, 1000, 10000},
+        [] (uint64_t n) { for (uint64_t i = 0; i < n; ++i) Transform::create(componentName("t", i)); },
+        [] (uint64_t n) { for (uint64_t i = 0; i < n; ++i) Transform::remove(componentName("t", i)); },
+        [] (uint64_t) { resetScene(); }});
+
+    // Mesh::loadData, including normal and tangent generation. Scale is the number of vertices.
+    {
+        auto positions = std::make_shared<std::vector<float>>();
+        auto texcoords = std::make_shared<std::vector<float>>();
+        auto indices = std::make_shared<std::vector<uint32_t>>();
+        benchmarks.push_back({"mesh_load_data", {32 * 32, 256 * 256, 1024 * 1024},
+            [=] (uint64_t n) { uint32_t side = uint32_t(sqrt(double(n))); makeGrid(side, side, *positions, *texcoords, *indices); },
+            [=] (uint64_t) {
+                Mesh::createFromData("mesh", *positions, 3, std::vector<float>(), 3, std::vector<float>(), 4, *texcoords, 2, *indices);
+            },
+            [] (uint64_t) { resetScene(); }});
+    }
+
+    // Procedural meshes. Scale is the tessellation.
+    benchmarks.push_back({"mesh_procedural_sphere", {16, 64, 256},
+        nullptr,
+        [] (uint64_t n) { Mesh::createSphere("sphere", 1.f, int(n * 2), int(n)); },
+        [] (uint64_t) { resetScene(); }});
+    benchmarks.push_back({"mesh_procedural_teapot", {4, 8, 16},
+        nullptr,
+        [] (uint64_t n) { Mesh::createTeapotahedron("teapot", int(n)); },
+        [] (uint64_t) { resetScene(); }});
+
+    // Moving the root of a binary tree of transforms, which updates every descendant
+    benchmarks.push_back({"transform_hierarchy_update", {100, 1000, 10000},
+        [] (uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                Transform* t = Transform::create(componentName("t", i), vec3(1.f), quat(1.f, 0.f, 0.f, 0.f), vec3(.1f, 0.f, 0.f));
+                if (i > 0) t->setParent(Transform::get(componentName("t", (i - 1) / 2)));
+            }
+        },
+        [] (uint64_t) {
+            Transform* root = Transform::get("t0");
+            for (int i = 0; i < 10; ++i) root->setPosition(vec3(float(i), 0.f, 0.f));
+        },
+        [] (uint64_t) { resetScene(); }});
+
+    // Moving entities, which recomputes their bounds and grows the scene bounds
+    benchmarks.push_back({"entity_aabb_update", {100, 1000, 10000},
+        [] (uint64_t n) {
+            Mesh* mesh = Mesh::createBox("box");
+            Material* material = Material::create("material");
+            for (uint64_t i = 0; i < n; ++i) {
+                Entity::create(componentName("e", i), Transform::create(componentName("t", i)), material, mesh);
+            }
+        },
+        [] (uint64_t n) {
+            // Entities move outwards, so the scene bounds must grow with each move
+            for (uint64_t i = 0; i < n; ++i) {
+                Transform::get(componentName("t", i))->setPosition(vec3(float(i), float(i % 7), 0.f));
+            }
+        },
+        [] (uint64_t) { resetScene(); }});
+
+    // Texture loading, through a PNG file written beforehand. Scale is the width and height.
+    benchmarks.push_back({"texture_load_png", {256, 1024, 4096},
+        [] (uint64_t n) {
+            std::vector<float> texels = makeImage(uint32_t(n), uint32_t(n));
+            std::vector<uint8_t> bytes(texels.size());
+            for (size_t i = 0; i < texels.size(); ++i) bytes[i] = uint8_t(texels[i] * 255.f);
+            stbi_write_png("nvisii_benchmark_texture.png", int(n), int(n), 4, bytes.data(), int(n) * 4);
+        },
+        [] (uint64_t) { Texture::createFromFile("texture", "nvisii_benchmark_texture.png"); },
+        [] (uint64_t) { resetScene(); std::remove("nvisii_benchmark_texture.png"); }});
+
+    // Texture operations, which produce a new texture from existing ones
+    auto createTextures = [] (uint64_t n) {
+        std::vector<float> texels = makeImage(uint32_t(n), uint32_t(n));
+        Texture::createFromData("a", uint32_t(n), uint32_t(n), texels.data(), uint32_t(texels.size()));
+        std::reverse(texels.begin(), texels.end());
+        Texture::createFromData("b", uint32_t(n), uint32_t(n), texels.data(), uint32_t(texels.size()));
+    };
+    benchmarks.push_back({"texture_hsv", {256, 1024, 2048},
+        createTextures,
+        [] (uint64_t) { Texture::createHSV("hsv", Texture::get("a"), .25f, 1.5f, .8f); },
+        [] (uint64_t) { resetScene(); }});
+    benchmarks.push_back({"texture_mix", {256, 1024, 2048},
+        createTextures,
+        [] (uint64_t) { Texture::createMix("mix", Texture::get("a"), Texture::get("b"), .5f); },
+        [] (uint64_t) { resetScene(); }});
+
+    // The dome light importance map, as built by setDomeLightTexture. Scale is the texture width.
+    benchmarks.push_back({"dome_cdf", {512, 2048, 8192},
+        [] (uint64_t n) {
+            std::vector<float> texels = makeImage(uint32_t(n), uint32_t(n / 2));
+            Texture::createFromData("dome", uint32_t(n), uint32_t(n / 2), texels.data(), uint32_t(texels.size()), true, true);
+        },
+        [] (uint64_t) {
+            Texture* texture = Texture::get("dome");
+            DomeImportanceMap map = buildDomeImportanceMap(texture->getWidth(), texture->getHeight(),
+                [texture] (uint32_t x, uint32_t y) { return texture->getLinearLuminance(x, y); });
+            if (map.table.empty()) throw std::runtime_error("Error: empty importance map");
+        },
+        [] (uint64_t) { resetScene(); }});
+
+    // The light tree used to select among many lights. Scale is the number of emitters.
+    {
+        auto emitters = std::make_shared<std::vector<LightTreeEmitter>>();
+        auto tree = std::make_shared<LightTree>();
+        benchmarks.push_back({"light_tree_build", {1000, 10000, 100000},
+            [=] (uint64_t n) { *emitters = makeEmitters(n, 0.f); },
+            [=] (uint64_t) { tree->build(*emitters); },
+            nullptr});
+        // Every emitter moves a little, as in an animation, keeping the topology of the tree
+        benchmarks.push_back({"light_tree_refit", {1000, 10000, 100000},
+            [=] (uint64_t n) { tree->build(makeEmitters(n, 0.f)); *emitters = makeEmitters(n, .001f); },
+            [=] (uint64_t) { tree->refit(*emitters); },
+            nullptr});
+        // A fixed number of selections from shading points spread through the emitters, with the CPU reference sampler
+        benchmarks.push_back({"light_tree_sample", {1000, 10000, 100000},
+            [=] (uint64_t n) { tree->build(makeEmitters(n, 0.f)); },
+            [=] (uint64_t) {
+                uint32_t picked = 0;
+                for (uint32_t i = 0; i < 100000; ++i) {
+                    float u = (float(i) + .5f) / 100000.f;
+                    vec3 p = 10.f * vec3(glm::fract(u * 7.f), glm::fract(u * 13.f), glm::fract(u * 17.f)) - 5.f;
+                    vec3 n = glm::normalize(vec3(sinf(u * 31.f), cosf(u * 37.f), .5f));
+                    float pdf;
+                    if (sampleLightTreeReference(*tree, p, n, glm::fract(u * 101.f), pdf) != LIGHT_TREE_INVALID_EMITTER) picked++;
+                }
+                if (picked == 0) throw std::runtime_error("Error: no light selected");
+            },
+            nullptr});
+    }
+
+    // Sampling the Disney BSDF, as the CPU path tracer does once per bounce, over a plastic, a metal and a glass.
+    // Scale is the number of samples.
+    {
+        benchmarks.push_back({"disney_bsdf_sample", {10000, 100000, 1000000},
+            nullptr,
+            [] (uint64_t n) {
+                DisneyMaterial materials[3] = {};
+                for (auto &mat : materials) {
+                    mat.base_color = mat.subsurface_color = make_float3(.8f, .8f, .8f);
+                    mat.specular = .5f;
+                    mat.roughness = .4f;
+                    mat.ior = 1.45f;
+                    mat.alpha = 1.f;
+                }
+                materials[0].clearcoat = 1.f;
+                materials[1].metallic = 1.f;
+                materials[2].specular_transmission = 1.f;
+                float3 normal = make_float3(0.f, 0.f, 1.f), tangent = make_float3(1.f, 0.f, 0.f), bitangent = make_float3(0.f, 1.f, 0.f);
+                float weight = 0.f;
+                for (uint64_t i = 0; i < n; ++i) {
+                    float u = (float(i) + .5f) / float(n);
+                    float3 w_o = normalize(make_float3(sinf(u * 31.f), cosf(u * 37.f), .2f + glm::fract(u * 7.f)));
+                    float3 w_i, bsdf;
+                    float pdf;
+                    int lobe;
+                    sample_disney_brdf(materials[i % 3], glm::fract(u * 101.f), make_float2(glm::fract(u * 13.f), glm::fract(u * 17.f)),
+                        normal, normal, normal, tangent, bitangent, w_o, w_i, pdf, lobe, bsdf);
+                    if (pdf > 0.f) weight += bsdf.x / pdf;
+                }
+                if (!(weight > 0.f)) throw std::runtime_error("Error: no BSDF sample succeeded");
+            },
+            nullptr});
+    }
+
+    // Building a sparse volume from a dense grid. Scale is the width, height and depth.
+    {
+        auto voxels = std::make_shared<std::vector<float>>();
+        benchmarks.push_back({"volume_create_from_data", {32, 64, 128},
+            [=] (uint64_t n) {
+                voxels->resize(n * n * n);
+                // A sphere, so that the volume is sparse outside of it
+                for (uint64_t z = 0; z < n; ++z) for (uint64_t y = 0; y < n; ++y) for (uint64_t x = 0; x < n; ++x) {
+                    vec3 p = (vec3(x, y, z) + .5f) / float(n) - .5f;
+                    (*voxels)[x + y * n + z * n * n] = std::max(0.f, .5f - glm::length(p));
+                }
+            },
+            [=] (uint64_t n) { Volume::createFromData("volume", uint32_t(n), uint32_t(n), uint32_t(n), voxels->data(), uint32_t(voxels->size()), 0.f); },
+            [] (uint64_t) { resetScene(); }});
+    }
+
+    // Image encoding, as done by render_to_file. Scale is the width and height.
+    {
+        auto texels = std::make_shared<std::vector<float>>();
+        auto discard = [] (void* context, void*, int size) { *((size_t*)context) += size_t(size); };
+        benchmarks.push_back({"image_encode_png", {256, 1024, 2048},
+            [=] (uint64_t n) { *texels = makeImage(uint32_t(n), uint32_t(n)); },
+            [=] (uint64_t n) {
+                std::vector<uint8_t> colors(texels->size());
+                for (size_t i = 0; i < texels->size(); ++i) colors[i] = uint8_t(glm::clamp((*texels)[i] * 255.f, 0.f, 255.f));
+                size_t bytes = 0;
+                stbi_write_png_to_func(discard, &bytes, int(n), int(n), 4, colors.data(), int(n) * 4);
+            },
+            nullptr});
+        benchmarks.push_back({"image_encode_hdr", {256, 1024, 2048},
+            [=] (uint64_t n) { *texels = makeImage(uint32_t(n), uint32_t(n)); },
+            [=] (uint64_t n) {
+                size_t bytes = 0;
+                stbi_write_hdr_to_func(discard, &bytes, int(n), int(n), 4, texels->data());
+            },
+            nullptr});
+    }
+
+    return benchmarks;
+}
+
+static std::string toJSON(const std::vector<BenchmarkResult> &results)
+{
+    std::ostringstream json;
+    json << "{\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult &r = results[i];
+        json << ((i == 0) ? "\n" : ",\n")
+             << "    {\"name\": \"" << r.name << "\", \"scale\": " << r.scale << ", \"iterations\": " << r.iterations
+             << ", \"mean_ms\": " << r.meanMs << ", \"min_ms\": " << r.minMs << ", \"max_ms\": " << r.maxMs << "}";
+    }
+    json << "\n  ]\n}\n";
+    return json.str();
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter, outputPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+        else if (arg == "--min-time" && i + 1 < argc) minTimeSeconds = atof(argv[++i]);
+        else if (arg == "--output" && i + 1 < argc) outputPath = argv[++i];
+        else {
+            std::cerr << "usage: " << argv[0] << " [--filter <substring>] [--min-time <seconds>] [--output <path>]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Only the component factories are needed, so the renderer itself is never started
+    const uint32_t maxComponents = 20000;
+    Entity::initializeFactory(maxComponents);
+    Transform::initializeFactory(maxComponents);
+    Material::initializeFactory(maxComponents);
+    Mesh::initializeFactory(maxComponents);
+    Camera::initializeFactory(maxComponents);
+    Light::initializeFactory(maxComponents);
+    Texture::initializeFactory(maxComponents);
+    Volume::initializeFactory(maxComponents);
+
+    std::vector<BenchmarkResult> results;
+    for (auto &benchmark : createBenchmarks()) {
+        if (benchmark.name.find(filter) == std::string::npos) continue;
+        for (auto scale : benchmark.scales) {
+            BenchmarkResult result = runBenchmark(benchmark, scale);
+            std::cerr << result.name << " [" << result.scale << "]: " << result.meanMs << " ms mean, "
+                      << result.minMs << " ms min over " << result.iterations << " iterations" << std::endl;
+            results.push_back(result);
+        }
+    }
+
+    if (outputPath.empty()) std::cout << toJSON(results);
+    else {
+        std::ofstream file(outputPath);
+        if (!file) {
+            std::cerr << "Error: unable to open \"" << outputPath << "\"" << std::endl;
+            return 1;
+        }
+        file << toJSON(results);
+    }
+    return 0;
+}
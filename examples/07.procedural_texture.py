@@ -1,9 +1,6 @@
 import nvisii as v
 
 import nvisii
-import noise
-import random
-import numpy as np 
 
 opt = lambda : None
 opt.spp = 1000 
@@ -28,35 +25,29 @@ nvisii.set_camera_entity(camera)
 
 # # # # # # # # # # # # # # # # # # # # # # # # #
 
-# Lets use noise package to create a 2D noise texture
-img_shape = (20,20,4)
-img = np.zeros(img_shape)
-for i in range(img_shape[0]):
-    for j in range(img_shape[1]):
-        for c in range(4):
-            img[i][j][c] = noise.snoise2(  
-                i, j, 
-                octaves=10, 
-                persistence=.25, 
-                lacunarity=1.0,
-                base=c
-            )
-
-# Going to create two textures, one for the noise,
-# and one for 1 - the noise
-noise = nvisii.texture.create_from_data(
+# Lets have nvisii generate a 2D fractal noise texture. Each of the four 
+# channels holds an independent pattern between 0 and 1.
+noise = nvisii.texture.create_noise(
     'noise',
-    img_shape[0],
-    img_shape[1],
-    1.0 - img.astype(np.float32)
-)    
+    width = 512,
+    height = 512,
+    seed = 0,
+    frequency = 4,
+    octaves = 8,
+    gain = .5,
+    tileable = True
+)
 
-noise_inv = nvisii.texture.create_from_data(
+# And a second, turbulent pattern, which gives a billowy, marble-like look
+noise_inv = nvisii.texture.create_noise_turbulence(
     'noise_inv',
-    img_shape[0],
-    img_shape[1],
-    img.astype(np.float32)
-)    
+    width = 512,
+    height = 512,
+    seed = 1,
+    frequency = 4,
+    octaves = 8,
+    tileable = True
+)
 
 # Set the sky
 dome = nvisii.texture.create_from_file("dome", "content/teatro_massimo_2k.hdr")
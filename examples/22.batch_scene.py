@@ -0,0 +1,103 @@
+# 22.batch_scene.py
+#
+# This shows how to populate a scene with a very large number of objects
+# using numpy arrays and entity.create_batch, which creates all of the
+# transforms and entities in a single call. Compare with 02.random_scene.py,
+# which creates and configures each object one at a time.
+
+import nvisii
+import numpy as np
+import colorsys
+
+opt = lambda: None
+opt.nb_objs = 100000
+opt.spp = 16
+opt.width = 1920
+opt.height = 1080
+opt.out = '22_batch_scene.png'
+
+# We'll need 16 meshes, 16 shared materials, and a transform and entity
+# for each object as well as one more for the camera.
+nvisii.initialize(
+    headless = True,
+    verbose = True,
+    lazy_updates = True,
+    max_entities = opt.nb_objs + 1,
+    max_transforms = opt.nb_objs + 1,
+    max_materials = 16,
+    max_meshes = 16
+)
+
+nvisii.enable_denoiser()
+
+camera = nvisii.entity.create(
+    name = "camera",
+    transform = nvisii.transform.create("camera"),
+    camera = nvisii.camera.create(
+        name = "camera",
+        aspect = float(opt.width)/float(opt.height)
+    )
+)
+camera.get_transform().look_at(at = (0,0,0), up = (1,0,0), eye = (0,0,5))
+nvisii.set_camera_entity(camera)
+
+# Pre-load some meshes, and a few materials to share between the objects
+meshes = [
+    nvisii.mesh.create_sphere('m_0'),
+    nvisii.mesh.create_torus_knot('m_1'),
+    nvisii.mesh.create_teapotahedron('m_2'),
+    nvisii.mesh.create_box('m_3'),
+    nvisii.mesh.create_capped_cone('m_4'),
+    nvisii.mesh.create_capped_cylinder('m_5'),
+    nvisii.mesh.create_capsule('m_6'),
+    nvisii.mesh.create_cylinder('m_7'),
+    nvisii.mesh.create_disk('m_8'),
+    nvisii.mesh.create_dodecahedron('m_9'),
+    nvisii.mesh.create_icosahedron('m_10'),
+    nvisii.mesh.create_icosphere('m_11'),
+    nvisii.mesh.create_rounded_box('m_12'),
+    nvisii.mesh.create_spring('m_13'),
+    nvisii.mesh.create_torus('m_14'),
+    nvisii.mesh.create_tube('m_15'),
+]
+
+materials = []
+for i in range(16):
+    mat = nvisii.material.create(f'mat_{i}')
+    mat.set_base_color(colorsys.hsv_to_rgb(i / 16.0, 0.85, 0.9))
+    mat.set_roughness(np.random.uniform(0, 1))
+    mat.set_metallic(float(i % 2))
+    materials.append(mat)
+
+# Describe every object with flat numpy arrays. Note that the float arrays
+# must be float32, and the id arrays must be int32.
+rng = np.random.default_rng(0)
+positions = rng.uniform((-5, -5, -1), (5, 5, 3), (opt.nb_objs, 3)).astype(np.float32)
+rotations = rng.normal(size = (opt.nb_objs, 4)).astype(np.float32) # (x, y, z, w), normalized by nvisii
+scales = rng.uniform(0.02, 0.06, opt.nb_objs).astype(np.float32) # one uniform scale per object
+mesh_ids = np.array([m.get_id() for m in meshes], dtype = np.int32)[rng.integers(0, 16, opt.nb_objs)]
+material_ids = np.array([m.get_id() for m in materials], dtype = np.int32)[rng.integers(0, 16, opt.nb_objs)]
+
+# Creates entities "obj_0" through "obj_99999", each with a transform of the same name
+ids = nvisii.entity.create_batch(
+    name_prefix = "obj",
+    count = opt.nb_objs,
+    positions = positions.flatten(),
+    rotations = rotations.flatten(),
+    scales = scales,
+    mesh_ids = mesh_ids,
+    material_ids = material_ids
+)
+print("created", len(ids), "objects")
+
+# The objects are regular entities, and can still be edited one at a time
+nvisii.entity.get("obj_0").get_transform().set_scale((0.3, 0.3, 0.3))
+
+nvisii.render_to_file(
+    width = opt.width,
+    height = opt.height,
+    samples_per_pixel = opt.spp,
+    file_path = opt.out
+)
+
+nvisii.deinitialize()
@@ -0,0 +1,71 @@
+# 23.domain_randomization.py
+#
+# This shows how to randomize the poses, materials and lights of a scene
+# every frame with native randomizers, instead of looping over every
+# entity in Python. Each randomizer draws one attribute of a set of
+# entities from a distribution, and randomize(frame) applies them all.
+
+import nvisii
+
+opt = lambda: None
+opt.nb_objs = 1000
+opt.nb_frames = 4
+opt.spp = 64
+opt.width = 1024
+opt.height = 1024
+
+nvisii.initialize(headless = True, verbose = True, lazy_updates = True)
+nvisii.enable_denoiser()
+
+camera = nvisii.entity.create(
+    name = "camera",
+    transform = nvisii.transform.create("camera"),
+    camera = nvisii.camera.create(
+        name = "camera",
+        aspect = float(opt.width)/float(opt.height)
+    )
+)
+camera.get_transform().look_at(at = (0,0,0), up = (0,0,1), eye = (0,6,3))
+nvisii.set_camera_entity(camera)
+
+# A few objects, each with its own material so that their colors can differ
+mesh = nvisii.mesh.create_rounded_box('box')
+for i in range(opt.nb_objs):
+    nvisii.entity.create(
+        name = f"obj_{i}",
+        transform = nvisii.transform.create(f"obj_{i}"),
+        material = nvisii.material.create(f"obj_{i}"),
+        mesh = mesh
+    )
+
+light = nvisii.entity.create(
+    name = "light",
+    transform = nvisii.transform.create("light", position = (0, 0, 4)),
+    mesh = nvisii.mesh.create_plane("light"),
+    light = nvisii.light.create("light")
+)
+
+# Names ending in "*" select every entity starting with that prefix
+objs = ["obj_*"]
+nvisii.add_randomizer("position", objs, "uniform", [-2, -2, -1, 2, 2, 1])
+nvisii.add_randomizer("rotation", objs) # uniformly distributed orientations
+nvisii.add_randomizer("uniform_scale", objs, "uniform", [0.05, 0.15])
+nvisii.add_randomizer("base_color", objs, "uniform_hsv", [0, 0.7, 0.7, 1, 1, 1])
+nvisii.add_randomizer("roughness", objs, "choice", [0.05, 0.9])
+nvisii.add_randomizer("metallic", objs, "uniform", [0, 1])
+nvisii.add_randomizer("light_temperature", ["light"], "uniform", [3000, 8000])
+nvisii.add_randomizer("light_intensity", ["light"], "normal", [2, 0.5])
+
+# The same seed and frame always give the same scene, so any frame can
+# be regenerated on its own later on.
+nvisii.set_randomizer_seed(42)
+for frame in range(opt.nb_frames):
+    nvisii.randomize(frame)
+    nvisii.render_to_file(
+        width = opt.width,
+        height = opt.height,
+        samples_per_pixel = opt.spp,
+        file_path = f"23_domain_randomization_{frame}.png"
+    )
+
+nvisii.deinitialize()
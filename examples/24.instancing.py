@@ -0,0 +1,78 @@
+# 24.instancing.py
+#
+# This shows how to render a very large number of copies of a mesh from a
+# single entity with entity.set_instances. Unlike 22.batch_scene.py, no
+# transform or entity is created per copy: the entity only keeps a matrix
+# and an optional material id per instance, so a million instances cost
+# tens of megabytes rather than gigabytes.
+
+import nvisii
+import numpy as np
+import colorsys
+
+opt = lambda: None
+opt.nb_instances = 1000000
+opt.nb_materials = 16
+opt.spp = 64
+opt.width = 1920
+opt.height = 1080
+opt.out = '24_instancing.png'
+
+nvisii.initialize(headless = True, verbose = True, lazy_updates = True)
+nvisii.enable_denoiser()
+
+camera = nvisii.entity.create(
+    name = "camera",
+    transform = nvisii.transform.create("camera"),
+    camera = nvisii.camera.create(
+        name = "camera",
+        aspect = float(opt.width)/float(opt.height)
+    )
+)
+camera.get_transform().look_at(at = (0,0,0), up = (0,0,1), eye = (0,-12,6))
+nvisii.set_camera_entity(camera)
+
+# A few materials for the instances to pick from
+materials = []
+for i in range(opt.nb_materials):
+    mat = nvisii.material.create(f'mat_{i}')
+    mat.set_base_color(colorsys.hsv_to_rgb(i / float(opt.nb_materials), 0.8, 0.9))
+    mat.set_roughness(0.3)
+    materials.append(mat)
+
+# The entity holding the instances. Its material is used by any instance
+# without one of its own, and its transform moves all of them at once.
+pebbles = nvisii.entity.create(
+    name = "pebbles",
+    transform = nvisii.transform.create("pebbles"),
+    mesh = nvisii.mesh.create_icosphere("pebble", radius = 1.0, segments = 2),
+    material = materials[0]
+)
+
+# One row-major 3x4 matrix per instance, [R | t], as a float32 array
+rng = np.random.default_rng(0)
+scales = rng.uniform(0.01, 0.03, opt.nb_instances).astype(np.float32)
+transforms = np.zeros((opt.nb_instances, 3, 4), dtype = np.float32)
+transforms[:, 0, 0] = scales
+transforms[:, 1, 1] = scales
+transforms[:, 2, 2] = scales * rng.uniform(0.5, 1.0, opt.nb_instances)
+transforms[:, :, 3] = rng.uniform((-8, -8, 0), (8, 8, 0.2), (opt.nb_instances, 3))
+
+# One material id per instance, as an int32 array. -1 uses the entity's material.
+material_ids = np.array([m.get_id() for m in materials], dtype = np.int32)
+material_ids = material_ids[rng.integers(0, opt.nb_materials, opt.nb_instances)]
+
+pebbles.set_instances(transforms.flatten(), material_ids)
+print("instances:", pebbles.get_instance_count())
+
+# Moving the entity moves every instance, without touching the arrays
+pebbles.get_transform().set_rotation(nvisii.angleAxis(0.3, (0,0,1)))
+
+nvisii.render_to_file(
+    width = opt.width,
+    height = opt.height,
+    samples_per_pixel = opt.spp,
+    file_path = opt.out
+)
+
+nvisii.deinitialize()
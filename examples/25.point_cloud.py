@@ -0,0 +1,81 @@
+# 25.point_cloud.py
+#
+# This shows how to render a particle simulation with a point cloud, a
+# mesh drawn as one sphere per point. Rather than one entity per particle,
+# or one tessellated sphere per particle baked into a single mesh, a point
+# cloud only keeps a position, a radius and an optional color per point,
+# and mesh.set_points moves all of them at once every frame.
+
+import nvisii
+import numpy as np
+import colorsys
+
+opt = lambda: None
+opt.nb_particles = 200000
+opt.nb_frames = 8
+opt.dt = 0.05
+opt.spp = 64
+opt.width = 1024
+opt.height = 1024
+
+nvisii.initialize(headless = True, verbose = True, lazy_updates = True)
+nvisii.enable_denoiser()
+
+camera = nvisii.entity.create(
+    name = "camera",
+    transform = nvisii.transform.create("camera"),
+    camera = nvisii.camera.create(
+        name = "camera",
+        aspect = float(opt.width)/float(opt.height)
+    )
+)
+camera.get_transform().look_at(at = (0,0,1), up = (0,0,1), eye = (0,-6,3))
+nvisii.set_camera_entity(camera)
+
+floor = nvisii.entity.create(
+    name = "floor",
+    transform = nvisii.transform.create("floor", scale = (10,10,10)),
+    mesh = nvisii.mesh.create_plane("floor"),
+    material = nvisii.material.create("floor")
+)
+
+# A fountain of particles, each with its own velocity, radius and color
+rng = np.random.default_rng(0)
+positions = np.zeros((opt.nb_particles, 3), dtype = np.float32)
+velocities = rng.normal((0, 0, 5), (0.8, 0.8, 1.0), (opt.nb_particles, 3)).astype(np.float32)
+radii = rng.uniform(0.005, 0.015, opt.nb_particles).astype(np.float32)
+hues = rng.uniform(0.5, 0.7, opt.nb_particles)
+colors = np.array([colorsys.hsv_to_rgb(h, 0.8, 1.0) for h in hues], dtype = np.float32)
+
+# Positions, radii and colors are flat float32 arrays. A single radius can
+# also be given for every point, and the colors can be RGB or RGBA.
+particles = nvisii.entity.create(
+    name = "particles",
+    transform = nvisii.transform.create("particles"),
+    mesh = nvisii.mesh.create_point_cloud("particles",
+        positions = positions.flatten(),
+        radii = radii,
+        colors = colors.flatten()),
+    material = nvisii.material.create("particles", roughness = 0.2)
+)
+
+for frame in range(opt.nb_frames):
+    # Step the simulation, bouncing the particles off the floor
+    velocities[:, 2] -= 9.8 * opt.dt
+    positions += velocities * opt.dt
+    below = positions[:, 2] < radii
+    positions[below, 2] = radii[below]
+    velocities[below, 2] *= -0.5
+
+    # With as many points as before, the radii and colors are kept, and the
+    # point cloud is updated in place rather than recreated
+    particles.get_mesh().set_points(positions.flatten())
+
+    nvisii.render_to_file(
+        width = opt.width,
+        height = opt.height,
+        samples_per_pixel = opt.spp,
+        file_path = f"25_point_cloud_{frame}.png"
+    )
+
+nvisii.deinitialize()
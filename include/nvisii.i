@@ -91,6 +91,18 @@ import_array();
 
 
 %apply (float* INPLACE_ARRAY_FLAT, int DIM_FLAT) {(const float* data, uint32_t length)};
+%apply (float* INPLACE_ARRAY_FLAT, int DIM_FLAT) {
+  (const float* positions, uint32_t positions_length),
+  (const float* rotations, uint32_t rotations_length),
+  (const float* scales, uint32_t scales_length),
+  (const float* transforms, uint32_t transforms_length),
+  (const float* radii, uint32_t radii_length),
+  (const float* colors, uint32_t colors_length)
+};
+%apply (int32_t* INPLACE_ARRAY_FLAT, int DIM_FLAT) {
+  (const int32_t* mesh_ids, uint32_t mesh_ids_length),
+  (const int32_t* material_ids, uint32_t material_ids_length)
+};
 
 
 /* -------- GLM Vector Math Library --------------*/
@@ -139,13 +151,18 @@ namespace std {
 %include "std_map.i"
 namespace std {
   %template(StringToUINT32Map) map<string, uint32_t>;
+  %template(StringToDoubleMap) map<string, double>;
+  %template(StringToDoubleMapVector) vector<map<string, double>>;
+  %template(StringToStringToDoubleMapMap) map<string, map<string, double>>;
 }
 
 /* -------- Ignores --------------*/
+%ignore nvisii::RenderHandle::RenderHandle(uint64_t frameID, std::shared_future<std::vector<float>> future);
 %ignore nvisii::Entity::Entity();
 %ignore nvisii::Entity::Entity(std::string name, uint32_t id);
 %ignore nvisii::Entity::initializeFactory();
 %ignore nvisii::Entity::getFront();
+%ignore nvisii::Entity::getFrontInstances();
 %ignore nvisii::Entity::getFrontStruct();
 %ignore nvisii::Entity::isFactoryInitialized();
 %ignore nvisii::Entity::updateComponents();
@@ -196,6 +213,7 @@ namespace std {
 %ignore nvisii::Texture::Texture();
 %ignore nvisii::Texture::Texture(std::string name, uint32_t id);
 %ignore nvisii::Texture::~Texture();
+%ignore nvisii::Texture::getLinearLuminance(uint32_t x, uint32_t y);
 
 %ignore nvisii::Volume::Volume();
 %ignore nvisii::Volume::Volume(std::string name, uint32_t id);
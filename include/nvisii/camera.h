@@ -18,6 +18,7 @@ namespace nvisii {
 class Camera : public StaticFactory
 {
 	friend class StaticFactory;
+	friend class SceneFile;
     friend class Entity;
 private:
   	/** Prevents multiple components from simultaneously being added and/or removed from the component list */
@@ -11,6 +11,7 @@ class Transform;
 class Material;
 class Mesh;
 class Volume;
+struct EntityInstances;
 
 /**
  * An "Entity" is a component that is used to connect other component types together. 
@@ -29,6 +30,8 @@ class Volume;
  */
 class Entity : public StaticFactory {
 	friend class StaticFactory;
+	friend class SceneFile;
+	friend class Randomizer;
 private:
 	/** If an entity isn't active, its callbacks aren't called */
 	bool active = true;
@@ -45,6 +48,9 @@ private:
     /** The table of Entity structs */
 	static std::vector<EntityStruct> entityStructs;
 
+    /** The instances of each entity, or nullptr for entities without instances */
+	static std::vector<std::shared_ptr<const EntityInstances>> entityInstances;
+
     /** A lookup table where, given the name of a component, returns the primary key of that component */
 	static std::map<std::string, uint32_t> lookupTable;
 	
@@ -89,6 +95,31 @@ public:
 		Volume* volume = nullptr
 	);
 
+	/**
+	 * Constructs many entities at once, each with its own transform, from flat arrays (eg, numpy arrays).
+	 * All transforms and entities are created in a single locked pass, which is much faster than 
+	 * creating and configuring them one at a time.
+	 * 
+	 * Entity i and its transform are both named name_prefix + "_" + str(i). If any of those names 
+	 * are taken, or if there is not enough room left for all of them, nothing is created.
+	 * 
+	 * @param name_prefix The prefix of the names of the entities and transforms to create.
+	 * @param count The number of entities to create.
+	 * @param positions Either empty, or 3 * count floats, the position of each entity.
+	 * @param rotations Either empty, or 4 * count floats, the rotation of each entity as an (x, y, z, w) quaternion.
+	 * @param scales Either empty, count floats for uniform scales, or 3 * count floats, the scale of each entity.
+	 * @param mesh_ids Either empty, a single mesh id shared by all entities, or count mesh ids. An id of -1 attaches no mesh.
+	 * @param material_ids Either empty, a single material id shared by all entities, or count material ids. An id of -1 attaches no material.
+	 * @returns the ids of the created entities
+	 */
+	static std::vector<uint32_t> createBatch(std::string name_prefix, uint32_t count,
+		const float* positions, uint32_t positions_length,
+		const float* rotations, uint32_t rotations_length,
+		const float* scales, uint32_t scales_length,
+		const int32_t* mesh_ids, uint32_t mesh_ids_length,
+		const int32_t* material_ids, uint32_t material_ids_length
+	);
+
 	/**
      * @param name The name of the entity to get
 	 * @returns an Entity who's name matches the given name 
@@ -149,6 +180,9 @@ public:
     /** Returns the simplified struct used to represent the current component */
 	EntityStruct &getStruct();
 
+	/** For internal use. Returns the instances of the first entity, indexed like getFrontStruct(). */
+	static const std::shared_ptr<const EntityInstances>* getFrontInstances();
+
     /** Connects a transform component to the current entity */
 	void setTransform(Transform* transform);
 
@@ -209,6 +243,29 @@ public:
 	/** @returns a reference to the connected volume component, or None/nullptr if no component is connected. */
 	Volume* getVolume();
 
+	/**
+	 * Turns the current entity into a group of instances of its mesh, from flat arrays (eg, numpy arrays).
+	 * Each instance is placed relative to the transform of the entity, and the entity itself is no longer 
+	 * rendered on its own. Instances are not components: no transform or entity is created per instance, 
+	 * so millions of them can be rendered at the cost of a few tens of bytes each.
+	 * 
+	 * Instances only apply to entities with a mesh, and are ignored for entities with a light, which are 
+	 * rendered on their own as usual. Replaces any instances set previously.
+	 * 
+	 * @param transforms 12 floats per instance, the row-major 3x4 affine matrix of each instance 
+	 * (eg, a numpy array of shape (N, 3, 4), flattened).
+	 * @param material_ids Either empty, to use the material of the entity for every instance, or one material 
+	 * id per instance. An id of -1 uses the material of the entity.
+	 */
+	void setInstances(const float* transforms, uint32_t transforms_length, 
+		const int32_t* material_ids = nullptr, uint32_t material_ids_length = 0);
+
+	/** Removes any instances from the current entity, which is then rendered on its own again. */
+	void clearInstances();
+
+	/** @returns the number of instances of the current entity, or 0 if it has none. */
+	uint32_t getInstanceCount();
+
 	/**
 	 * Objects can be set to be invisible to particular ray types:
 	 * @param camera Makes the object visible to camera rays
@@ -227,8 +284,8 @@ public:
 	/** For internal use. Returns the mutex used to lock entities for processing by the renderer. */
 	static std::shared_ptr<std::recursive_mutex> getEditMutex();
 
-	/** For internal use. */
-	void computeAabb();
+	/** For internal use. If updateScene is false, the scene bounds are left for the caller to recompute. */
+	void computeAabb(bool updateScene = true);
 
 	/** For internal use. */
 	void updateRenderables();
@@ -15,6 +15,8 @@ class Texture;
 */
 class Light : public StaticFactory {
     friend class StaticFactory;
+    friend class SceneFile;
+    friend class Randomizer;
     friend class Entity;
 public:
     /**
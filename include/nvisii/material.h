@@ -38,6 +38,8 @@ class Texture;
 class Material : public StaticFactory
 {
   friend class StaticFactory;
+  friend class SceneFile;
+  friend class Randomizer;
   friend class Entity;
   public:
 
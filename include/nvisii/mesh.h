@@ -71,6 +71,7 @@ namespace nvisii {
 class Mesh : public StaticFactory
 {
     friend class StaticFactory;
+    friend class SceneFile;
     friend class Entity;
     public:
         /**
@@ -671,7 +672,9 @@ class Mesh : public StaticFactory
          * Supported file formats include: AMF 3DS AC ASE ASSBIN B3D BVH COLLADA DXF 
          * CSM HMP IRRMESH IRR LWO LWS M3D MD2 MD3 MD5 MDC MDL NFF NDO OFF OBJ OGRE 
          * OPENGEX PLY MS3D COB BLEND IFC XGL FBX Q3D Q3BSP RAW SIB SMD STL 
-         * TERRAGEN 3D X X3D GLTF 3MF MMD
+         * TERRAGEN 3D X X3D GLTF 3MF MMD, as well as NVMESH files baked ahead of time by 
+         * the nvisii_bake tool, which load without any processing.
+         * The file is read without locking the other meshes, so several threads can load meshes at once.
          * 
          * @param name The name (used as a primary key) for this mesh component
          * @param path A path to the file.
@@ -718,6 +721,44 @@ class Mesh : public StaticFactory
             uint32_t texcoord_dimensions = 2, 
             std::vector<uint32_t> indices = std::vector<uint32_t>());
 
+        /**
+         * Creates a point cloud, a mesh drawn as one sphere per point rather than as triangles. Point clouds
+         * are intersected as spheres by the renderer and kept in their own compact acceleration structure,
+         * so that millions of points, eg from a depth map or a particle simulation, cost a few floats each
+         * rather than an entity or a tessellated sphere each. Like any other mesh, a point cloud is placed
+         * in the scene through an entity, which sets its transform and material.
+         * 
+         * @param name The name (used as a primary key) for this mesh component
+         * @param positions The center of each point, 3 floats per point. Must contain at least one point.
+         * @param radii Either a single radius shared by every point, or one radius per point
+         * @param colors Either empty, or one RGB or RGBA color per point (3 or 4 floats per point), which then replaces the base color of the material and scales its alpha
+         * @returns a reference to the mesh component
+        */
+        static Mesh* createPointCloud(
+            std::string name,
+            const float* positions, uint32_t positions_length,
+            const float* radii, uint32_t radii_length,
+            const float* colors = nullptr, uint32_t colors_length = 0);
+
+        /**
+         * Replaces the points of a point cloud in place, eg once per frame of a particle simulation. When the
+         * number of points is unchanged, the points are uploaded into the existing buffers, and the acceleration
+         * structure of the point cloud is rebuilt over the same geometry rather than created anew.
+         * 
+         * @param positions The center of each point, 3 floats per point. Must contain at least one point.
+         * @param radii Either empty to keep the current radii (only if the number of points is unchanged), 
+         * a single radius shared by every point, or one radius per point
+         * @param colors Either empty to keep the current colors (only if the number of points is unchanged), 
+         * or one RGB or RGBA color per point
+        */
+        void setPoints(
+            const float* positions, uint32_t positions_length,
+            const float* radii = nullptr, uint32_t radii_length = 0,
+            const float* colors = nullptr, uint32_t colors_length = 0);
+
+        /** @returns True if this mesh is a point cloud, made by createPointCloud, and False otherwise */
+        bool isPointCloud();
+
         /**
          * @param name The name of the Mesh to get
          * @returns a Mesh who's name matches the given name 
@@ -801,6 +842,9 @@ class Mesh : public StaticFactory
         /** @returns a list of triangle indices */
         std::vector<uint32_t> getTriangleIndices();
 
+        /** @returns the radius of each point, if this mesh is a point cloud, and an empty list otherwise */
+        std::vector<float> getRadii();
+
         // /* Returns a list of tetrahedra indices */
         // std::vector<uint32_t> get_tetrahedra_indices();		
 
@@ -913,6 +957,19 @@ class Mesh : public StaticFactory
 
     private:
 
+        /** Validates and copies the arrays given to createPointCloud or setPoints into this mesh */
+        void loadPoints(
+            const float* positions, uint32_t positions_length,
+            const float* radii, uint32_t radii_length,
+            const float* colors, uint32_t colors_length);
+
+        /** Computes per vertex tangents by averaging the tangents of the neighboring faces. Touches no component state. */
+        static void computeSmoothTangents(
+            const std::vector<std::array<float, 3>> &positions,
+            const std::vector<glm::vec2> &texCoords,
+            const std::vector<uint32_t> &triangleIndices,
+            std::vector<glm::vec4> &tangents);
+
         static std::set<Mesh*> dirtyMeshes;
 
         /* TODO */
@@ -938,6 +995,9 @@ class Mesh : public StaticFactory
         std::vector<uint32_t> triangleIndices;
         // std::vector<uint32_t> edge_indices;
 
+        /* One radius per point if the mesh is a point cloud, and empty otherwise. Point cloud colors are kept in colors. */
+        std::vector<float> radii;
+
         // /* A handle to the buffer containing per vertex positions */
         // vk::Buffer pointBuffer;
         // vk::DeviceMemory pointBufferMemory;
@@ -18,4 +18,6 @@ struct MeshStruct {
     int32_t show_bounding_box; // 56
     int32_t numTris; // 60
     int32_t numVerts; // 64
+    /* Non-zero if the mesh is a point cloud, drawn as one sphere per point rather than as triangles */
+    int32_t numPoints; // 68
 };
@@ -8,6 +8,8 @@
 #include <nvisii/texture.h>
 #include <nvisii/volume.h>
 
+#include <future>
+
 namespace nvisii {
 
 /**
@@ -54,6 +56,13 @@ void initializeHeadless(
   * @param max_materials The max number of creatable Material components.
   * @param max_lights The max number of creatable Light components.
   * @param max_textures The max number of creatable Texture components.
+  * @param max_volumes The max number of creatable Volume components.
+  * @param backend The renderer to use. Either "optix" for the GPU path tracer, or "cpu" for a multithreaded 
+  * CPU path tracer which does not require a GPU. The cpu backend always runs headless, and does not 
+  * yet support volumes or the denoiser.
+  * @param num_threads The number of threads used for host side work, like CPU rendering and building 
+  * dome light importance maps. If 0, uses the number of threads this process may run at once, 
+  * respecting its CPU affinity and cgroup CPU quota. See set_thread_count.
 */
 void initialize(
   bool headless = false, 
@@ -67,7 +76,9 @@ void initialize(
   uint32_t max_materials = 10000,
   uint32_t max_lights = 100,
   uint32_t max_textures = 1000,
-  uint32_t max_volumes = 1000);
+  uint32_t max_volumes = 1000,
+  std::string backend = "optix",
+  uint32_t num_threads = 0);
 
 /**
   * Removes any allocated components but keeps nvisii initialized.
@@ -137,12 +148,51 @@ void setDomeLightColor(glm::vec3 color);
  * @param atmosphere_thickness effects Rayleigh scattering. Thin atmospheres look more 
  * like space, and thick atmospheres see more Rayleigh scattering.
  * @param saturation causes the sky to appear more or less "vibrant"
+ * @param width The width in texels of the generated sky texture
+ * @param height The height in texels of the generated sky texture
+ * @param enable_cdf If True, importance samples the sky (and the sun in particular), 
+ * reducing noise at a small expense of frame rate.
+ * @param max_cdf_width If non-zero, the importance map used when enable_cdf is True
+ * is downsampled to at most this many texels wide, independent of the sky resolution.
+ * 
+ * Generated skies are cached, so returning to a previously used set of sky parameters 
+ * is nearly free. See precompute_dome_light_sky and set_dome_light_sky_cache_size.
  */ 
 void setDomeLightSky(
     glm::vec3 sun_position, 
     glm::vec3 sky_tint = vec3(.5f, .5f, .5f), 
     float atmosphere_thickness = 1.0f,
-    float saturation = 1.0f);
+    float saturation = 1.0f,
+    uint32_t width = 512,
+    uint32_t height = 256,
+    bool enable_cdf = false,
+    uint32_t max_cdf_width = 0);
+
+/** 
+ * Generates and caches procedural skies for a sequence of sun positions ahead of time, 
+ * eg for a time-lapse. Subsequent calls to set_dome_light_sky with any of these sun positions 
+ * and the same remaining parameters then skip sky generation entirely. 
+ * The sky cache grows to fit the whole sequence if needed.
+ * 
+ * @param sun_positions The sequence of sun positions to generate skies for
+ * See set_dome_light_sky for the remaining parameters.
+ */ 
+void precomputeDomeLightSky(
+    std::vector<glm::vec3> sun_positions, 
+    glm::vec3 sky_tint = vec3(.5f, .5f, .5f), 
+    float atmosphere_thickness = 1.0f,
+    float saturation = 1.0f,
+    uint32_t width = 512,
+    uint32_t height = 256,
+    bool enable_cdf = false,
+    uint32_t max_cdf_width = 0);
+
+/** 
+ * Sets how many generated procedural skies are kept around for reuse. 
+ * The least recently used skies are discarded first. 
+ * @param size The maximum number of cached skies. Defaults to 16.
+ */ 
+void setDomeLightSkyCacheSize(uint32_t size);
 
 /** 
  * Sets the texture used to color the dome light (aka the environment). 
@@ -152,8 +202,11 @@ void setDomeLightSky(
  * @param enable_cdf If True, reduces noise of sampling a dome light texture, 
  * but at the expense of frame rate. Useful for dome lights with bright lights 
  * that should cast shadows.
+ * @param max_cdf_width If non-zero, the importance map used when enable_cdf is True
+ * is downsampled to at most this many texels wide. Useful for very large (eg 8K) HDRIs,
+ * where a 1K or 2K importance map is usually just as effective and much faster to build.
  */ 
-void setDomeLightTexture(Texture* texture, bool enable_cdf = false);
+void setDomeLightTexture(Texture* texture, bool enable_cdf = false, uint32_t max_cdf_width = 0);
 
 /** Disconnects the dome light texture, reverting back to any existing constant dome light color */
 void clearDomeLightTexture();
@@ -172,6 +225,19 @@ void enableDomeLightSampling();
  * Instead, the dome light will only effect the background color. */
 void disableDomeLightSampling();
 
+/** 
+ * If enabled, light sources are picked for shadow rays using a light bounding volume hierarchy, 
+ * which favors lights that are close to, and facing towards, the point being shaded. 
+ * Greatly reduces noise in scenes with many light sources. Enabled by default.
+ */
+void enableLightTree();
+
+/** 
+ * If disabled, light sources are picked for shadow rays in proportion to their estimated power, 
+ * regardless of where they are relative to the point being shaded. 
+ */
+void disableLightTree();
+
 /** 
  * Clamps the indirect light intensity during progressive image refinement. 
  * This reduces fireflies from indirect lighting, but also removes energy, and biases the resulting image.
@@ -221,6 +287,19 @@ void setMaxBounceDepth(
  */
 void setLightSampleCount(uint32_t count);
 
+/** 
+ * Sets the sampler used to generate the random numbers of each path. Low discrepancy samplers stratify 
+ * samples against each other within a pixel, reducing noise at low sample counts. Combined with the seed 
+ * given to render, the result is deterministic.
+ * 
+ * @param sampler One of 
+ * "independent" (uncorrelated random numbers), 
+ * "sobol" (Owen scrambled Sobol points, the default), 
+ * "pmj02" (Owen scrambled (0,2) sequences, stratified like progressive multi-jittered samples), or 
+ * "blue_noise" ((0,2) sequences dithered between pixels, which distributes the remaining error as blue noise).
+ */
+void setSampler(std::string sampler);
+
 /** 
  * Sets the region of the pixel where rays should sample. By default, rays sample the entire
  * pixel area between [0,1]. Rays can instead sample a specific location of the pixel, like the pixel center,
@@ -242,6 +321,50 @@ void samplePixelArea(glm::vec2 x_sample_interval = glm::vec2(0.f, 1.f), glm::vec
  */ 
 void sampleTimeInterval(glm::vec2 time_sample_interval = glm::vec2(0.f, 1.f));
 
+/**
+ * Enables adaptive sampling for subsequent calls to render. The image is split into square tiles, and
+ * the error of each tile is periodically estimated by comparing the mean of all samples against the mean
+ * of every other sample. Tiles whose error drops below the threshold stop taking samples, and the samples
+ * they save are spent on the tiles that are still noisy. The samples per pixel given to render then become
+ * an average budget across the image, rather than a fixed count for every pixel.
+ *
+ * @param error_threshold Tiles whose mean relative pixel error falls below this value are considered converged.
+ * Smaller values give cleaner images at the cost of more samples.
+ * @param min_samples The number of samples every pixel takes before its tile may converge.
+ * @param max_sample_scale Limits the samples any pixel may take to this multiple of the samples per pixel given to render.
+ * @param tile_size The width and height of each tile in pixels.
+ */
+void enableAdaptiveSampling(float error_threshold = .01f, uint32_t min_samples = 16, float max_sample_scale = 4.f, uint32_t tile_size = 16);
+
+/** Disables adaptive sampling, so that every pixel takes the samples per pixel given to render. */
+void disableAdaptiveSampling();
+
+/**
+ * Enables temporal accumulation for subsequent calls to render, so that each frame of an animation reuses
+ * the samples of the frames before it. Every pixel follows its motion vector back into the previous frame's
+ * result, rejects it where a different surface was seen there (eg where an object moved away and revealed
+ * what was behind it), and blends what remains with the new samples. Animations can then be rendered
+ * with a fraction of the samples per pixel otherwise needed.
+ *
+ * Motion vectors come from the previous transforms of the camera and the objects, so as with motion blur,
+ * set the "previous" pose of everything that moved before rendering each frame.
+ *
+ * @param max_history_samples The most samples per pixel the previous frames may contribute. Lower values
+ * respond faster to changes in lighting and shading, at the cost of more noise.
+ * @param depth_tolerance The relative difference in distance to the camera beyond which the previous frame
+ * is considered to show a different surface.
+ */
+void enableTemporalAccumulation(float max_history_samples = 64.f, float depth_tolerance = .1f);
+
+/** Disables temporal accumulation, so that every frame is rendered from scratch. */
+void disableTemporalAccumulation();
+
+/**
+ * Discards the frames accumulated so far by temporal accumulation, eg after a camera cut,
+ * so that the next frame is rendered from scratch.
+ */
+void clearTemporalHistory();
+
 /** Enables the Optix denoiser. */
 void enableDenoiser();
 
@@ -264,10 +387,156 @@ void configureDenoiser(bool use_albedo_guide = true, bool use_normal_guide = tru
  * 
  * @param width The width of the image to render
  * @param height The height of the image to render
- * @param samples_per_pixel The number of rays to trace and accumulate per pixel.
+ * @param samples_per_pixel The number of rays to trace and accumulate per pixel. With a time budget, this is the 
+ * most that will be taken. With adaptive sampling enabled, this is instead the average taken across the image.
+ * @param seed A seed used to initialize the random number generator.
+ * @param time_budget_ms If greater than 0, stops accumulating samples once another pass would exceed this many 
+ * milliseconds, returning the image as refined so far. At least one sample per pixel is always taken. 
+ * Combine with enable_adaptive_sampling to also stop early once a target noise level is reached.
+ * Use get_rendered_samples_per_pixel to find how many samples were actually taken.
+*/
+std::vector<float> render(uint32_t width, uint32_t height, uint32_t samples_per_pixel, uint32_t seed = 0, float time_budget_ms = 0.f);
+
+/** A frame requested with render_async, whose pixels become available once it has been rendered and read back */
+class RenderHandle {
+public:
+    RenderHandle() {}
+    RenderHandle(uint64_t frameID, std::shared_future<std::vector<float>> future);
+
+    /** Blocks until the frame has been rendered and read back */
+    void wait();
+
+    /** @returns True if the frame has been rendered and read back, so that get will not block */
+    bool ready();
+
+    /** 
+     * Waits for the frame, then returns its framebuffer, in the same layout as render.
+     * If rendering the frame failed, raises the error instead.
+     */
+    std::vector<float> get();
+
+    /** @returns the number of the frame, counting up from 0 across all calls to render_async */
+    uint64_t getFrameID();
+
+private:
+    uint64_t frameID = 0;
+    std::shared_future<std::vector<float>> future;
+};
+
+/**
+ * Like render, but returns as soon as the frame is queued, so that the next frame can be set up while this one
+ * renders. The frame shows the scene as it is at the time of the call (or as of the last commit, with manual
+ * commits enabled), whatever edits follow. Frames render and become ready in the order they were requested.
+ * Blocks only while the maximum number of frames is already in flight (see set_max_frames_in_flight).
+ *
+ * @param width The width of the image to render
+ * @param height The height of the image to render
+ * @param samples_per_pixel The number of rays to trace and accumulate per pixel
  * @param seed A seed used to initialize the random number generator.
+ * @param time_budget_ms If greater than 0, stops accumulating samples once another pass would exceed this many milliseconds.
+ * @returns a handle to wait on the frame and get its framebuffer
 */
-std::vector<float> render(uint32_t width, uint32_t height, uint32_t samples_per_pixel, uint32_t seed = 0);
+RenderHandle renderAsync(uint32_t width, uint32_t height, uint32_t samples_per_pixel, uint32_t seed = 0, float time_budget_ms = 0.f);
+
+/**
+ * Sets how many frames requested with render_async may be rendering or reading back at once. 
+ * Each frame in flight holds its own readback buffer. Defaults to 2.
+ * @param count The number of frames, at least 1
+*/
+void setMaxFramesInFlight(uint32_t count);
+
+/** @returns how many frames requested with render_async may be rendering or reading back at once */
+uint32_t getMaxFramesInFlight();
+
+/**
+ * @returns the average number of samples per pixel taken by the most recent call to render, which can be 
+ * lower than requested when render was given a time budget, or differ per pixel under adaptive sampling.
+ */
+float getRenderedSamplesPerPixel();
+
+/**
+ * Returns timings and counters for the most recent frames, where a frame is a call to render or render_data,
+ * or one refresh of the interactive window. Each frame is a dictionary, which may include:
+ * 
+ * "frame": The index of the frame since initialization or clear_frame_statistics.
+ * "frame_ms": The wall time of the whole frame.
+ * "<stage>_ms": The wall time spent in a stage, summed over the frame. Stages include "update_components", 
+ * which is broken down into "mesh_update", "volume_update", "entity_update" (TLAS rebuilds), "texture_material_update", 
+ * "transform_update" and "light_selection_update", followed by "launch", "denoise", "adaptive_update", 
+ * "temporal_accumulation" and "readback".
+ * "<stage>_gpu_ms": The GPU time spent in a stage, measured with CUDA events, for "launch", "denoise" and "temporal_accumulation".
+ * Counters: "meshes_updated", "volumes_updated", "entities_updated", "textures_updated", "materials_updated", 
+ * "transforms_updated", "blas_builds", "tlas_builds", "textures_created", and "bytes_uploaded".
+ * "samples_per_pixel": The average samples per pixel taken by a call to render.
+ * 
+ * Entries only appear in frames where they were recorded. Work done between frames, like creating components, 
+ * is recorded in the next frame.
+ * 
+ * @param frame_count The number of frames to return. Fewer are returned if fewer are kept.
+ * @returns A list of frames, oldest first.
+ */
+std::vector<std::map<std::string, double>> getFrameStatistics(uint32_t frame_count = 1);
+
+/** 
+ * Sets how many frames of statistics are kept for get_frame_statistics. Defaults to 120. 
+ * @param frame_count The number of frames to keep.
+ */
+void setFrameStatisticsHistorySize(uint32_t frame_count);
+
+/** Discards all frame statistics collected so far. */
+void clearFrameStatistics();
+
+/**
+ * Starts recording a trace of what each thread is doing, which save_trace writes out for viewing in 
+ * chrome://tracing or ui.perfetto.dev. The trace shows frames and the stages listed under get_frame_statistics,
+ * commands sent to the render thread (with arrows from where they were sent), image encodes, and asset loads.
+ * 
+ * @param events_per_thread The number of events kept for each thread. Once a thread records more, 
+ * its oldest events are discarded.
+ */
+void enableTracing(uint32_t events_per_thread = 65536);
+
+/** Stops recording a trace, keeping the events recorded so far. */
+void disableTracing();
+
+/** Discards all events recorded by enable_tracing so far. */
+void clearTrace();
+
+/**
+ * Writes the events recorded since enable_tracing to a file, in the Chrome trace event (JSON) format.
+ * @param path The path of the file to write, usually ending in ".json".
+ */
+void saveTrace(std::string path);
+
+/**
+ * Reports the host and device memory used by the scene, in bytes. Each entry of the returned dictionary 
+ * holds a "host_bytes" and a "device_bytes" value. Entries are named "<category>" for the total of a category, 
+ * "<category>/<name>" for one of its members, and "total" for everything. Categories include:
+ * 
+ * "mesh", "texture" and "volume": Per named component, its host data, plus its device buffers. 
+ * For meshes and volumes, the device memory includes the bottom level acceleration structure, 
+ * counted at its size before compaction.
+ * "factories": Per component type, the arrays preallocated by initialize, and their device copies.
+ * "frame_buffers": The frame buffer, accumulation buffer, denoiser guides and other per pixel buffers.
+ * "scene": Top level acceleration structures and light sampling tables.
+ * 
+ * Component data is accounted for once the component has been uploaded by the renderer, 
+ * so recently created components may not be included until the next render.
+ */
+std::map<std::string, std::map<std::string, double>> getMemoryUsage();
+
+/**
+ * Sets the number of threads used for host side work, like CPU rendering and building dome light 
+ * importance maps. All of this work shares one pool of threads, so it never runs more threads than this, 
+ * even when it overlaps. Waits for any work already queued on the pool to finish.
+ * @param num_threads The number of threads, including the thread which starts the work. If 0, uses the 
+ * number of threads this process may run at once, respecting its CPU affinity and cgroup CPU quota. 
+ * The NVISII_NUM_THREADS environment variable overrides that default.
+ */
+void setThreadCount(uint32_t num_threads);
+
+/** @returns the number of threads used for host side work. See set_thread_count. */
+uint32_t getThreadCount();
 
 /** 
  * Deprecated. Please use renderToFile. 
@@ -371,6 +640,71 @@ Scene importScene(
         glm::quat rotation = glm::angleAxis(0.0f, glm::vec3(1.0f, 0.0f, 0.0f)),
         std::vector<std::string> args = std::vector<std::string>());
 
+/**
+ * Saves every component to a binary ".nvscene" file, including names, entity bindings, the transform hierarchy,
+ * material parameters, and the mesh, texture and volume data, so that loadScene can restore the scene exactly.
+ * Renderer settings like the camera entity and the dome light are not part of the file.
+ *
+ * @param file_path The path of the file to write
+*/
+void saveScene(std::string file_path);
+
+/**
+ * Replaces every component with those saved to a ".nvscene" file by saveScene.
+ * Components keep the ids they were saved with, so nvisii must have been initialized with at least as many
+ * components of each type as the scene used. Since the file stores components the way they are held in memory,
+ * loading involves no importing or recomputation, and is much faster than rebuilding the scene.
+ * Set the camera entity again after loading.
+ *
+ * @param file_path The path of the file to read
+*/
+void loadScene(std::string file_path);
+
+/**
+ * Adds a randomizer, which draws one attribute of a set of entities from a distribution every time randomize is called.
+ * Randomizing in bulk this way is much faster than setting each value from Python, since every draw is made natively,
+ * in parallel, and the affected components are updated together.
+ *
+ * @param attribute The attribute to randomize. 
+ * Transform attributes: "position", "rotation", "scale", "uniform_scale".
+ * Material attributes: "base_color", "subsurface_color", "subsurface_radius", "alpha", "subsurface", "metallic", "specular", 
+ * "specular_tint", "roughness", "anisotropic", "anisotropic_rotation", "sheen", "sheen_tint", "clearcoat", "clearcoat_roughness", 
+ * "ior", "transmission", "transmission_roughness".
+ * Light attributes: "light_color", "light_temperature", "light_intensity", "light_exposure", "light_falloff".
+ * Attributes are applied to the transform, material, or light attached to each entity. Entities without one are skipped.
+ * @param entities The names of the entities to randomize. A name ending in "*" matches every entity whose name starts 
+ * with the rest of the name, eg "obj_*". Every name must match an entity when the randomizer is added. Names are 
+ * matched again each time randomize is called, so entities created or removed since are included or skipped.
+ * @param distribution One of: 
+ * "uniform" - parameters are the minimum and maximum, either as 2 floats shared by all components of the attribute, 
+ * or as the minimum of each component followed by the maximum of each component. 
+ * "normal" - parameters are the mean and standard deviation, laid out like the uniform distribution's parameters.
+ * "choice" - parameters are a list of values to pick from with equal probability, one after another.
+ * "uniform_hsv" - for colors only. Parameters are the minimum hue, saturation and value, followed by the maximums.
+ * Rotations are drawn as (x, y, z) euler angles in radians, except that "uniform" with no parameters draws uniformly 
+ * distributed orientations, and "choice" picks from (x, y, z, w) quaternions.
+ * @param parameters The parameters of the distribution
+ * @returns the index of the randomizer. Randomizers are applied in the order they were added.
+*/
+uint32_t addRandomizer(std::string attribute, std::vector<std::string> entities, std::string distribution = "uniform", std::vector<float> parameters = std::vector<float>());
+
+/** Removes all randomizers */
+void clearRandomizers();
+
+/** 
+ * Sets the seed used by randomize. 
+ * @param seed Together with the frame passed to randomize, determines every value drawn.
+*/
+void setRandomizerSeed(uint32_t seed);
+
+/**
+ * Applies every randomizer added by addRandomizer. 
+ * A value depends only on the seed, the frame, the randomizer and the entity, so the same frame always gives the 
+ * same scene, independent of the frames randomized before it.
+ * @param frame The frame to randomize the scene for
+*/
+void randomize(uint32_t frame = 0);
+
 /** @returns the minimum axis aligned bounding box position for the axis aligned bounding box containing all scene geometry*/
 glm::vec3 getSceneMinAabbCorner();
 
@@ -400,6 +734,26 @@ void disableUpdates();
 /*** If in interactive mode, returns true if updates are enabled, and false otherwise */
 bool areUpdatesEnabled();
 
+/**
+ * Publishes all component edits made since the previous commit to the renderer, as one consistent change.
+ * The renderer only ever sees committed edits, and reads them from its own copy of the scene, so edits
+ * made while a frame is being prepared never show up half applied, and never wait on the renderer.
+ * Unless manual commits are enabled, every frame commits automatically before rendering.
+ */
+void commit();
+
+/**
+ * Stops frames from committing edits automatically. Edits then only reach the renderer through commit(),
+ * which allows building up a scene change over several frames without any of it showing until it is complete.
+ */
+void enableManualCommit();
+
+/** Makes every frame commit all edits made so far before rendering again. This is the default. */
+void disableManualCommit();
+
+/** @returns true if edits only reach the renderer through commit() */
+bool isManualCommitEnabled();
+
 /**
   * If using interactive mode, resizes the window to the specified dimensions.
   * 
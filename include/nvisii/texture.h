@@ -6,6 +6,8 @@
 #include <nvisii/utilities/static_factory.h>
 #include <nvisii/texture_struct.h>
 
+struct NoiseParameters;
+
 namespace nvisii {
 
 /**
@@ -14,6 +16,7 @@ namespace nvisii {
 class Texture : public StaticFactory
 {
 	friend class StaticFactory;
+	friend class SceneFile;
 	friend class Material;
 	friend class Light;
   public:
@@ -43,7 +46,9 @@ class Texture : public StaticFactory
 	/** 
 	 * Constructs a Texture with the given name from a file. 
 	 * @param name The name of the texture to create.
-	 * Supported formats include JPEG, PNG, TGA, BMP, PSD, GIF, HDR, PIC, PNM, KTX, and DDS
+	 * Supported formats include JPEG, PNG, TGA, BMP, PSD, GIF, HDR, PIC, PNM, KTX, and DDS.
+	 * KTX and DDS files can be baked ahead of time with the nvisii_bake tool.
+	 * The image is decoded without locking the other textures, so several threads can load textures at once.
 	 * @param path The path to the image.
 	 * @param linear Indicates the image is already linear and should not be gamma corrected. Ignored for KTX, DDS, and HDR formats.
      * @returns a Texture allocated by the renderer. 
@@ -108,6 +113,78 @@ class Texture : public StaticFactory
 	*/
 	static Texture* createHSV(std::string name, Texture* tex, float hue, float saturation, float value, float mix = 1.0, bool hdr = false);
 
+	/** 
+	 * Constructs a Texture with the given name from fractal gradient noise (Perlin or simplex fBm).
+	 * Each of the four channels holds an independent noise signal between 0 and 1, so that a single 
+	 * texture can drive several material parameters through different channels.
+	 * The noise is evaluated on the host over all available threads, without locking the other textures.
+	 * @param name The name of the texture to create.
+	 * @param width The width of the image.
+	 * @param height The height of the image.
+	 * @param seed Selects one of many distinct noise patterns.
+	 * @param frequency The number of noise cells across the width of the texture, for the first octave.
+	 * @param octaves The number of layers of noise added together, each finer than the last. Between 1 and 16.
+	 * @param lacunarity The factor the frequency grows by from one octave to the next.
+	 * @param gain The factor the amplitude shrinks by from one octave to the next.
+	 * @param simplex If true, uses simplex noise, which has fewer axis aligned artifacts. Simplex noise cannot be tileable.
+	 * @param tileable If true, the texture repeats seamlessly. The frequency of every octave is rounded to a whole number.
+	 * @param hdr If true, represents the channels of the texture using 32 bit floats. Otherwise, textures are stored natively using 8 bits per channel.
+	 * @returns a Texture allocated by the renderer. 
+	*/
+	static Texture *createNoise(std::string name, uint32_t width, uint32_t height, uint32_t seed = 0, 
+		float frequency = 4.f, uint32_t octaves = 6, float lacunarity = 2.f, float gain = .5f, 
+		bool simplex = false, bool tileable = false, bool hdr = false);
+
+	/** 
+	 * Constructs a Texture with the given name from turbulence, which adds up the absolute values of 
+	 * each octave of gradient noise, giving billowy, cloud and marble like patterns.
+	 * Takes the same parameters as createNoise.
+	 * @returns a Texture allocated by the renderer. 
+	*/
+	static Texture *createNoiseTurbulence(std::string name, uint32_t width, uint32_t height, uint32_t seed = 0, 
+		float frequency = 4.f, uint32_t octaves = 6, float lacunarity = 2.f, float gain = .5f, 
+		bool simplex = false, bool tileable = false, bool hdr = false);
+
+	/** 
+	 * Constructs a Texture with the given name from cellular (Worley) noise, the distance from each texel 
+	 * to the nearest of a set of randomly placed feature points. Useful for stones, cells and scales.
+	 * @param name The name of the texture to create.
+	 * @param width The width of the image.
+	 * @param height The height of the image.
+	 * @param seed Selects one of many distinct noise patterns.
+	 * @param frequency The number of cells across the width of the texture, for the first octave.
+	 * @param octaves The number of layers of noise added together, each finer than the last. Between 1 and 16.
+	 * @param lacunarity The factor the frequency grows by from one octave to the next.
+	 * @param gain The factor the amplitude shrinks by from one octave to the next.
+	 * @param jitter How far feature points may stray from a regular grid, from 0 (a grid) to 1.
+	 * @param tileable If true, the texture repeats seamlessly. The frequency of every octave is rounded to a whole number.
+	 * @param hdr If true, represents the channels of the texture using 32 bit floats. Otherwise, textures are stored natively using 8 bits per channel.
+	 * @returns a Texture allocated by the renderer. 
+	*/
+	static Texture *createNoiseCellular(std::string name, uint32_t width, uint32_t height, uint32_t seed = 0, 
+		float frequency = 8.f, uint32_t octaves = 1, float lacunarity = 2.f, float gain = .5f, 
+		float jitter = 1.f, bool tileable = false, bool hdr = false);
+
+	/** 
+	 * Constructs a Texture with the given name from domain warped gradient noise, where the lookup position 
+	 * of each texel is displaced by two more noise signals, giving swirling, flowing patterns.
+	 * @param name The name of the texture to create.
+	 * @param width The width of the image.
+	 * @param height The height of the image.
+	 * @param seed Selects one of many distinct noise patterns.
+	 * @param frequency The number of noise cells across the width of the texture, for the first octave.
+	 * @param octaves The number of layers of noise added together, each finer than the last. Between 1 and 16.
+	 * @param lacunarity The factor the frequency grows by from one octave to the next.
+	 * @param gain The factor the amplitude shrinks by from one octave to the next.
+	 * @param warp How far the lookup position is displaced, in noise cells of the first octave.
+	 * @param tileable If true, the texture repeats seamlessly. The frequency of every octave is rounded to a whole number.
+	 * @param hdr If true, represents the channels of the texture using 32 bit floats. Otherwise, textures are stored natively using 8 bits per channel.
+	 * @returns a Texture allocated by the renderer. 
+	*/
+	static Texture *createNoiseWarped(std::string name, uint32_t width, uint32_t height, uint32_t seed = 0, 
+		float frequency = 4.f, uint32_t octaves = 6, float lacunarity = 2.f, float gain = .5f, 
+		float warp = 1.f, bool tileable = false, bool hdr = false);
+
     /**
      * @param name The name of the Texture to get
 	 * @returns a Texture who's name matches the given name 
@@ -132,6 +209,12 @@ class Texture : public StaticFactory
 	// for internal use
 	int32_t getAddress();
 
+	/** 
+	 * For internal use. Reads a single texel without copying the texel list.
+	 * @returns the luminance of the texel at the given coordinates, converting sRGB texels to linear.
+	*/
+	float getLinearLuminance(uint32_t x, uint32_t y);
+
 	/** @returns A map whose key is a texture name and whose value is the ID for that texture */
 	static std::map<std::string, uint32_t> getNameToIdMap();
 
@@ -229,6 +312,9 @@ class Texture : public StaticFactory
     std::vector<vec4> floatTexels;
     std::vector<u8vec4> byteTexels;
 	bool linear = false;
+
+	/* Validates the parameters, then generates the noise without holding the edit mutex */
+	static Texture *createNoiseTexture(std::string name, uint32_t width, uint32_t height, const NoiseParameters &parameters, bool hdr);
 };
 
 };
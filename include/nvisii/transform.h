@@ -32,6 +32,8 @@ namespace nvisii {
 class Transform : public StaticFactory
 {
     friend class StaticFactory;
+    friend class SceneFile;
+    friend class Randomizer;
     friend class Entity;
 
   private:
@@ -93,6 +95,12 @@ class Transform : public StaticFactory
     /* Updates cached final local to world matrix values */
     void updateWorldMatrix();
 
+    /* Recomputes the local to parent matrices, without updating children or marking anything dirty */
+    void computeLocalMatrices();
+
+    /* Recomputes the local to world matrices from the ancestors, without marking anything dirty */
+    void computeWorldMatrices();
+
     /* updates all childrens cached final local to world matrix values */
     void updateChildren();
 
@@ -0,0 +1,219 @@
+#pragma once
+
+#ifdef __CUDACC__
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR __both__
+#endif
+#else
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR
+#endif
+#endif
+
+#include <stdint.h>
+#include <math.h>
+
+#ifndef __CUDA_ARCH__
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#endif
+
+/* Tile mask values. Pixels in converged tiles take no further samples. */
+#define ADAPTIVE_TILE_ACTIVE 1
+#define ADAPTIVE_TILE_CONVERGED 0
+
+/**
+ * @returns the index of the adaptive sampling tile a pixel belongs to
+ * @param x The pixel's column
+ * @param y The pixel's row, counted from the top of the image like the launch index
+ * @param width The frame width
+ * @param tileSize The width and height of each tile in pixels
+ */
+inline CUDA_DECORATOR
+uint32_t adaptiveTileIndex(uint32_t x, uint32_t y, uint32_t width, uint32_t tileSize)
+{
+    uint32_t tilesX = (width + tileSize - 1) / tileSize;
+    return (y / tileSize) * tilesX + (x / tileSize);
+}
+
+/**
+ * Estimates the remaining error of a pixel by comparing the mean of all of its samples against
+ * the mean of only its even numbered samples (Dammertz et al., "A Hierarchical Automatic Stopping
+ * Condition for Monte Carlo Global Illumination"). Normalizing by the square root of the
+ * intensity approximates the perceived, rather than the absolute, difference.
+ */
+inline CUDA_DECORATOR
+float adaptivePixelError(float r, float g, float b, float halfR, float halfG, float halfB)
+{
+    float difference = fabsf(r - halfR) + fabsf(g - halfG) + fabsf(b - halfB);
+    float intensity = r + g + b;
+    // The small floor stops black pixels with a few bright samples from never converging
+    return difference / sqrtf(fmaxf(intensity, 1e-4f));
+}
+
+#ifndef __CUDA_ARCH__
+/**
+ * Decides which tiles of an image still need samples during a progressive render.
+ *
+ * Each pass renders one sample for every pixel in the active tiles. Every so often the
+ * accumulated frame is handed back to updateConvergence, which retires tiles whose error
+ * dropped below the threshold. The samples they no longer take stay in the budget, and
+ * are spent on the remaining tiles, up to a per pixel maximum.
+ *
+ * Tiles only ever go from active to converged. All active tiles therefore have taken the
+ * same number of samples, which is simply the number of passes so far.
+ */
+class AdaptiveSampler {
+public:
+    /**
+     * Starts a new render with all tiles active.
+     * @param width The frame width
+     * @param height The frame height
+     * @param tileSize The width and height of each tile in pixels
+     * @param errorThreshold Tiles whose mean pixel error is below this value are considered converged
+     * @param minSamples The number of samples every pixel takes before its tile may converge
+     * @param maxSamples The largest number of samples any pixel may take
+     * @param sampleBudget The total number of samples to take across all pixels
+     */
+    void reset(uint32_t width, uint32_t height, uint32_t tileSize, float errorThreshold,
+        uint32_t minSamples, uint32_t maxSamples, uint64_t sampleBudget)
+    {
+        this->width = width;
+        this->height = height;
+        this->tileSize = std::max(tileSize, 1u);
+        this->errorThreshold = errorThreshold;
+        this->minSamples = minSamples;
+        this->maxSamples = std::max(maxSamples, 1u);
+        this->sampleBudget = sampleBudget;
+        tilesX = (width + this->tileSize - 1) / this->tileSize;
+        tilesY = (height + this->tileSize - 1) / this->tileSize;
+        tileMask.assign(tilesX * tilesY, ADAPTIVE_TILE_ACTIVE);
+        tileErrors.assign(tilesX * tilesY, INFINITY);
+        tilePixels.resize(tilesX * tilesY);
+        for (uint32_t ty = 0; ty < tilesY; ++ty) {
+            for (uint32_t tx = 0; tx < tilesX; ++tx) {
+                uint32_t w = std::min(this->tileSize, width - tx * this->tileSize);
+                uint32_t h = std::min(this->tileSize, height - ty * this->tileSize);
+                tilePixels[ty * tilesX + tx] = w * h;
+            }
+        }
+        activeTiles = tilesX * tilesY;
+        activePixels = uint64_t(width) * uint64_t(height);
+        passes = 0;
+        lastUpdate = 0;
+        samplesTaken = 0;
+        maxError = INFINITY;
+    }
+
+    /** Records that one more sample was taken for every pixel in the active tiles */
+    void advance()
+    {
+        passes++;
+        samplesTaken += activePixels;
+    }
+
+    /**
+     * @returns true once enough passes happened since the last update to make another worthwhile.
+     * Updates get sparser as the render progresses, so that reading back the frame stays cheap.
+     */
+    bool needsConvergenceUpdate() const
+    {
+        if (passes < minSamples) return false;
+        return (passes - lastUpdate) >= std::max(4u, passes / 4);
+    }
+
+    /**
+     * Re-estimates the error of every active tile, retiring those that converged.
+     * Both buffers are stored bottom row first, like the frame buffer.
+     * @param mean The mean of all samples taken so far
+     * @param halfMean The mean of the even numbered samples taken so far
+     * @returns true if any tile converged
+     */
+    bool updateConvergence(const glm::vec4* mean, const glm::vec4* halfMean)
+    {
+        lastUpdate = passes;
+        std::vector<double> sums(tileMask.size(), 0.0);
+        for (uint32_t y = 0; y < height; ++y) {
+            const glm::vec4* row = mean + size_t(width) * ((height - 1) - y);
+            const glm::vec4* halfRow = halfMean + size_t(width) * ((height - 1) - y);
+            uint32_t tileRow = (y / tileSize) * tilesX;
+            for (uint32_t x = 0; x < width; ++x) {
+                uint32_t tile = tileRow + x / tileSize;
+                if (tileMask[tile] != ADAPTIVE_TILE_ACTIVE) continue;
+                float e = adaptivePixelError(row[x].r, row[x].g, row[x].b, halfRow[x].r, halfRow[x].g, halfRow[x].b);
+                sums[tile] += (isfinite(e)) ? e : 1e20;
+            }
+        }
+
+        bool anyConverged = false;
+        maxError = 0.f;
+        for (uint32_t tile = 0; tile < tileMask.size(); ++tile) {
+            if (tileMask[tile] != ADAPTIVE_TILE_ACTIVE) continue;
+            tileErrors[tile] = float(sums[tile] / double(tilePixels[tile]));
+            if (tileErrors[tile] < errorThreshold || passes >= maxSamples) {
+                retireTile(tile);
+                anyConverged = true;
+            }
+            else maxError = std::max(maxError, tileErrors[tile]);
+        }
+        return anyConverged;
+    }
+
+    /** @returns true once all tiles converged, the sample budget is spent, or no pixel may take another sample */
+    bool isDone() const
+    {
+        return activeTiles == 0 || samplesTaken >= sampleBudget || passes >= maxSamples;
+    }
+
+    /** @returns one value per tile, in row major order from the top of the image, either ADAPTIVE_TILE_ACTIVE or ADAPTIVE_TILE_CONVERGED */
+    const std::vector<uint8_t> &getTileMask() const { return tileMask; }
+
+    /** @returns the error of each tile as of its last update. Infinite for tiles that have not been evaluated yet. */
+    const std::vector<float> &getTileErrors() const { return tileErrors; }
+
+    /** @returns the largest error among the tiles still active, as of the last update */
+    float getMaxError() const { return maxError; }
+
+    /** @returns the number of tiles still taking samples */
+    uint32_t getActiveTileCount() const { return activeTiles; }
+
+    /** @returns the number of passes so far, which is the sample count of every pixel in an active tile */
+    uint32_t getPassCount() const { return passes; }
+
+    /** @returns the total number of samples taken across all pixels */
+    uint64_t getSamplesTaken() const { return samplesTaken; }
+
+    /** @returns the average number of samples taken per pixel */
+    float getAverageSamplesPerPixel() const
+    {
+        uint64_t pixels = uint64_t(width) * uint64_t(height);
+        return (pixels == 0) ? 0.f : float(double(samplesTaken) / double(pixels));
+    }
+
+    uint32_t getTileSize() const { return tileSize; }
+
+private:
+    void retireTile(uint32_t tile)
+    {
+        tileMask[tile] = ADAPTIVE_TILE_CONVERGED;
+        activeTiles--;
+        activePixels -= tilePixels[tile];
+    }
+
+    uint32_t width = 0, height = 0, tileSize = 16;
+    uint32_t tilesX = 0, tilesY = 0;
+    float errorThreshold = 0.f;
+    uint32_t minSamples = 0, maxSamples = 1;
+    uint64_t sampleBudget = 0;
+
+    std::vector<uint8_t> tileMask;
+    std::vector<float> tileErrors;
+    std::vector<uint32_t> tilePixels;
+    uint32_t activeTiles = 0;
+    uint64_t activePixels = 0;
+    uint32_t passes = 0, lastUpdate = 0;
+    uint64_t samplesTaken = 0;
+    float maxError = INFINITY;
+};
+#endif
@@ -0,0 +1,134 @@
+#pragma once
+
+#ifdef __CUDACC__
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR __both__
+#endif
+#else
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR
+#endif
+#endif
+
+#include <stdint.h>
+
+#ifndef __CUDA_ARCH__
+#include <vector>
+#endif
+
+/**
+ * One bin of a Walker/Vose alias table. A bin is picked uniformly, then either
+ * the bin itself (with probability "threshold") or its "alias" is returned.
+ * "pdf" is the normalized discrete probability of the bin, kept alongside so
+ * that the probability of any outcome can be evaluated in O(1) as well.
+ */
+struct AliasTableEntry {
+    float threshold = 1.f;
+    uint32_t alias = 0;
+    float pdf = 0.f;
+};
+
+/**
+ * Draws a bin from an alias table in constant time.
+ * @param table The alias table to sample
+ * @param n The number of bins in the table
+ * @param u A uniform random number in [0, 1)
+ * @param pdf Returns the discrete probability of the selected bin
+ * @param remapped Returns a fresh uniform random number in [0, 1), recovered from
+ * the unused bits of u. Useful for jittering within the selected bin.
+ * @returns the index of the selected bin
+ */
+inline CUDA_DECORATOR
+uint32_t sampleAliasTable(const AliasTableEntry* table, uint32_t n, float u, float &pdf, float &remapped)
+{
+    float scaled = u * float(n);
+    uint32_t idx = uint32_t(scaled);
+    idx = (idx < n) ? idx : (n - 1);
+    float coin = scaled - float(idx);
+    coin = (coin < 0.99999994f) ? coin : 0.99999994f;
+
+    const AliasTableEntry &bin = table[idx];
+    uint32_t result;
+    if (coin < bin.threshold) {
+        result = idx;
+        remapped = coin / bin.threshold;
+    } else {
+        result = bin.alias;
+        remapped = (coin - bin.threshold) / (1.f - bin.threshold);
+    }
+    remapped = (remapped < 0.99999994f) ? remapped : 0.99999994f;
+    pdf = table[result].pdf;
+    return result;
+}
+
+/** Convenience overload for when the remapped random number is not needed. */
+inline CUDA_DECORATOR
+uint32_t sampleAliasTable(const AliasTableEntry* table, uint32_t n, float u, float &pdf)
+{
+    float remapped;
+    return sampleAliasTable(table, n, u, pdf, remapped);
+}
+
+#ifndef __CUDA_ARCH__
+/**
+ * Builds an alias table over a set of non-negative weights using Vose's method.
+ * Weights do not need to be normalized. If all weights are zero, the resulting
+ * table samples every bin uniformly.
+ * @param weights The weights of each bin
+ * @param n The number of weights
+ * @param table The output table, which must hold n entries
+ * @returns the sum of all weights
+ */
+inline double buildAliasTable(const float* weights, uint32_t n, AliasTableEntry* table)
+{
+    if (n == 0) return 0.0;
+
+    double sum = 0.0;
+    for (uint32_t i = 0; i < n; ++i) sum += (weights[i] > 0.f) ? double(weights[i]) : 0.0;
+
+    if (!(sum > 0.0)) {
+        for (uint32_t i = 0; i < n; ++i) {
+            table[i].threshold = 1.f;
+            table[i].alias = i;
+            table[i].pdf = 1.f / float(n);
+        }
+        return 0.0;
+    }
+
+    // Scale each weight so that the average bin holds exactly 1
+    std::vector<double> scaled(n);
+    std::vector<uint32_t> small, large;
+    small.reserve(n); large.reserve(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        double w = (weights[i] > 0.f) ? double(weights[i]) : 0.0;
+        table[i].pdf = float(w / sum);
+        table[i].alias = i;
+        scaled[i] = w * double(n) / sum;
+        if (scaled[i] < 1.0) small.push_back(i);
+        else large.push_back(i);
+    }
+
+    while (!small.empty() && !large.empty()) {
+        uint32_t s = small.back(); small.pop_back();
+        uint32_t l = large.back(); large.pop_back();
+        table[s].threshold = float(scaled[s]);
+        table[s].alias = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+        if (scaled[l] < 1.0) small.push_back(l);
+        else large.push_back(l);
+    }
+
+    // Whatever remains is (up to round off) exactly full
+    for (uint32_t i : large) { table[i].threshold = 1.f; table[i].alias = i; }
+    for (uint32_t i : small) { table[i].threshold = 1.f; table[i].alias = i; }
+    return sum;
+}
+
+/** Builds an alias table over a vector of weights. See buildAliasTable above. */
+inline std::vector<AliasTableEntry> buildAliasTable(const std::vector<float> &weights)
+{
+    std::vector<AliasTableEntry> table(weights.size());
+    buildAliasTable(weights.data(), uint32_t(weights.size()), table.data());
+    return table;
+}
+#endif
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Reads and writes ".nvmesh" files, made by the nvisii_bake tool and loaded by Mesh::createFromFile.
+ *
+ * A baked mesh has already been imported, welded, and given normals and tangents, and is stored the
+ * way the Mesh component holds it in memory, so loading one is a few reads with no processing.
+ * The file is a BakedMeshHeader followed by the positions, normals, tangents, colors, texture
+ * coordinates and triangle indices, each a tightly packed array in little endian byte order.
+ */
+
+struct BakedMeshHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t numVertices;
+    uint32_t numIndices;
+    uint32_t reserved;
+};
+
+struct BakedMesh {
+    std::vector<std::array<float, 3>> positions;
+    std::vector<glm::vec4> normals;
+    std::vector<glm::vec4> tangents;
+    std::vector<glm::vec4> colors;
+    std::vector<glm::vec2> texCoords;
+    std::vector<uint32_t> triangleIndices;
+};
+
+static const char BAKED_MESH_MAGIC[8] = {'N', 'V', 'M', 'E', 'S', 'H', 0, 0};
+static const uint32_t BAKED_MESH_VERSION = 1;
+
+/** @returns the size in bytes of a baked mesh file with the given number of vertices and indices */
+inline uint64_t getBakedMeshSize(uint64_t numVertices, uint64_t numIndices)
+{
+    return sizeof(BakedMeshHeader)
+        + numVertices * (sizeof(std::array<float, 3>) + 3 * sizeof(glm::vec4) + sizeof(glm::vec2))
+        + numIndices * sizeof(uint32_t);
+}
+
+/** Writes a baked mesh. Every per vertex list must be as long as the position list. */
+inline void saveBakedMesh(const std::string &path, const BakedMesh &mesh)
+{
+    size_t n = mesh.positions.size();
+    if (mesh.normals.size() != n || mesh.tangents.size() != n || mesh.colors.size() != n || mesh.texCoords.size() != n)
+        throw std::runtime_error("Error: every per vertex list of a baked mesh must be as long as its position list");
+    if ((mesh.triangleIndices.size() % 3) != 0)
+        throw std::runtime_error("Error: the length of a baked mesh's indices must be a multiple of 3");
+
+    BakedMeshHeader header;
+    memcpy(header.magic, BAKED_MESH_MAGIC, sizeof(header.magic));
+    header.version = BAKED_MESH_VERSION;
+    header.numVertices = uint32_t(n);
+    header.numIndices = uint32_t(mesh.triangleIndices.size());
+    header.reserved = 0;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error(std::string("Error: unable to open baked mesh \"") + path + "\"");
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)mesh.positions.data(), n * sizeof(mesh.positions[0]));
+    file.write((const char*)mesh.normals.data(), n * sizeof(mesh.normals[0]));
+    file.write((const char*)mesh.tangents.data(), n * sizeof(mesh.tangents[0]));
+    file.write((const char*)mesh.colors.data(), n * sizeof(mesh.colors[0]));
+    file.write((const char*)mesh.texCoords.data(), n * sizeof(mesh.texCoords[0]));
+    file.write((const char*)mesh.triangleIndices.data(), mesh.triangleIndices.size() * sizeof(uint32_t));
+    if (!file) throw std::runtime_error(std::string("Error: unable to write baked mesh \"") + path + "\"");
+}
+
+/** Reads a baked mesh, validating its header, size and indices */
+inline BakedMesh loadBakedMesh(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) throw std::runtime_error(std::string("Error: unable to open baked mesh \"") + path + "\"");
+    uint64_t fileSize = uint64_t(file.tellg());
+    file.seekg(0);
+
+    BakedMeshHeader header;
+    if (fileSize < sizeof(header) || !file.read((char*)&header, sizeof(header))
+        || memcmp(header.magic, BAKED_MESH_MAGIC, sizeof(header.magic)) != 0)
+        throw std::runtime_error(std::string("Error: \"") + path + "\" is not a baked mesh");
+    if (header.version != BAKED_MESH_VERSION)
+        throw std::runtime_error(std::string("Error: baked mesh \"") + path + "\" has version "
+            + std::to_string(header.version) + ", expected " + std::to_string(BAKED_MESH_VERSION) + ". Please bake it again.");
+    if (fileSize != getBakedMeshSize(header.numVertices, header.numIndices) || (header.numIndices % 3) != 0)
+        throw std::runtime_error(std::string("Error: baked mesh \"") + path + "\" is truncated or corrupt");
+
+    BakedMesh mesh;
+    size_t n = header.numVertices;
+    mesh.positions.resize(n);
+    mesh.normals.resize(n);
+    mesh.tangents.resize(n);
+    mesh.colors.resize(n);
+    mesh.texCoords.resize(n);
+    mesh.triangleIndices.resize(header.numIndices);
+    file.read((char*)mesh.positions.data(), n * sizeof(mesh.positions[0]));
+    file.read((char*)mesh.normals.data(), n * sizeof(mesh.normals[0]));
+    file.read((char*)mesh.tangents.data(), n * sizeof(mesh.tangents[0]));
+    file.read((char*)mesh.colors.data(), n * sizeof(mesh.colors[0]));
+    file.read((char*)mesh.texCoords.data(), n * sizeof(mesh.texCoords[0]));
+    file.read((char*)mesh.triangleIndices.data(), mesh.triangleIndices.size() * sizeof(uint32_t));
+    if (!file) throw std::runtime_error(std::string("Error: unable to read baked mesh \"") + path + "\"");
+
+    for (uint32_t index : mesh.triangleIndices) {
+        if (index >= n) throw std::runtime_error(std::string("Error: baked mesh \"") + path + "\" has an index out of bounds");
+    }
+    return mesh;
+}
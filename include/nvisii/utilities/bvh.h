@@ -0,0 +1,249 @@
+#pragma once
+
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+
+/**
+ * A node of a bounding volume hierarchy. Nodes are stored depth first, so the
+ * first child of an interior node always directly follows its parent.
+ */
+struct BVHNode {
+    glm::vec3 bbmin;
+    /* For leaves, the first primitive of the leaf. For interior nodes, the second child. */
+    uint32_t offset;
+    glm::vec3 bbmax;
+    /* The number of primitives in a leaf, or 0 for interior nodes */
+    uint32_t count;
+};
+
+/**
+ * Intersects a ray against a node's bounding box.
+ * @param node The node to intersect
+ * @param origin The ray origin
+ * @param invDir The reciprocal of the ray direction
+ * @param tmin The start of the ray interval
+ * @param tmax The end of the ray interval
+ * @param tnear Returns the distance at which the ray enters the box
+ * @returns true if the ray overlaps the box within [tmin, tmax]
+ */
+inline bool intersectBVHNode(const BVHNode &node, const glm::vec3 &origin, const glm::vec3 &invDir, float tmin, float tmax, float &tnear)
+{
+    glm::vec3 t0 = (node.bbmin - origin) * invDir;
+    glm::vec3 t1 = (node.bbmax - origin) * invDir;
+    glm::vec3 tsmall = glm::min(t0, t1);
+    glm::vec3 tbig = glm::max(t0, t1);
+    tnear = std::max(std::max(tsmall.x, tsmall.y), std::max(tsmall.z, tmin));
+    float tfar = std::min(std::min(tbig.x, tbig.y), std::min(tbig.z, tmax));
+    return tnear <= tfar;
+}
+
+/**
+ * A bounding volume hierarchy over a set of axis aligned boxes, built on the CPU with
+ * the surface area heuristic evaluated over a fixed number of bins per axis.
+ * The hierarchy is agnostic to what the boxes contain: traversal hands candidate
+ * primitives to a caller provided intersection function.
+ */
+class BVH {
+public:
+    std::vector<BVHNode> nodes;
+
+    /* The original index of each primitive, in the order the leaves reference them */
+    std::vector<uint32_t> primitives;
+
+    /**
+     * Builds the hierarchy, replacing any previous one.
+     * @param bbmins The minimum corner of each primitive's bounding box
+     * @param bbmaxs The maximum corner of each primitive's bounding box
+     * @param maxLeafSize Leaves are only created above this size when primitives cannot be separated
+     */
+    void build(const std::vector<glm::vec3> &bbmins, const std::vector<glm::vec3> &bbmaxs, uint32_t maxLeafSize = 4)
+    {
+        const uint32_t numBins = 16;
+        const float traversalCost = 1.f;
+        // Beyond this depth, nodes are split at the median so that traversal stacks stay bounded
+        const uint32_t maxSAHDepth = 64;
+
+        nodes.clear();
+        primitives.resize(bbmins.size());
+        if (bbmins.empty()) return;
+        nodes.reserve(2 * bbmins.size());
+
+        std::vector<glm::vec3> centroids(bbmins.size());
+        for (uint32_t i = 0; i < primitives.size(); ++i) {
+            primitives[i] = i;
+            centroids[i] = (bbmins[i] + bbmaxs[i]) * .5f;
+        }
+
+        struct Task { uint32_t begin, end, parent, depth; };
+        std::vector<Task> stack;
+        stack.push_back({0, uint32_t(primitives.size()), UINT32_MAX, 0});
+
+        struct Bin { glm::vec3 bbmin, bbmax; uint32_t count; };
+        Bin bins[numBins];
+        float rightAreas[numBins];
+        uint32_t rightCounts[numBins];
+
+        while (!stack.empty()) {
+            Task task = stack.back(); stack.pop_back();
+            uint32_t nodeIndex = uint32_t(nodes.size());
+            nodes.push_back(BVHNode());
+            if (task.parent != UINT32_MAX) nodes[task.parent].offset = nodeIndex;
+
+            // Bound the primitives and their centroids
+            glm::vec3 bbmin(FLT_MAX), bbmax(-FLT_MAX), cmin(FLT_MAX), cmax(-FLT_MAX);
+            for (uint32_t i = task.begin; i < task.end; ++i) {
+                uint32_t p = primitives[i];
+                bbmin = glm::min(bbmin, bbmins[p]); bbmax = glm::max(bbmax, bbmaxs[p]);
+                cmin = glm::min(cmin, centroids[p]); cmax = glm::max(cmax, centroids[p]);
+            }
+            nodes[nodeIndex].bbmin = bbmin;
+            nodes[nodeIndex].bbmax = bbmax;
+
+            uint32_t count = task.end - task.begin;
+            auto makeLeaf = [&] () {
+                nodes[nodeIndex].offset = task.begin;
+                nodes[nodeIndex].count = count;
+            };
+            if (count <= 1) { makeLeaf(); continue; }
+
+            // Find the cheapest split plane among the bin boundaries of all three axes
+            float bestCost = FLT_MAX;
+            int bestAxis = -1;
+            uint32_t bestBin = 0;
+            glm::vec3 extent = cmax - cmin;
+            for (int axis = 0; axis < 3 && task.depth < maxSAHDepth; ++axis) {
+                if (!(extent[axis] > 0.f)) continue;
+                float scale = float(numBins) / extent[axis];
+                for (uint32_t b = 0; b < numBins; ++b) bins[b] = {glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX), 0};
+                for (uint32_t i = task.begin; i < task.end; ++i) {
+                    uint32_t p = primitives[i];
+                    uint32_t b = std::min(uint32_t((centroids[p][axis] - cmin[axis]) * scale), numBins - 1);
+                    bins[b].bbmin = glm::min(bins[b].bbmin, bbmins[p]);
+                    bins[b].bbmax = glm::max(bins[b].bbmax, bbmaxs[p]);
+                    bins[b].count++;
+                }
+
+                // Sweep from the right to get the cost of everything right of each boundary...
+                glm::vec3 rmin(FLT_MAX), rmax(-FLT_MAX);
+                uint32_t rcount = 0;
+                for (uint32_t b = numBins - 1; b > 0; --b) {
+                    rmin = glm::min(rmin, bins[b].bbmin); rmax = glm::max(rmax, bins[b].bbmax);
+                    rcount += bins[b].count;
+                    rightAreas[b] = surfaceArea(rmin, rmax);
+                    rightCounts[b] = rcount;
+                }
+
+                // ... then from the left, combining both sides
+                glm::vec3 lmin(FLT_MAX), lmax(-FLT_MAX);
+                uint32_t lcount = 0;
+                for (uint32_t b = 0; b < numBins - 1; ++b) {
+                    lmin = glm::min(lmin, bins[b].bbmin); lmax = glm::max(lmax, bins[b].bbmax);
+                    lcount += bins[b].count;
+                    if (lcount == 0 || rightCounts[b + 1] == 0) continue;
+                    float cost = surfaceArea(lmin, lmax) * lcount + rightAreas[b + 1] * rightCounts[b + 1];
+                    if (cost < bestCost) { bestCost = cost; bestAxis = axis; bestBin = b; }
+                }
+            }
+
+            uint32_t mid;
+            if (bestAxis == -1) {
+                // All centroids coincide, or the tree is too deep. Split in the middle if the leaf would be too large.
+                if (count <= maxLeafSize) { makeLeaf(); continue; }
+                mid = task.begin + count / 2;
+            }
+            else {
+                float parentArea = surfaceArea(bbmin, bbmax);
+                float splitCost = traversalCost + ((parentArea > 0.f) ? bestCost / parentArea : bestCost);
+                if (count <= maxLeafSize && splitCost >= float(count)) { makeLeaf(); continue; }
+
+                float scale = float(numBins) / extent[bestAxis];
+                float split = cmin[bestAxis];
+                auto it = std::partition(primitives.begin() + task.begin, primitives.begin() + task.end,
+                    [&] (uint32_t p) {
+                        return std::min(uint32_t((centroids[p][bestAxis] - split) * scale), numBins - 1) <= bestBin;
+                    });
+                mid = uint32_t(it - primitives.begin());
+            }
+
+            // The first child is processed next, so that it is stored right after its parent
+            nodes[nodeIndex].count = 0;
+            stack.push_back({mid, task.end, nodeIndex, task.depth + 1});
+            stack.push_back({task.begin, mid, UINT32_MAX, task.depth + 1});
+        }
+    }
+
+    /**
+     * Finds intersections between a ray and the primitives in the hierarchy, visiting nearer nodes first.
+     * @param origin The ray origin
+     * @param direction The ray direction, which does not need to be normalized
+     * @param tmin The start of the ray interval
+     * @param tmax The end of the ray interval. Updated by the intersection function as closer hits are found.
+     * @param intersect Called as intersect(primitive, tmin, tmax) for each candidate primitive, where primitive
+     * is the original index of the primitive. Should return true and shrink tmax if the primitive was hit.
+     * @param anyHit If true, returns as soon as any intersection is found
+     * @returns true if any primitive was hit
+     */
+    template<typename Intersector>
+    bool traverse(glm::vec3 origin, glm::vec3 direction, float tmin, float &tmax, Intersector &&intersect, bool anyHit = false) const
+    {
+        if (nodes.empty()) return false;
+        glm::vec3 invDir = 1.f / direction;
+        bool hit = false;
+        float tnear;
+        if (!intersectBVHNode(nodes[0], origin, invDir, tmin, tmax, tnear)) return false;
+
+        uint32_t stack[128];
+        uint32_t stackSize = 0;
+        uint32_t current = 0;
+        while (true) {
+            const BVHNode &node = nodes[current];
+            if (node.count > 0) {
+                for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+                    if (intersect(primitives[i], tmin, tmax)) {
+                        hit = true;
+                        if (anyHit) return true;
+                    }
+                }
+            }
+            else {
+                uint32_t first = current + 1, second = node.offset;
+                float tfirst, tsecond;
+                bool hitFirst = intersectBVHNode(nodes[first], origin, invDir, tmin, tmax, tfirst);
+                bool hitSecond = intersectBVHNode(nodes[second], origin, invDir, tmin, tmax, tsecond);
+                if (hitFirst && hitSecond) {
+                    if (tsecond < tfirst) std::swap(first, second);
+                    stack[stackSize++] = second;
+                    current = first;
+                    continue;
+                }
+                if (hitFirst) { current = first; continue; }
+                if (hitSecond) { current = second; continue; }
+            }
+
+            // Pop the next node, skipping any that are now further away than the closest hit
+            bool found = false;
+            while (stackSize > 0) {
+                current = stack[--stackSize];
+                if (intersectBVHNode(nodes[current], origin, invDir, tmin, tmax, tnear)) { found = true; break; }
+            }
+            if (!found) return hit;
+        }
+    }
+
+    /** @returns the minimum corner of the bounds of all primitives */
+    glm::vec3 getMinAabbCorner() const { return (nodes.empty()) ? glm::vec3(0.f) : nodes[0].bbmin; }
+
+    /** @returns the maximum corner of the bounds of all primitives */
+    glm::vec3 getMaxAabbCorner() const { return (nodes.empty()) ? glm::vec3(0.f) : nodes[0].bbmax; }
+
+private:
+    static float surfaceArea(const glm::vec3 &bbmin, const glm::vec3 &bbmax)
+    {
+        glm::vec3 d = glm::max(bbmax - bbmin, glm::vec3(0.f));
+        return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#ifdef __CUDACC__
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR __both__
+#endif
+#else
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR
+#endif
+#endif
+
+#include <math.h>
+#include <nvisii/utilities/alias_table.h>
+
+#ifndef __CUDA_ARCH__
+#include <vector>
+#include <algorithm>
+#include <nvisii/utilities/thread_pool.h>
+#endif
+
+/** Relative luminance of a linear RGB color */
+inline CUDA_DECORATOR
+float domeLuminance(float r, float g, float b)
+{
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+/**
+ * Converts the discrete probability of picking a texel in a latitude/longitude
+ * importance map into a probability density over solid angle, given the vertical
+ * texture coordinate the sample was placed at.
+ * Texels are sampled uniformly within their footprint, which in uv space has
+ * density width * height, and the lat/long mapping stretches that footprint by
+ * 2 * pi^2 * sin(theta).
+ * @param texelPdf The discrete probability of the sampled texel
+ * @param v The vertical texture coordinate in [0, 1] of the sampled direction
+ * @param width The width of the importance map
+ * @param height The height of the importance map
+ * @returns the solid angle pdf of the sampled direction
+ */
+inline CUDA_DECORATOR
+float domeImportancePdf(float texelPdf, float v, int width, int height)
+{
+    float sinTheta = sinf(3.14159265358979323846f * v);
+    if (sinTheta <= 0.f) return 0.f;
+    return texelPdf * float(width) * float(height) / (2.f * 3.14159265358979323846f * 3.14159265358979323846f * sinTheta);
+}
+
+#ifndef __CUDA_ARCH__
+/** A sin(theta) weighted luminance importance map for a lat/long dome light texture */
+struct DomeImportanceMap {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<AliasTableEntry> table;
+};
+
+/**
+ * Builds a solid-angle weighted importance map for a lat/long texture, optionally
+ * at a lower resolution than the texture itself. Every texel of the texture is
+ * box-filtered into the importance map cell covering its center, so large
+ * HDRIs can be reduced to something cheap to build and to keep in memory.
+ * Rows are processed in parallel on the shared thread pool.
+ * @param width The width of the source texture
+ * @param height The height of the source texture
+ * @param luminance A callable luminance(x, y) returning the luminance of a source texel
+ * @param maxWidth If non-zero, the maximum width of the importance map. The height is scaled
+ * down by the same factor.
+ * @returns the importance map, with an alias table of width * height bins
+ */
+template<typename LuminanceFn>
+DomeImportanceMap buildDomeImportanceMap(
+    uint32_t width, uint32_t height, LuminanceFn luminance,
+    uint32_t maxWidth = 0)
+{
+    DomeImportanceMap map;
+    if (width == 0 || height == 0) return map;
+
+    map.width = width;
+    map.height = height;
+    if (maxWidth != 0 && width > maxWidth) {
+        double factor = double(width) / double(maxWidth);
+        map.width = maxWidth;
+        map.height = std::max(uint32_t(1), uint32_t(ceil(double(height) / factor)));
+    }
+
+    // For each importance map column/row, the range of source texels whose centers fall inside it
+    auto sourceRange = [] (uint32_t cell, uint32_t cells, uint32_t texels) {
+        double scale = double(texels) / double(cells);
+        uint32_t first = uint32_t(std::max(0.0, ceil(cell * scale - .5)));
+        uint32_t last = uint32_t(std::max(0.0, ceil((cell + 1) * scale - .5)));
+        return std::make_pair(std::min(first, texels), std::min(last, texels));
+    };
+    std::vector<std::pair<uint32_t, uint32_t>> columns(map.width);
+    for (uint32_t x = 0; x < map.width; ++x) columns[x] = sourceRange(x, map.width, width);
+
+    std::vector<float> weights(size_t(map.width) * size_t(map.height));
+    ThreadPool::global().parallelFor(0, map.height, [&] (uint64_t row) {
+        uint32_t y = uint32_t(row);
+        auto rows = sourceRange(y, map.height, height);
+        float sinTheta = sinf(3.14159265358979323846f * (y + .5f) / float(map.height));
+        for (uint32_t x = 0; x < map.width; ++x) {
+            double sum = 0.0; uint32_t count = 0;
+            for (uint32_t sy = rows.first; sy < rows.second; ++sy) {
+                for (uint32_t sx = columns[x].first; sx < columns[x].second; ++sx) {
+                    float l = luminance(sx, sy);
+                    // ignore nans and negative values, which would otherwise poison the table
+                    if (l > 0.f) sum += l;
+                    ++count;
+                }
+            }
+            float average = (count > 0) ? float(sum / count) : 0.f;
+            weights[size_t(y) * map.width + x] = average * sinTheta;
+        }
+    }, 1);
+
+    map.table.resize(weights.size());
+    buildAliasTable(weights.data(), uint32_t(weights.size()), map.table.data());
+    return map;
+}
+#endif
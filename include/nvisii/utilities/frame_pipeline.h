@@ -0,0 +1,218 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Keeps track of frames which were handed to the renderer but whose results have not been read back yet,
+ * so that the caller can set up the next frame while earlier ones render.
+ *
+ * The caller acquires a frame, which waits while the maximum number of frames is already in flight, and
+ * keeps the future of its result. The renderer renders the frame, starts reading its result back into
+ * the readback slot the frame was given, and submits the readback. poll() finishes readbacks in the order
+ * the frames were acquired, so results become ready in that order, and a slot is only handed to a new
+ * frame once the frame which used it has finished.
+ *
+ * Nothing here depends on the renderer, so a mock renderer can drive it just as well.
+ */
+template <typename Result>
+class FramePipeline {
+public:
+    /** How the result of a frame gets back to the host */
+    struct Readback {
+        /** @returns true once take can run without waiting on the renderer */
+        std::function<bool()> isDone;
+        /** Takes the result out of the readback slot. Only called once isDone returned true. */
+        std::function<Result()> take;
+    };
+
+    /** A frame in flight, as seen by the caller */
+    struct Frame {
+        uint64_t id = 0;
+        uint32_t slot = 0;
+        std::shared_future<Result> future;
+    };
+
+    explicit FramePipeline(uint32_t maxFramesInFlight = 2) : maxFramesInFlight(std::max(1u, maxFramesInFlight)) {}
+
+    uint32_t getMaxFramesInFlight()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return maxFramesInFlight;
+    }
+
+    /**
+     * Changes how many frames may be in flight at once, which is also the number of readback slots.
+     * Frames already in flight keep their slots.
+     */
+    void setMaxFramesInFlight(uint32_t count)
+    {
+        if (count < 1) throw std::runtime_error("Error: at least one frame must be allowed in flight");
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            maxFramesInFlight = count;
+        }
+        available.notify_all();
+    }
+
+    /** @returns the number of frames acquired and not finished yet */
+    uint32_t getFramesInFlight()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return uint32_t(frames.size());
+    }
+
+    /**
+     * Starts a new frame, waiting until fewer than the maximum number of frames are in flight.
+     * @param pump If given, called repeatedly while waiting instead of sleeping. Threads which finish frames
+     * themselves, by calling poll(), must pass one, since nothing else would finish a frame for them.
+     */
+    Frame acquire(const std::function<void()> &pump = nullptr)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        int32_t slot = findFreeSlot();
+        while (slot < 0) {
+            if (pump) {
+                lock.unlock();
+                pump();
+                std::this_thread::yield();
+                lock.lock();
+            }
+            else available.wait(lock);
+            slot = findFreeSlot();
+        }
+        if (uint32_t(slot) >= slotsInUse.size()) slotsInUse.resize(slot + 1, false);
+        slotsInUse[slot] = true;
+
+        InFlight frame;
+        frame.id = nextFrameID++;
+        frame.slot = uint32_t(slot);
+        frame.promise = std::make_shared<std::promise<Result>>();
+        frames.push_back(frame);
+
+        Frame result;
+        result.id = frame.id;
+        result.slot = frame.slot;
+        result.future = frame.promise->get_future().share();
+        return result;
+    }
+
+    /** Hands over the readback of a frame, once the renderer has started it */
+    void submit(uint64_t frameID, Readback readback)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        InFlight &frame = find(frameID);
+        frame.readback = std::make_shared<Readback>(std::move(readback));
+    }
+
+    /** Ends a frame with an error, which its future rethrows once the frames before it have finished */
+    void fail(uint64_t frameID, std::exception_ptr error)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        find(frameID).error = error;
+    }
+
+    /** Ends every frame which has not been submitted yet with an error, for when the renderer goes away */
+    void failAll(std::exception_ptr error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto &frame : frames) if (!frame.readback && !frame.error) frame.error = error;
+        }
+        flush();
+    }
+
+    /**
+     * Finishes the frames whose readbacks are done, oldest first, stopping at the first frame which is still
+     * rendering or reading back.
+     * @returns the number of frames finished
+     */
+    uint32_t poll()
+    {
+        std::lock_guard<std::mutex> pollLock(pollMutex);
+        uint32_t finished = 0;
+        while (true) {
+            InFlight frame;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (frames.empty()) break;
+                frame = frames.front();
+            }
+            if (frame.error) frame.promise->set_exception(frame.error);
+            else if (!frame.readback || !frame.readback->isDone()) break;
+            else {
+                try { frame.promise->set_value(frame.readback->take()); }
+                catch (...) { frame.promise->set_exception(std::current_exception()); }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                frames.pop_front();
+                slotsInUse[frame.slot] = false;
+            }
+            available.notify_all();
+            finished++;
+        }
+        return finished;
+    }
+
+    /**
+     * Waits until no submitted readback is still reading from the renderer, then finishes what it can.
+     * The renderer calls this before overwriting anything a readback might still read from.
+     */
+    void flush()
+    {
+        std::vector<std::shared_ptr<Readback>> readbacks;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto &frame : frames) if (frame.readback) readbacks.push_back(frame.readback);
+        }
+        for (auto &readback : readbacks) {
+            while (!readback->isDone()) std::this_thread::yield();
+        }
+        poll();
+    }
+
+private:
+    struct InFlight {
+        uint64_t id = 0;
+        uint32_t slot = 0;
+        std::shared_ptr<std::promise<Result>> promise;
+        std::shared_ptr<Readback> readback;
+        std::exception_ptr error;
+    };
+
+    std::mutex mutex;
+    std::mutex pollMutex;
+    std::condition_variable available;
+    std::deque<InFlight> frames;
+    std::vector<bool> slotsInUse;
+    uint32_t maxFramesInFlight;
+    uint64_t nextFrameID = 0;
+
+    /* @returns the lowest free slot below the limit, or -1 if the limit is reached */
+    int32_t findFreeSlot()
+    {
+        if (frames.size() >= maxFramesInFlight) return -1;
+        for (uint32_t slot = 0; slot < maxFramesInFlight; ++slot) {
+            if (slot >= slotsInUse.size() || !slotsInUse[slot]) return int32_t(slot);
+        }
+        return -1;
+    }
+
+    InFlight &find(uint64_t frameID)
+    {
+        for (auto &frame : frames) if (frame.id == frameID) return frame;
+        throw std::runtime_error("Error: frame " + std::to_string(frameID) + " is not in flight");
+    }
+};
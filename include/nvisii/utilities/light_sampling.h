@@ -0,0 +1,157 @@
+#pragma once
+
+#ifdef __CUDACC__
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR __both__
+#endif
+#else
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR
+#endif
+#endif
+
+#include <stdint.h>
+#include <nvisii/light_struct.h>
+#include <glm/glm.hpp>
+#include <nvisii/utilities/alias_table.h>
+
+#ifndef __CUDA_ARCH__
+#include <vector>
+#include <array>
+#include <cmath>
+#include <algorithm>
+#endif
+
+/**
+ * @returns the probability of picking the dome light during next event estimation.
+ * The dome keeps the share it would have under uniform selection, since its power cannot
+ * be compared meaningfully against the power of the area lights in the scene.
+ */
+inline CUDA_DECORATOR
+float domeSelectionProbability(uint32_t numLights, bool domeEnabled)
+{
+    return (domeEnabled) ? 1.f / float(numLights + 1) : 0.f;
+}
+
+/**
+ * Picks either the dome light or one of the area lights, in proportion to their estimated power.
+ * @param lightTable An alias table over the power of each area light
+ * @param numLights The number of area lights
+ * @param domeEnabled If true, the dome light can be picked as well
+ * @param u A uniform random number in [0, 1)
+ * @param pdf Returns the discrete probability of the selection. Zero if there is nothing to sample.
+ * @returns the index of the selected area light, or numLights if the dome light was selected
+ */
+inline CUDA_DECORATOR
+uint32_t selectLight(const AliasTableEntry* lightTable, uint32_t numLights, bool domeEnabled, float u, float &pdf)
+{
+    float pDome = domeSelectionProbability(numLights, domeEnabled);
+    if (u < pDome) { pdf = pDome; return numLights; }
+    if (numLights == 0 || lightTable == nullptr) { pdf = 0.f; return 0; }
+    u = (u - pDome) / (1.f - pDome);
+    u = (u < 0.99999994f) ? u : 0.99999994f;
+    float p;
+    uint32_t idx = sampleAliasTable(lightTable, numLights, u, p);
+    pdf = (1.f - pDome) * p;
+    return idx;
+}
+
+/** @returns the probability that selectLight returns the given index */
+inline CUDA_DECORATOR
+float selectLightPdf(const AliasTableEntry* lightTable, uint32_t numLights, bool domeEnabled, uint32_t index)
+{
+    float pDome = domeSelectionProbability(numLights, domeEnabled);
+    if (index == numLights) return pDome;
+    if (index > numLights || lightTable == nullptr) return 0.f;
+    return (1.f - pDome) * lightTable[index].pdf;
+}
+
+/**
+ * Picks a triangle of a mesh light. When the light's intensity is defined per unit surface area,
+ * triangles are picked proportional to their area. Otherwise every triangle contributes equally,
+ * so triangles are picked uniformly.
+ * @param triangleTable An alias table over the area of each triangle, or nullptr if unavailable
+ * @param numTris The number of triangles in the mesh
+ * @param areaWeighted Whether or not to pick triangles proportional to their area
+ * @param u A uniform random number in [0, 1)
+ * @param pdf Returns the discrete probability of the selected triangle
+ * @returns the index of the selected triangle
+ */
+inline CUDA_DECORATOR
+uint32_t selectTriangle(const AliasTableEntry* triangleTable, uint32_t numTris, bool areaWeighted, float u, float &pdf)
+{
+    if (numTris == 0) { pdf = 0.f; return 0; }
+    if (areaWeighted && triangleTable != nullptr) return sampleAliasTable(triangleTable, numTris, u, pdf);
+    uint32_t idx = uint32_t(u * float(numTris));
+    pdf = 1.f / float(numTris);
+    return (idx < numTris) ? idx : numTris - 1;
+}
+
+#ifndef __CUDA_ARCH__
+/**
+ * Estimates the relative power emitted by a light, used to decide how often it gets sampled.
+ * Textured lights are assumed to have a unit average color.
+ * @param light The light to estimate power for
+ * @param surfaceArea The world space surface area of the mesh emitting the light
+ */
+inline float estimateLightPower(const LightStruct &light, float surfaceArea)
+{
+    float luminance = (light.color_texture_id == -1) ?
+        (0.2126f * light.r + 0.7152f * light.g + 0.0722f * light.b) : 1.f;
+    float power = luminance * light.intensity * powf(2.f, light.exposure);
+    // Without surface area scaling, each light emits the same power regardless of its size.
+    if (light.use_surface_area) power *= surfaceArea;
+    return (power > 0.f) ? power : 0.f;
+}
+
+/**
+ * @param vertices The vertex positions of a triangle mesh
+ * @param indices Three vertex indices per triangle
+ * @returns the area of each triangle
+ */
+inline std::vector<float> computeTriangleAreas(const std::vector<std::array<float, 3>> &vertices, const std::vector<uint32_t> &indices)
+{
+    std::vector<float> areas(indices.size() / 3);
+    for (size_t t = 0; t < areas.size(); ++t) {
+        const auto &a = vertices[indices[t * 3 + 0]];
+        const auto &b = vertices[indices[t * 3 + 1]];
+        const auto &c = vertices[indices[t * 3 + 2]];
+        float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        areas[t] = 0.5f * sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    }
+    return areas;
+}
+
+/**
+ * Bounds the directions a mesh light emits towards. Emission follows the interpolated
+ * vertex normals, so the cone bounds those rather than the geometric face normals.
+ * @param vertices The vertex positions of a triangle mesh
+ * @param normals The vertex normals of the mesh
+ * @param indices Three vertex indices per triangle
+ * @returns a cone bounding the facing directions of all triangles, as the cone axis in xyz 
+ * and the cosine of the cone's spread in w
+ */
+inline glm::vec4 computeNormalCone(
+    const std::vector<std::array<float, 3>> &vertices, 
+    const std::vector<glm::vec4> &normals, 
+    const std::vector<uint32_t> &indices)
+{
+    std::vector<float> areas = computeTriangleAreas(vertices, indices);
+    glm::vec3 sum(0.f);
+    for (size_t t = 0; t < areas.size(); ++t) {
+        glm::vec3 n(0.f);
+        for (uint32_t k = 0; k < 3; ++k) n = n + glm::vec3(normals[indices[t * 3 + k]]);
+        if (glm::length(n) > 0.f) sum = sum + glm::normalize(n) * areas[t];
+    }
+    if (!(glm::length(sum) > 1e-6f)) return glm::vec4(0.f, 0.f, 1.f, -1.f);
+    glm::vec3 axis = glm::normalize(sum);
+    float cosTheta = 1.f;
+    for (uint32_t idx : indices) {
+        glm::vec3 n = glm::vec3(normals[idx]);
+        if (glm::length(n) > 0.f) cosTheta = std::min(cosTheta, glm::dot(axis, glm::normalize(n)));
+    }
+    return glm::vec4(axis.x, axis.y, axis.z, cosTheta);
+}
+#endif
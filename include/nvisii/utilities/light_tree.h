@@ -0,0 +1,410 @@
+#pragma once
+
+#ifdef __CUDACC__
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR __both__
+#endif
+#else
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR
+#endif
+#endif
+
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#ifndef __CUDA_ARCH__
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#endif
+
+#define LIGHT_TREE_INVALID_EMITTER 0xFFFFFFFFu
+
+/**
+ * A node of a light bounding volume hierarchy. Each node bounds the position of its emitters
+ * with a box, and the direction they emit light in with a cone around "axis". Emitters face
+ * at most acos(cosThetaO) away from the axis, and each emits light over a further
+ * acos(cosThetaE) around its own facing direction.
+ * Nodes are stored depth first, so the first child of an interior node immediately follows it.
+ */
+struct LightTreeNode {
+    glm::vec3 bbmin = glm::vec3(0.f);
+    float power = 0.f;
+    glm::vec3 bbmax = glm::vec3(0.f);
+    float cosThetaO = 1.f;
+    glm::vec3 axis = glm::vec3(0.f, 0.f, 1.f);
+    float cosThetaE = 1.f;
+    /* For interior nodes, the index of the second child. For leaves, the index of the emitter. */
+    uint32_t childOrEmitter = 0;
+    uint32_t isLeaf = 0;
+};
+
+inline CUDA_DECORATOR
+float lightTreeSafeSqrt(float x) { return sqrtf((x > 0.f) ? x : 0.f); }
+
+/** @returns cos(max(0, a - b)) given the cosines and sines of a and b */
+inline CUDA_DECORATOR
+float lightTreeCosSubClamped(float cosA, float sinA, float cosB, float sinB)
+{
+    if (cosA > cosB) return 1.f;
+    return cosA * cosB + sinA * sinB;
+}
+
+/** @returns sin(max(0, a - b)) given the cosines and sines of a and b */
+inline CUDA_DECORATOR
+float lightTreeSinSubClamped(float cosA, float sinA, float cosB, float sinB)
+{
+    if (cosA > cosB) return 0.f;
+    return sinA * cosB - cosA * sinB;
+}
+
+/**
+ * Estimates how much light the emitters under a node contribute to a point, taking
+ * distance, the orientation of the emitters and the orientation of the receiver into account.
+ * The estimate is conservative: it is only zero if the emitters cannot light the point.
+ * @param node The node to estimate the contribution of
+ * @param p The receiving point
+ * @param n The receiving surface normal, or zero for points in a participating medium
+ */
+inline CUDA_DECORATOR
+float lightTreeImportance(const LightTreeNode &node, glm::vec3 p, glm::vec3 n)
+{
+    if (node.power <= 0.f) return 0.f;
+    glm::vec3 pc = (node.bbmin + node.bbmax) * .5f;
+    glm::vec3 diag = node.bbmax - node.bbmin;
+    glm::vec3 toP = p - pc;
+    float d2 = glm::dot(toP, toP);
+    // Avoid the singularity for points near or within the bounds, by clamping to the squared radius of the bounds
+    d2 = glm::max(d2, glm::dot(diag, diag) * .25f);
+    glm::vec3 wi = (glm::dot(toP, toP) > 0.f) ? glm::normalize(toP) : glm::vec3(0.f, 0.f, 1.f);
+
+    // Angle between the emitters' axis and the receiver
+    float cosThetaW = glm::dot(node.axis, wi);
+    float sinThetaW = lightTreeSafeSqrt(1.f - cosThetaW * cosThetaW);
+
+    // Angle subtended by the bounds as seen from the receiver
+    float cosThetaB, sinThetaB;
+    bool inside = glm::all(glm::greaterThanEqual(p, node.bbmin)) && glm::all(glm::lessThanEqual(p, node.bbmax));
+    float radius2 = glm::dot(diag, diag) * .25f;
+    float dist2 = glm::dot(toP, toP);
+    if (inside || dist2 < radius2) { cosThetaB = -1.f; sinThetaB = 0.f; }
+    else {
+        float sin2ThetaB = radius2 / dist2;
+        cosThetaB = lightTreeSafeSqrt(1.f - sin2ThetaB);
+        sinThetaB = sqrtf(sin2ThetaB);
+    }
+
+    // Smallest angle between the receiver and any emitter facing direction
+    float sinThetaO = lightTreeSafeSqrt(1.f - node.cosThetaO * node.cosThetaO);
+    float cosThetaX = lightTreeCosSubClamped(cosThetaW, sinThetaW, node.cosThetaO, sinThetaO);
+    float sinThetaX = lightTreeSinSubClamped(cosThetaW, sinThetaW, node.cosThetaO, sinThetaO);
+    float cosThetaP = lightTreeCosSubClamped(cosThetaX, sinThetaX, cosThetaB, sinThetaB);
+    if (cosThetaP <= node.cosThetaE) return 0.f;
+
+    float importance = node.power * cosThetaP / d2;
+
+    // Account for foreshortening at the receiver
+    if (glm::dot(n, n) > 0.f) {
+        float cosThetaI = fabsf(glm::dot(wi, n));
+        float sinThetaI = lightTreeSafeSqrt(1.f - cosThetaI * cosThetaI);
+        importance *= lightTreeCosSubClamped(cosThetaI, sinThetaI, cosThetaB, sinThetaB);
+    }
+    return (importance > 0.f) ? importance : 0.f;
+}
+
+/**
+ * Stochastically descends the light tree, picking children in proportion to their importance.
+ * @param nodes The nodes of the tree
+ * @param numNodes The number of nodes in the tree
+ * @param p The receiving point
+ * @param n The receiving surface normal, or zero for points in a participating medium
+ * @param u A uniform random number in [0, 1)
+ * @param pdf Returns the discrete probability of picking the returned emitter
+ * @returns the index of the selected emitter, or LIGHT_TREE_INVALID_EMITTER if no emitter can light p
+ */
+inline CUDA_DECORATOR
+uint32_t sampleLightTree(const LightTreeNode* nodes, uint32_t numNodes, glm::vec3 p, glm::vec3 n, float u, float &pdf)
+{
+    pdf = 0.f;
+    if (numNodes == 0 || nodes == nullptr) return LIGHT_TREE_INVALID_EMITTER;
+    if (lightTreeImportance(nodes[0], p, n) <= 0.f) return LIGHT_TREE_INVALID_EMITTER;
+    float pmf = 1.f;
+    uint32_t idx = 0;
+    while (!nodes[idx].isLeaf) {
+        uint32_t left = idx + 1;
+        uint32_t right = nodes[idx].childOrEmitter;
+        float il = lightTreeImportance(nodes[left], p, n);
+        float ir = lightTreeImportance(nodes[right], p, n);
+        if (il <= 0.f && ir <= 0.f) return LIGHT_TREE_INVALID_EMITTER;
+        float pl = il / (il + ir);
+        if (u < pl) {
+            idx = left; pmf *= pl;
+            u = u / pl;
+        } else {
+            idx = right; pmf *= (1.f - pl);
+            u = (u - pl) / (1.f - pl);
+        }
+        u = (u < 0.99999994f) ? u : 0.99999994f;
+    }
+    pdf = pmf;
+    return nodes[idx].childOrEmitter;
+}
+
+/**
+ * @param nodes The nodes of the tree
+ * @param trail The path from the root to the emitter's leaf, one bit per level,
+ * where a set bit means the second child was taken
+ * @returns the probability that sampleLightTree picks the emitter at the end of the trail
+ */
+inline CUDA_DECORATOR
+float lightTreePdf(const LightTreeNode* nodes, uint32_t numNodes, uint64_t trail, glm::vec3 p, glm::vec3 n)
+{
+    if (numNodes == 0 || nodes == nullptr) return 0.f;
+    if (lightTreeImportance(nodes[0], p, n) <= 0.f) return 0.f;
+    float pmf = 1.f;
+    uint32_t idx = 0;
+    while (!nodes[idx].isLeaf) {
+        uint32_t left = idx + 1;
+        uint32_t right = nodes[idx].childOrEmitter;
+        float il = lightTreeImportance(nodes[left], p, n);
+        float ir = lightTreeImportance(nodes[right], p, n);
+        if (il <= 0.f && ir <= 0.f) return 0.f;
+        bool second = (trail & 1ull) != 0;
+        pmf *= (second ? ir : il) / (il + ir);
+        idx = second ? right : left;
+        trail >>= 1;
+    }
+    return pmf;
+}
+
+/**
+ * Picks either the dome light, or one of the area lights through the light tree.
+ * The dome keeps the share it would have under uniform selection.
+ * See sampleLightTree for the remaining parameters.
+ * @param numLights The number of area lights
+ * @param domeEnabled If true, the dome light can be picked as well
+ * @returns numLights if the dome light was picked, otherwise the index of the area light.
+ * If nothing can be sampled, pdf is set to zero.
+ */
+inline CUDA_DECORATOR
+uint32_t selectLightFromTree(const LightTreeNode* nodes, uint32_t numNodes, uint32_t numLights, bool domeEnabled,
+    glm::vec3 p, glm::vec3 n, float u, float &pdf)
+{
+    float pDome = (domeEnabled) ? 1.f / float(numLights + 1) : 0.f;
+    if (u < pDome) { pdf = pDome; return numLights; }
+    u = (u - pDome) / (1.f - pDome);
+    u = (u < 0.99999994f) ? u : 0.99999994f;
+    float treePdf;
+    uint32_t idx = sampleLightTree(nodes, numNodes, p, n, u, treePdf);
+    if (idx == LIGHT_TREE_INVALID_EMITTER) { pdf = 0.f; return 0; }
+    pdf = (1.f - pDome) * treePdf;
+    return idx;
+}
+
+#ifndef __CUDA_ARCH__
+/** The spatial and directional extent of a single emitter, used to build a light tree */
+struct LightTreeEmitter {
+    glm::vec3 bbmin = glm::vec3(0.f);
+    glm::vec3 bbmax = glm::vec3(0.f);
+    glm::vec3 axis = glm::vec3(0.f, 0.f, 1.f);
+    /* Cosine of the spread of the emitter's facing directions around the axis */
+    float cosThetaO = -1.f;
+    /* Cosine of the emission spread around each facing direction. One sided diffuse emitters use 0 */
+    float cosThetaE = 0.f;
+    float power = 0.f;
+};
+
+/** A host side light tree, which can be built from scratch or refit as emitters move */
+class LightTree {
+  public:
+    /** The depth first list of nodes, ready to upload */
+    std::vector<LightTreeNode> nodes;
+    /** For each emitter, the path from the root to its leaf. See lightTreePdf */
+    std::vector<uint64_t> trails;
+    /** For each emitter, the index of its leaf, or LIGHT_TREE_INVALID_EMITTER if it emits no power */
+    std::vector<uint32_t> leaves;
+
+    /** Builds the tree from scratch. Emitters with no power are left out. */
+    void build(const std::vector<LightTreeEmitter> &emitters)
+    {
+        nodes.clear();
+        trails.assign(emitters.size(), 0);
+        leaves.assign(emitters.size(), LIGHT_TREE_INVALID_EMITTER);
+        std::vector<uint32_t> indices;
+        for (uint32_t i = 0; i < emitters.size(); ++i) if (emitters[i].power > 0.f) indices.push_back(i);
+        if (indices.empty()) return;
+        nodes.reserve(indices.size() * 2 - 1);
+        buildRecursive(emitters, indices, 0, uint32_t(indices.size()), 0ull, 0);
+    }
+
+    /**
+     * Updates bounds, cones and power after emitters move or change intensity, keeping the topology.
+     * Cheaper than a rebuild, but the tree may degrade if emitters move far.
+     * Emitters which had no power at build time are still left out.
+     */
+    void refit(const std::vector<LightTreeEmitter> &emitters)
+    {
+        if (emitters.size() != leaves.size()) { build(emitters); return; }
+        for (uint32_t i = 0; i < emitters.size(); ++i) {
+            if (leaves[i] == LIGHT_TREE_INVALID_EMITTER) continue;
+            nodes[leaves[i]] = makeLeaf(emitters[i], i);
+        }
+        // Children always come after their parents, so walk backwards
+        for (int64_t i = int64_t(nodes.size()) - 1; i >= 0; --i) {
+            if (nodes[i].isLeaf) continue;
+            uint32_t right = nodes[i].childOrEmitter;
+            nodes[i] = merge(nodes[i + 1], nodes[right]);
+            nodes[i].childOrEmitter = right;
+            nodes[i].isLeaf = 0;
+        }
+    }
+
+  private:
+    static LightTreeNode makeLeaf(const LightTreeEmitter &e, uint32_t emitter)
+    {
+        LightTreeNode node;
+        node.bbmin = e.bbmin; node.bbmax = e.bbmax;
+        node.axis = e.axis; node.cosThetaO = e.cosThetaO; node.cosThetaE = e.cosThetaE;
+        node.power = e.power;
+        node.childOrEmitter = emitter;
+        node.isLeaf = 1;
+        return node;
+    }
+
+    static float clampedAcos(float c) { return acosf(std::max(-1.f, std::min(1.f, c))); }
+
+    /** The smallest cone containing the two given cones */
+    static void coneUnion(glm::vec3 a, float cosA, glm::vec3 b, float cosB, glm::vec3 &axis, float &cosTheta)
+    {
+        float thetaA = clampedAcos(cosA), thetaB = clampedAcos(cosB);
+        float thetaD = clampedAcos(glm::dot(a, b));
+        const float pi = 3.14159265358979323846f;
+        if (std::min(thetaD + thetaB, pi) <= thetaA) { axis = a; cosTheta = cosA; return; }
+        if (std::min(thetaD + thetaA, pi) <= thetaB) { axis = b; cosTheta = cosB; return; }
+        float thetaO = (thetaA + thetaD + thetaB) * .5f;
+        if (thetaO >= pi) { axis = a; cosTheta = -1.f; return; }
+        // Rotate a towards b by thetaO - thetaA
+        float thetaR = thetaO - thetaA;
+        glm::vec3 wr = glm::cross(a, b);
+        if (glm::dot(wr, wr) < 1e-12f) { axis = a; cosTheta = -1.f; return; }
+        wr = glm::normalize(wr);
+        axis = a * cosf(thetaR) + glm::cross(wr, a) * sinf(thetaR) + wr * glm::dot(wr, a) * (1.f - cosf(thetaR));
+        axis = glm::normalize(axis);
+        cosTheta = cosf(thetaO);
+    }
+
+    static LightTreeNode merge(const LightTreeNode &a, const LightTreeNode &b)
+    {
+        if (a.power <= 0.f) return b;
+        if (b.power <= 0.f) return a;
+        LightTreeNode node;
+        node.bbmin = glm::min(a.bbmin, b.bbmin);
+        node.bbmax = glm::max(a.bbmax, b.bbmax);
+        coneUnion(a.axis, a.cosThetaO, b.axis, b.cosThetaO, node.axis, node.cosThetaO);
+        node.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+        node.power = a.power + b.power;
+        node.isLeaf = 0;
+        return node;
+    }
+
+    /** The orientation term of the split cost, the solid angle measure of a node's cones */
+    static float orientationMeasure(float cosThetaO, float cosThetaE)
+    {
+        const float pi = 3.14159265358979323846f;
+        float thetaO = clampedAcos(cosThetaO), thetaE = clampedAcos(cosThetaE);
+        float thetaW = std::min(thetaO + thetaE, pi);
+        float sinThetaO = sinf(thetaO);
+        return 2.f * pi * (1.f - cosThetaO) +
+            pi / 2.f * (2.f * thetaW * sinThetaO - cosf(thetaO - 2.f * thetaW) - 2.f * thetaO * sinThetaO + cosThetaO);
+    }
+
+    static float surfaceArea(glm::vec3 bbmin, glm::vec3 bbmax)
+    {
+        glm::vec3 d = glm::max(bbmax - bbmin, glm::vec3(0.f));
+        return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    static float splitCost(const LightTreeNode &n, float axisScale)
+    {
+        if (n.power <= 0.f) return 0.f;
+        return n.power * orientationMeasure(n.cosThetaO, n.cosThetaE) * surfaceArea(n.bbmin, n.bbmax) * axisScale;
+    }
+
+    uint32_t buildRecursive(const std::vector<LightTreeEmitter> &emitters, std::vector<uint32_t> &indices,
+        uint32_t begin, uint32_t end, uint64_t trail, uint32_t depth)
+    {
+        uint32_t nodeIndex = uint32_t(nodes.size());
+        if (end - begin == 1) {
+            uint32_t e = indices[begin];
+            nodes.push_back(makeLeaf(emitters[e], e));
+            trails[e] = trail;
+            leaves[e] = nodeIndex;
+            return nodeIndex;
+        }
+        nodes.push_back(LightTreeNode());
+
+        // Bounds of the emitter centroids
+        glm::vec3 cmin(1e30f), cmax(-1e30f);
+        for (uint32_t i = begin; i < end; ++i) {
+            glm::vec3 c = (emitters[indices[i]].bbmin + emitters[indices[i]].bbmax) * .5f;
+            cmin = glm::min(cmin, c); cmax = glm::max(cmax, c);
+        }
+        glm::vec3 extent = cmax - cmin;
+        float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+
+        // Bin emitters along each axis and pick the split with the lowest orientation aware SAH cost
+        const int numBuckets = 12;
+        float bestCost = 1e30f; int bestAxis = -1, bestBucket = -1;
+        for (int axis = 0; axis < 3 && maxExtent > 0.f; ++axis) {
+            if (extent[axis] <= 0.f) continue;
+            LightTreeNode buckets[numBuckets];
+            for (uint32_t i = begin; i < end; ++i) {
+                const auto &e = emitters[indices[i]];
+                float c = ((e.bbmin + e.bbmax) * .5f)[axis];
+                int b = std::min(numBuckets - 1, int(numBuckets * (c - cmin[axis]) / extent[axis]));
+                buckets[b] = merge(buckets[b], makeLeaf(e, indices[i]));
+            }
+            float axisScale = maxExtent / extent[axis];
+            for (int split = 0; split < numBuckets - 1; ++split) {
+                LightTreeNode below, above;
+                for (int b = 0; b <= split; ++b) below = merge(below, buckets[b]);
+                for (int b = split + 1; b < numBuckets; ++b) above = merge(above, buckets[b]);
+                if (below.power <= 0.f || above.power <= 0.f) continue;
+                float cost = splitCost(below, axisScale) + splitCost(above, axisScale);
+                if (cost < bestCost) { bestCost = cost; bestAxis = axis; bestBucket = split; }
+            }
+        }
+
+        uint32_t mid = (begin + end) / 2;
+        if (bestAxis != -1) {
+            auto it = std::partition(indices.begin() + begin, indices.begin() + end, [&] (uint32_t i) {
+                const auto &e = emitters[i];
+                float c = ((e.bbmin + e.bbmax) * .5f)[bestAxis];
+                int b = std::min(numBuckets - 1, int(numBuckets * (c - cmin[bestAxis]) / extent[bestAxis]));
+                return b <= bestBucket;
+            });
+            mid = uint32_t(it - indices.begin());
+            if (mid == begin || mid == end) mid = (begin + end) / 2;
+        }
+
+        // Trails only hold 64 levels, deeper emitters get approximate pdfs
+        uint64_t bit = (depth < 64) ? (1ull << depth) : 0ull;
+        uint32_t left = buildRecursive(emitters, indices, begin, mid, trail, depth + 1);
+        uint32_t right = buildRecursive(emitters, indices, mid, end, trail | bit, depth + 1);
+        nodes[nodeIndex] = merge(nodes[left], nodes[right]);
+        nodes[nodeIndex].childOrEmitter = right;
+        nodes[nodeIndex].isLeaf = 0;
+        return nodeIndex;
+    }
+};
+
+/**
+ * CPU reference light selection, matching what the path tracer does on the device.
+ * Useful to validate the tree against the pdfs it reports.
+ */
+inline uint32_t sampleLightTreeReference(const LightTree &tree, glm::vec3 p, glm::vec3 n, float u, float &pdf)
+{
+    return sampleLightTree(tree.nodes.data(), uint32_t(tree.nodes.size()), p, n, u, pdf);
+}
+#endif
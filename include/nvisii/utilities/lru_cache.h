@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * A small least-recently-used cache. Looking up or inserting an entry marks it as the
+ * most recently used, and inserting beyond the capacity evicts the least recently used entry.
+ * Not thread safe; callers are expected to provide their own locking.
+ */
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class LRUCache {
+  public:
+    LRUCache(size_t capacity) : capacity(capacity) {}
+
+    /**
+     * @param key The key to look up
+     * @param value Returns the cached value, if found
+     * @returns True if the key was found in the cache
+     */
+    bool get(const Key &key, Value &value) {
+        auto it = lookup.find(key);
+        if (it == lookup.end()) return false;
+        entries.splice(entries.begin(), entries, it->second);
+        value = it->second->second;
+        return true;
+    }
+
+    /** Inserts or replaces the value for the given key, evicting old entries if over capacity */
+    void put(const Key &key, const Value &value) {
+        auto it = lookup.find(key);
+        if (it != lookup.end()) {
+            it->second->second = value;
+            entries.splice(entries.begin(), entries, it->second);
+            return;
+        }
+        entries.emplace_front(key, value);
+        lookup[key] = entries.begin();
+        evict();
+    }
+
+    /** Changes the maximum number of entries, evicting old entries if needed */
+    void setCapacity(size_t newCapacity) {
+        capacity = newCapacity;
+        evict();
+    }
+
+    /** @returns the maximum number of entries */
+    size_t getCapacity() const { return capacity; }
+
+    /** @returns the number of entries currently cached */
+    size_t size() const { return entries.size(); }
+
+    /** Removes all entries */
+    void clear() {
+        entries.clear();
+        lookup.clear();
+    }
+
+  private:
+    void evict() {
+        while (entries.size() > capacity) {
+            lookup.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+    size_t capacity;
+    std::list<std::pair<Key, Value>> entries;
+    std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator, Hash> lookup;
+};
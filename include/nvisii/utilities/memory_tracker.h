@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * Keeps a running account of the host and device memory held by each component.
+ *
+ * Entries are grouped by category (eg "mesh" or "texture") and identified by the component's id,
+ * rather than its name, so that an entry can still be removed after its component was cleared.
+ * Each entry is updated when its component's resources are (re)allocated, so that reading the
+ * totals never needs to walk the scene.
+ *
+ * All functions are safe to call from any thread.
+ */
+class MemoryTracker {
+public:
+    struct Usage {
+        uint64_t hostBytes = 0;
+        uint64_t deviceBytes = 0;
+    };
+
+    /** Sets the host memory held by a component, replacing the previous amount */
+    void setHostBytes(const std::string &category, uint32_t id, const std::string &name, uint64_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry &entry = categories[category][id];
+        entry.name = name;
+        entry.usage.hostBytes = bytes;
+    }
+
+    /** Sets the device memory held by a component, replacing the previous amount */
+    void setDeviceBytes(const std::string &category, uint32_t id, const std::string &name, uint64_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry &entry = categories[category][id];
+        entry.name = name;
+        entry.usage.deviceBytes = bytes;
+    }
+
+    /** Forgets a component, eg once it has been removed */
+    void remove(const std::string &category, uint32_t id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = categories.find(category);
+        if (it != categories.end()) it->second.erase(id);
+    }
+
+    /** Forgets all components */
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        categories.clear();
+    }
+
+    /**
+     * @returns the usage of each component under "<category>/<name>", and the total of each
+     * category under "<category>". Categories without components are left out.
+     */
+    std::map<std::string, Usage> getUsage() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<std::string, Usage> usage;
+        for (auto &category : categories) {
+            if (category.second.empty()) continue;
+            Usage &total = usage[category.first];
+            for (auto &entry : category.second) {
+                Usage &component = usage[category.first + "/" + entry.second.name];
+                component.hostBytes += entry.second.usage.hostBytes;
+                component.deviceBytes += entry.second.usage.deviceBytes;
+                total.hostBytes += entry.second.usage.hostBytes;
+                total.deviceBytes += entry.second.usage.deviceBytes;
+            }
+        }
+        return usage;
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        Usage usage;
+    };
+
+    mutable std::mutex mutex;
+    std::map<std::string, std::map<uint32_t, Entry>> categories;
+};
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <nvisii/utilities/thread_pool.h>
+
+/**
+ * Procedural noise, evaluated on the host straight into texture storage by Texture::createNoise and friends.
+ *
+ * NOISE_GRADIENT: Perlin's gradient noise, with quintic interpolation between lattice points.
+ * NOISE_SIMPLEX: Gradient noise on a simplex (triangle) lattice, which has fewer axis aligned artifacts.
+ * NOISE_CELLULAR: Worley's cellular noise, the distance to the nearest of one jittered feature point per cell.
+ *
+ * Lattice points are hashed rather than looked up in a permutation table, and the texels of a row are
+ * evaluated in tight loops with the octave and noise type hoisted out, so that the compiler can vectorize
+ * them. Rows are spread over the shared thread pool.
+ */
+enum NoiseType : uint32_t {
+    NOISE_GRADIENT = 0,
+    NOISE_SIMPLEX = 1,
+    NOISE_CELLULAR = 2
+};
+
+struct NoiseParameters {
+    NoiseType type = NOISE_GRADIENT;
+    uint32_t seed = 0;
+    /* The number of lattice cells across the width of the texture, for the first octave */
+    float frequency = 4.f;
+    uint32_t octaves = 6;
+    /* The factor the frequency grows by from one octave to the next */
+    float lacunarity = 2.f;
+    /* The factor the amplitude shrinks by from one octave to the next */
+    float gain = .5f;
+    /* If true, octaves add up their absolute values, giving billowy turbulence instead of fractal noise */
+    bool turbulence = false;
+    /* How far noise displaces the lookup position, in cells of the first octave. Zero disables domain warping. */
+    float warp = 0.f;
+    /* For cellular noise, how far feature points may stray from the corner of their cell, from 0 to 1 */
+    float jitter = 1.f;
+    /* If true, every octave has a whole number of cells across the texture, and the lattice wraps around */
+    bool tileable = false;
+};
+
+/* A well mixed 32 bit hash of a lattice point (lowbias32 by Chris Wellons) */
+inline uint32_t hashNoiseLattice(int32_t x, int32_t y, uint32_t seed)
+{
+    uint32_t h = seed ^ (uint32_t(x) * 0x8da6b343u) ^ (uint32_t(y) * 0xd8163841u);
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+/*
+ * Rounds down by truncation, which vectorizes on every x86-64 CPU, unlike std::floor which needs SSE 4.1.
+ * Selects in the kernels below are written as arithmetic on comparisons for the same reason.
+ */
+inline float floorNoise(float x)
+{
+    int32_t t = int32_t(x);
+    return float(t - int32_t(float(t) > x));
+}
+
+/* The lattice period used when noise does not tile, large enough to never wrap within a texture */
+static const float NOISE_UNTILED_PERIOD = 16777216.f;
+
+/* Wraps a lattice coordinate into [0, period). Done in floating point, which vectorizes where integer modulo does not. */
+inline float wrapNoiseLattice(float i, float period)
+{
+    return i - period * floorNoise(i / period);
+}
+
+/* @returns the dot product of the gradient hashed from h with (x, y). Gradient components lie in [-1, 1]. */
+inline float dotNoiseGradient(uint32_t h, float x, float y)
+{
+    float gx = float(h & 0xffffu) * (2.f / 65535.f) - 1.f;
+    float gy = float(h >> 16) * (2.f / 65535.f) - 1.f;
+    return gx * x + gy * y;
+}
+
+/* Gradient noise at (x, y), roughly within [-1, 1]. The lattice repeats every periodX by periodY cells. */
+inline float gradientNoise(float x, float y, uint32_t seed, float periodX, float periodY)
+{
+    float fx = floorNoise(x), fy = floorNoise(y);
+    float dx = x - fx, dy = y - fy;
+    float wx = wrapNoiseLattice(fx, periodX), wy = wrapNoiseLattice(fy, periodY);
+    int32_t x0 = int32_t(wx), x1 = (x0 + 1) * int32_t(wx + 1.f < periodX);
+    int32_t y0 = int32_t(wy), y1 = (y0 + 1) * int32_t(wy + 1.f < periodY);
+
+    float n00 = dotNoiseGradient(hashNoiseLattice(x0, y0, seed), dx, dy);
+    float n10 = dotNoiseGradient(hashNoiseLattice(x1, y0, seed), dx - 1.f, dy);
+    float n01 = dotNoiseGradient(hashNoiseLattice(x0, y1, seed), dx, dy - 1.f);
+    float n11 = dotNoiseGradient(hashNoiseLattice(x1, y1, seed), dx - 1.f, dy - 1.f);
+
+    float u = dx * dx * dx * (dx * (dx * 6.f - 15.f) + 10.f);
+    float v = dy * dy * dy * (dy * (dy * 6.f - 15.f) + 10.f);
+    float nx0 = n00 + u * (n10 - n00);
+    float nx1 = n01 + u * (n11 - n01);
+    return 1.7f * (nx0 + v * (nx1 - nx0));
+}
+
+/* Simplex noise at (x, y), roughly within [-1, 1]. The simplex lattice does not tile. */
+inline float simplexNoise(float x, float y, uint32_t seed)
+{
+    const float F2 = 0.36602540378f; // (sqrt(3) - 1) / 2
+    const float G2 = 0.21132486540f; // (3 - sqrt(3)) / 6
+
+    float s = (x + y) * F2;
+    float fi = floorNoise(x + s), fj = floorNoise(y + s);
+    float t = (fi + fj) * G2;
+    float x0 = x - (fi - t), y0 = y - (fj - t);
+    float i1 = float(int32_t(x0 > y0));
+    float j1 = 1.f - i1;
+    float x1 = x0 - i1 + G2, y1 = y0 - j1 + G2;
+    float x2 = x0 - 1.f + 2.f * G2, y2 = y0 - 1.f + 2.f * G2;
+    int32_t i = int32_t(fi), j = int32_t(fj);
+
+    float t0 = 0.5f - x0 * x0 - y0 * y0;
+    float t1 = 0.5f - x1 * x1 - y1 * y1;
+    float t2 = 0.5f - x2 * x2 - y2 * y2;
+    t0 *= t0 * float(int32_t(t0 > 0.f));
+    t1 *= t1 * float(int32_t(t1 > 0.f));
+    t2 *= t2 * float(int32_t(t2 > 0.f));
+    float n0 = t0 * t0 * dotNoiseGradient(hashNoiseLattice(i, j, seed), x0, y0);
+    float n1 = t1 * t1 * dotNoiseGradient(hashNoiseLattice(i + int32_t(i1), j + int32_t(j1), seed), x1, y1);
+    float n2 = t2 * t2 * dotNoiseGradient(hashNoiseLattice(i + 1, j + 1, seed), x2, y2);
+    return 80.f * (n0 + n1 + n2);
+}
+
+/*
+ * Cellular noise at (x, y): the squared distance to the nearest feature point, in cells.
+ * See mapCellularNoise, which is kept separate since std::sqrt does not vectorize.
+ */
+inline float cellularNoiseSquared(float x, float y, uint32_t seed, float jitter, float periodX, float periodY)
+{
+    float fx = floorNoise(x), fy = floorNoise(y);
+    float dx = x - fx, dy = y - fy;
+    float nearest = 8.f;
+    for (int32_t oy = -1; oy <= 1; ++oy) {
+        for (int32_t ox = -1; ox <= 1; ++ox) {
+            int32_t cx = int32_t(wrapNoiseLattice(fx + float(ox), periodX));
+            int32_t cy = int32_t(wrapNoiseLattice(fy + float(oy), periodY));
+            uint32_t h = hashNoiseLattice(cx, cy, seed);
+            float px = float(ox) + jitter * float(h & 0xffffu) * (1.f / 65535.f) - dx;
+            float py = float(oy) + jitter * float(h >> 16) * (1.f / 65535.f) - dy;
+            nearest = std::min(nearest, px * px + py * py);
+        }
+    }
+    return nearest;
+}
+
+/* Maps a squared distance from cellularNoiseSquared, clamped to [0, 1], to [-1, 1] */
+inline float mapCellularNoise(float nearest)
+{
+    return std::min(std::sqrt(nearest), 1.f) * 2.f - 1.f;
+}
+
+/**
+ * Sums the octaves of noise at the texture coordinates (u[i], v[i]) into out[i], normalized by the total
+ * amplitude, so that fractal noise lies roughly within [-1, 1] and turbulence within [0, 1].
+ * @param aspect The height of the texture over its width, so that cells stay square
+ * @param scratch Room for count floats
+ */
+inline void accumulateNoise(const NoiseParameters &p, const float* u, const float* v, uint32_t count, float aspect,
+    uint32_t seed, float* out, float* scratch)
+{
+    std::fill(out, out + count, 0.f);
+    float frequency = p.frequency, amplitude = 1.f, total = 0.f;
+    for (uint32_t octave = 0; octave < p.octaves; ++octave) {
+        float fx = frequency, fy = frequency * aspect;
+        float periodX = NOISE_UNTILED_PERIOD, periodY = NOISE_UNTILED_PERIOD;
+        if (p.tileable) {
+            fx = periodX = std::max(1.f, std::round(fx));
+            fy = periodY = std::max(1.f, std::round(fy));
+        }
+        uint32_t octaveSeed = seed + octave * 0x9e3779b9u;
+        float jitter = p.jitter;
+
+        // One loop per noise type, so that each loop body is straight line code
+        float* n = scratch;
+        if (p.type == NOISE_SIMPLEX) {
+            for (uint32_t i = 0; i < count; ++i) n[i] = simplexNoise(u[i] * fx, v[i] * fy, octaveSeed);
+        }
+        else if (p.type == NOISE_CELLULAR) {
+            for (uint32_t i = 0; i < count; ++i) n[i] = cellularNoiseSquared(u[i] * fx, v[i] * fy, octaveSeed, jitter, periodX, periodY);
+            for (uint32_t i = 0; i < count; ++i) n[i] = mapCellularNoise(n[i]);
+        }
+        else {
+            for (uint32_t i = 0; i < count; ++i) n[i] = gradientNoise(u[i] * fx, v[i] * fy, octaveSeed, periodX, periodY);
+        }
+        if (p.turbulence) for (uint32_t i = 0; i < count; ++i) out[i] += amplitude * std::abs(n[i]);
+        else for (uint32_t i = 0; i < count; ++i) out[i] += amplitude * n[i];
+
+        total += amplitude;
+        amplitude *= p.gain;
+        frequency *= p.lacunarity;
+    }
+    if (total > 0.f) for (uint32_t i = 0; i < count; ++i) out[i] /= total;
+}
+
+inline void storeNoiseChannel(glm::vec4 &texel, int channel, float value)
+{
+    texel[channel] = value;
+}
+
+inline void storeNoiseChannel(glm::u8vec4 &texel, int channel, float value)
+{
+    texel[channel] = uint8_t(value * 255.f + .5f);
+}
+
+/**
+ * Fills a width by height image with noise, every channel with an independent noise signal.
+ * Values are mapped to [0, 1], with fractal noise centered around .5.
+ * @param texels Either glm::vec4 or glm::u8vec4 texels, in row major order
+ */
+template <typename Texel>
+inline void generateNoiseImage(Texel* texels, uint32_t width, uint32_t height, const NoiseParameters &p)
+{
+    if (width == 0 || height == 0) return;
+    float aspect = float(height) / float(width);
+
+    // Domain warping displaces the lookup by two more fractal noise signals, which never use turbulence
+    NoiseParameters warpParameters = p;
+    warpParameters.turbulence = false;
+
+    ThreadPool::global().parallelFor(0, height, [&] (uint64_t y) {
+        std::vector<float> u(width), v(width), value(width), scratch(width), warpX, warpY;
+        Texel* row = texels + size_t(y) * width;
+        for (int channel = 0; channel < 4; ++channel) {
+            uint32_t seed = hashNoiseLattice(channel, 0, p.seed);
+            for (uint32_t x = 0; x < width; ++x) {
+                u[x] = (x + .5f) / float(width);
+                v[x] = (y + .5f) / float(height);
+            }
+            if (p.warp != 0.f) {
+                warpX.resize(width);
+                warpY.resize(width);
+                accumulateNoise(warpParameters, u.data(), v.data(), width, aspect, seed ^ 0x68e31da4u, warpX.data(), scratch.data());
+                accumulateNoise(warpParameters, u.data(), v.data(), width, aspect, seed ^ 0xb5297a4du, warpY.data(), scratch.data());
+                float scaleX = p.warp / p.frequency, scaleY = p.warp / (p.frequency * aspect);
+                for (uint32_t x = 0; x < width; ++x) {
+                    u[x] += scaleX * warpX[x];
+                    v[x] += scaleY * warpY[x];
+                }
+            }
+            accumulateNoise(p, u.data(), v.data(), width, aspect, seed, value.data(), scratch.data());
+            for (uint32_t x = 0; x < width; ++x) {
+                float n = p.turbulence ? value[x] : value[x] * .5f + .5f;
+                storeNoiseChannel(row[x], channel, std::min(std::max(n, 0.f), 1.f));
+            }
+        }
+    }, 1);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#ifdef __CUDACC__
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR __both__
+#endif
+#else
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR
+#endif
+#endif
+
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#ifndef __CUDA_ARCH__
+#include <vector>
+#include <array>
+#include <cmath>
+#include <nvisii/utilities/bvh.h>
+#endif
+
+/**
+ * Point clouds, as made by Mesh::createPointCloud, are drawn as one sphere per point rather than
+ * as triangles. Both backends keep each point as its center followed by its radius, and intersect
+ * the spheres with the functions below: the OptiX backend from its own custom primitive BLAS, and
+ * the CPU backend from a BVH built by buildPointCloudBVH.
+ */
+
+/**
+ * Intersects a ray with a sphere. Directions need not be normalized.
+ * @param t Returns the distance to the nearest intersection within (tmin, tmax)
+ * @returns true if the ray hits the sphere within (tmin, tmax)
+ */
+inline CUDA_DECORATOR
+bool intersectSphere(const glm::vec3 &origin, const glm::vec3 &direction, const glm::vec3 &center, float radius,
+    float tmin, float tmax, float &t)
+{
+    // Solved about the point on the ray closest to the center, which keeps small spheres far from the origin precise
+    glm::vec3 oc = origin - center;
+    float a = glm::dot(direction, direction);
+    float tc = -glm::dot(oc, direction) / a;
+    glm::vec3 l = oc + tc * direction;
+    float disc = radius * radius - glm::dot(l, l);
+    if (disc < 0.f) return false;
+    float h = sqrtf(disc / a);
+    if ((tc - h) > tmin && (tc - h) < tmax) { t = tc - h; return true; }
+    // The ray starts inside the sphere
+    if ((tc + h) > tmin && (tc + h) < tmax) { t = tc + h; return true; }
+    return false;
+}
+
+/** @returns latitude-longitude texture coordinates for a unit direction from the center of a sphere */
+inline CUDA_DECORATOR
+glm::vec2 sphereUV(const glm::vec3 &n)
+{
+    const float pi = 3.14159265358979f;
+    return glm::vec2(atan2f(n.y, n.x) * (.5f / pi) + .5f, acosf(glm::clamp(n.z, -1.f, 1.f)) / pi);
+}
+
+/** @returns a unit tangent along increasing u, for a unit direction from the center of a sphere */
+inline CUDA_DECORATOR
+glm::vec3 sphereTangent(const glm::vec3 &n)
+{
+    glm::vec3 t = glm::vec3(-n.y, n.x, 0.f);
+    float length = glm::length(t);
+    // At the poles, any direction in the tangent plane will do
+    return (length > 1e-6f) ? t / length : glm::vec3(1.f, 0.f, 0.f);
+}
+
+#ifndef __CUDA_ARCH__
+/** @returns each point as its center followed by its radius */
+inline std::vector<glm::vec4> packPoints(const std::vector<std::array<float, 3>> &positions, const std::vector<float> &radii)
+{
+    std::vector<glm::vec4> points(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i)
+        points[i] = glm::vec4(positions[i][0], positions[i][1], positions[i][2], radii[i]);
+    return points;
+}
+
+/**
+ * Builds a BVH over the bounding box of each sphere, in the space of the point cloud.
+ * @param points Each point as its center followed by its radius, as returned by packPoints
+ */
+inline void buildPointCloudBVH(const std::vector<glm::vec4> &points, BVH &bvh, uint32_t maxLeafSize = 4)
+{
+    std::vector<glm::vec3> bbmins(points.size()), bbmaxs(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        glm::vec3 center = glm::vec3(points[i]);
+        float radius = fabsf(points[i].w);
+        bbmins[i] = center - glm::vec3(radius);
+        bbmaxs[i] = center + glm::vec3(radius);
+    }
+    bvh.build(bbmins, bbmaxs, maxLeafSize);
+}
+#endif
@@ -21,43 +21,63 @@ float Scale(float inCos)
 	return 0.25f * exp(-0.00287f + x*(0.459f + x*(3.83f + x*(-6.80f + x*5.25f))));
 }
 
+#define OUTER_RADIUS 1.025f
+#define kRAYLEIGH (mix(0.0f, 0.0025f, pow(atmosphereThickness,2.5f))) 
+#define kMIE 0.0010f 
+#define kSUN_BRIGHTNESS 20.0f 
+#define kMAX_SCATTER 50.0f 
+#define MIE_G (-0.990f) 
+#define MIE_G2 0.9801f 
+
+/** 
+ * Terms of the procedural sky which only depend on the sky parameters, and not 
+ * on the view direction. Computing these once per image rather than once per texel 
+ * leaves only straight line arithmetic in the per-texel evaluation.
+ */
+struct ProceduralSkyConstants {
+    vec3 sunDir;
+    vec3 invWavelength;
+    float krESun;
+    float kr4PI;
+    float saturation;
+};
+
 inline CUDA_DECORATOR
-vec3 ProceduralSkybox(
-    vec3 rd, 
+ProceduralSkyConstants ProceduralSkyboxConstants(
     vec3 sunPos, 
     vec3 skyTint = vec3(.5f, .5f, .5f), 
     float atmosphereThickness = 1.0f,
     float saturation = 1.0f
 )
 {
-    #define OUTER_RADIUS 1.025f
-    #define kRAYLEIGH (mix(0.0f, 0.0025f, pow(atmosphereThickness,2.5f))) 
-    #define kMIE 0.0010f 
-    #define kSUN_BRIGHTNESS 20.0f 
-    #define kMAX_SCATTER 50.0f 
-    #define MIE_G (-0.990f) 
-    #define MIE_G2 0.9801f 
     const vec3 ScatteringWavelength = vec3(.65f, .57f, .475f);
     const vec3 ScatteringWavelengthRange = vec3(.15f, .15f, .15f);    
+    vec3 kSkyTintInGammaSpace = skyTint;
+    vec3 kScatteringWavelength = mix(ScatteringWavelength-ScatteringWavelengthRange,ScatteringWavelength+ScatteringWavelengthRange,vec3(1.f,1.f,1.f) - kSkyTintInGammaSpace);
+
+    ProceduralSkyConstants c;
+    c.sunDir = normalize(sunPos);
+    c.invWavelength = 1.0f / (pow(kScatteringWavelength, vec3(4.0f)));
+    c.krESun = kRAYLEIGH * kSUN_BRIGHTNESS;
+    c.kr4PI = kRAYLEIGH * 4.0f * 3.14159265f;
+    c.saturation = saturation;
+    return c;
+}
+
+inline CUDA_DECORATOR
+vec3 ProceduralSkybox(vec3 rd, const ProceduralSkyConstants &c)
+{
     const float kOuterRadius = OUTER_RADIUS; 
     const float kOuterRadius2 = OUTER_RADIUS*OUTER_RADIUS;
     const float kInnerRadius = 1.0f;
     const float kInnerRadius2 = 1.0f;
     const float kCameraHeight = 0.0001f;
-    const float kHDSundiskIntensityFactor = 15.0f;
-    const float kSunScale = 400.0f * kSUN_BRIGHTNESS;
     const float kKmESun = kMIE * kSUN_BRIGHTNESS;
     const float kKm4PI = kMIE * 4.0f * 3.14159265f;
     const float kScale = 1.0 / (OUTER_RADIUS - 1.0f);
-    const float kScaleDepth = 0.25f;
     const float kScaleOverScaleDepth = (1.0f / (OUTER_RADIUS - 1.0f)) / 0.25f;
     const float kSamples = 2.0f;
 
-    vec3 kSkyTintInGammaSpace = skyTint;
-    vec3 kScatteringWavelength = mix(ScatteringWavelength-ScatteringWavelengthRange,ScatteringWavelength+ScatteringWavelengthRange,vec3(1.f,1.f,1.f) - kSkyTintInGammaSpace);
-    vec3 kInvWavelength = 1.0f / (pow(kScatteringWavelength, vec3(4.0f)));
-    float kKrESun = kRAYLEIGH * kSUN_BRIGHTNESS;
-    float kKr4PI = kRAYLEIGH * 4.0f * 3.14159265f;
     vec3 cameraPos = vec3(0.f,kInnerRadius + kCameraHeight,0.f);
     vec3 eyeRay = rd;
     eyeRay.y = abs(eyeRay.y);
@@ -65,7 +85,6 @@ vec3 ProceduralSkybox(
     vec3 cIn, cOut;
 
     _far = sqrt(kOuterRadius2 + kInnerRadius2 * eyeRay.y * eyeRay.y - kInnerRadius2) - kInnerRadius * eyeRay.y;
-    vec3 pos = cameraPos + _far * eyeRay;
     float height = kInnerRadius + kCameraHeight;
     float depth = exp(kScaleOverScaleDepth * (-kCameraHeight));
     float startAngle = dot(eyeRay, cameraPos) / height;
@@ -79,24 +98,80 @@ vec3 ProceduralSkybox(
     {
         float height = length(samplePoint);
         float depth = exp(kScaleOverScaleDepth * (kInnerRadius - height));
-        float lightAngle = dot(normalize(sunPos), samplePoint) / height;
+        float lightAngle = dot(c.sunDir, samplePoint) / height;
         float cameraAngle = dot(eyeRay, samplePoint) / height;
         float scatter = (startOffset + depth*(Scale(lightAngle) - Scale(cameraAngle)));
-        vec3 attenuate = exp(-glm::clamp(scatter, 0.0f, kMAX_SCATTER) * (kInvWavelength * kKr4PI + kKm4PI));
+        vec3 attenuate = exp(-glm::clamp(scatter, 0.0f, kMAX_SCATTER) * (c.invWavelength * c.kr4PI + kKm4PI));
         frontColor += attenuate * (depth * scaledLength);
         samplePoint += sampleRay;
     }
-    cIn = frontColor * (kInvWavelength * kKrESun);
+    cIn = frontColor * (c.invWavelength * c.krESun);
     cOut = frontColor * kKmESun;
     
-    vec3 skyColor = (cIn * (0.75f + 0.75f * dot(normalize(sunPos), -eyeRay) * dot(normalize(sunPos), -eyeRay))); 
+    vec3 skyColor = (cIn * (0.75f + 0.75f * dot(c.sunDir, -eyeRay) * dot(c.sunDir, -eyeRay))); 
     skyColor = pow(skyColor, vec3(1.0f / 2.2f));
 
     vec3 W = vec3(0.2125f, 0.7154f, 0.0721f);
     vec3 intensity = vec3(dot(skyColor, W));
-    skyColor = glm::mix(intensity, skyColor, saturation);
+    skyColor = glm::mix(intensity, skyColor, c.saturation);
 
     // skyColor = pow(skyColor, vec3(2.2f));
     vec3 color = skyColor;
     return color;
-}
\ No newline at end of file
+}
+
+inline CUDA_DECORATOR
+vec3 ProceduralSkybox(
+    vec3 rd, 
+    vec3 sunPos, 
+    vec3 skyTint = vec3(.5f, .5f, .5f), 
+    float atmosphereThickness = 1.0f,
+    float saturation = 1.0f
+)
+{
+    return ProceduralSkybox(rd, ProceduralSkyboxConstants(sunPos, skyTint, atmosphereThickness, saturation));
+}
+
+#ifndef __CUDA_ARCH__
+#include <vector>
+#include <algorithm>
+#include <nvisii/utilities/thread_pool.h>
+
+/**
+ * Evaluates the procedural sky into a latitude/longitude image, using the same 
+ * mapping the dome light uses to look up its texture. Rows are generated in parallel on the shared thread pool, 
+ * and the trigonometry for each row and column is computed once up front so that 
+ * the per-texel work is only the scattering integral itself.
+ * @param texels The output image, which must hold width * height texels
+ * @param width The width of the image
+ * @param height The height of the image
+ * @param sunPos The position of the sun relative to [0,0,0], in nvisii's Z-up coordinates
+ */
+inline void generateProceduralSkyImage(
+    vec4* texels, uint32_t width, uint32_t height,
+    vec3 sunPos, vec3 skyTint, float atmosphereThickness, float saturation)
+{
+    if (width == 0 || height == 0) return;
+
+    // The sky model is Y-up
+    ProceduralSkyConstants c = ProceduralSkyboxConstants(vec3(sunPos.x, sunPos.z, sunPos.y), skyTint, atmosphereThickness, saturation);
+
+    std::vector<float> cosTheta(width), sinTheta(width);
+    for (uint32_t x = 0; x < width; ++x) {
+        float theta = 2.0f * 3.14159265f * (x / float(width)) - 3.14159265f / 2.0f;
+        cosTheta[x] = cos(theta);
+        sinTheta[x] = sin(theta);
+    }
+
+    ThreadPool::global().parallelFor(0, height, [&] (uint64_t y) {
+        float phi = 3.14159265f * (y / float(height));
+        float sinPhi = sin(phi), cosPhi = cos(phi);
+        vec4* row = texels + size_t(y) * width;
+        for (uint32_t x = 0; x < width; ++x) {
+            vec3 dir = vec3(cosTheta[x] * sinPhi, sinTheta[x] * sinPhi, cosPhi);
+            vec3 color = ProceduralSkybox(vec3(dir.x, -dir.z, dir.y), c);
+            row[x] = vec4(color.r, color.g, color.b, 1.0f);
+        }
+    }, 1);
+}
+#endif
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+/**
+ * Collects timings and counters for each rendered frame, keeping the most recent frames around.
+ *
+ * Timings are accumulated in milliseconds under "<stage>_ms", and counters under their own name,
+ * so a stage that runs several times in a frame (eg one launch per sample) reports its total.
+ * Anything recorded between two calls to endFrame belongs to the frame ended by the second call,
+ * which means work done between frames (eg creating a texture) shows up in the next frame.
+ *
+ * All functions are safe to call from any thread.
+ */
+class FrameProfiler {
+public:
+    typedef std::map<std::string, double> Frame;
+
+    /** Adds time spent in a stage to the current frame */
+    void addTime(const std::string &stage, double milliseconds)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current[stage + "_ms"] += milliseconds;
+    }
+
+    /** Adds to a counter of the current frame */
+    void addCount(const std::string &counter, double amount = 1.0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current[counter] += amount;
+    }
+
+    /** Sets a value of the current frame, replacing any previous value */
+    void setValue(const std::string &name, double value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current[name] = value;
+    }
+
+    /** Marks the start of a frame, from which "frame_ms" is measured */
+    void beginFrame()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frameStart = std::chrono::steady_clock::now();
+        frameStarted = true;
+    }
+
+    /** Completes the current frame, numbering it and moving it into the history */
+    void endFrame()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (frameStarted) {
+            current["frame_ms"] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+            frameStarted = false;
+        }
+        current["frame"] = double(frameCount++);
+        history.push_back(std::move(current));
+        current.clear();
+        while (history.size() > historySize) history.pop_front();
+    }
+
+    /**
+     * @param count The number of frames to return
+     * @returns up to count of the most recently completed frames, oldest first
+     */
+    std::vector<Frame> getFrames(size_t count) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        count = std::min(count, history.size());
+        return std::vector<Frame>(history.end() - count, history.end());
+    }
+
+    /** Sets how many completed frames are kept, discarding the oldest ones if needed */
+    void setHistorySize(size_t size)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        historySize = size;
+        while (history.size() > historySize) history.pop_front();
+    }
+
+    size_t getHistorySize() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return historySize;
+    }
+
+    /** Discards all frames, including the one in progress, and restarts frame numbering */
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        history.clear();
+        current.clear();
+        frameCount = 0;
+        frameStarted = false;
+    }
+
+private:
+    mutable std::mutex mutex;
+    Frame current;
+    std::deque<Frame> history;
+    size_t historySize = 120;
+    uint64_t frameCount = 0;
+    bool frameStarted = false;
+    std::chrono::steady_clock::time_point frameStart;
+};
+
+/**
+ * Adds the wall time between its construction and destruction to a stage of the current frame,
+ * and records it as a span when tracing is enabled. The stage must be a string literal.
+ */
+class ScopedTimer {
+public:
+    ScopedTimer(FrameProfiler &profiler, const char* stage)
+        : profiler(profiler), stage(stage), trace(stage, "render"), start(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer()
+    {
+        profiler.addTime(stage, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer &operator=(const ScopedTimer&) = delete;
+
+private:
+    FrameProfiler &profiler;
+    const char* stage;
+    TraceScope trace;
+    std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+
+/**
+ * Decides when a progressive render should stop, given a time budget and a maximum
+ * number of passes.
+ *
+ * After each pass, the caller reports the total time elapsed since the render began.
+ * Another pass is only started if a smoothed estimate of the pass time says it will
+ * finish within the budget, so that renders end close to, but not after, their deadline.
+ * The first pass is always rendered, so that there is an image to return.
+ *
+ * Time is measured by the caller rather than here, which keeps the stopping logic
+ * independent of any particular clock.
+ */
+class RenderBudget {
+public:
+    /**
+     * Starts tracking a new render.
+     * @param timeBudgetMs The time the render may take in milliseconds, or 0 for no time limit
+     * @param maxPasses The largest number of passes to render
+     */
+    void begin(double timeBudgetMs, uint32_t maxPasses)
+    {
+        this->timeBudgetMs = timeBudgetMs;
+        this->maxPasses = maxPasses;
+        passes = 0;
+        elapsedMs = 0.0;
+        estimatedPassMs = 0.0;
+    }
+
+    /**
+     * Records that a pass finished.
+     * @param elapsedMs The time since the render began in milliseconds, including the pass that just finished
+     */
+    void endPass(double elapsedMs)
+    {
+        double passMs = std::max(elapsedMs - this->elapsedMs, 0.0);
+        // The first pass tends to be slower than the rest, so its estimate is quickly replaced
+        estimatedPassMs = (passes == 0) ? passMs : (1.0 - smoothing) * estimatedPassMs + smoothing * passMs;
+        this->elapsedMs = std::max(elapsedMs, this->elapsedMs);
+        passes++;
+    }
+
+    /** @returns true if another pass should be rendered */
+    bool shouldContinue() const
+    {
+        if (passes >= maxPasses) return false;
+        if (!hasTimeBudget() || passes == 0) return true;
+        return elapsedMs + estimatedPassMs <= timeBudgetMs;
+    }
+
+    /** @returns true if the render stopped, or will stop, because it ran out of time rather than passes */
+    bool isOutOfTime() const
+    {
+        return hasTimeBudget() && passes > 0 && passes < maxPasses && !shouldContinue();
+    }
+
+    /** @returns true if the render has a time limit */
+    bool hasTimeBudget() const { return timeBudgetMs > 0.0; }
+
+    /** @returns the number of passes rendered so far */
+    uint32_t getPassCount() const { return passes; }
+
+    /** @returns the time since the render began in milliseconds, as of the last pass */
+    double getElapsedMs() const { return elapsedMs; }
+
+    /** @returns the smoothed time a pass takes in milliseconds */
+    double getEstimatedPassMs() const { return estimatedPassMs; }
+
+private:
+    const double smoothing = .5;
+
+    double timeBudgetMs = 0.0;
+    uint32_t maxPasses = 0;
+    uint32_t passes = 0;
+    double elapsedMs = 0.0;
+    double estimatedPassMs = 0.0;
+};
@@ -0,0 +1,272 @@
+#pragma once
+
+#ifdef __CUDACC__
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR __both__
+#endif
+#else
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR
+#endif
+#endif
+
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+/**
+ * Low discrepancy samplers used to generate the random numbers of a path.
+ *
+ * Every random decision along a path is assigned a fixed "dimension", and each
+ * sampler maps (pixel, sample index, dimension) to a number in [0, 1). Unlike a
+ * sequential random number generator, samples taken at the same dimension are
+ * stratified against each other across the samples of a pixel, which reduces
+ * noise at the low sample counts typically used for data generation.
+ *
+ * SAMPLER_INDEPENDENT: Uncorrelated random numbers, for reference.
+ * SAMPLER_SOBOL: Owen scrambled Sobol points, shuffled and padded in groups of four dimensions
+ *      (Burley 2020, "Practical Hash-based Owen Scrambling"). Dimensions within a group of four
+ *      are stratified jointly.
+ * SAMPLER_PMJ02: Each 1D or 2D request is an independently shuffled, Owen scrambled (0,2) sequence,
+ *      which has the same elementary interval stratification as progressive multi-jittered (0,2) samples.
+ * SAMPLER_BLUE_NOISE: PMJ02 samples shared between pixels and toroidally shifted per pixel by a
+ *      blue noise like dither mask (Georgiev and Fajardo 2016, "Blue-noise Dithered Sampling"),
+ *      so that the remaining error is distributed as high frequency noise across the image.
+ */
+enum SamplerType : uint32_t {
+    SAMPLER_INDEPENDENT = 0,
+    SAMPLER_SOBOL = 1,
+    SAMPLER_PMJ02 = 2,
+    SAMPLER_BLUE_NOISE = 3
+};
+
+/** The per-pixel, per-sample state of a sampler. Small enough to keep in registers. */
+struct SamplerState {
+    uint32_t type;
+    uint32_t index;
+    uint32_t pixelX;
+    uint32_t pixelY;
+    uint32_t pixelSeed;
+    uint32_t seed;
+};
+
+/** A fast, well mixed 32 bit integer hash (Wellons' "lowbias32") */
+inline CUDA_DECORATOR
+uint32_t samplerHash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+inline CUDA_DECORATOR
+uint32_t samplerHashCombine(uint32_t seed, uint32_t v)
+{
+    return samplerHash(seed ^ (v + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+}
+
+inline CUDA_DECORATOR
+uint32_t samplerReverseBits(uint32_t x)
+{
+    #ifdef __CUDA_ARCH__
+    return __brev(x);
+    #else
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+    #endif
+}
+
+/**
+ * A hash that only lets bits influence higher bits, with the improved constants by Nathan Vegdahl.
+ * Applied to bit reversed values, this is an approximation of a nested uniform (Owen) scramble.
+ */
+inline CUDA_DECORATOR
+uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed)
+{
+    x ^= x * 0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16) | 1u;
+    x ^= x * 0x05526c56u;
+    x ^= x * 0x53a22864u;
+    return x;
+}
+
+/** Owen scrambles the bits of x, most significant bit first */
+inline CUDA_DECORATOR
+uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+{
+    x = samplerReverseBits(x);
+    x = laineKarrasPermutation(x, seed);
+    return samplerReverseBits(x);
+}
+
+/** Joe and Kuo's direction numbers for the third and fourth dimension of the Sobol sequence */
+#ifdef __CUDA_ARCH__
+__constant__
+#endif
+static const uint32_t sobolDirections[2][32] = {
+    {
+        0x80000000, 0xc0000000, 0x60000000, 0x90000000, 0xe8000000, 0x5c000000, 0x8e000000, 0xc5000000,
+        0x68800000, 0x9cc00000, 0xee600000, 0x55900000, 0x80680000, 0xc09c0000, 0x60ee0000, 0x90550000,
+        0xe8808000, 0x5cc0c000, 0x8e606000, 0xc5909000, 0x6868e800, 0x9c9c5c00, 0xeeee8e00, 0x5555c500,
+        0x8000e880, 0xc0005cc0, 0x60008e60, 0x9000c590, 0xe8006868, 0x5c009c9c, 0x8e00eeee, 0xc5005555
+    },
+    {
+        0x80000000, 0xc0000000, 0x20000000, 0x50000000, 0xf8000000, 0x74000000, 0xa2000000, 0x93000000,
+        0xd8800000, 0x25400000, 0x59e00000, 0xe6d00000, 0x78080000, 0xb40c0000, 0x82020000, 0xc3050000,
+        0x208f8000, 0x51474000, 0xfbea2000, 0x75d93000, 0xa0858800, 0x914e5400, 0xdbe79e00, 0x25db6d00,
+        0x58800080, 0xe54000c0, 0x79e00020, 0xb6d00050, 0x800800f8, 0xc00c0074, 0x200200a2, 0x50050093
+    }
+};
+
+/**
+ * @param index The index of the point in the sequence
+ * @param dimension The dimension of the point, between 0 and 3
+ * @returns a component of a point of the Sobol sequence, as a 32 bit fixed point number
+ */
+inline CUDA_DECORATOR
+uint32_t sobolSample(uint32_t index, uint32_t dimension)
+{
+    // The first dimension is the van der Corput sequence
+    if (dimension == 0) return samplerReverseBits(index);
+
+    // The second dimension's generator matrix is the Pascal matrix mod 2
+    if (dimension == 1) {
+        uint32_t x = 0, v = 1u << 31;
+        for (; index != 0; index >>= 1, v ^= v >> 1) if (index & 1u) x ^= v;
+        return x;
+    }
+
+    const uint32_t *v = sobolDirections[(dimension - 2) & 1];
+    uint32_t x = 0;
+    for (uint32_t bit = 0; index != 0; index >>= 1, ++bit) if (index & 1u) x ^= v[bit];
+    return x;
+}
+
+/** Converts a 32 bit fixed point number to a float in [0, 1) */
+inline CUDA_DECORATOR
+float samplerToFloat(uint32_t x)
+{
+    float f = float(x >> 8) * (1.f / 16777216.f);
+    return (f < 0.99999994f) ? f : 0.99999994f;
+}
+
+/**
+ * A dither mask with blue noise like spectral properties, from Roberts' R2 sequence over pixel coordinates.
+ * @returns the toroidal shift to apply at the given pixel and dimension, as a 32 bit fixed point number
+ */
+inline CUDA_DECORATOR
+uint32_t samplerDither(uint32_t x, uint32_t y, uint32_t dimension)
+{
+    // Offset the mask per dimension so that dimensions are not shifted identically
+    uint32_t h = samplerHash(dimension + 0x68bc21ebu);
+    x += h & 0xffffu; y += h >> 16;
+    // 2^32 / g and 2^32 / g^2, where g is the plastic number
+    return x * 3242174889u + y * 2447445413u + 0x80000000u;
+}
+
+/**
+ * Creates the sampler for one sample of one pixel.
+ * @param type The SamplerType to use
+ * @param pixelX The horizontal pixel coordinate
+ * @param pixelY The vertical pixel coordinate
+ * @param index The index of the sample within the pixel. Samples with consecutive indices are stratified against each other.
+ * @param seed A seed decorrelating renders, for example the seed passed to render
+ */
+inline CUDA_DECORATOR
+SamplerState samplerInit(uint32_t type, uint32_t pixelX, uint32_t pixelY, uint32_t index, uint32_t seed)
+{
+    SamplerState s;
+    s.type = type;
+    s.index = index;
+    s.pixelX = pixelX;
+    s.pixelY = pixelY;
+    s.seed = samplerHash(seed + 0x2545f491u);
+    s.pixelSeed = samplerHashCombine(samplerHashCombine(s.seed, pixelX), pixelY);
+    return s;
+}
+
+/** @returns a 1D Owen scrambled van der Corput point, shuffled so that each dimension is decorrelated */
+inline CUDA_DECORATOR
+uint32_t samplerPadded1D(uint32_t index, uint32_t seed, uint32_t dimension)
+{
+    uint32_t h = samplerHashCombine(seed, dimension);
+    uint32_t i = nestedUniformScramble(index, h);
+    return nestedUniformScramble(sobolSample(i, 0), samplerHash(h));
+}
+
+/** Computes a 2D Owen scrambled (0,2) sequence point, shuffled so that each dimension is decorrelated */
+inline CUDA_DECORATOR
+void samplerPadded2D(uint32_t index, uint32_t seed, uint32_t dimension, uint32_t &x, uint32_t &y)
+{
+    uint32_t h = samplerHashCombine(seed, dimension);
+    uint32_t i = nestedUniformScramble(index, h);
+    x = nestedUniformScramble(sobolSample(i, 0), samplerHash(h ^ 0xa511e9b3u));
+    y = nestedUniformScramble(sobolSample(i, 1), samplerHash(h ^ 0x63d83595u));
+}
+
+/** @returns a component of a shuffled, Owen scrambled 4D Sobol point, padded across groups of four dimensions */
+inline CUDA_DECORATOR
+uint32_t samplerSobolComponent(const SamplerState &s, uint32_t dimension)
+{
+    uint32_t group = dimension >> 2, lane = dimension & 3u;
+    uint32_t h = samplerHashCombine(s.pixelSeed, group);
+    uint32_t i = nestedUniformScramble(s.index, h);
+    return nestedUniformScramble(sobolSample(i, lane), samplerHashCombine(h, lane));
+}
+
+/**
+ * @param s The sampler
+ * @param dimension The dimension of the random decision being made
+ * @returns a sample in [0, 1)
+ */
+inline CUDA_DECORATOR
+float samplerGet1D(const SamplerState &s, uint32_t dimension)
+{
+    switch (s.type) {
+        case SAMPLER_SOBOL:
+            return samplerToFloat(samplerSobolComponent(s, dimension));
+        case SAMPLER_PMJ02:
+            return samplerToFloat(samplerPadded1D(s.index, s.pixelSeed, dimension));
+        case SAMPLER_BLUE_NOISE:
+            return samplerToFloat(samplerPadded1D(s.index, s.seed, dimension) + samplerDither(s.pixelX, s.pixelY, dimension));
+        default:
+            return samplerToFloat(samplerHashCombine(samplerHashCombine(s.pixelSeed, s.index), dimension));
+    }
+}
+
+/**
+ * @param s The sampler
+ * @param dimension The first of the two dimensions of the random decision being made.
+ * For the Sobol sampler, both dimensions should be within the same group of four.
+ * @returns a sample in [0, 1)^2
+ */
+inline CUDA_DECORATOR
+glm::vec2 samplerGet2D(const SamplerState &s, uint32_t dimension)
+{
+    switch (s.type) {
+        case SAMPLER_SOBOL:
+            return glm::vec2(
+                samplerToFloat(samplerSobolComponent(s, dimension)),
+                samplerToFloat(samplerSobolComponent(s, dimension + 1)));
+        case SAMPLER_PMJ02: {
+            uint32_t x, y;
+            samplerPadded2D(s.index, s.pixelSeed, dimension, x, y);
+            return glm::vec2(samplerToFloat(x), samplerToFloat(y));
+        }
+        case SAMPLER_BLUE_NOISE: {
+            uint32_t x, y;
+            samplerPadded2D(s.index, s.seed, dimension, x, y);
+            x += samplerDither(s.pixelX, s.pixelY, dimension);
+            y += samplerDither(s.pixelX, s.pixelY, dimension + 1);
+            return glm::vec2(samplerToFloat(x), samplerToFloat(y));
+        }
+        default:
+            return glm::vec2(samplerGet1D(s, dimension), samplerGet1D(s, dimension + 1));
+    }
+}
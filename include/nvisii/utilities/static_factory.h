@@ -37,7 +37,9 @@
 #include <memory>
 #include <typeindex>
 
+#include <atomic>
 #include <exception>
+#include <functional>
 #include <mutex>
 #include <thread>
 #include <future>
@@ -61,12 +63,12 @@ class StaticFactory {
         return (it != lookupTable.end());
     }
 
-    /* Returns the first index where an item of type T is uninitialized. */
+    /* Returns the first index where an item of type T is uninitialized and not reserved. */
     template<class T>
     static int32_t findAvailableID(T *items, size_t maxItems) 
     {
         for (size_t i = 0; i < maxItems; ++i)
-            if (items[i].initialized == false)
+            if ((items[i].initialized == false) && (items[i].reservation == 0))
                 return (int32_t)i;
         return -1;
     }
@@ -98,6 +100,69 @@ class StaticFactory {
         return &items[id];
     }
 
+    /* 
+     * Creates an item in three steps, so that slow work like file IO and decoding runs without holding the mutex.
+     * First, a location in items and the name are reserved under the mutex. The reserved item is invisible to get,
+     * and other creates can neither take its location nor its name. Next, build is called with no lock held, and
+     * returns a payload. Last, the item is constructed under the mutex, and publish moves the payload into it.
+     * If build or publish throws, or if the item is removed while being built, the reservation is released again.
+     */
+    template<class T, class Payload>
+    static T* create(std::shared_ptr<std::recursive_mutex> factory_mutex, std::string name, std::string type, std::map<std::string, uint32_t> &lookupTable, T* items, size_t maxItems, std::function<Payload()> build, std::function<void(T*, Payload&)> publish) 
+    {
+        auto mutex = factory_mutex.get();
+        int32_t id;
+        uint64_t reservation = getNextReservation();
+        {
+            std::lock_guard<std::recursive_mutex> lock(*mutex);
+            if (doesItemExist(lookupTable, name))
+                throw std::runtime_error(std::string("Error: " + type + " \"" + name + "\" already exists."));
+
+            id = findAvailableID(items, maxItems);
+
+            if (id < 0) 
+                throw std::runtime_error(std::string("Error: max " + type + " limit reached."));
+
+            items[id].reservation = reservation;
+            lookupTable[name] = id;
+        }
+
+        // Only releases the reservation if it is still ours, since the item might have been removed and the
+        // location reused in the meantime.
+        auto release = [&] () {
+            if (items[id].reservation != reservation) return;
+            items[id] = T();
+            lookupTable.erase(name);
+        };
+
+        Payload payload;
+        try {
+            payload = build();
+        } catch (...) {
+            std::lock_guard<std::recursive_mutex> lock(*mutex);
+            release();
+            throw;
+        }
+
+        std::lock_guard<std::recursive_mutex> lock(*mutex);
+        if (items[id].reservation != reservation)
+            throw std::runtime_error(std::string("Error: " + type + " \"" + name + "\" was removed while being created."));
+
+        #if SF_VERBOSE
+        std::cout << "Adding " << type << " \"" << name << "\"" << std::endl;
+        #endif
+        items[id] = T(name, id);
+        items[id].reservation = reservation;
+        try {
+            publish(&items[id], payload);
+        } catch (...) {
+            release();
+            throw;
+        }
+        items[id].reservation = 0;
+        return &items[id];
+    }
+
     /* Retrieves an element with a lookup table indirection */
     template<class T>
     static T* get(std::shared_ptr<std::recursive_mutex> factory_mutex, std::string name, std::string type, std::map<std::string, uint32_t> &lookupTable, T* items, size_t maxItems) 
@@ -174,6 +239,9 @@ class StaticFactory {
 
     /* Inheriting factories should set this field to true when a component is considered initialied. */
     bool initialized = false;
+
+    /* Non-zero while this location is reserved by a create which is still building its payload. */
+    uint64_t reservation = 0;
     
     /* Inheriting factories should set these fields when a component is created. */
     std::string name = "";
@@ -183,5 +251,14 @@ class StaticFactory {
     std::set<uint32_t> entities; // most components are foreign keys to an entity
     std::set<uint32_t> materials; // textures are foreign keys to materials
     std::set<uint32_t> lights; // textures also foreign keys to lights (for textured lights)
+
+    private:
+
+    /* Returns a new, non-zero reservation number, unique across all factories. */
+    static uint64_t getNextReservation()
+    {
+        static std::atomic<uint64_t> counter(0);
+        return ++counter;
+    }
 };
 #undef SF_VERBOSE
\ No newline at end of file
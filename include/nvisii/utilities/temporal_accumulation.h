@@ -0,0 +1,115 @@
+#pragma once
+
+#ifdef __CUDACC__
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR __both__
+#endif
+#else
+#ifndef CUDA_DECORATOR
+#define CUDA_DECORATOR
+#endif
+#endif
+
+#include <stdint.h>
+#include <math.h>
+#include <glm/glm.hpp>
+
+/**
+ * Temporal accumulation reuses the samples of previous frames in an animation.
+ *
+ * While rendering, the path tracer writes a guide for each pixel, describing the first
+ * surface seen through it: (screen space motion x, screen space motion y, hit distance, entity id).
+ * The motion is the offset from where the surface was in the previous frame to where it is now,
+ * as a fraction of the frame size, and the entity id is -1 where the camera ray missed.
+ *
+ * Each pixel then follows its motion vector back into the history, the accumulated result of the
+ * previous frames, and bilinearly filters it. History pixels which saw a different entity, or a
+ * surface at a different distance, were occluded in the previous frame and are rejected.
+ * What remains is blended with the new samples, weighted by sample count. The alpha channel of
+ * the history holds that count, capped so that older frames fade out and lighting changes
+ * are picked up.
+ */
+
+/**
+ * Blends the new samples of one pixel with the reprojected history.
+ * All buffers are width * height pixels, stored bottom row first like the frame buffer.
+ * @param x The pixel's column
+ * @param y The pixel's row in the buffers, counted from the bottom
+ * @param samples The mean of the samples taken this frame
+ * @param guides The guides written this frame
+ * @param historyColor The accumulated color of the previous frame, with the sample count in alpha.
+ * May be null if there is no history.
+ * @param historyGuides The guides written the previous frame
+ * @param sampleCount The number of samples per pixel taken this frame
+ * @param maxHistorySamples The largest number of samples the history may contribute
+ * @param depthTolerance The relative difference in hit distance beyond which history is rejected
+ * @returns the blended color, with the number of samples it represents in alpha
+ */
+inline CUDA_DECORATOR
+glm::vec4 temporalAccumulatePixel(int x, int y, int width, int height,
+    const glm::vec4* samples, const glm::vec4* guides,
+    const glm::vec4* historyColor, const glm::vec4* historyGuides,
+    float sampleCount, float maxHistorySamples, float depthTolerance)
+{
+    const int i = y * width + x;
+    glm::vec3 current = glm::vec3(samples[i]);
+    glm::vec4 guide = guides[i];
+    if (!historyColor || !historyGuides || maxHistorySamples <= 0.f) return glm::vec4(current, sampleCount);
+
+    // Find where the center of this pixel was in the previous frame, relative to the history's pixel centers
+    float px = (float(x) + .5f) - guide.x * float(width) - .5f;
+    float py = (float(y) + .5f) - guide.y * float(height) - .5f;
+    int x0 = int(floorf(px)), y0 = int(floorf(py));
+    float fx = px - float(x0), fy = py - float(y0);
+
+    glm::vec3 history = glm::vec3(0.f);
+    float historySamples = 0.f;
+    float weightSum = 0.f;
+    for (int tap = 0; tap < 4; ++tap) {
+        int tx = x0 + (tap & 1), ty = y0 + (tap >> 1);
+        float w = ((tap & 1) ? fx : 1.f - fx) * ((tap >> 1) ? fy : 1.f - fy);
+        if (w <= 0.f || tx < 0 || ty < 0 || tx >= width || ty >= height) continue;
+
+        // Reject history of other surfaces, which this surface was occluded by or revealed from
+        int j = ty * width + tx;
+        glm::vec4 historyGuide = historyGuides[j];
+        if (historyGuide.w != guide.w) continue;
+        if (guide.w >= 0.f && fabsf(historyGuide.z - guide.z) > depthTolerance * fmaxf(historyGuide.z, guide.z)) continue;
+
+        glm::vec4 h = historyColor[j];
+        history += w * glm::vec3(h);
+        historySamples += w * h.w;
+        weightSum += w;
+    }
+    if (weightSum < 1e-3f) return glm::vec4(current, sampleCount);
+
+    // Partially rejected footprints are trusted in proportion to how much of them was valid
+    history = history / weightSum;
+    historySamples = fminf(historySamples / weightSum, maxHistorySamples) * weightSum;
+    float total = sampleCount + historySamples;
+    return glm::vec4((sampleCount * current + historySamples * history) / total, total);
+}
+
+#ifndef __CUDA_ARCH__
+/**
+ * The host reference of the temporal accumulation stage, which the CPU backend uses directly.
+ * See temporalAccumulatePixel for the parameters.
+ * @param result Receives the blended color of each pixel, with an alpha of 1
+ * @param newHistory Receives the blended color of each pixel, with its sample count in alpha
+ */
+inline void temporalAccumulate(int width, int height,
+    const glm::vec4* samples, const glm::vec4* guides,
+    const glm::vec4* historyColor, const glm::vec4* historyGuides,
+    float sampleCount, float maxHistorySamples, float depthTolerance,
+    glm::vec4* result, glm::vec4* newHistory)
+{
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            glm::vec4 c = temporalAccumulatePixel(x, y, width, height, samples, guides,
+                historyColor, historyGuides, sampleCount, maxHistorySamples, depthTolerance);
+            newHistory[y * width + x] = c;
+            result[y * width + x] = glm::vec4(glm::vec3(c), 1.f);
+        }
+    }
+}
+#endif
@@ -0,0 +1,385 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "trace.h"
+
+/** Lets the owner of some work ask for it to stop early. Copies share the same flag. */
+class CancellationToken {
+public:
+    CancellationToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() { *flag = true; }
+
+    bool isCancelled() const { return flag->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+/**
+ * A work stealing thread pool, shared by the host side code that runs in parallel (see global()),
+ * so that nested or concurrent parallel work never runs more threads than the process is allowed.
+ *
+ * Each worker keeps its own queue, running its newest tasks first and stealing the oldest tasks of
+ * the others when it runs dry. A thread which waits on the pool, in parallelFor or wait, runs queued
+ * tasks in the meantime, which makes it safe to use the pool from within its own tasks.
+ *
+ * The thread count includes the thread calling parallelFor, so a pool of one thread has no workers
+ * and runs everything on the caller.
+ *
+ * Any thread may submit work while another resizes the pool: resize waits for parallelFor calls and
+ * submissions from outside the pool to finish, and holds back new ones until the new workers run.
+ */
+class ThreadPool {
+public:
+    typedef std::function<void()> Task;
+
+    /** @param numThreads The number of threads, or zero for getDefaultThreadCount() */
+    explicit ThreadPool(uint32_t numThreads = 0) { start(numThreads ? numThreads : getDefaultThreadCount()); }
+
+    ~ThreadPool() { stop(); }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool &operator=(const ThreadPool&) = delete;
+
+    /** @returns the pool shared by all of nvisii */
+    static ThreadPool &global()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    /**
+     * @returns the number of threads this process may run at once: the hardware threads, limited by the
+     * CPU affinity mask and the cgroup CPU quota on Linux. The NVISII_NUM_THREADS environment variable
+     * overrides it.
+     */
+    static uint32_t getDefaultThreadCount()
+    {
+        if (const char* env = getenv("NVISII_NUM_THREADS")) {
+            int count = atoi(env);
+            if (count > 0) return uint32_t(count);
+        }
+        uint32_t count = std::max(1u, std::thread::hardware_concurrency());
+#ifdef __linux__
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) count = std::min(count, uint32_t(std::max(1, CPU_COUNT(&set))));
+
+        // cgroup v2 stores "<quota> <period>", or "max <period>" when unlimited. cgroup v1 uses two files.
+        double quota = -1.0, period = 0.0;
+        std::ifstream cpuMax("/sys/fs/cgroup/cpu.max");
+        std::string quotaString;
+        if (cpuMax >> quotaString >> period) {
+            if (quotaString != "max") quota = atof(quotaString.c_str());
+        } else {
+            std::ifstream quotaFile("/sys/fs/cgroup/cpu/cpu.cfs_quota_us"), periodFile("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+            if (!(quotaFile >> quota) || !(periodFile >> period)) quota = -1.0;
+        }
+        if (quota > 0.0 && period > 0.0) count = std::min(count, std::max(1u, uint32_t(std::ceil(quota / period))));
+#endif
+        return count;
+    }
+
+    /** @returns the number of threads work runs on, including the calling thread */
+    uint32_t getThreadCount() const { return threadCount; }
+
+    /**
+     * Changes the number of threads, after finishing the tasks already queued.
+     * Must not be called from within a task of this pool, nor from a parallelFor body.
+     * @param numThreads The number of threads, or zero for getDefaultThreadCount()
+     */
+    void resize(uint32_t numThreads)
+    {
+        if (numThreads == 0) numThreads = getDefaultThreadCount();
+        if (isWorker() || isSubmitting()) throw std::runtime_error("Error: a thread pool cannot be resized from one of its own tasks");
+        std::lock_guard<std::mutex> lock(resizeMutex);
+        if (numThreads == getThreadCount()) return;
+        {
+            // New submissions wait from here on, so that a busy pool cannot hold off the resize forever
+            std::unique_lock<std::mutex> gateLock(gateMutex);
+            resizing = true;
+            gateChanged.wait(gateLock, [this] () { return activeSubmissions == 0; });
+        }
+        stop();
+        start(numThreads);
+        {
+            std::lock_guard<std::mutex> gateLock(gateMutex);
+            resizing = false;
+        }
+        gateChanged.notify_all();
+    }
+
+    /**
+     * Queues a task.
+     * @param token If given and cancelled before the task starts, the task is skipped, and its
+     * future throws std::future_error (broken promise) when read.
+     * @returns a future for the result of the task. Prefer wait() over get() from within a task.
+     */
+    template <typename F>
+    auto submit(F f, const CancellationToken* token = nullptr) -> std::future<decltype(f())>
+    {
+        typedef decltype(f()) R;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::move(f));
+        std::future<R> future = task->get_future();
+        SubmissionGuard guard(*this);
+        if (workers.empty()) {
+            if (!token || !token->isCancelled()) (*task)();
+            return future;
+        }
+        std::shared_ptr<CancellationToken> tokenCopy = token ? std::make_shared<CancellationToken>(*token) : nullptr;
+        push([task, tokenCopy] () { if (!tokenCopy || !tokenCopy->isCancelled()) (*task)(); });
+        return future;
+    }
+
+    /** Waits for a future of this pool, running queued tasks in the meantime */
+    template <typename T>
+    void wait(const std::future<T> &future)
+    {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!runPendingTask()) std::this_thread::yield();
+        }
+    }
+
+    /**
+     * Calls body(i) for every i in [begin, end), split into chunks which the calling thread and the
+     * workers claim as they go, and returns once every chunk is done.
+     * If a call throws, chunks which have not started yet are skipped and the first exception is
+     * rethrown here.
+     * @param grain The number of indices per chunk, or zero to pick one from the range and thread count
+     * @param token If given, chunks which have not started yet are skipped once it is cancelled
+     */
+    template <typename F>
+    void parallelFor(uint64_t begin, uint64_t end, F body, uint64_t grain = 0, const CancellationToken* token = nullptr)
+    {
+        if (end <= begin) return;
+        SubmissionGuard guard(*this);
+        uint64_t count = end - begin;
+        if (grain == 0) grain = std::max<uint64_t>(1, count / (uint64_t(getThreadCount()) * 8));
+        uint64_t numChunks = (count + grain - 1) / grain;
+
+        std::atomic<uint64_t> nextChunk(0);
+        std::atomic<bool> failed(false);
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        auto runChunks = [&] () {
+            for (uint64_t chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++) {
+                if (failed || (token && token->isCancelled())) continue;
+                try {
+                    uint64_t first = begin + chunk * grain, last = std::min(end, first + grain);
+                    for (uint64_t i = first; i < last; ++i) body(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) error = std::current_exception();
+                    failed = true;
+                }
+            }
+        };
+
+        // Helpers only reference this frame, so all of them must have finished before returning
+        uint64_t numHelpers = std::min<uint64_t>(workers.size(), numChunks - 1);
+        std::atomic<uint64_t> unfinished(numHelpers);
+        for (uint64_t i = 0; i < numHelpers; ++i) push([&] () { runChunks(); unfinished--; });
+        runChunks();
+        while (unfinished > 0) {
+            if (!runPendingTask()) std::this_thread::yield();
+        }
+        if (error) std::rethrow_exception(error);
+    }
+
+    /**
+     * Runs one queued task on the calling thread, if there is one.
+     * @returns true if a task was run
+     */
+    bool runPendingTask()
+    {
+        SubmissionGuard guard(*this);
+        Task task;
+        if (!pop(task)) return false;
+        task();
+        return true;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct WorkerIdentity {
+        ThreadPool* pool = nullptr;
+        uint32_t index = 0;
+    };
+
+    /*
+     * Keeps the workers and queues from being replaced by resize while a thread from outside the pool
+     * uses them. Workers never take it, as resize drains them before replacing anything, and a thread
+     * only takes it once however deeply its parallelFor calls nest.
+     */
+    class SubmissionGuard {
+    public:
+        explicit SubmissionGuard(ThreadPool &pool) : pool(pool), owner(!pool.isWorker() && !pool.isSubmitting())
+        {
+            if (!owner) return;
+            {
+                std::unique_lock<std::mutex> lock(pool.gateMutex);
+                pool.gateChanged.wait(lock, [this] () { return !this->pool.resizing; });
+                pool.activeSubmissions++;
+            }
+            getSubmittingPools().push_back(&pool);
+        }
+
+        ~SubmissionGuard()
+        {
+            if (!owner) return;
+            getSubmittingPools().pop_back();
+            {
+                std::lock_guard<std::mutex> lock(pool.gateMutex);
+                if (--pool.activeSubmissions > 0 || !pool.resizing) return;
+            }
+            pool.gateChanged.notify_all();
+        }
+
+    private:
+        ThreadPool &pool;
+        bool owner;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<uint32_t> threadCount{1};
+    std::atomic<uint64_t> pending{0};
+    std::atomic<uint32_t> nextQueue{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::mutex resizeMutex;
+    std::mutex gateMutex;
+    std::condition_variable gateChanged;
+    uint32_t activeSubmissions = 0;
+    bool resizing = false;
+    bool stopping = false;
+
+    static WorkerIdentity &getWorkerIdentity()
+    {
+        static thread_local WorkerIdentity identity;
+        return identity;
+    }
+
+    bool isWorker() { return getWorkerIdentity().pool == this; }
+
+    /* The pools whose SubmissionGuard the calling thread holds, innermost last */
+    static std::vector<const ThreadPool*> &getSubmittingPools()
+    {
+        static thread_local std::vector<const ThreadPool*> pools;
+        return pools;
+    }
+
+    bool isSubmitting()
+    {
+        auto &pools = getSubmittingPools();
+        return std::find(pools.begin(), pools.end(), this) != pools.end();
+    }
+
+    void start(uint32_t numThreads)
+    {
+        stopping = false;
+        queues.clear();
+        for (uint32_t i = 0; i + 1 < numThreads; ++i) queues.emplace_back(new Queue());
+        for (uint32_t i = 0; i + 1 < numThreads; ++i) {
+            workers.emplace_back([this, i] () {
+                getWorkerIdentity().pool = this;
+                getWorkerIdentity().index = i;
+                TraceRecorder::setThreadName("nvisii worker " + std::to_string(i));
+                workerLoop();
+            });
+        }
+        threadCount = numThreads;
+    }
+
+    /* Lets the workers run out of tasks, then joins them */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers) worker.join();
+        workers.clear();
+        threadCount = 1;
+    }
+
+    void workerLoop()
+    {
+        while (true) {
+            if (runPendingTask()) continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] () { return stopping || pending > 0; });
+            if (stopping && pending == 0) return;
+        }
+    }
+
+    /* Workers push to their own queue, and other threads spread tasks over all queues */
+    void push(Task task)
+    {
+        WorkerIdentity &identity = getWorkerIdentity();
+        uint32_t index = (identity.pool == this) ? identity.index : (nextQueue++ % uint32_t(queues.size()));
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        pending++;
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wake.notify_one();
+    }
+
+    /* Takes the newest task of the calling worker's own queue, or else steals the oldest task of another queue */
+    bool pop(Task &task)
+    {
+        if (queues.empty()) return false;
+        WorkerIdentity &identity = getWorkerIdentity();
+        uint32_t first = 0;
+        if (identity.pool == this) {
+            Queue &own = *queues[identity.index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                pending--;
+                return true;
+            }
+            first = identity.index + 1;
+        }
+        for (uint32_t i = 0; i < queues.size(); ++i) {
+            Queue &other = *queues[(first + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            if (!other.tasks.empty()) {
+                task = std::move(other.tasks.front());
+                other.tasks.pop_front();
+                pending--;
+                return true;
+            }
+        }
+        return false;
+    }
+};
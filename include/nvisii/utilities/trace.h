@@ -0,0 +1,236 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Records begin/end events from any thread, and exports them as a Chrome trace
+ * (chrome://tracing, or ui.perfetto.dev), to show where threads spend their time and wait on each other.
+ *
+ * Each thread writes into its own ring buffer, so recording never contends with other threads,
+ * and a buffer only keeps the most recent events once it is full. Event names and categories
+ * are stored as pointers, and so must be string literals or otherwise outlive the recorder.
+ *
+ * While tracing is disabled, recording an event costs a single branch.
+ */
+class TraceRecorder {
+public:
+    /** @returns true if events are currently being recorded */
+    static bool isEnabled() { return State<>::enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Starts recording events.
+     * @param eventsPerThread The number of events each thread keeps before overwriting its oldest ones
+     */
+    static void enable(size_t eventsPerThread = 65536)
+    {
+        if (eventsPerThread == 0) throw std::runtime_error("Error: trace buffer size must be greater than zero");
+        std::lock_guard<std::mutex> lock(State<>::mutex);
+        if (eventsPerThread != State<>::capacity) {
+            State<>::capacity = eventsPerThread;
+            for (auto &buffer : State<>::buffers) {
+                std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+                buffer->events.assign(eventsPerThread, Event());
+                buffer->next = buffer->count = 0;
+            }
+        }
+        State<>::enabled = true;
+    }
+
+    /** Stops recording events, keeping those recorded so far */
+    static void disable() { State<>::enabled = false; }
+
+    /** Discards all recorded events */
+    static void clear()
+    {
+        std::lock_guard<std::mutex> lock(State<>::mutex);
+        for (auto &buffer : State<>::buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            buffer->next = buffer->count = 0;
+        }
+    }
+
+    /** Names the calling thread in exported traces */
+    static void setThreadName(const std::string &name)
+    {
+        ThreadBuffer &buffer = getThreadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.name = name;
+    }
+
+    /** @returns the current time in nanoseconds, on the clock events are recorded with */
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /** Records a span of time on the calling thread */
+    static void recordComplete(const char* name, const char* category, int64_t startNs, int64_t endNs)
+    {
+        if (!isEnabled()) return;
+        record({name, category, 'X', startNs, endNs - startNs, 0});
+    }
+
+    /** Records a moment in time on the calling thread */
+    static void recordInstant(const char* name, const char* category)
+    {
+        if (!isEnabled()) return;
+        record({name, category, 'i', now(), 0, 0});
+    }
+
+    /**
+     * Records one end of an arrow between two threads, eg from where work is queued to where it runs.
+     * @param id Identifies the arrow, and must be the same for both ends. See newFlowId.
+     * @param start True for the end the arrow starts from, false for the end it points to.
+     * The end it points to should be recorded within a span, which it attaches to.
+     */
+    static void recordFlow(const char* name, const char* category, uint64_t id, bool start)
+    {
+        if (!isEnabled()) return;
+        record({name, category, start ? 's' : 'f', now(), 0, id});
+    }
+
+    /** @returns a new id for recordFlow */
+    static uint64_t newFlowId() { return ++State<>::flowIds; }
+
+    /** @returns the recorded events in the Chrome trace event format */
+    static std::string toJSON()
+    {
+        std::lock_guard<std::mutex> lock(State<>::mutex);
+        std::ostringstream json;
+        json.precision(3);
+        json << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (auto &buffer : State<>::buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            json << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                 << ",\"args\":{\"name\":\"" << escape(buffer->name) << "\"}}";
+            first = false;
+
+            size_t oldest = (buffer->next + buffer->events.size() - buffer->count) % buffer->events.size();
+            for (size_t i = 0; i < buffer->count; ++i) {
+                const Event &e = buffer->events[(oldest + i) % buffer->events.size()];
+                json << ",\n{\"name\":\"" << escape(e.name) << "\",\"cat\":\"" << escape(e.category)
+                     << "\",\"ph\":\"" << e.phase << "\",\"pid\":1,\"tid\":" << buffer->tid
+                     << ",\"ts\":" << (e.startNs - State<>::origin) / 1000.0;
+                if (e.phase == 'X') json << ",\"dur\":" << e.durationNs / 1000.0;
+                if (e.phase == 'i') json << ",\"s\":\"t\"";
+                if (e.phase == 's' || e.phase == 'f') json << ",\"id\":" << e.id;
+                if (e.phase == 'f') json << ",\"bp\":\"e\"";
+                json << "}";
+            }
+        }
+        json << "\n]}\n";
+        return json.str();
+    }
+
+    /** Writes the recorded events to a Chrome trace file */
+    static void save(const std::string &path)
+    {
+        std::ofstream file(path);
+        if (!file) throw std::runtime_error(std::string("Error: unable to open trace file \"") + path + "\"");
+        file << toJSON();
+        if (!file) throw std::runtime_error(std::string("Error: unable to write trace file \"") + path + "\"");
+    }
+
+private:
+    struct Event {
+        const char* name;
+        const char* category;
+        char phase;
+        int64_t startNs;
+        int64_t durationNs;
+        uint64_t id;
+    };
+
+    struct ThreadBuffer {
+        std::mutex mutex; // only contended while exporting
+        std::vector<Event> events;
+        size_t next = 0;
+        size_t count = 0;
+        uint32_t tid;
+        std::string name;
+    };
+
+    // A class template, so that its static members can be defined in this header
+    template <typename T = void>
+    struct State {
+        static std::atomic<bool> enabled;
+        static std::atomic<uint64_t> flowIds;
+        static std::mutex mutex;
+        static std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        static size_t capacity;
+        static int64_t origin;
+    };
+
+    /** Registers a buffer for the calling thread the first time it records. Buffers outlive their threads. */
+    static ThreadBuffer &getThreadBuffer()
+    {
+        static thread_local std::shared_ptr<ThreadBuffer> buffer;
+        if (!buffer) {
+            buffer = std::make_shared<ThreadBuffer>();
+            std::lock_guard<std::mutex> lock(State<>::mutex);
+            buffer->events.resize(State<>::capacity);
+            buffer->tid = uint32_t(State<>::buffers.size() + 1);
+            buffer->name = "thread " + std::to_string(buffer->tid);
+            State<>::buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    static void record(const Event &event)
+    {
+        ThreadBuffer &buffer = getThreadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.events[buffer.next] = event;
+        buffer.next = (buffer.next + 1) % buffer.events.size();
+        if (buffer.count < buffer.events.size()) buffer.count++;
+    }
+
+    static std::string escape(const std::string &s)
+    {
+        std::string escaped;
+        for (char c : s) {
+            if (c == '"' || c == '\\') escaped += '\\';
+            if (uint8_t(c) < 0x20) continue;
+            escaped += c;
+        }
+        return escaped;
+    }
+};
+
+template <typename T> std::atomic<bool> TraceRecorder::State<T>::enabled(false);
+template <typename T> std::atomic<uint64_t> TraceRecorder::State<T>::flowIds(0);
+template <typename T> std::mutex TraceRecorder::State<T>::mutex;
+template <typename T> std::vector<std::shared_ptr<TraceRecorder::ThreadBuffer>> TraceRecorder::State<T>::buffers;
+template <typename T> size_t TraceRecorder::State<T>::capacity = 65536;
+template <typename T> int64_t TraceRecorder::State<T>::origin = TraceRecorder::now();
+
+/** Records the time between its construction and destruction as a span on the calling thread */
+class TraceScope {
+public:
+    TraceScope(const char* name, const char* category)
+        : name(name), category(category), start(TraceRecorder::isEnabled() ? TraceRecorder::now() : -1) {}
+
+    ~TraceScope()
+    {
+        if (start >= 0) TraceRecorder::recordComplete(name, category, start, TraceRecorder::now());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope &operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    const char* category;
+    int64_t start;
+};
@@ -27,6 +27,7 @@ namespace nvisii {
 class Volume : public StaticFactory
 {
 	friend class StaticFactory;
+	friend class SceneFile;
 	friend class Entity;
   public:
 	/**
@@ -52,6 +53,7 @@ class Volume : public StaticFactory
 	 * Constructs a Volume with the given name from a file. 
 	 * @param name The name of the volume to create.
 	 * Supported formats include NanoVDB (.nvdb)
+	 * The file is read without locking the other volumes, so several threads can load volumes at once.
 	 * @param path The path to the file.
 	 * @returns a Volume allocated by the renderer. 
 	*/
@@ -0,0 +1,1311 @@
+#include <cpucode/cpu_renderer.h>
+#include "../entity_instances.h"
+#include "../scene_snapshot.h"
+
+#include <nvisii/entity.h>
+#include <nvisii/transform.h>
+#include <nvisii/material.h>
+#include <nvisii/mesh.h>
+#include <nvisii/light.h>
+#include <nvisii/camera.h>
+#include <nvisii/texture.h>
+#include <nvisii/volume.h>
+
+#include <nvisii/utilities/bvh.h>
+#include <nvisii/utilities/light_sampling.h>
+#include <nvisii/utilities/dome_importance.h>
+#include <nvisii/utilities/thread_pool.h>
+#include <nvisii/utilities/point_cloud.h>
+
+#include <devicecode/disney_bsdf.h>
+#include <devicecode/lights.h>
+#include <devicecode/render_data_flags.h>
+
+#include <glm/gtc/color_space.hpp>
+#include <glm/gtc/matrix_access.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace nvisii {
+
+// The sampler dimensions used by each random decision along a path, matching devicecode/path_tracer.cu
+enum CPUSampleDimension : uint32_t {
+    DIM_PIXEL = 0,
+    DIM_LENS = 2,
+    DIM_TIME = 4,
+    DIM_CAMERA_COUNT = 8,
+
+    DIM_LIGHT_SELECTION = 0,
+    DIM_LIGHT_TRIANGLE = 1,
+    DIM_LIGHT_POSITION = 2,
+    DIM_BSDF_LOBE = 4,
+    DIM_BSDF_DIRECTION = 5,
+    DIM_RUSSIAN_ROULETTE = 7,
+    DIM_ALPHA = 8,
+    DIM_VOLUME_SCATTER = 9,
+    DIM_BOUNCE_TIME = 10,
+    DIM_BOUNCE_COUNT = 12
+};
+
+static inline uint32_t bounceDimension(uint32_t depth, uint32_t offset) {
+    return DIM_CAMERA_COUNT + depth * DIM_BOUNCE_COUNT + offset;
+}
+
+#define CPU_TILE_SIZE 16
+
+/* Mesh data, along with a BVH over the mesh's triangles in object space */
+struct CPUMesh {
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec4> normals;
+    std::vector<glm::vec4> tangents;
+    std::vector<glm::vec2> texCoords;
+    std::vector<uint32_t> indices;
+    // Point clouds only: each point as its center followed by its radius, and optional per point colors
+    std::vector<glm::vec4> points;
+    std::vector<glm::vec4> pointColors;
+    BVH bvh;
+
+    // Built on demand for meshes used by lights
+    std::vector<AliasTableEntry> triangleTable;
+    float surfaceArea = 0.f;
+};
+
+/* An entity, or one instance of an entity, placed into the scene, with its transform at the start and end of the frame */
+struct CPUInstance {
+    uint32_t entityID;
+    uint32_t meshID;
+    /* Overrides the material of the entity if not -1 */
+    int32_t materialID;
+    glm::mat4 localToWorldT0;
+    glm::mat4 localToWorldT1;
+    glm::mat4 worldToLocalT1;
+    bool moving;
+};
+
+/* Texels converted to linear floating point, so that they can be filtered like CUDA textures */
+struct CPUTexture {
+    int32_t width = 0;
+    int32_t height = 0;
+    glm::vec2 scale = glm::vec2(1.f);
+    std::vector<glm::vec4> texels;
+};
+
+/* A material, along with the constants used for any parameter without a texture */
+struct CPUMaterial {
+    MaterialStruct ids;
+    glm::vec4 constants[NUM_MAT_PARAMS];
+};
+
+static struct CPUScene {
+    std::vector<CPUMesh> meshes;
+    std::vector<CPUTexture> textures;
+    std::vector<CPUMaterial> materials;
+    std::vector<LightStruct> lights;
+    std::vector<CameraStruct> cameras;
+    std::vector<EntityStruct> entities;
+
+    std::vector<CPUInstance> instances;
+    BVH instanceBVH;
+
+    std::vector<uint32_t> lightEntities;
+    std::vector<glm::mat4> lightTransforms;
+    std::vector<AliasTableEntry> lightTable;
+} CPUScene;
+
+/* The closest intersection along a ray */
+struct CPUHit {
+    int instance = -1;
+    uint32_t primitive = 0;
+    glm::vec2 barycentrics = glm::vec2(0.f);
+    // Point clouds only: the hit in the space of the point cloud, since spheres have no vertices to interpolate
+    glm::vec3 localPosition = glm::vec3(0.f);
+    float t = -1.f;
+};
+
+static void copyMesh(const MeshSnapshot &m, CPUMesh &cm)
+{
+    cm = CPUMesh();
+    cm.vertices.resize(m.positions.size());
+    for (size_t i = 0; i < m.positions.size(); ++i) cm.vertices[i] = glm::vec3(m.positions[i][0], m.positions[i][1], m.positions[i][2]);
+    cm.normals = m.normals;
+    cm.tangents = m.tangents;
+    cm.texCoords = m.texCoords;
+    cm.indices = m.triangleIndices;
+
+    if (m.radii.size() > 0) {
+        cm.points = packPoints(m.positions, m.radii);
+        cm.pointColors = m.colors;
+        buildPointCloudBVH(cm.points, cm.bvh);
+        return;
+    }
+
+    uint32_t numTris = uint32_t(cm.indices.size() / 3);
+    std::vector<glm::vec3> bbmins(numTris), bbmaxs(numTris);
+    for (uint32_t t = 0; t < numTris; ++t) {
+        const glm::vec3 &a = cm.vertices[cm.indices[t * 3 + 0]];
+        const glm::vec3 &b = cm.vertices[cm.indices[t * 3 + 1]];
+        const glm::vec3 &c = cm.vertices[cm.indices[t * 3 + 2]];
+        bbmins[t] = glm::min(a, glm::min(b, c));
+        bbmaxs[t] = glm::max(a, glm::max(b, c));
+    }
+    cm.bvh.build(bbmins, bbmaxs);
+}
+
+static void copyTexture(const TextureSnapshot &texture, CPUTexture &ct)
+{
+    ct = CPUTexture();
+    ct.width = int32_t(texture.width);
+    ct.height = int32_t(texture.height);
+    if (texture.isHDR()) {
+        ct.texels = texture.floatTexels;
+        return;
+    }
+    // Matches the sRGB to linear conversion CUDA applies when reading 8 bit textures
+    const auto &texels = texture.byteTexels;
+    ct.texels.resize(texels.size());
+    for (size_t i = 0; i < texels.size(); ++i) {
+        glm::vec4 t = glm::vec4(texels[i]) / 255.f;
+        if (!texture.linear) t = glm::vec4(glm::convertSRGBToLinear(glm::vec3(t)), t.a);
+        ct.texels[i] = t;
+    }
+}
+
+/* Rebuilds the instance list, the instance BVH, and the light selection tables */
+static void buildInstances(const PublishedScene &scene)
+{
+    auto &S = CPUScene;
+    S.instances.clear();
+    S.lightEntities.clear();
+    S.lightTransforms.clear();
+    for (uint32_t eid = 0; eid < uint32_t(scene.entityStructs.size()); ++eid) {
+        // Same requirements as the OptiX backend's surface instances. Volumes are not supported yet.
+        int32_t tid = scene.getTransformID(eid);
+        int32_t mid = scene.getMeshID(eid);
+        if (tid < 0 || mid < 0) continue;
+        if (scene.getMaterialID(eid) < 0 && scene.getLightID(eid) < 0) continue;
+
+        CPUInstance inst;
+        inst.entityID = eid;
+        inst.meshID = uint32_t(mid);
+        inst.materialID = -1;
+        inst.localToWorldT0 = scene.transformStructs[tid].localToWorldPrev;
+        inst.localToWorldT1 = scene.transformStructs[tid].localToWorld;
+        inst.worldToLocalT1 = glm::inverse(inst.localToWorldT1);
+        inst.moving = (inst.localToWorldT0 != inst.localToWorldT1);
+        if (S.meshes[inst.meshID].bvh.nodes.empty()) continue;
+
+        // Entities with instances expand into one instance each, as in the OptiX backend
+        const EntityInstances* instances = scene.getInstances(eid);
+        if (instances) {
+            size_t first = S.instances.size();
+            S.instances.resize(first + instances->size(), inst);
+            ThreadPool::global().parallelFor(0, instances->size(), [&] (uint64_t i) {
+                CPUInstance &instance = S.instances[first + i];
+                glm::mat4 instanceToLocal = instances->getTransform(uint32_t(i));
+                instance.localToWorldT0 = inst.localToWorldT0 * instanceToLocal;
+                instance.localToWorldT1 = inst.localToWorldT1 * instanceToLocal;
+                instance.worldToLocalT1 = glm::inverse(instance.localToWorldT1);
+                int32_t instanceMaterial = instances->getMaterialID(uint32_t(i));
+                bool alive = (instanceMaterial >= 0) && (instanceMaterial < int32_t(scene.materialAlive.size()))
+                    && scene.materialAlive[instanceMaterial];
+                instance.materialID = alive ? instanceMaterial : -1;
+            }, 4096);
+            continue;
+        }
+        S.instances.push_back(inst);
+
+        // Point clouds have no triangles to sample, so emissive points are only seen when hit
+        if ((scene.getLightID(eid) >= 0) && S.meshes[inst.meshID].points.empty()) {
+            S.lightEntities.push_back(eid);
+            S.lightTransforms.push_back(inst.localToWorldT1);
+        }
+    }
+
+    // Transforms are interpolated linearly, so the bounds at both ends of the frame bound the whole motion
+    std::vector<glm::vec3> bbmins(S.instances.size()), bbmaxs(S.instances.size());
+    ThreadPool::global().parallelFor(0, S.instances.size(), [&] (uint64_t i) {
+        const CPUInstance &inst = S.instances[i];
+        const CPUMesh &mesh = S.meshes[inst.meshID];
+        glm::vec3 lmin = mesh.bvh.getMinAabbCorner(), lmax = mesh.bvh.getMaxAabbCorner();
+        bbmins[i] = glm::vec3(FLT_MAX); bbmaxs[i] = glm::vec3(-FLT_MAX);
+        for (uint32_t c = 0; c < 8; ++c) {
+            glm::vec4 corner((c & 1) ? lmax.x : lmin.x, (c & 2) ? lmax.y : lmin.y, (c & 4) ? lmax.z : lmin.z, 1.f);
+            glm::vec3 w0 = glm::vec3(inst.localToWorldT0 * corner);
+            glm::vec3 w1 = glm::vec3(inst.localToWorldT1 * corner);
+            bbmins[i] = glm::min(bbmins[i], glm::min(w0, w1));
+            bbmaxs[i] = glm::max(bbmaxs[i], glm::max(w0, w1));
+        }
+    }, 1024);
+    S.instanceBVH.build(bbmins, bbmaxs, /*maxLeafSize = */ 1);
+
+    // Power weighted light table, area weighted triangle tables, as in the OptiX backend
+    std::vector<float> lightPowers(S.lightEntities.size());
+    for (uint32_t i = 0; i < S.lightEntities.size(); ++i) {
+        uint32_t eid = S.lightEntities[i];
+        CPUMesh &mesh = S.meshes[scene.getMeshID(eid)];
+        if (mesh.triangleTable.empty()) {
+            std::vector<std::array<float, 3>> vertices(mesh.vertices.size());
+            for (size_t v = 0; v < vertices.size(); ++v) vertices[v] = {mesh.vertices[v].x, mesh.vertices[v].y, mesh.vertices[v].z};
+            std::vector<float> areas = computeTriangleAreas(vertices, mesh.indices);
+            mesh.triangleTable.resize(areas.size());
+            mesh.surfaceArea = float(buildAliasTable(areas.data(), uint32_t(areas.size()), mesh.triangleTable.data()));
+        }
+        glm::mat3 ltw = glm::mat3(S.lightTransforms[i]);
+        float areaScale = powf(fabs(glm::determinant(ltw)), 2.f / 3.f);
+        lightPowers[i] = estimateLightPower(S.lights[scene.getLightID(eid)], mesh.surfaceArea * areaScale);
+    }
+    S.lightTable = buildAliasTable(lightPowers);
+}
+
+bool cpuUpdateComponents(const SceneSnapshot &changes, const PublishedScene &scene)
+{
+    auto &S = CPUScene;
+    if (changes.empty()) return false;
+
+    bool instancesDirty = changes.areMeshesDirty() || changes.areTransformsDirty() || changes.areLightsDirty() || changes.areEntitiesDirty();
+
+    S.meshes.resize(scene.meshStructs.size());
+    S.textures.resize(scene.textureStructs.size());
+    S.materials.resize(scene.materialAlive.size());
+
+    for (auto &m : changes.meshes) {
+        if (m.removed) { S.meshes[m.id] = CPUMesh(); continue; }
+        copyMesh(m, S.meshes[m.id]);
+    }
+
+    for (auto &t : changes.textures) {
+        if (t.removed) { S.textures[t.id] = CPUTexture(); continue; }
+        copyTexture(t, S.textures[t.id]);
+    }
+    for (uint32_t tid = 0; tid < uint32_t(scene.textureStructs.size()); ++tid) S.textures[tid].scale = scene.textureStructs[tid].scale;
+
+    for (auto &m : changes.materials) {
+        S.materials[m.id].ids = m.ids;
+        for (uint32_t i = 0; i < NUM_MAT_PARAMS; ++i) S.materials[m.id].constants[i] = m.constants[i];
+    }
+
+    S.lights = scene.lightStructs;
+    S.cameras = scene.cameraStructs;
+    S.entities = scene.entityStructs;
+
+    if (instancesDirty) buildInstances(scene);
+    return true;
+}
+
+void cpuReleaseScene()
+{
+    CPUScene.meshes.clear();
+    CPUScene.textures.clear();
+    CPUScene.materials.clear();
+    CPUScene.lights.clear();
+    CPUScene.cameras.clear();
+    CPUScene.entities.clear();
+    CPUScene.instances.clear();
+    CPUScene.instanceBVH = BVH();
+    CPUScene.lightEntities.clear();
+    CPUScene.lightTransforms.clear();
+    CPUScene.lightTable.clear();
+}
+
+/* Bilinearly filters texels with wrapping, like a CUDA texture with normalized coordinates */
+static glm::vec4 filterTexels(const glm::vec4* texels, int32_t width, int32_t height, glm::vec2 uv)
+{
+    float x = uv.x * float(width) - .5f, y = uv.y * float(height) - .5f;
+    float fx = floorf(x), fy = floorf(y);
+    float ax = x - fx, ay = y - fy;
+    auto wrap = [] (int64_t i, int32_t n) { int64_t r = i % n; return int32_t((r < 0) ? r + n : r); };
+    int32_t x0 = wrap(int64_t(fx), width), x1 = wrap(int64_t(fx) + 1, width);
+    int32_t y0 = wrap(int64_t(fy), height), y1 = wrap(int64_t(fy) + 1, height);
+    glm::vec4 a = glm::mix(texels[y0 * width + x0], texels[y0 * width + x1], ax);
+    glm::vec4 b = glm::mix(texels[y1 * width + x0], texels[y1 * width + x1], ax);
+    return glm::mix(a, b, ay);
+}
+
+static bool lookupTexture(int32_t textureId, float2 texCoord, glm::vec4 &value) {
+    const auto &S = CPUScene;
+    if (textureId < 0 || textureId >= int32_t(S.textures.size())) return false;
+    const CPUTexture &tex = S.textures[textureId];
+    if (tex.texels.empty()) return false;
+    value = filterTexels(tex.texels.data(), tex.width, tex.height, glm::vec2(texCoord.x / tex.scale.x, texCoord.y / tex.scale.y));
+    return true;
+}
+
+static float3 sampleTexture(int32_t textureId, float2 texCoord, float3 defaultVal) {
+    glm::vec4 v;
+    if (!lookupTexture(textureId, texCoord, v)) return defaultVal;
+    return make_float3(v);
+}
+
+/* Samples a material parameter from its texture, or from its constant if it has none */
+static float sampleMaterial(const CPUMaterial &m, int32_t textureId, int8_t channel, uint32_t constant, float2 texCoord) {
+    glm::vec4 v;
+    if (!lookupTexture(textureId, texCoord, v)) v = m.constants[constant];
+    if (channel < 0 || channel > 3) return m.constants[constant][0];
+    return v[channel];
+}
+
+static float3 sampleMaterial(const CPUMaterial &m, int32_t textureId, uint32_t constant, float2 texCoord) {
+    glm::vec4 v;
+    if (!lookupTexture(textureId, texCoord, v)) v = m.constants[constant];
+    return make_float3(v);
+}
+
+static void loadDisneyMaterial(const CPUMaterial &m, float2 uv, DisneyMaterial &mat, float roughnessMinimum) {
+    const MaterialStruct &p = m.ids;
+    mat.base_color = sampleMaterial(m, p.base_color_texture_id, 1, uv);
+    mat.metallic = sampleMaterial(m, p.metallic_texture_id, p.metallic_texture_channel, 8, uv);
+    mat.specular = sampleMaterial(m, p.specular_texture_id, p.specular_texture_channel, 9, uv);
+    mat.roughness = sampleMaterial(m, p.roughness_texture_id, p.roughness_texture_channel, 2, uv);
+    mat.specular_tint = sampleMaterial(m, p.specular_tint_texture_id, p.specular_tint_texture_channel, 10, uv);
+    mat.anisotropy = sampleMaterial(m, p.anisotropic_texture_id, p.anisotropic_texture_channel, 11, uv);
+    mat.sheen = sampleMaterial(m, p.sheen_texture_id, p.sheen_texture_channel, 13, uv);
+    mat.sheen_tint = sampleMaterial(m, p.sheen_tint_texture_id, p.sheen_tint_texture_channel, 14, uv);
+    mat.clearcoat = sampleMaterial(m, p.clearcoat_texture_id, p.clearcoat_texture_channel, 15, uv);
+    float clearcoat_roughness = sampleMaterial(m, p.clearcoat_roughness_texture_id, p.clearcoat_roughness_texture_channel, 16, uv);
+    mat.ior = sampleMaterial(m, p.ior_texture_id, p.ior_texture_channel, 17, uv);
+    mat.specular_transmission = sampleMaterial(m, p.transmission_texture_id, p.transmission_texture_channel, 18, uv);
+    mat.flatness = sampleMaterial(m, p.subsurface_texture_id, p.subsurface_texture_channel, 7, uv);
+    mat.subsurface_color = sampleMaterial(m, p.subsurface_color_texture_id, 5, uv);
+    mat.transmission_roughness = sampleMaterial(m, p.transmission_roughness_texture_id, p.transmission_roughness_texture_channel, 0, uv);
+    mat.alpha = sampleMaterial(m, p.alpha_texture_id, p.alpha_texture_channel, 3, uv);
+
+    mat.transmission_roughness = max(max(mat.transmission_roughness, MIN_ROUGHNESS), roughnessMinimum);
+    mat.roughness = max(max(mat.roughness, MIN_ROUGHNESS), roughnessMinimum);
+    clearcoat_roughness = max(clearcoat_roughness, roughnessMinimum);
+    mat.clearcoat_gloss = 1.0 - clearcoat_roughness * clearcoat_roughness;
+}
+
+/* Double sided Moller-Trumbore ray triangle intersection, with barycentrics following OptiX */
+static bool intersectTriangle(const glm::vec3 &o, const glm::vec3 &d,
+    const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, float tmin, float tmax, float &t, glm::vec2 &bary)
+{
+    glm::vec3 e1 = b - a, e2 = c - a;
+    glm::vec3 pv = glm::cross(d, e2);
+    float det = glm::dot(e1, pv);
+    if (det == 0.f) return false;
+    float invDet = 1.f / det;
+    glm::vec3 tv = o - a;
+    float u = glm::dot(tv, pv) * invDet;
+    if (u < 0.f || u > 1.f) return false;
+    glm::vec3 qv = glm::cross(tv, e1);
+    float v = glm::dot(d, qv) * invDet;
+    if (v < 0.f || u + v > 1.f) return false;
+    t = glm::dot(e2, qv) * invDet;
+    if (!(t > tmin && t < tmax)) return false;
+    bary = glm::vec2(u, v);
+    return true;
+}
+
+static glm::mat4 instanceLocalToWorld(const CPUInstance &inst, float time)
+{
+    if (!inst.moving) return inst.localToWorldT1;
+    return inst.localToWorldT0 * (1.f - time) + inst.localToWorldT1 * time;
+}
+
+/**
+ * Traces a ray against all surfaces in the scene. Directions need not be normalized.
+ * @param anyHit If true, stops at the first intersection found rather than the closest
+ */
+static CPUHit traceRay(glm::vec3 origin, glm::vec3 direction, float tmin, float tmax, float time, bool anyHit = false)
+{
+    const auto &S = CPUScene;
+    CPUHit hit;
+    S.instanceBVH.traverse(origin, direction, tmin, tmax, [&] (uint32_t i, float tmin, float &tmax) {
+        const CPUInstance &inst = S.instances[i];
+        const CPUMesh &mesh = S.meshes[inst.meshID];
+        glm::mat4 worldToLocal = (inst.moving) ? glm::inverse(instanceLocalToWorld(inst, time)) : inst.worldToLocalT1;
+        // Affine transforms preserve distances along unnormalized rays, so t carries over between spaces
+        glm::vec3 lo = glm::vec3(worldToLocal * glm::vec4(origin, 1.f));
+        glm::vec3 ld = glm::vec3(worldToLocal * glm::vec4(direction, 0.f));
+        if (mesh.points.size() > 0) {
+            return mesh.bvh.traverse(lo, ld, tmin, tmax, [&] (uint32_t point, float tmin, float &tmax) {
+                float t;
+                const glm::vec4 &p = mesh.points[point];
+                if (!intersectSphere(lo, ld, glm::vec3(p), p.w, tmin, tmax, t)) return false;
+                tmax = t;
+                hit.instance = int(i); hit.primitive = point; hit.barycentrics = glm::vec2(0.f); hit.t = t;
+                hit.localPosition = lo + t * ld;
+                return true;
+            }, anyHit);
+        }
+        return mesh.bvh.traverse(lo, ld, tmin, tmax, [&] (uint32_t tri, float tmin, float &tmax) {
+            float t; glm::vec2 bary;
+            if (!intersectTriangle(lo, ld,
+                mesh.vertices[mesh.indices[tri * 3 + 0]],
+                mesh.vertices[mesh.indices[tri * 3 + 1]],
+                mesh.vertices[mesh.indices[tri * 3 + 2]], tmin, tmax, t, bary)) return false;
+            tmax = t;
+            hit.instance = int(i); hit.primitive = tri; hit.barycentrics = bary; hit.t = t;
+            return true;
+        }, anyHit);
+    }, anyHit);
+    return hit;
+}
+
+static glm::vec2 toUV(glm::vec3 n)
+{
+    n.z = -n.z;
+    n.x = -n.x;
+    glm::vec2 uv;
+
+    uv.x = approx_atan2f(float(-n.x), float(n.y));
+    uv.x = (uv.x + M_PI / 2.0f) / (M_PI * 2.0f) + M_PI * (28.670f / 360.0f);
+
+    uv.y = glm::clamp(float(acosf(n.z) / M_PI), .001f, .999f);
+
+    return uv;
+}
+
+static glm::vec3 toPolar(glm::vec2 uv)
+{
+    float theta = 2.0 * M_PI * uv.x + - M_PI / 2.0;
+    float phi = M_PI * uv.y;
+
+    glm::vec3 n;
+    n.x = cosf(theta) * sinf(phi);
+    n.y = sinf(theta) * sinf(phi);
+    n.z = cosf(phi);
+
+    n.z = -n.z;
+    n.x = -n.x;
+    return n;
+}
+
+static float3 missColor(const CPULaunchParams &LP, const float3 n_dir)
+{
+    const auto &S = CPUScene;
+    glm::vec3 rayDir = LP.environmentMapRotation * make_vec3(n_dir);
+    const glm::vec4* texels = nullptr;
+    int32_t width = 0, height = 0;
+    if (LP.environmentMapID >= 0 && LP.environmentMapID < int32_t(S.textures.size())) {
+        const CPUTexture &tex = S.textures[LP.environmentMapID];
+        texels = (tex.texels.empty()) ? nullptr : tex.texels.data();
+        width = tex.width; height = tex.height;
+    } else if (LP.environmentMapID == -2) {
+        texels = LP.proceduralSkyTexels;
+        width = int32_t(LP.proceduralSkyWidth); height = int32_t(LP.proceduralSkyHeight);
+    }
+    if (texels) {
+        glm::vec2 tc = toUV(rayDir);
+        return make_float3(filterTexels(texels, width, height, tc));
+    }
+
+    if (glm::any(glm::greaterThanEqual(LP.domeLightColor, glm::vec3(0.f)))) return make_float3(LP.domeLightColor);
+    float t = 0.5f*(rayDir.z + 1.0f);
+    float3 c = (1.0f - t) * make_float3(glm::pow(glm::vec3(1.0f), glm::vec3(2.2f))) + t * make_float3(glm::pow(glm::vec3(0.5f, 0.7f, 1.0f), glm::vec3(2.2f)));
+    return c;
+}
+
+static float sampleTime(const CPULaunchParams &LP, float xi) {
+    return  LP.timeSamplingInterval[0] +
+           (LP.timeSamplingInterval[1] -
+            LP.timeSamplingInterval[0]) * xi;
+}
+
+static void generateRay(const CPULaunchParams &LP, const CameraStruct &camera, glm::ivec2 pixelID, glm::ivec2 frameSize,
+    const SamplerState &sampler, float time, glm::vec3 &rayOrigin, glm::vec3 &rayDirection)
+{
+    /* Generate camera rays */
+    glm::quat r0 = glm::quat_cast(LP.viewT0);
+    glm::quat r1 = glm::quat_cast(LP.viewT1);
+    glm::vec4 p0 = glm::column(LP.viewT0, 3);
+    glm::vec4 p1 = glm::column(LP.viewT1, 3);
+
+    glm::vec4 pos = glm::mix(p0, p1, time);
+    glm::quat rot = (glm::all(glm::equal(r0, r1))) ? r0 : glm::slerp(r0, r1, time);
+    glm::mat4 camLocalToWorld = glm::mat4_cast(rot);
+    camLocalToWorld = glm::column(camLocalToWorld, 3, pos);
+
+    glm::mat4 projinv = glm::inverse(LP.proj);
+    glm::mat4 viewinv = glm::inverse(camLocalToWorld);
+    glm::vec2 aa =  glm::vec2(LP.xPixelSamplingInterval[0], LP.yPixelSamplingInterval[0])
+            + (glm::vec2(LP.xPixelSamplingInterval[1], LP.yPixelSamplingInterval[1])
+            -  glm::vec2(LP.xPixelSamplingInterval[0], LP.yPixelSamplingInterval[0])
+            ) * samplerGet2D(sampler, DIM_PIXEL);
+
+    glm::vec2 inUV = (glm::vec2(pixelID.x, pixelID.y) + aa) / glm::vec2(frameSize);
+    glm::vec3 right = glm::normalize(glm::vec3(glm::column(viewinv, 0)));
+    glm::vec3 up = glm::normalize(glm::vec3(glm::column(viewinv, 1)));
+    glm::vec3 origin = glm::vec3(glm::column(viewinv, 3));
+
+    float cameraLensRadius = camera.apertureDiameter;
+
+    glm::vec3 p(0.f);
+    if (cameraLensRadius > 0.0) {
+        // Uniformly sample the lens using a concentric mapping, which preserves stratification
+        glm::vec2 u = samplerGet2D(sampler, DIM_LENS) * 2.f - 1.f;
+        if (u.x != 0.f || u.y != 0.f) {
+            float r, theta;
+            if (fabs(u.x) > fabs(u.y)) { r = u.x; theta = float(M_PI / 4.0) * (u.y / u.x); }
+            else { r = u.y; theta = float(M_PI / 2.0) - float(M_PI / 4.0) * (u.x / u.y); }
+            p = glm::vec3(r * cos(theta), r * sin(theta), 0.f);
+        }
+    }
+
+    glm::vec3 rd = cameraLensRadius * p;
+    glm::vec3 lens_offset = (right * rd.x) / float(frameSize.x) + (up * rd.y) / float(frameSize.y);
+
+    origin = origin + lens_offset;
+    glm::vec2 dir = inUV * 2.f - 1.f; dir.y *= -1.f;
+    glm::vec4 t = (projinv * glm::vec4(dir.x, dir.y, -1.f, 1.f));
+    glm::vec3 target = glm::vec3(t) / float(t.w);
+    glm::vec3 direction = glm::normalize(glm::vec3(viewinv * glm::vec4(target, 0.f))) * camera.focalDistance;
+    direction = glm::normalize(direction - lens_offset);
+
+    rayOrigin = origin;
+    rayDirection = direction;
+}
+
+static void initializeRenderData(const CPULaunchParams &LP, float3 &renderData)
+{
+    // these might change in the future...
+    if (LP.renderDataMode == RenderDataFlags::NONE) {
+        renderData = make_float3(FLT_MAX);
+    }
+    else if (LP.renderDataMode == RenderDataFlags::DEPTH) {
+        renderData = make_float3(FLT_MAX);
+    }
+    else if (LP.renderDataMode == RenderDataFlags::POSITION) {
+        renderData = make_float3(FLT_MAX);
+    }
+    else if (LP.renderDataMode == RenderDataFlags::NORMAL) {
+        renderData = make_float3(FLT_MAX);
+    }
+    else if (LP.renderDataMode == RenderDataFlags::SCREEN_SPACE_NORMAL) {
+        renderData = make_float3(0.0f);
+    }
+    else if (LP.renderDataMode == RenderDataFlags::ENTITY_ID) {
+        renderData = make_float3(FLT_MAX);
+    }
+    else if (LP.renderDataMode == RenderDataFlags::BASE_COLOR) {
+        renderData = make_float3(0.0, 0.0, 0.0);
+    }
+    else if (LP.renderDataMode == RenderDataFlags::TEXTURE_COORDINATES) {
+        renderData = make_float3(0.0, 0.0, 0.0);
+    }
+    else if (LP.renderDataMode == RenderDataFlags::DIFFUSE_MOTION_VECTORS) {
+        renderData = make_float3(0.0, 0.0, -1.0);
+    }
+    else if (LP.renderDataMode == RenderDataFlags::HEATMAP) {
+        renderData = make_float3(0.0, 0.0, 0.0);
+    }
+}
+
+static void saveLightingColorRenderData(const CPULaunchParams &LP,
+    float3 &renderData, int bounce,
+    float3 w_n, float3 w_o, float3 w_i,
+    DisneyMaterial &mat)
+{
+    if (LP.renderDataMode == RenderDataFlags::NONE) return;
+    if (bounce != LP.renderDataBounce) return;
+
+    if (LP.renderDataMode == RenderDataFlags::DIFFUSE_COLOR) {
+        renderData = disney_diffuse_color(mat, w_n, w_o, w_i, normalize(w_o + w_i));
+    }
+    else if (LP.renderDataMode == RenderDataFlags::GLOSSY_COLOR) {
+        renderData = disney_microfacet_reflection_color(mat, w_n, w_o, w_i, normalize(w_o + w_i));
+    }
+    else if (LP.renderDataMode == RenderDataFlags::TRANSMISSION_COLOR) {
+        renderData = disney_microfacet_transmission_color(mat, w_n, w_o, w_i, normalize(w_o + w_i));
+    }
+}
+
+static void saveMissRenderData(const CPULaunchParams &LP, float3 &renderData, int bounce, float3 mvec)
+{
+    if (LP.renderDataMode == RenderDataFlags::NONE) return;
+    if (bounce != LP.renderDataBounce) return;
+
+    if (LP.renderDataMode == RenderDataFlags::DIFFUSE_MOTION_VECTORS) {
+        renderData = mvec;
+    }
+}
+
+static void saveGeometricRenderData(const CPULaunchParams &LP,
+    float3 &renderData,
+    int bounce, float depth,
+    float3 w_p, float3 w_n, float3 w_o, float2 uv,
+    int entity_id, float3 diffuse_mvec, float time,
+    DisneyMaterial &mat)
+{
+    if (LP.renderDataMode == RenderDataFlags::NONE) return;
+    if (bounce != LP.renderDataBounce) return;
+
+    if (LP.renderDataMode == RenderDataFlags::DEPTH) {
+        renderData = make_float3(depth);
+    }
+    else if (LP.renderDataMode == RenderDataFlags::POSITION) {
+        renderData = w_p;
+    }
+    else if (LP.renderDataMode == RenderDataFlags::NORMAL) {
+        renderData = w_n;
+    }
+    else if (LP.renderDataMode == RenderDataFlags::SCREEN_SPACE_NORMAL) {
+        glm::quat r0 = glm::quat_cast(LP.viewT0);
+        glm::quat r1 = glm::quat_cast(LP.viewT1);
+        glm::quat rot = (glm::all(glm::equal(r0, r1))) ? r0 : glm::slerp(r0, r1, time);
+        glm::vec3 tmp = glm::normalize(glm::mat3_cast(rot) * make_vec3(w_n));
+        tmp = glm::normalize(glm::vec3(LP.proj * glm::vec4(tmp, 0.f)));
+        renderData.x = tmp.x;
+        renderData.y = tmp.y;
+        renderData.z = tmp.z;
+    }
+    else if (LP.renderDataMode == RenderDataFlags::ENTITY_ID) {
+        renderData = make_float3(float(entity_id));
+    }
+    else if (LP.renderDataMode == RenderDataFlags::DIFFUSE_MOTION_VECTORS) {
+        renderData = diffuse_mvec;
+    }
+    else if (LP.renderDataMode == RenderDataFlags::BASE_COLOR) {
+        renderData = mat.base_color;
+    }
+    else if (LP.renderDataMode == RenderDataFlags::TEXTURE_COORDINATES) {
+        renderData = make_float3(uv.x, uv.y, 0.0);
+    }
+    else if (LP.renderDataMode == RenderDataFlags::RAY_DIRECTION) {
+        renderData = -w_o;
+    }
+}
+
+static float3 interpolate(const float3 &a, const float3 &b, const float3 &c, glm::vec2 bary) {
+    return a * (1.f - (bary.x + bary.y)) + b * bary.x + c * bary.y;
+}
+
+static float2 interpolate(const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &c, glm::vec2 bary) {
+    return make_float2(a * (1.f - (bary.x + bary.y)) + b * bary.x + c * bary.y);
+}
+
+static float2 loadMeshUV(const CPUMesh &mesh, uint32_t primitive, glm::vec2 bary) {
+    if (mesh.texCoords.empty()) return make_float2(0.f);
+    return interpolate(
+        mesh.texCoords[mesh.indices[primitive * 3 + 0]],
+        mesh.texCoords[mesh.indices[primitive * 3 + 1]],
+        mesh.texCoords[mesh.indices[primitive * 3 + 2]], bary);
+}
+
+/* The light emitted by a light entity towards the given texture coordinate, before any falloff */
+static float3 lightEmission(const LightStruct &light, float2 uv) {
+    float3 emission;
+    if (light.color_texture_id == -1) emission = make_float3(light.r, light.g, light.b);
+    else emission = sampleTexture(light.color_texture_id, uv, make_float3(0.f, 0.f, 0.f));
+    return emission;
+}
+
+/* The time spent on a sample, scaled to roughly match the GPU heatmap */
+static float heatmapValue(std::chrono::steady_clock::time_point start) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    return min(float(elapsed) / 10000.f, 1.f);
+}
+
+/**
+ * Traces one path through a pixel. A host port of the ray generation program in devicecode/path_tracer.cu.
+ * @returns false if there is no camera, in which case the pixel is filled with noise
+ */
+static bool tracePath(const CPULaunchParams &LP, glm::ivec2 pixelID, uint32_t frameID,
+    float3 &result, float3 &primaryAlbedo, float3 &primaryNormal, glm::vec4 &primaryGuide, float &time)
+{
+    const auto &S = CPUScene;
+    auto start_clock = std::chrono::steady_clock::now();
+    float tmax = 1e20f;
+    uint32_t numLights = uint32_t(S.lightEntities.size());
+    bool enableDomeSampling = LP.enableDomeSampling;
+
+    SamplerState sampler = samplerInit(LP.samplerType, pixelID.x, pixelID.y, frameID, LP.seed);
+    time = sampleTime(LP, samplerGet1D(sampler, DIM_TIME));
+
+    // If no camera is in use, just display some random noise...
+    const EntityStruct &camera_entity = LP.cameraEntity;
+    if (!camera_entity.initialized ||
+        (camera_entity.transform_id < 0) || (camera_entity.camera_id < 0) ||
+        (camera_entity.camera_id >= int32_t(S.cameras.size()))) {
+        uint32_t h = samplerHashCombine(samplerHashCombine(sampler.pixelSeed, frameID), 0x5bd1e995u);
+        result = make_float3(samplerToFloat(h), samplerToFloat(samplerHash(h)), samplerToFloat(samplerHash(h + 1)));
+        return false;
+    }
+    const CameraStruct &camera = S.cameras[camera_entity.camera_id];
+
+    // Trace an initial ray through the scene
+    glm::vec3 rayOrigin, rayDirection;
+    generateRay(LP, camera, pixelID, LP.frameSize, sampler, time, rayOrigin, rayDirection);
+    float rayTmin = .001f;
+    float rayTime = time;
+
+    float3 pathThroughput = make_float3(1.f);
+    float3 renderData = make_float3(0.f);
+    primaryAlbedo = make_float3(0.f);
+    primaryNormal = make_float3(0.f);
+    primaryGuide = glm::vec4(0.f, 0.f, 0.f, -1.f);
+    initializeRenderData(LP, renderData);
+
+    uint8_t depth = 0;
+    uint8_t diffuseDepth = 0;
+    uint8_t glossyDepth = 0;
+    uint8_t transparencyDepth = 0;
+    uint8_t transmissionDepth = 0;
+
+    // direct here is used for final image clamping
+    float3 directIllum = make_float3(0.f);
+    float3 illum = make_float3(0.f);
+
+    CPUHit surfHit = traceRay(rayOrigin, rayDirection, rayTmin, tmax, rayTime);
+
+    // Skips forward through the surface that was just hit, continuing in the same direction
+    auto skipForward = [&] () {
+        rayOrigin = rayOrigin + rayDirection * (surfHit.t + EPSILON);
+        rayTime = time;
+        surfHit = traceRay(rayOrigin, rayDirection, rayTmin, tmax, rayTime);
+    };
+
+    // Shade each hit point on a path using NEE with MIS
+    do {
+        // If ray misses, terminate the ray
+        if (surfHit.instance < 0) {
+            // Compute lighting from environment
+            if (depth == 0) {
+                float3 col = missColor(LP, make_float3(rayDirection));
+                illum = illum + pathThroughput * (col * LP.domeLightIntensity);
+                directIllum = illum;
+                primaryAlbedo = col;
+            }
+            else if (enableDomeSampling)
+                illum = illum + pathThroughput * (missColor(LP, make_float3(rayDirection)) * LP.domeLightIntensity * pow(2.f, LP.domeLightExposure));
+
+            const float envDist = 10000.0f; // large value
+            /* Compute miss motion vector */
+            glm::vec3 pFar = rayOrigin + rayDirection * envDist;
+            glm::vec4 tmp1 = LP.proj * LP.viewT0 * glm::vec4(pFar, 1.0f);
+            glm::vec4 tmp2 = LP.proj * LP.viewT1 * glm::vec4(pFar, 1.0f);
+            float3 pt0 = make_float3(tmp1 / tmp1.w) * .5f;
+            float3 pt1 = make_float3(tmp2 / tmp2.w) * .5f;
+            saveMissRenderData(LP, renderData, depth, pt1 - pt0);
+            if (depth == 0) primaryGuide = glm::vec4(pt1.x - pt0.x, pt1.y - pt0.y, 0.f, -1.f);
+            break;
+        }
+
+        // Load the object we hit.
+        const CPUInstance &instance = S.instances[surfHit.instance];
+        int entityID = int(instance.entityID);
+        EntityStruct entity = S.entities[entityID];
+        // Instances of an entity can override its material
+        if (instance.materialID >= 0) entity.material_id = instance.materialID;
+        const CPUMesh &mesh = S.meshes[instance.meshID];
+        bool isLight = (entity.light_id >= 0 && entity.light_id < int32_t(S.lights.size()));
+
+        // Skip forward if the hit object is invisible for this ray type, skip it.
+        if (((entity.flags & ENTITY_VISIBILITY_CAMERA_RAYS) == 0)) {
+            skipForward();
+            transparencyDepth++;
+            if (transparencyDepth > LP.maxTransparencyDepth) break;
+            continue;
+        }
+
+        // Set new outgoing light direction and hit position.
+        const float3 w_o = -make_float3(rayDirection);
+
+        // Load geometry data for the hit object
+        float3 mp, p, v_x, v_y, v_z, v_gz, v_bz;
+        float2 uv;
+        float3 diffuseMotion;
+        if (mesh.points.size() > 0) {
+            const glm::vec4 &point = mesh.points[surfHit.primitive];
+            glm::vec3 n = glm::normalize(surfHit.localPosition - glm::vec3(point));
+            v_z = v_gz = make_float3(n);
+            // Snap the hit onto the sphere, so that rays leaving it start from its surface
+            mp = make_float3(glm::vec3(point) + n * point.w);
+            uv = make_float2(sphereUV(n));
+            v_x = make_float3(sphereTangent(n));
+        }
+        else {
+            glm::vec2 bary = surfHit.barycentrics;
+            uint32_t i0 = mesh.indices[surfHit.primitive * 3 + 0];
+            uint32_t i1 = mesh.indices[surfHit.primitive * 3 + 1];
+            uint32_t i2 = mesh.indices[surfHit.primitive * 3 + 2];
+            float3 A = make_float3(mesh.vertices[i0]), B = make_float3(mesh.vertices[i1]), C = make_float3(mesh.vertices[i2]);
+            mp = interpolate(A, B, C, bary);
+            v_gz = normalize(cross(B - A, C - A));
+            uv = loadMeshUV(mesh, surfHit.primitive, bary);
+            v_z = (mesh.normals.empty()) ? v_gz : interpolate(
+                make_float3(mesh.normals[i0]), make_float3(mesh.normals[i1]), make_float3(mesh.normals[i2]), bary);
+            v_x = (mesh.tangents.empty()) ? make_float3(0.f) : interpolate(
+                make_float3(mesh.tangents[i0]), make_float3(mesh.tangents[i1]), make_float3(mesh.tangents[i2]), bary);
+        }
+
+        // Load material data for the hit object. Lights without a material report their color as albedo.
+        DisneyMaterial mat = {}; MaterialStruct entityMaterial;
+        mat.alpha = 1.f;
+        if (entity.material_id >= 0 && entity.material_id < int32_t(S.materials.size())) {
+            entityMaterial = S.materials[entity.material_id].ids;
+            loadDisneyMaterial(S.materials[entity.material_id], uv, mat, MIN_ROUGHNESS);
+        } else if (isLight) {
+            float3 color = lightEmission(S.lights[entity.light_id], uv);
+            mat.base_color = make_float3(glm::clamp(color.x, 0.f, 1.f), glm::clamp(color.y, 0.f, 1.f), glm::clamp(color.z, 0.f, 1.f));
+        }
+
+        // Point colors replace the base color of the material, and scale its alpha
+        if (mesh.pointColors.size() > 0) {
+            const glm::vec4 &pointColor = mesh.pointColors[surfHit.primitive];
+            mat.base_color = make_float3(glm::vec3(pointColor));
+            mat.alpha *= pointColor.w;
+        }
+
+        // Transform geometry data into world space
+        {
+            glm::mat4 xfm = instanceLocalToWorld(instance, rayTime);
+            p = make_float3(xfm * make_vec4(mp, 1.0f));
+            glm::mat3 nxfm = glm::transpose(glm::inverse(glm::mat3(xfm)));
+            v_gz = make_float3(glm::normalize(nxfm * make_vec3(v_gz)));
+            v_z = make_float3(glm::normalize(nxfm * make_vec3(v_z)));
+            v_x = make_float3(glm::normalize(nxfm * make_vec3(v_x)));
+            v_y = cross(v_z, v_x);
+            v_x = cross(v_y, v_z);
+
+            if ((LP.renderDataMode != RenderDataFlags::NONE) || LP.writeTemporalGuides) {
+                glm::vec4 tmp1 = LP.proj * LP.viewT0 * instance.localToWorldT0 * make_vec4(mp, 1.0f);
+                glm::vec4 tmp2 = LP.proj * LP.viewT1 * instance.localToWorldT1 * make_vec4(mp, 1.0f);
+                float3 pt0 = make_float3(tmp1 / tmp1.w) * .5f;
+                float3 pt1 = make_float3(tmp2 / tmp2.w) * .5f;
+                diffuseMotion = pt1 - pt0;
+            } else {
+                diffuseMotion = make_float3(0.f, 0.f, 0.f);
+            }
+        }
+        float3 hit_p = p;
+
+        // Fallback for tangent and bitangent if UVs result in degenerate vectors.
+        if (
+            glm::all(glm::lessThan(glm::abs(make_vec3(v_x)), glm::vec3(EPSILON))) ||
+            glm::all(glm::lessThan(glm::abs(make_vec3(v_y)), glm::vec3(EPSILON))) ||
+            glm::any(glm::isnan(make_vec3(v_x))) ||
+            glm::any(glm::isnan(make_vec3(v_y)))
+        ) {
+            ortho_basis(v_x, v_y, v_z);
+        }
+
+        // Construct TBN matrix, sample normal map
+        {
+            glm::mat3 tbn;
+            tbn = glm::column(tbn, 0, make_vec3(v_x) );
+            tbn = glm::column(tbn, 1, make_vec3(v_y) );
+            tbn = glm::column(tbn, 2, make_vec3(v_z) );
+            float3 dN;
+            if (isLight) {
+                dN = make_float3(0.5f, .5f, 1.f);
+            } else if (entity.material_id >= 0 && entity.material_id < int32_t(S.materials.size())) {
+                dN = sampleMaterial(S.materials[entity.material_id], entityMaterial.normal_map_texture_id, 4, uv);
+            } else {
+                dN = make_float3(0.5f, .5f, 1.f);
+            }
+
+            dN = normalize( (dN * make_float3(2.0f)) - make_float3(1.f) );
+            v_z = make_float3(tbn * make_vec3(dN));
+
+            // make sure geometric and shading normal face the same direction.
+            if (dot(v_z, v_gz) < 0.f) {
+                v_z = -v_z;
+            }
+
+            v_bz = v_z;
+        }
+
+        // If we didn't hit glass, flip the surface normal to face forward.
+        if ((mat.specular_transmission == 0.f) && (entity.light_id == -1)) {
+            if (dot(w_o, v_gz) < 0.f) {
+                v_z = -v_z;
+                v_gz = -v_gz;
+            }
+
+            // compute bent normal
+            float3 r = reflect(-w_o, v_z);
+            float a = dot(v_gz, r);
+            v_bz = v_z;
+            if (a < 0.f) {
+                float b = max(0.001f, dot(v_z, v_gz));
+                v_bz = normalize(w_o + normalize(r - v_z * a / b));
+            }
+        }
+
+        if (glm::any(glm::isnan(make_vec3(v_z)))) {
+            v_z = v_x = v_y = make_float3(0.f);
+        }
+
+        // For segmentations, save geometric metadata
+        saveGeometricRenderData(LP, renderData, depth, surfHit.t, hit_p, v_z, w_o, uv, entityID, diffuseMotion, time, mat);
+        if (depth == 0) {
+            primaryAlbedo = mat.base_color;
+            primaryNormal = v_z;
+            primaryGuide = glm::vec4(diffuseMotion.x, diffuseMotion.y, surfHit.t, float(entityID));
+        }
+
+        // Potentially skip forward if the hit object is transparent
+        if ((entity.light_id == -1) && (mat.alpha < 1.f)) {
+            float alpha_rnd = samplerGet1D(sampler, bounceDimension(depth, DIM_ALPHA));
+
+            if (alpha_rnd > mat.alpha) {
+                skipForward();
+                ++depth;
+                transparencyDepth++;
+                continue;
+            }
+        }
+
+        // If the entity we hit is a light, terminate the path.
+        // Note that NEE/MIS will also potentially terminate the path, preventing double-counting.
+        if (isLight) {
+            float dotNWi = max(dot(make_float3(rayDirection), v_z), 0.f);
+            if ((dotNWi > EPSILON) && (depth != 0)) break;
+
+            const LightStruct &entityLight = S.lights[entity.light_id];
+            float3 emission = lightEmission(entityLight, uv);
+            float dist = surfHit.t;
+            emission = (emission * entityLight.intensity);
+            if (depth != 0) emission = (emission * pow(2.f, entityLight.exposure)) / max((dist * dist), 1.f);
+            float3 contribution = pathThroughput * emission;
+            illum = illum + contribution;
+            if (depth == 0) directIllum = illum;
+            break;
+        }
+
+        // Next, we'll be sampling direct light sources
+        int32_t sampledLightID = -2;
+        float lightPDF = 0.f;
+        float3 irradiance = make_float3(0.f);
+
+        // First, sample the BRDF so that we can use the sampled direction for MIS
+        float3 w_i;
+        float bsdfPDF;
+        int sampledBsdf = -1;
+        float3 bsdf;
+        {
+            float lobeSample = samplerGet1D(sampler, bounceDimension(depth, DIM_BSDF_LOBE));
+            glm::vec2 directionSample = samplerGet2D(sampler, bounceDimension(depth, DIM_BSDF_DIRECTION));
+            sample_disney_brdf(
+                mat, lobeSample, make_float2(directionSample.x, directionSample.y), // inputs
+                v_gz, v_z, v_bz, v_x, v_y, w_o,
+                w_i, bsdfPDF, sampledBsdf, bsdf);                                  // outputs
+        }
+
+        // At this point, if we are refracting and we ran out of transmission bounces, skip forward.
+        // This avoids creating black regions on glass objects due to bounce limits
+        if (sampledBsdf == DISNEY_TRANSMISSION_BRDF && transmissionDepth >= LP.maxTransmissionDepth) {
+            skipForward();
+            // Count this as a "transparent" bounce.
+            ++depth;
+            transparencyDepth++;
+            continue;
+        }
+
+        // Pick a light, keeping the dome's share of uniform selection, in proportion to the power of each light
+        float lightSelectionPDF = 0.f;
+        float triangleSelectionPDF = 1.f;
+        uint32_t randomID = selectLight((S.lightTable.empty()) ? nullptr : S.lightTable.data(), numLights,
+            enableDomeSampling, samplerGet1D(sampler, bounceDimension(depth, DIM_LIGHT_SELECTION)), lightSelectionPDF);
+        float dotNWi  = 0.f;
+        float3 l_bsdf = make_float3(0.f);
+        float3 emission = make_float3(0.f);
+        float3 lightDir = make_float3(0.f);
+        float lightDistance = 1e20f;
+        float falloff = 2.0f;
+
+        // sample background
+        if (randomID == numLights) {
+            sampledLightID = -1;
+            if (
+                (LP.environmentMapWidth != 0) && (LP.environmentMapHeight != 0) &&
+                (LP.environmentMapAlias != nullptr)
+            )
+            {
+                // Importance sample the solid angle weighted luminance map of the dome
+                int width = LP.environmentMapWidth;
+                int height = LP.environmentMapHeight;
+                float texelPDF, rx;
+                glm::vec2 texelSample = samplerGet2D(sampler, bounceDimension(depth, DIM_LIGHT_POSITION));
+                uint32_t texel = sampleAliasTable(LP.environmentMapAlias, width * height, texelSample.x, texelPDF, rx);
+                float ry = texelSample.y;
+                glm::vec2 domeUV = glm::vec2((texel % width + rx) / float(width), (texel / width + ry) / float(height));
+                lightDir = make_float3(glm::inverse(LP.environmentMapRotation) * toPolar(domeUV));
+                lightPDF = domeImportancePdf(texelPDF, domeUV.y, width, height);
+            }
+            else
+            {
+                glm::mat3 tbn;
+                tbn = glm::column(tbn, 0, make_vec3(v_x) );
+                tbn = glm::column(tbn, 1, make_vec3(v_y) );
+                tbn = glm::column(tbn, 2, make_vec3(v_z) );
+                glm::vec2 hemiSample = samplerGet2D(sampler, bounceDimension(depth, DIM_LIGHT_POSITION));
+                const float3 hemi_dir = (cos_sample_hemisphere(make_float2(hemiSample.x, hemiSample.y)));
+                lightDir = make_float3(tbn * make_vec3(hemi_dir));
+                lightPDF = 1.f / float(2.0 * M_PI);
+            }
+
+            emission = (missColor(LP, lightDir) * LP.domeLightIntensity * pow(2.f, LP.domeLightExposure));
+        }
+        // sample light sources
+        else if (lightSelectionPDF > 0.f)
+        {
+            sampledLightID = int32_t(S.lightEntities[randomID]);
+            const EntityStruct &light_entity = S.entities[sampledLightID];
+            const LightStruct &light_light = S.lights[light_entity.light_id];
+            const CPUMesh &light_mesh = S.meshes[light_entity.mesh_id];
+            const glm::mat4 &ltw = S.lightTransforms[randomID];
+            uint32_t numTris = uint32_t(light_mesh.indices.size() / 3);
+            uint32_t random_tri_id = selectTriangle(light_mesh.triangleTable.data(), numTris, light_light.use_surface_area,
+                samplerGet1D(sampler, bounceDimension(depth, DIM_LIGHT_TRIANGLE)), triangleSelectionPDF);
+            uint32_t i0 = light_mesh.indices[random_tri_id * 3 + 0];
+            uint32_t i1 = light_mesh.indices[random_tri_id * 3 + 1];
+            uint32_t i2 = light_mesh.indices[random_tri_id * 3 + 2];
+
+            // Sample the light to compute an incident light ray to this point
+            float3 dir; float2 lightUV;
+            float3 pos = hit_p;
+            float3 v1 = make_float3(light_mesh.vertices[i0]), v2 = make_float3(light_mesh.vertices[i1]), v3 = make_float3(light_mesh.vertices[i2]);
+            float3 n1, n2, n3;
+            if (light_mesh.normals.empty()) n1 = n2 = n3 = normalize(cross(v2 - v1, v3 - v1));
+            else { n1 = make_float3(light_mesh.normals[i0]); n2 = make_float3(light_mesh.normals[i1]); n3 = make_float3(light_mesh.normals[i2]); }
+            float2 uv1 = make_float2(0.f), uv2 = make_float2(0.f), uv3 = make_float2(0.f);
+            if (!light_mesh.texCoords.empty()) {
+                uv1 = make_float2(light_mesh.texCoords[i0]); uv2 = make_float2(light_mesh.texCoords[i1]); uv3 = make_float2(light_mesh.texCoords[i2]);
+            }
+
+            // Matches the device code, which transforms light normals by the light's transform directly
+            n1 = make_float3(ltw * make_float4(n1, 0.0f));
+            n2 = make_float3(ltw * make_float4(n2, 0.0f));
+            n3 = make_float3(ltw * make_float4(n3, 0.0f));
+            v1 = make_float3(ltw * make_float4(v1, 1.0f));
+            v2 = make_float3(ltw * make_float4(v2, 1.0f));
+            v3 = make_float3(ltw * make_float4(v3, 1.0f));
+            glm::vec2 positionSample = samplerGet2D(sampler, bounceDimension(depth, DIM_LIGHT_POSITION));
+            sampleTriangle(pos, n1, n2, n3, v1, v2, v3, uv1, uv2, uv3,
+                positionSample.x, positionSample.y, dir, lightDistance, lightPDF, lightUV,
+                /*double_sided*/ false, /*use surface area*/ light_light.use_surface_area);
+
+            falloff = light_light.falloff;
+            lightDir = make_float3(dir.x, dir.y, dir.z);
+            emission = lightEmission(light_light, lightUV) * (light_light.intensity * pow(2.f, light_light.exposure));
+        }
+
+        disney_brdf(
+            mat, v_gz, v_z, v_bz, v_x, v_y,
+            w_o, lightDir, normalize(w_o + lightDir), l_bsdf
+        );
+        dotNWi = max(dot(lightDir, v_z), 0.f);
+
+        lightPDF *= lightSelectionPDF * triangleSelectionPDF;
+        if ((lightPDF > 0.0) && (dotNWi > EPSILON)) {
+            CPUHit shadowHit = traceRay(make_vec3(hit_p), make_vec3(lightDir), EPSILON * 10.f, lightDistance + EPSILON, time,
+                /*anyHit = */ randomID == numLights);
+            bool visible;
+            if (randomID == numLights) {
+                //  If we sampled the dome light, just check to see if we hit anything
+                visible = (shadowHit.instance == -1);
+            } else {
+                // If we sampled a light source, then check to see if we hit something other than the light
+                visible = (shadowHit.instance == -1 || int32_t(S.instances[shadowHit.instance].entityID) == sampledLightID);
+            }
+            if (visible) {
+                if (randomID != numLights) emission = emission / max(pow(shadowHit.t, falloff),1.f);
+                float w = power_heuristic(1.f, lightPDF, 1.f, bsdfPDF);
+                float3 Li = (emission * w) / lightPDF;
+                irradiance = irradiance + (l_bsdf * Li);
+            }
+        }
+
+        // For segmentations, save lighting metadata
+        saveLightingColorRenderData(LP, renderData, depth, v_z, w_o, w_i, mat);
+
+        // Terminate the path if the bsdf probability is impossible, or if the bsdf filters out all light
+        if (bsdfPDF < EPSILON || all_zero(bsdf)) {
+            float3 contribution = pathThroughput * irradiance;
+            illum = illum + contribution;
+            break;
+        }
+
+        // Next, sample a light source using the importance sampled BDRF direction.
+        rayOrigin = make_vec3(hit_p);
+        rayDirection = make_vec3(w_i);
+        rayTmin = EPSILON;
+        rayTime = sampleTime(LP, samplerGet1D(sampler, bounceDimension(depth, DIM_BOUNCE_TIME)));
+        surfHit = traceRay(rayOrigin, rayDirection, rayTmin, tmax, rayTime);
+
+        // Check if we hit any of the previously sampled lights
+        bool hitLight = false;
+        if (lightPDF > EPSILON)
+        {
+            float dotNWi = max(dot(w_i, v_gz), 0.f);  // geometry term
+
+            // if by sampling the brdf we also hit the dome light...
+            if ((surfHit.instance == -1) && (sampledLightID == -1) && enableDomeSampling) {
+                // Case where we hit the background, and also previously sampled the background
+                float w = power_heuristic(1.f, bsdfPDF, 1.f, lightPDF);
+                float3 domeEmission = missColor(LP, w_i) * LP.domeLightIntensity * pow(2.f, LP.domeLightExposure);
+                float3 Li = (domeEmission * w) / bsdfPDF;
+
+                if (dotNWi > 0.f) {
+                    irradiance = irradiance + (bsdf * Li);
+                }
+                hitLight = true;
+            }
+            // else if by sampling the brdf we also hit an area light
+            else if (surfHit.instance != -1) {
+                bool visible = (int32_t(S.instances[surfHit.instance].entityID) == sampledLightID);
+                // We hit the light we sampled previously
+                if (visible) {
+                    const EntityStruct &light_entity = S.entities[sampledLightID];
+                    const LightStruct &light_light = S.lights[light_entity.light_id];
+                    float2 lightUV = loadMeshUV(S.meshes[light_entity.mesh_id], surfHit.primitive, surfHit.barycentrics);
+
+                    float dist = surfHit.t;
+                    float3 hitEmission = lightEmission(light_light, lightUV) * (light_light.intensity * pow(2.f, light_light.exposure));
+                    hitEmission = hitEmission / max(pow(dist, light_light.falloff), 1.f);
+
+                    if (dotNWi > EPSILON)
+                    {
+                        float w = power_heuristic(1.f, bsdfPDF, 1.f, lightPDF);
+                        float3 Li = (hitEmission * w) / bsdfPDF;
+                        irradiance = irradiance + (bsdf * Li);
+                    }
+                    hitLight = true;
+                }
+            }
+        }
+
+        // Accumulate radiance (ie pathThroughput * irradiance), and update the path throughput using the sampled BRDF
+        float3 contribution = pathThroughput * irradiance;
+        illum = illum + contribution;
+        pathThroughput = (pathThroughput * bsdf) / bsdfPDF;
+        if (depth == 0) directIllum = illum;
+
+        // Avoid double counting light sources by terminating here if we hit a light sampled thorugh NEE/MIS
+        if (hitLight) break;
+
+        // Russian Roulette
+        // Randomly terminate a path with a probability inversely equal to the throughput
+        float pmax = max(pathThroughput.x, max(pathThroughput.y, pathThroughput.z));
+        if (samplerGet1D(sampler, bounceDimension(depth, DIM_RUSSIAN_ROULETTE)) > pmax) {
+            break;
+        }
+
+        // if the bounce count is less than the max bounce count, potentially add on radiance from the next hit location.
+        ++depth;
+        if (sampledBsdf == DISNEY_DIFFUSE_BRDF) diffuseDepth++;
+        else if (sampledBsdf == DISNEY_GLOSSY_BRDF) glossyDepth++;
+        else if (sampledBsdf == DISNEY_CLEARCOAT_BRDF) glossyDepth++;
+        else if (sampledBsdf == DISNEY_TRANSMISSION_BRDF) transmissionDepth++;
+        // transparency depth handled earlier
+
+        // for transmission, once we hit the limit, we'll stop refracting instead
+        // of terminating, just so that we don't get black regions in our glass
+        if (transmissionDepth >= LP.maxTransmissionDepth) continue;
+    } while (
+        diffuseDepth < LP.maxDiffuseDepth &&
+        glossyDepth < LP.maxGlossyDepth &&
+        transparencyDepth < LP.maxTransparencyDepth
+    );
+
+    // For segmentations, save heatmap metadata
+    if (LP.renderDataMode == RenderDataFlags::HEATMAP) renderData = make_float3(heatmapValue(start_clock));
+
+    // clamp out any extreme fireflies
+    glm::vec3 gillum = make_vec3(illum);
+    glm::vec3 dillum = make_vec3(directIllum);
+    glm::vec3 iillum = gillum - dillum;
+
+    if (LP.indirectClamp > 0.f)
+        iillum = glm::clamp(iillum, glm::vec3(0.f), glm::vec3(LP.indirectClamp));
+    if (LP.directClamp > 0.f)
+        dillum = glm::clamp(dillum, glm::vec3(0.f), glm::vec3(LP.directClamp));
+
+    gillum = dillum + iillum;
+
+    // just in case we get inf's or nans, remove them.
+    if (glm::any(glm::isnan(gillum))) gillum = glm::vec3(0.f);
+    if (glm::any(glm::isinf(gillum))) gillum = glm::vec3(0.f);
+
+    // Override framebuffer output if user requested to render metadata
+    result = (LP.renderDataMode == RenderDataFlags::NONE) ? make_float3(gillum) : renderData;
+    return true;
+}
+
+static void renderPixel(const CPULaunchParams &LP, glm::ivec2 pixelID, uint32_t sampleCount,
+    glm::vec4* frameBuffer, glm::vec4* albedoBuffer, glm::vec4* normalBuffer, glm::vec4* halfBuffer, glm::vec4* guideBuffer)
+{
+    // Pixels in tiles that adaptive sampling found converged take no further samples
+    if (LP.adaptiveTileSize > 0 && LP.adaptiveTileMask) {
+        uint32_t tile = adaptiveTileIndex(pixelID.x, pixelID.y, LP.frameSize.x, LP.adaptiveTileSize);
+        if (LP.adaptiveTileMask[tile] != ADAPTIVE_TILE_ACTIVE) return;
+    }
+
+    auto fbOfs = pixelID.x + LP.frameSize.x * ((LP.frameSize.y - 1) - pixelID.y);
+    glm::vec4 color = frameBuffer[fbOfs];
+    glm::vec4 halfColor = (halfBuffer) ? halfBuffer[fbOfs] : glm::vec4(0.f);
+    glm::vec4 albedo = albedoBuffer[fbOfs];
+    glm::vec4 normal = normalBuffer[fbOfs];
+    if (glm::any(glm::isnan(albedo))) albedo = glm::vec4(0.f);
+    if (glm::any(glm::isnan(normal))) normal = glm::vec4(0.f);
+
+    for (uint32_t s = 0; s < sampleCount; ++s) {
+        uint32_t frameID = uint32_t(LP.frameID + s);
+        float3 result, primaryAlbedo, primaryNormal;
+        glm::vec4 primaryGuide;
+        float time;
+        if (!tracePath(LP, pixelID, frameID, result, primaryAlbedo, primaryNormal, primaryGuide, time)) {
+            color = glm::vec4(make_vec3(result), 1.f);
+            continue;
+        }
+
+        // the first sample describes the surface seen through this pixel, for temporal accumulation
+        if (guideBuffer && LP.writeTemporalGuides && frameID == 0) guideBuffer[fbOfs] = primaryGuide;
+
+        // accumulate the results of this sample into what will be an average of all samples in this pixel
+        float n = float(frameID);
+        color = glm::vec4((make_vec3(result) + n * glm::vec3(color)) / (n + 1.f), 1.0f);
+
+        // the even numbered samples make up a second, independent estimate, used to measure convergence
+        if (halfBuffer && LP.adaptiveTileSize > 0 && LP.renderDataMode == RenderDataFlags::NONE && (frameID % 2) == 0) {
+            float k = float(frameID / 2);
+            halfColor = glm::vec4((make_vec3(result) + k * glm::vec3(halfColor)) / (k + 1.f), 1.0f);
+        }
+
+        // compute screen space normal / albedo
+        glm::vec4 newAlbedo = glm::vec4(make_vec3(primaryAlbedo), 1.f);
+        albedo = (newAlbedo + n * albedo) / (n + 1.f);
+        glm::vec4 newNormal = glm::vec4(make_vec3(primaryNormal), 1.f);
+        if (!glm::all(glm::equal(make_vec3(primaryNormal), glm::vec3(0.f, 0.f, 0.f)))) {
+            glm::quat r0 = glm::quat_cast(LP.viewT0);
+            glm::quat r1 = glm::quat_cast(LP.viewT1);
+            glm::quat rot = (glm::all(glm::equal(r0, r1))) ? r0 : glm::slerp(r0, r1, time);
+            glm::vec3 tmp = glm::normalize(glm::mat3_cast(rot) * make_vec3(primaryNormal));
+            tmp = glm::normalize(glm::vec3(LP.proj * glm::vec4(tmp, 0.f)));
+            newNormal = glm::vec4(tmp, 1.f);
+        }
+        normal = (newNormal + n * normal) / (n + 1.f);
+    }
+
+    // save data to frame buffers
+    frameBuffer[fbOfs] = color;
+    albedoBuffer[fbOfs] = albedo;
+    normalBuffer[fbOfs] = normal;
+    if (halfBuffer) halfBuffer[fbOfs] = halfColor;
+}
+
+void cpuRender(const CPULaunchParams &LP, uint32_t sampleCount,
+    glm::vec4* frameBuffer, glm::vec4* albedoBuffer, glm::vec4* normalBuffer, glm::vec4* halfBuffer, glm::vec4* guideBuffer)
+{
+    if (LP.frameSize.x <= 0 || LP.frameSize.y <= 0 || sampleCount == 0) return;
+
+    // Tiles are handed out to the shared thread pool in scanline order, one at a time
+    uint32_t tilesX = (LP.frameSize.x + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+    uint32_t tilesY = (LP.frameSize.y + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+    ThreadPool::global().parallelFor(0, tilesX * tilesY, [&] (uint64_t tile) {
+        int x0 = int(tile % tilesX) * CPU_TILE_SIZE, y0 = int(tile / tilesX) * CPU_TILE_SIZE;
+        int x1 = std::min(x0 + CPU_TILE_SIZE, LP.frameSize.x), y1 = std::min(y0 + CPU_TILE_SIZE, LP.frameSize.y);
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                renderPixel(LP, glm::ivec2(x, y), sampleCount, frameBuffer, albedoBuffer, normalBuffer, halfBuffer, guideBuffer);
+            }
+        }
+    }, 1);
+}
+
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <nvisii/entity_struct.h>
+#include <nvisii/utilities/alias_table.h>
+#include <nvisii/utilities/sampler.h>
+#include <nvisii/utilities/adaptive_sampling.h>
+
+/**
+ * The CPU backend: a multithreaded, tile scheduled path tracer over a SAH BVH,
+ * which renders the same scene components as the OptiX backend. It follows the
+ * ray generation program in devicecode/path_tracer.cu, sharing the Disney BSDF,
+ * the light sampling code and the samplers with it, so that images match the
+ * GPU backend up to sampling noise.
+ *
+ * Not yet supported on the CPU: volumes, the denoiser, and the light BVH
+ * (lights are always selected in proportion to their power).
+ */
+
+namespace nvisii {
+
+struct SceneSnapshot;
+struct PublishedScene;
+
+/* The frame state read by the CPU path tracer, mirroring the OptiX launch parameters */
+struct CPULaunchParams {
+    glm::ivec2 frameSize = glm::ivec2(0);
+    uint64_t frameID = 0;
+    uint32_t seed = 0;
+    uint32_t samplerType = SAMPLER_SOBOL;
+
+    float domeLightIntensity = 1.f;
+    float domeLightExposure = 0.f;
+    glm::vec3 domeLightColor = glm::vec3(-1.f);
+    bool enableDomeSampling = true;
+
+    float directClamp = 100.f;
+    float indirectClamp = 100.f;
+    uint32_t maxDiffuseDepth = 2;
+    uint32_t maxGlossyDepth = 2;
+    uint32_t maxTransparencyDepth = 8;
+    uint32_t maxTransmissionDepth = 12;
+
+    glm::vec2 xPixelSamplingInterval = glm::vec2(0.f, 1.f);
+    glm::vec2 yPixelSamplingInterval = glm::vec2(0.f, 1.f);
+    glm::vec2 timeSamplingInterval = glm::vec2(0.f, 1.f);
+
+    EntityStruct cameraEntity;
+    glm::mat4 proj;
+    glm::mat4 viewT0;
+    glm::mat4 viewT1;
+
+    /* A texture ID, -1 for no texture, or -2 for the procedural sky */
+    int32_t environmentMapID = -1;
+    glm::quat environmentMapRotation = glm::quat(1, 0, 0, 0);
+    const AliasTableEntry* environmentMapAlias = nullptr;
+    int environmentMapWidth = 0;
+    int environmentMapHeight = 0;
+    const glm::vec4* proceduralSkyTexels = nullptr;
+    uint32_t proceduralSkyWidth = 0;
+    uint32_t proceduralSkyHeight = 0;
+
+    uint32_t renderDataMode = 0;
+    uint32_t renderDataBounce = 0;
+
+    /* One ADAPTIVE_TILE_* value per tile, or nullptr to sample every pixel */
+    const uint8_t* adaptiveTileMask = nullptr;
+    uint32_t adaptiveTileSize = 0;
+
+    /* If true, the first sample of each pixel writes a temporal accumulation guide */
+    bool writeTemporalGuides = false;
+};
+
+/**
+ * Applies the changes of a committed scene snapshot to the CPU renderer's copy of the scene,
+ * rebuilding any affected acceleration structures.
+ * @param changes The changes committed since the previous call
+ * @param scene The published scene, with the changes already applied
+ * @returns true if anything changed
+ */
+bool cpuUpdateComponents(const SceneSnapshot &changes, const PublishedScene &scene);
+
+/**
+ * Path traces a number of samples per pixel, progressively refining the given buffers.
+ * Pixels are ordered bottom row first, like the OptiX frame buffers.
+ * @param LP The frame state. Samples are numbered from LP.frameID onwards, and are averaged
+ * with the LP.frameID samples already accumulated into the buffers.
+ * @param sampleCount The number of samples to take per pixel
+ * @param frameBuffer The accumulated color, or render data, of each pixel
+ * @param albedoBuffer The accumulated albedo of the first surface seen through each pixel
+ * @param normalBuffer The accumulated screen space normal of the first surface seen through each pixel
+ * @param halfBuffer If not null, the accumulated color of only the even numbered samples, used by adaptive sampling
+ * @param guideBuffer If not null, receives the temporal accumulation guide of each pixel (see utilities/temporal_accumulation.h)
+ */
+void cpuRender(const CPULaunchParams &LP, uint32_t sampleCount,
+    glm::vec4* frameBuffer, glm::vec4* albedoBuffer, glm::vec4* normalBuffer, 
+    glm::vec4* halfBuffer = nullptr, glm::vec4* guideBuffer = nullptr);
+
+/** Releases the CPU renderer's copy of the scene */
+void cpuReleaseScene();
+
+};
@@ -1,13 +1,15 @@
 #pragma once
 
+#ifdef __CUDACC__
 #include <math_constants.h>
 #include <optix.h>
+#endif
 #include "float3.h"
 #include "types.h"
 
 // Tone Mapping
 // From http://filmicgames.com/archives/75
-__device__ float3 uncharted_2_tonemap(float3 x)
+inline CUDA_DECORATOR float3 uncharted_2_tonemap(float3 x)
 {
 	if (x.x < 0) x.x = 0;
 	if (x.y < 0) x.y = 0;
@@ -25,23 +27,23 @@ __device__ float3 uncharted_2_tonemap(float3 x)
 	return result;
 }
 
-__device__ float linear_to_srgb(float x) {
+inline CUDA_DECORATOR float linear_to_srgb(float x) {
 	if (x <= 0.0031308f) {
 		return 12.92f * x;
 	}
 	return 1.055f * pow(x, 1.f/2.4f) - 0.055f;
 }
 
-__device__ float luminance(const float3 &c) {
+inline CUDA_DECORATOR float luminance(const float3 &c) {
 	return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z;
 }
 
-__device__ float pow2(float x) {
+inline CUDA_DECORATOR float pow2(float x) {
 	return x * x;
 }
 
 // code from [Frisvad2012]
-__device__ void ortho_basis(float3 &b1, float3 &b2, float3 n)
+inline CUDA_DECORATOR void ortho_basis(float3 &b1, float3 &b2, float3 n)
 {
     if (n.z < -0.9999999f)
     {
@@ -56,7 +58,7 @@ __device__ void ortho_basis(float3 &b1, float3 &b2, float3 n)
 }
 
 template<typename T>
-__device__ T clamp(const T &x, const T &lo, const T &hi) {
+inline CUDA_DECORATOR T clamp(const T &x, const T &lo, const T &hi) {
 	if (x < lo) {
 		return lo;
 	}
@@ -66,19 +68,19 @@ __device__ T clamp(const T &x, const T &lo, const T &hi) {
 	return x;
 }
 
-__device__ float lerp(float x, float y, float s) {
+inline CUDA_DECORATOR float lerp(float x, float y, float s) {
 	return x * (1.f - s) + y * s;
 }
 
-__device__ float3 lerp(float3 x, float3 y, float s) {
+inline CUDA_DECORATOR float3 lerp(float3 x, float3 y, float s) {
 	return x * (1.f - s) + y * s;
 }
 
-__device__ float3 reflect(const float3 &i, const float3 &n) {
+inline CUDA_DECORATOR float3 reflect(const float3 &i, const float3 &n) {
 	return i - 2.f * n * dot(i, n);
 }
 
-__device__ float3 refract( float3 i, float3 n, float eta )
+inline CUDA_DECORATOR float3 refract( float3 i, float3 n, float eta )
 {
   if (eta == 1.f) return i;
   if (eta <= 0.f) return make_float3(0.f);
@@ -90,7 +92,7 @@ __device__ float3 refract( float3 i, float3 n, float eta )
   return t * ((cost2 > 0.f) ? make_float3(1.f) : make_float3(0.f));
 }
 
-__device__ float3 refract_ray(const float3 &i, const float3 &n, float eta) {
+inline CUDA_DECORATOR float3 refract_ray(const float3 &i, const float3 &n, float eta) {
 	float n_dot_i = dot(n, i);
 	float k = 1.f - eta * eta * (1.f - n_dot_i * n_dot_i);
 	if (k < 0.f) {
@@ -99,7 +101,7 @@ __device__ float3 refract_ray(const float3 &i, const float3 &n, float eta) {
 	return eta * i - (eta * n_dot_i + sqrt(k)) * n;
 }
 
-__device__ float component(const float4 &v, const uint32_t i) {
+inline CUDA_DECORATOR float component(const float4 &v, const uint32_t i) {
     switch (i) {
     case 0: return v.x;
     case 1: return v.y;
@@ -109,17 +111,18 @@ __device__ float component(const float4 &v, const uint32_t i) {
     }
 }
 
-__device__ void* unpack_ptr(uint32_t hi, uint32_t lo) {
+inline CUDA_DECORATOR void* unpack_ptr(uint32_t hi, uint32_t lo) {
 	const uint64_t val = static_cast<uint64_t>(hi) << 32 | lo;
 	return reinterpret_cast<void*>(val);
 }
 
-__device__ void pack_ptr(void *ptr, uint32_t &hi, uint32_t &lo) {
+inline CUDA_DECORATOR void pack_ptr(void *ptr, uint32_t &hi, uint32_t &lo) {
 	const uint64_t val = reinterpret_cast<uint64_t>(ptr);
 	hi = val >> 32;
 	lo = val & 0x00000000ffffffff;
 }
 
+#ifdef __CUDACC__
 template<typename T>
 __device__ T& get_payload() {
 	return *reinterpret_cast<T*>(unpack_ptr(optixGetPayload_0(), optixGetPayload_1()));
@@ -129,3 +132,4 @@ template<typename T>
 __device__ const T& get_shader_params() {
 	return *reinterpret_cast<const T*>(optixGetSbtDataPointer());
 }
+#endif
@@ -2,7 +2,6 @@
 
 #include "cuda_utils.h"
 #include "float3.h"
-#include "lcg_rng.h"
 
 /* Disney BSDF functions, for additional details and examples see:
  * - https://blog.selfshadow.com/publications/s2012-shading-course/burley/s2012_pbs_disney_brdf_notes_v3.pdf
@@ -43,11 +42,11 @@ struct DisneyMaterial {
 	float alpha;
 };
 
-__device__ bool same_hemisphere(const float3 &w_o, const float3 &w_i, const float3 &n) {
+inline CUDA_DECORATOR bool same_hemisphere(const float3 &w_o, const float3 &w_i, const float3 &n) {
 	return dot(w_o, n) * dot(w_i, n) > 0.f;
 }
 
-__device__ bool relative_ior(const float3 &w_o, const float3 &n, float ior, float &eta_o, float &eta_i)
+inline CUDA_DECORATOR bool relative_ior(const float3 &w_o, const float3 &n, float ior, float &eta_o, float &eta_i)
 {
 	bool entering = dot(w_o, n) > 0.f;
 	eta_i = entering ? 1.f : ior;
@@ -57,7 +56,7 @@ __device__ bool relative_ior(const float3 &w_o, const float3 &n, float ior, floa
 
 // Sample the hemisphere using a cosine weighted distribution,
 // returns a vector in a hemisphere oriented about (0, 0, 1)
-__device__ float3 cos_sample_hemisphere(float2 u) {
+inline CUDA_DECORATOR float3 cos_sample_hemisphere(float2 u) {
 	float2 s = 2.f * u - make_float2(1.f);
 	float2 d;
 	float radius = 0.f;
@@ -77,25 +76,25 @@ __device__ float3 cos_sample_hemisphere(float2 u) {
 	return make_float3(d.x, d.y, sqrt(max(0.f, 1.f - d.x * d.x - d.y * d.y)));
 }
 
-__device__ float3 spherical_dir(float sin_theta, float cos_theta, float phi) {
+inline CUDA_DECORATOR float3 spherical_dir(float sin_theta, float cos_theta, float phi) {
 	return make_float3(sin_theta * cos(phi), sin_theta * sin(phi), cos_theta);
 }
 
-__device__ float power_heuristic(float n_f, float pdf_f, float n_g, float pdf_g) {
+inline CUDA_DECORATOR float power_heuristic(float n_f, float pdf_f, float n_g, float pdf_g) {
 	float f = n_f * pdf_f;
 	float g = n_g * pdf_g;
 	return (f * f) / (f * f + g * g);
 }
 
-__device__ float schlick_weight(float cos_theta) {
-	return pow(saturate(1.f - cos_theta), 5.f);
+inline CUDA_DECORATOR float schlick_weight(float cos_theta) {
+	return pow(glm::clamp(1.f - cos_theta, 0.f, 1.f), 5.f);
 }
 
 // Complete Fresnel Dielectric computation, for transmission at ior near 1
 // they mention having issues with the Schlick approximation.
 // eta_i: material on incident side's ior
 // eta_t: material on transmitted side's ior
-__device__ float fresnel_dielectric(float cos_theta_i, float eta_i, float eta_t) {
+inline CUDA_DECORATOR float fresnel_dielectric(float cos_theta_i, float eta_i, float eta_t) {
 	float g = pow2(eta_t) / pow2(eta_i) - 1.f + pow2(cos_theta_i);
 	if (g < 0.f) {
 		return 1.f;
@@ -106,7 +105,7 @@ __device__ float fresnel_dielectric(float cos_theta_i, float eta_i, float eta_t)
 
 // D_GTR1: Generalized Trowbridge-Reitz with gamma=1
 // Burley notes eq. 4
-__device__ float gtr_1(float cos_theta_h, float alpha) {
+inline CUDA_DECORATOR float gtr_1(float cos_theta_h, float alpha) {
 	if (alpha >= 1.f) {
 		return M_1_PI;
 	}
@@ -116,60 +115,60 @@ __device__ float gtr_1(float cos_theta_h, float alpha) {
 
 // D_GTR2: Generalized Trowbridge-Reitz with gamma=2
 // Burley notes eq. 8
-__device__ float gtr_2(float cos_theta_h, float alpha) {
+inline CUDA_DECORATOR float gtr_2(float cos_theta_h, float alpha) {
 	float alpha_sqr = alpha * alpha;
 	return M_1_PI * alpha_sqr / max(pow2(1.f + (alpha_sqr - 1.f) * cos_theta_h * cos_theta_h), SMALL_EPSILON);
 }
 
 // D_GTR2 Anisotropic: Anisotropic generalized Trowbridge-Reitz with gamma=2
 // Burley notes eq. 13
-__device__ float gtr_2_aniso(float h_dot_n, float h_dot_x, float h_dot_y, float2 alpha) {
+inline CUDA_DECORATOR float gtr_2_aniso(float h_dot_n, float h_dot_x, float h_dot_y, float2 alpha) {
 	return M_1_PI / max((alpha.x * alpha.y * pow2(pow2(h_dot_x / alpha.x) + pow2(h_dot_y / alpha.y) + h_dot_n * h_dot_n)), SMALL_EPSILON);
 }
 
-__device__ float smith_shadowing_ggx(float n_dot_o, float alpha_g) {
+inline CUDA_DECORATOR float smith_shadowing_ggx(float n_dot_o, float alpha_g) {
 	float a = alpha_g * alpha_g;
 	float b = n_dot_o * n_dot_o;
 	return 1.f / (n_dot_o + sqrt(a + b - a * b));
 }
 
-__device__ float smith_shadowing_ggx_aniso(float n_dot_o, float o_dot_x, float o_dot_y, float2 alpha) {
+inline CUDA_DECORATOR float smith_shadowing_ggx_aniso(float n_dot_o, float o_dot_x, float o_dot_y, float2 alpha) {
 	return 1.f / (n_dot_o + sqrt(pow2(o_dot_x * alpha.x) + pow2(o_dot_y * alpha.y) + pow2(n_dot_o)));
 }
 
 // Sample a reflection direction the hemisphere oriented along n and spanned by v_x, v_y using the random samples in s
-__device__ float3 sample_lambertian_dir(const float3 &n, const float3 &v_x, const float3 &v_y, const float2 &s) {
+inline CUDA_DECORATOR float3 sample_lambertian_dir(const float3 &n, const float3 &v_x, const float3 &v_y, const float2 &s) {
 	const float3 hemi_dir = normalize(cos_sample_hemisphere(s));
 	return hemi_dir.x * v_x + hemi_dir.y * v_y + hemi_dir.z * n;
 }
 
 // Sample the microfacet normal vectors for the various microfacet distributions
-__device__ float3 sample_gtr_1_h(const float3 &n, const float3 &v_x, const float3 &v_y, float alpha, const float2 &s) {
+inline CUDA_DECORATOR float3 sample_gtr_1_h(const float3 &n, const float3 &v_x, const float3 &v_y, float alpha, const float2 &s) {
 	float phi_h = 2.f * M_PI * s.x;
 	float alpha_sqr = alpha * alpha;
 	float cos_theta_h_sqr = (1.f - pow(alpha_sqr, 1.f - s.y)) / (1.f - alpha_sqr);
 	float cos_theta_h = sqrt(cos_theta_h_sqr);
-	float sin_theta_h = 1.f - cos_theta_h_sqr;
+	float sin_theta_h = sqrt(max(0.f, 1.f - cos_theta_h_sqr));
 	float3 hemi_dir = normalize(spherical_dir(sin_theta_h, cos_theta_h, phi_h));
 	return hemi_dir.x * v_x + hemi_dir.y * v_y + hemi_dir.z * n;
 }
 
-__device__ float3 sample_gtr_2_h(const float3 &n, const float3 &v_x, const float3 &v_y, float alpha, const float2 &s) {
+inline CUDA_DECORATOR float3 sample_gtr_2_h(const float3 &n, const float3 &v_x, const float3 &v_y, float alpha, const float2 &s) {
 	float phi_h = 2.f * M_PI * s.x;
 	float cos_theta_h_sqr = (1.f - s.y) / (1.f + (alpha * alpha - 1.f) * s.y);
 	float cos_theta_h = sqrt(cos_theta_h_sqr);
-	float sin_theta_h = 1.f - cos_theta_h_sqr;
+	float sin_theta_h = sqrt(max(0.f, 1.f - cos_theta_h_sqr));
 	float3 hemi_dir = normalize(spherical_dir(sin_theta_h, cos_theta_h, phi_h));
 	return hemi_dir.x * v_x + hemi_dir.y * v_y + hemi_dir.z * n;
 }
 
-__device__ float3 sample_gtr_2_aniso_h(const float3 &n, const float3 &v_x, const float3 &v_y, const float2 &alpha, const float2 &s) {
+inline CUDA_DECORATOR float3 sample_gtr_2_aniso_h(const float3 &n, const float3 &v_x, const float3 &v_y, const float2 &alpha, const float2 &s) {
 	float x = 2.f * M_PI * s.x;
 	float3 w_h = sqrt(s.y / (1.f - s.y)) * (alpha.x * cos(x) * v_x + alpha.y * sin(x) * v_y) + n;
 	return normalize(w_h);
 }
 
-__device__ float lambertian_pdf(const float3 &w_i, const float3 &n) {
+inline CUDA_DECORATOR float lambertian_pdf(const float3 &w_i, const float3 &n) {
 	float d = dot(w_i, n);
 	if (d > 0.f) {
 		return d * M_1_PI;
@@ -177,7 +176,7 @@ __device__ float lambertian_pdf(const float3 &w_i, const float3 &n) {
 	return 0.f;
 }
 
-__device__ float gtr_1_pdf(const float3 &w_o, const float3 &w_i, const float3 &w_h, const float3 &n, float alpha) {
+inline CUDA_DECORATOR float gtr_1_pdf(const float3 &w_o, const float3 &w_i, const float3 &w_h, const float3 &n, float alpha) {
 	if (!same_hemisphere(w_o, w_i, n)) {
 		return 0.f;
 	}
@@ -186,7 +185,7 @@ __device__ float gtr_1_pdf(const float3 &w_o, const float3 &w_i, const float3 &w
 	return d * cos_theta_h / (4.f * dot(w_o, w_h));
 }
 
-__device__ float gtr_2_pdf(const float3 &w_o, const float3 &w_i, const float3 &w_h, const float3 &n, float alpha) {
+inline CUDA_DECORATOR float gtr_2_pdf(const float3 &w_o, const float3 &w_i, const float3 &w_h, const float3 &n, float alpha) {
 	if (!same_hemisphere(w_o, w_i, n)) {
 		return 0.f;
 	}
@@ -195,7 +194,7 @@ __device__ float gtr_2_pdf(const float3 &w_o, const float3 &w_i, const float3 &w
 	return d * cos_theta_h / (4.f * fabs(dot(w_o, w_h)));
 }
 
-__device__ float gtr_2_transmission_pdf(const float3 &w_o, const float3 &w_i, const float3 &n, float transmission_roughness, float ior)
+inline CUDA_DECORATOR float gtr_2_transmission_pdf(const float3 &w_o, const float3 &w_i, const float3 &n, float transmission_roughness, float ior)
 {
 	float alpha = max(0.001f, transmission_roughness * transmission_roughness);
 
@@ -273,7 +272,7 @@ __device__ float gtr_2_transmission_pdf(const float3 &w_o, const float3 &w_i, co
 // 	return d * cos_theta_h * fabs(dwh_dwi);
 // }
 
-__device__ float gtr_2_aniso_pdf(const float3 &w_o, const float3 &w_i, const float3 &w_h, const float3 &n,
+inline CUDA_DECORATOR float gtr_2_aniso_pdf(const float3 &w_o, const float3 &w_i, const float3 &w_h, const float3 &n,
 	const float3 &v_x, const float3 &v_y, const float2 alpha)
 {
 	if (!same_hemisphere(w_o, w_i, n)) {
@@ -284,19 +283,19 @@ __device__ float gtr_2_aniso_pdf(const float3 &w_o, const float3 &w_i, const flo
 	return d * cos_theta_h / (4.f * dot(w_o, w_h));
 }
 
-__device__ float3 disney_diffuse_color(const DisneyMaterial &mat, const float3 &n,
+inline CUDA_DECORATOR float3 disney_diffuse_color(const DisneyMaterial &mat, const float3 &n,
 	const float3 &w_o, const float3 &w_i, const float3 &w_h)
 {
 	return mat.base_color;
 }
 
-__device__ float3 disney_subsurface_color(const DisneyMaterial &mat, const float3 &n,
+inline CUDA_DECORATOR float3 disney_subsurface_color(const DisneyMaterial &mat, const float3 &n,
 	const float3 &w_o, const float3 &w_i)
 {
 	return mat.subsurface_color;
 }
 
-__device__ void disney_diffuse(const DisneyMaterial &mat, const float3 &n,
+inline CUDA_DECORATOR void disney_diffuse(const DisneyMaterial &mat, const float3 &n,
 	const float3 &w_o, const float3 &w_i, const float3 &w_h, float3 &bsdf, float3 &color)
 {
 	float n_dot_o = fabs(dot(w_o, n));
@@ -309,7 +308,7 @@ __device__ void disney_diffuse(const DisneyMaterial &mat, const float3 &n,
 	bsdf = make_float3(M_1_PI * lerp(1.f, fd90, fi) * lerp(1.f, fd90, fo));
 }
 
-__device__ void disney_subsurface(const DisneyMaterial &mat, const float3 &n,
+inline CUDA_DECORATOR void disney_subsurface(const DisneyMaterial &mat, const float3 &n,
 	const float3 &w_o, const float3 &w_i, const float3 &w_h, float3 &bsdf, float3 &color) {
     float n_dot_o = fabs(dot(w_o, n));
 	float n_dot_i = fabs(dot(w_i, n));
@@ -324,7 +323,7 @@ __device__ void disney_subsurface(const DisneyMaterial &mat, const float3 &n,
 }
 
 // Eavg in the algorithm is fitted into this
-__device__ float AverageEnergy(float rough){
+inline CUDA_DECORATOR float AverageEnergy(float rough){
     float smoothness = 1.0 - rough;
     float r = -0.0761947 - 0.383026 * smoothness;
           r = 1.04997 + smoothness * r;
@@ -334,10 +333,12 @@ __device__ float AverageEnergy(float rough){
 
 // multiple scattering...
 // Favg in the algorithm is fitted into this
-__device__ float3 AverageFresnel(float3 specularColor){
+inline CUDA_DECORATOR float3 AverageFresnel(float3 specularColor){
     return specularColor + (make_float3(1.0) - specularColor) * (1.0 / 21.0);
 }
 
+// Reads the GGX energy lookup tables through textures, so is only available on the device
+#ifdef __CUDACC__
 __device__ float3 disney_multiscatter(const DisneyMaterial &mat, const float3 &n,
 	const float3 &w_o, const float3 &w_i, const float3 &w_h,
 	cudaTextureObject_t GGX_E_LOOKUP, cudaTextureObject_t GGX_E_AVG_LOOKUP)
@@ -368,6 +369,7 @@ __device__ float3 disney_multiscatter(const DisneyMaterial &mat, const float3 &n
 
     return brdf * energyScale;
 }
+#endif
 
 // __device__ float G(float3 i, float3 o, float3 h, float alpha)
 // {
@@ -407,7 +409,7 @@ __device__ float3 disney_multiscatter(const DisneyMaterial &mat, const float3 &n
 // 	return f;
 // }
 
-__device__ float3 disney_microfacet_reflection_color(const DisneyMaterial &mat, const float3 &n,
+inline CUDA_DECORATOR float3 disney_microfacet_reflection_color(const DisneyMaterial &mat, const float3 &n,
 	const float3 &w_o, const float3 &w_i, const float3 &w_h)
 {
 	float lum = luminance(mat.base_color);
@@ -420,7 +422,7 @@ __device__ float3 disney_microfacet_reflection_color(const DisneyMaterial &mat,
 	return f;
 }
 
-__device__ float3 disney_microfacet_isotropic(const DisneyMaterial &mat, const float3 &n,
+inline CUDA_DECORATOR float3 disney_microfacet_isotropic(const DisneyMaterial &mat, const float3 &n,
 	const float3 &w_o, const float3 &w_i, const float3 &w_h)
 {
 	float lum = luminance(mat.base_color);
@@ -436,7 +438,7 @@ __device__ float3 disney_microfacet_isotropic(const DisneyMaterial &mat, const f
 	return d * f * g;
 }
 
-__device__ float3 disney_microfacet_transmission_color(const DisneyMaterial &mat, const float3 &n,
+inline CUDA_DECORATOR float3 disney_microfacet_transmission_color(const DisneyMaterial &mat, const float3 &n,
 	const float3 &w_o, const float3 &w_i, const float3 &w_h)
 {	
 	// Approximate absorption
@@ -444,7 +446,7 @@ __device__ float3 disney_microfacet_transmission_color(const DisneyMaterial &mat
 	return mat.base_color;
 }
 
-__device__ void disney_microfacet_transmission_isotropic(const DisneyMaterial &mat, const float3 &n,
+inline CUDA_DECORATOR void disney_microfacet_transmission_isotropic(const DisneyMaterial &mat, const float3 &n,
 	const float3 &w_o, const float3 &w_i, float &bsdf, float3 &color)
 {	
 
@@ -505,7 +507,7 @@ __device__ void disney_microfacet_transmission_isotropic(const DisneyMaterial &m
 	// return mat.base_color * d;// * f * g; //abs( pow(dot(w_ht, n), (1.0f / (alpha + EPSILON))) ); //* c;//g; //c * (1.f - f) * g * d;
 }
 
-__device__ float3 disney_microfacet_anisotropic(const DisneyMaterial &mat, const float3 &n,
+inline CUDA_DECORATOR float3 disney_microfacet_anisotropic(const DisneyMaterial &mat, const float3 &n,
 	const float3 &w_o, const float3 &w_i, const float3 &w_h, const float3 &v_x, const float3 &v_y)
 {
 	float lum = luminance(mat.base_color);
@@ -524,23 +526,24 @@ __device__ float3 disney_microfacet_anisotropic(const DisneyMaterial &mat, const
 	return d * f * g;
 }
 
-__device__ float disney_clear_coat(const DisneyMaterial &mat, const float3 &n,
+inline CUDA_DECORATOR float disney_clear_coat(const DisneyMaterial &mat, const float3 &n,
 	const float3 &w_o, const float3 &w_i, const float3 &w_h)
 {
 	float alpha = lerp(0.1f, MIN_ALPHA, mat.clearcoat_gloss);
 	float d = gtr_1(fabs(dot(n, w_h)), alpha);
-	float f = lerp(0.04f, 1.f, schlick_weight(dot(w_i, n)));
+	// Fresnel from the half vector, as in Burley's reference, keeps the coat reciprocal
+	float f = lerp(0.04f, 1.f, schlick_weight(fabs(dot(w_i, w_h))));
 	float g = smith_shadowing_ggx(fabs(dot(n, w_i)), 0.25f) * smith_shadowing_ggx(fabs(dot(n, w_o)), 0.25f);
 	return /*0.25f * */mat.clearcoat * d * f * g;
 }
 
-__device__ float3 disney_sheen(const DisneyMaterial &mat, const float3 &n,
+inline CUDA_DECORATOR float3 disney_sheen(const DisneyMaterial &mat, const float3 &n,
 	const float3 &w_o, const float3 &w_i, const float3 &w_h)
 {
 	float lum = luminance(mat.base_color);
 	float3 tint = lum > 0.f ? mat.base_color / lum : make_float3(1.f);
 	float3 sheen_color = lerp(make_float3(1.f), tint, mat.sheen_tint);
-	float f = schlick_weight(dot(w_i, n));
+	float f = schlick_weight(fabs(dot(w_i, w_h)));
 	return f * mat.sheen * sheen_color;
 }
 
@@ -557,7 +560,7 @@ __device__ float3 disney_sheen(const DisneyMaterial &mat, const float3 &n,
  * @param w_h The halfway vector between the incoming and outgoing vectors
  * @param pdf The returned probability of this sample
  */
-__device__ void disney_brdf(
+inline CUDA_DECORATOR void disney_brdf(
 	const DisneyMaterial &mat, 
 	const float3 &g_n,
 	const float3 &s_n,
@@ -617,7 +620,7 @@ __device__ void disney_brdf(
  * @param w_h The halfway vector between the incoming and outgoing vectors
  * @param pdf The returned probability of this sample
  */
-__device__ void disney_pdf(
+inline CUDA_DECORATOR void disney_pdf(
 	const DisneyMaterial &mat, 
 	const float3 &g_n,
 	const float3 &s_n,
@@ -674,7 +677,8 @@ __device__ void disney_pdf(
 /* 
  * Sample a component of the Disney BRDF
  * @param mat The structure containing material information.
- * @param rng The random number generator
+ * @param lobe_sample A uniform random number in [0, 1) used to pick the lobe to sample
+ * @param direction_sample Two uniform random numbers in [0, 1) used to sample a direction from the lobe
  * @param g_n The geometric normal (cross product of the two triangle edges)
  * @param s_n The shading normal (per-vertex interpolated normal)
  * @param b_n The bent normal (see A.3 here https://arxiv.org/abs/1705.01263)
@@ -687,9 +691,10 @@ __device__ void disney_pdf(
  * 	Can be either DISNEY_DIFFUSE_BRDF, DISNEY_GLOSSY_BRDF, DISNEY_CLEARCOAT_BRDF, DISNEY_TRANSMISSION_BRDF
  * @param bsdf The throughput of all brdfs in the sampled direction
  */
-__device__ void sample_disney_brdf(
+inline CUDA_DECORATOR void sample_disney_brdf(
 	const DisneyMaterial &mat,
-	LCGRand &rng,
+	float lobe_sample,
+	const float2 &direction_sample,
 	const float3 &g_n, const float3 &s_n, const float3 &b_n, 
 	const float3 &v_x, const float3 &v_y,
 	const float3 &w_o,
@@ -700,18 +705,18 @@ __device__ void sample_disney_brdf(
 ) {
 	// Randomly pick a brdf to sample
 	if (mat.specular_transmission == 0.f) {
-		sampled_bsdf = lcg_randomf(rng) * 3.f;
+		sampled_bsdf = lobe_sample * 3.f;
 		sampled_bsdf = glm::clamp(sampled_bsdf, 0, 2);
 	} else {
 		// If we're looking at the front face 
 		if (dot(w_o, b_n) > 0.f) {
-			sampled_bsdf = lcg_randomf(rng) * 4.f;
+			sampled_bsdf = lobe_sample * 4.f;
 			sampled_bsdf = glm::clamp(sampled_bsdf, 0, 3);
 		}
 		else sampled_bsdf = DISNEY_TRANSMISSION_BRDF; 
 	}
 
-	float2 samples = make_float2(lcg_randomf(rng), lcg_randomf(rng));
+	float2 samples = direction_sample;
 	if (sampled_bsdf == DISNEY_DIFFUSE_BRDF) {
 		w_i = sample_lambertian_dir(b_n, v_x, v_y, samples);
 	} else if (sampled_bsdf == DISNEY_GLOSSY_BRDF) {
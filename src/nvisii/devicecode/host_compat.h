@@ -0,0 +1,48 @@
+#pragma once
+
+// Lets the portable parts of the device code (float3.h, cuda_utils.h, disney_bsdf.h)
+// compile with a regular C++ compiler, so that they can be validated and benchmarked on the CPU.
+// Uses the CUDA vector types when the CUDA headers are available, and minimal stand-ins otherwise.
+
+#include <math.h>
+#include <cmath>
+#include <stdint.h>
+
+#if defined(__has_include)
+#if __has_include(<vector_types.h>) && __has_include(<vector_functions.h>)
+#define NVISII_HAS_CUDA_VECTOR_TYPES
+#endif
+#endif
+
+#ifdef NVISII_HAS_CUDA_VECTOR_TYPES
+#include <vector_types.h>
+#include <vector_functions.h>
+#else
+struct float2 { float x, y; };
+struct float3 { float x, y, z; };
+struct float4 { float x, y, z, w; };
+struct int3 { int x, y, z; };
+struct uint2 { unsigned int x, y; };
+
+inline float2 make_float2(float x, float y) { float2 v; v.x = x; v.y = y; return v; }
+inline float3 make_float3(float x, float y, float z) { float3 v; v.x = x; v.y = y; v.z = z; return v; }
+inline float4 make_float4(float x, float y, float z, float w) { float4 v; v.x = x; v.y = y; v.z = z; v.w = w; return v; }
+inline int3 make_int3(int x, int y, int z) { int3 v; v.x = x; v.y = y; v.z = z; return v; }
+inline uint2 make_uint2(unsigned int x, unsigned int y) { uint2 v; v.x = x; v.y = y; return v; }
+#endif
+
+#ifndef CUDART_NAN_F
+#define CUDART_NAN_F NAN
+#endif
+
+// CUDA provides non-template min and max overloads, which take precedence over the glm templates
+inline float min(float a, float b) { return fminf(a, b); }
+inline float max(float a, float b) { return fmaxf(a, b); }
+inline double min(double a, double b) { return fmin(a, b); }
+inline double max(double a, double b) { return fmax(a, b); }
+inline double min(double a, float b) { return fmin(a, double(b)); }
+inline double max(double a, float b) { return fmax(a, double(b)); }
+inline double min(float a, double b) { return fmin(double(a), b); }
+inline double max(float a, double b) { return fmax(double(a), b); }
+inline int min(int a, int b) { return (a < b) ? a : b; }
+inline int max(int a, int b) { return (a > b) ? a : b; }
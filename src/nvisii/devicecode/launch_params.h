@@ -15,8 +15,13 @@
 #include <nvisii/light_struct.h>
 #include <nvisii/texture_struct.h>
 #include <nvisii/volume_struct.h>
+#include <nvisii/utilities/alias_table.h>
+#include <nvisii/utilities/light_tree.h>
+#include <nvisii/utilities/sampler.h>
+#include <nvisii/utilities/adaptive_sampling.h>
 
 #include "./buffer.h"
+#include "./render_data_flags.h"
 
 struct LaunchParams {
     glm::ivec2 frameSize;
@@ -27,6 +32,10 @@ struct LaunchParams {
     glm::vec4 *scratchBuffer;
     glm::vec4 *mvecBuffer;
     glm::vec4 *accumPtr;
+    glm::vec4 *halfBuffer;
+    uint8_t *adaptiveTileMask;
+    uint32_t adaptiveTileSize = 0;
+    bool writeTemporalGuides = false;
     OptixTraversableHandle surfacesIAS;
     OptixTraversableHandle volumesIAS;
     float domeLightIntensity = 1.f;
@@ -58,7 +67,13 @@ struct LaunchParams {
     Buffer<TextureStruct> textures;
     Buffer<VolumeStruct> volumes;
     Buffer<uint32_t> lightEntities;
+    Buffer<AliasTableEntry> lightSelectionTable;
+    Buffer<AliasTableEntry> triangleSelectionTables;
+    Buffer<uint32_t> triangleSelectionOffsets;
+    Buffer<LightTreeNode> lightTree;
+    uint32_t numLightTreeNodes = 0;
     Buffer<uint32_t> surfaceInstanceToEntity;
+    Buffer<int32_t> surfaceInstanceToMaterial;
     Buffer<uint32_t> volumeInstanceToEntity;
     uint32_t         numLightEntities = 0;
 
@@ -67,11 +82,13 @@ struct LaunchParams {
     Buffer<Buffer<float4>> tangentLists;
     Buffer<Buffer<float2>> texCoordLists;
     Buffer<Buffer<int3>> indexLists;
+    /* Point clouds only: each point as its center followed by its radius, and optional per point colors */
+    Buffer<Buffer<float4>> pointLists;
+    Buffer<Buffer<float4>> pointColorLists;
 
     int32_t environmentMapID = -1;
     glm::quat environmentMapRotation = glm::quat(1,0,0,0);
-    float* environmentMapRows = nullptr;
-    float* environmentMapCols = nullptr;
+    AliasTableEntry* environmentMapAlias = nullptr;
     int environmentMapWidth = 0;
     int environmentMapHeight = 0;
     cudaTextureObject_t proceduralSkyTexture = 0;
@@ -89,29 +106,8 @@ struct LaunchParams {
     glm::vec3 sceneBBMax = glm::vec3(0.f);
 
     bool enableDomeSampling = true;
-};
-
-enum RenderDataFlags : uint32_t { 
-  NONE = 0, 
-  DEPTH = 1, 
-  POSITION = 2,
-  NORMAL = 3,
-  ENTITY_ID = 4,
-  SCREEN_SPACE_NORMAL = 5,
-  DIFFUSE_MOTION_VECTORS = 7,
-  BASE_COLOR = 8,
-  DIFFUSE_COLOR = 9,
-  DIFFUSE_DIRECT_LIGHTING = 10,
-  DIFFUSE_INDIRECT_LIGHTING = 11,
-  GLOSSY_COLOR = 12,
-  GLOSSY_DIRECT_LIGHTING = 13,
-  GLOSSY_INDIRECT_LIGHTING = 14,
-  TRANSMISSION_COLOR = 15,
-  TRANSMISSION_DIRECT_LIGHTING = 16,
-  TRANSMISSION_INDIRECT_LIGHTING = 17,
-  RAY_DIRECTION = 18,
-  HEATMAP = 19,
-  TEXTURE_COORDINATES = 20
+    bool enableLightTree = true;
+    uint32_t samplerType = SAMPLER_SOBOL;
 };
 
 #define MAX_LIGHT_SAMPLES 10
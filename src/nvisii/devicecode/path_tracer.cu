@@ -6,6 +6,7 @@
 #include "types.h"
 #include "path_tracer.h"
 #include "disney_bsdf.h"
+#include "lcg_rng.h"
 #include "lights.h"
 #include "math.h"
 #include <optix_device.h>
@@ -13,6 +14,11 @@
 #include <owl/common/math/box.h>
 
 #include "nvisii/utilities/procedural_sky.h"
+#include "nvisii/utilities/dome_importance.h"
+#include "nvisii/utilities/light_sampling.h"
+#include "nvisii/utilities/light_tree.h"
+#include "nvisii/utilities/sampler.h"
+#include "nvisii/utilities/point_cloud.h"
 
 #include <glm/gtx/matrix_interpolation.hpp>
 
@@ -20,6 +26,42 @@ typedef owl::common::LCG<4> Random;
 
 extern "C" __constant__ LaunchParams optixLaunchParams;
 
+// The sampler dimensions used by each random decision along a path. 
+// Camera decisions come first, followed by a fixed range of dimensions per bounce.
+// Dimensions are grouped in fours, so that the Sobol sampler stratifies related decisions jointly.
+enum SampleDimension : uint32_t {
+    DIM_PIXEL = 0,
+    DIM_LENS = 2,
+    DIM_TIME = 4,
+    DIM_CAMERA_COUNT = 8,
+
+    DIM_LIGHT_SELECTION = 0,
+    DIM_LIGHT_TRIANGLE = 1,
+    DIM_LIGHT_POSITION = 2,
+    DIM_BSDF_LOBE = 4,
+    DIM_BSDF_DIRECTION = 5,
+    DIM_RUSSIAN_ROULETTE = 7,
+    DIM_ALPHA = 8,
+    DIM_VOLUME_SCATTER = 9,
+    DIM_BOUNCE_TIME = 10,
+    DIM_BOUNCE_COUNT = 12
+};
+
+inline __device__
+uint32_t bounceDimension(uint32_t depth, uint32_t offset) {
+    return DIM_CAMERA_COUNT + depth * DIM_BOUNCE_COUNT + offset;
+}
+
+// The volume programs take a copy of the payload's LCG for delta tracking, and do not hand it back.
+// Each volume trace is seeded from the path's generator and a running count of volume traces instead,
+// so that no two traces along a path draw the same free flight distances.
+inline __device__
+LCGRand volumeTraceRng(const LCGRand &rng, uint32_t &volumeTraces) {
+    LCGRand traceRng;
+    traceRng.state = murmur_hash3_finalize(murmur_hash3_mix(rng.state, volumeTraces++));
+    return traceRng;
+}
+
 struct RayPayload {
     int instanceID = -1;
     int primitiveID = -1;
@@ -117,9 +159,33 @@ OPTIX_MISS_PROGRAM(miss)()
 {
 }
 
-OPTIX_CLOSEST_HIT_PROGRAM(TriangleMesh)()
+/* Records the transform of the hit instance, along with its transforms at the start and end of the frame if needed */
+inline __device__
+void loadHitTransforms(RayPayload &prd)
 {
     auto &LP = optixLaunchParams;
+    optixGetObjectToWorldTransformMatrix(prd.localToWorld);
+    
+    // If we don't need motion vectors, (or in the future if an object 
+    // doesn't have motion blur) then return.
+    if (LP.renderDataMode == RenderDataFlags::NONE) return;
+   
+    OptixTraversableHandle handle = optixGetTransformListHandle(prd.instanceID);
+    float4 trf00, trf01, trf02;
+    float4 trf10, trf11, trf12;
+    
+    optix_impl::optixGetInterpolatedTransformationFromHandle( trf00, trf01, trf02, handle, /* time */ 0.f, true );
+    optix_impl::optixGetInterpolatedTransformationFromHandle( trf10, trf11, trf12, handle, /* time */ 1.f, true );
+    memcpy(&prd.localToWorldT0[0], &trf00, sizeof(trf00));
+    memcpy(&prd.localToWorldT0[4], &trf01, sizeof(trf01));
+    memcpy(&prd.localToWorldT0[8], &trf02, sizeof(trf02));
+    memcpy(&prd.localToWorldT1[0], &trf10, sizeof(trf10));
+    memcpy(&prd.localToWorldT1[4], &trf11, sizeof(trf11));
+    memcpy(&prd.localToWorldT1[8], &trf12, sizeof(trf12));
+}
+
+OPTIX_CLOSEST_HIT_PROGRAM(TriangleMesh)()
+{
     RayPayload &prd = owl::getPRD<RayPayload>();
     prd.instanceID = optixGetInstanceIndex();
     prd.tHit = optixGetRayTmax();
@@ -140,24 +206,19 @@ OPTIX_CLOSEST_HIT_PROGRAM(TriangleMesh)()
     // const float4* transform = (const float4*)( &transformData->transform[key][0] );
     // const float4* transform = (const float4*)( &transformData->transform[key][0] );
     
-    optixGetObjectToWorldTransformMatrix(prd.localToWorld);
-    
-    // If we don't need motion vectors, (or in the future if an object 
-    // doesn't have motion blur) then return.
-    if (LP.renderDataMode == RenderDataFlags::NONE) return;
-   
-    OptixTraversableHandle handle = optixGetTransformListHandle(prd.instanceID);
-    float4 trf00, trf01, trf02;
-    float4 trf10, trf11, trf12;
-    
-    optix_impl::optixGetInterpolatedTransformationFromHandle( trf00, trf01, trf02, handle, /* time */ 0.f, true );
-    optix_impl::optixGetInterpolatedTransformationFromHandle( trf10, trf11, trf12, handle, /* time */ 1.f, true );
-    memcpy(&prd.localToWorldT0[0], &trf00, sizeof(trf00));
-    memcpy(&prd.localToWorldT0[4], &trf01, sizeof(trf01));
-    memcpy(&prd.localToWorldT0[8], &trf02, sizeof(trf02));
-    memcpy(&prd.localToWorldT1[0], &trf10, sizeof(trf10));
-    memcpy(&prd.localToWorldT1[4], &trf11, sizeof(trf11));
-    memcpy(&prd.localToWorldT1[8], &trf12, sizeof(trf12));
+    loadHitTransforms(prd);
+}
+
+OPTIX_CLOSEST_HIT_PROGRAM(PointCloud)()
+{
+    RayPayload &prd = owl::getPRD<RayPayload>();
+    prd.instanceID = optixGetInstanceIndex();
+    prd.tHit = optixGetRayTmax();
+    prd.barycentrics = make_float2(0.f, 0.f);
+    prd.primitiveID = optixGetPrimitiveIndex();
+    // Spheres have no vertices to interpolate, so keep the object space hit for the ray generation program
+    prd.mp = optixGetObjectRayOrigin() + prd.tHit * optixGetObjectRayDirection();
+    loadHitTransforms(prd);
 }
 
 OPTIX_CLOSEST_HIT_PROGRAM(ShadowRay)()
@@ -501,6 +562,33 @@ OPTIX_INTERSECT_PROGRAM(VolumeIntersection)()
     }
 }
 
+OPTIX_INTERSECT_PROGRAM(PointIntersection)()
+{
+    const auto &self = owl::getProgramData<PointsGeomData>();
+    const float4 point = self.points[optixGetPrimitiveIndex()];
+    float t;
+    if (intersectSphere(make_vec3(optixGetObjectRayOrigin()), make_vec3(optixGetObjectRayDirection()),
+        vec3(point.x, point.y, point.z), point.w, optixGetRayTmin(), optixGetRayTmax(), t)) {
+        optixReportIntersection(t, /* hit kind */ 0);
+    }
+}
+
+OPTIX_BOUNDS_PROGRAM(PointBounds)(
+    const void  *geomData,
+    owl::common::box3f &primBounds,
+    const int    primID)
+{
+    const PointsGeomData &self = *(const PointsGeomData*)geomData;
+    const float4 point = self.points[primID];
+    primBounds = owl::common::box3f();
+    primBounds.lower.x = point.x - point.w;
+    primBounds.lower.y = point.y - point.w;
+    primBounds.lower.z = point.z - point.w;
+    primBounds.upper.x = point.x + point.w;
+    primBounds.upper.y = point.y + point.w;
+    primBounds.upper.z = point.z + point.w;
+}
+
 OPTIX_BOUNDS_PROGRAM(VolumeBounds)(
     const void  *geomData,
     owl::common::box3f &primBounds,
@@ -610,6 +698,25 @@ void loadMeshTangentData(int meshID, int numTangents, int3 indices, float2 baryc
     tangent = make_float3(A) * (1.f - (barycentrics.x + barycentrics.y)) + make_float3(B) * barycentrics.x + make_float3(C) * barycentrics.y;
 }
 
+__device__
+void loadPointData(int meshID, int primitiveID, float4 &point)
+{
+    auto &LP = optixLaunchParams;
+    GET(Buffer<float4> points, Buffer<float4>, LP.pointLists, meshID);
+    GET(point, float4, points, primitiveID);
+}
+
+/* @returns false if the point cloud has no colors */
+__device__
+bool loadPointColor(int meshID, int primitiveID, float4 &color)
+{
+    auto &LP = optixLaunchParams;
+    GET(Buffer<float4> colors, Buffer<float4>, LP.pointColorLists, meshID);
+    if (colors.data == nullptr) return false;
+    GET(color, float4, colors, primitiveID);
+    return true;
+}
+
 __device__ 
 void loadDisneyMaterial(const MaterialStruct &p, float2 uv, DisneyMaterial &mat, float roughnessMinimum) {
     mat.base_color = sampleTexture(p.base_color_texture_id, uv, make_float3(.8f, .8f, .8f));
@@ -644,7 +751,7 @@ float sampleTime(float xi) {
 }
 
 inline __device__
-owl::Ray generateRay(const CameraStruct &camera, const TransformStruct &transform, ivec2 pixelID, ivec2 frameSize, LCGRand &rng, float time)
+owl::Ray generateRay(const CameraStruct &camera, const TransformStruct &transform, ivec2 pixelID, ivec2 frameSize, const SamplerState &sampler, float time)
 {
     auto &LP = optixLaunchParams;
     /* Generate camera rays */    
@@ -663,7 +770,7 @@ owl::Ray generateRay(const CameraStruct &camera, const TransformStruct &transfor
     vec2 aa =  vec2(LP.xPixelSamplingInterval[0], LP.yPixelSamplingInterval[0])
             + (vec2(LP.xPixelSamplingInterval[1], LP.yPixelSamplingInterval[1]) 
             -  vec2(LP.xPixelSamplingInterval[0], LP.yPixelSamplingInterval[0])
-            ) * vec2(lcg_randomf(rng),lcg_randomf(rng));
+            ) * samplerGet2D(sampler, DIM_PIXEL);
 
     vec2 inUV = (vec2(pixelID.x, pixelID.y) + aa) / vec2(frameSize);
     vec3 right = normalize(glm::column(viewinv, 0));
@@ -674,9 +781,14 @@ owl::Ray generateRay(const CameraStruct &camera, const TransformStruct &transfor
 
     vec3 p(0.f);
     if (cameraLensRadius > 0.0) {
-        do {
-            p = 2.0f*vec3(lcg_randomf(rng),lcg_randomf(rng),0.f) - vec3(1.f,1.f,0.f);
-        } while (dot(p,p) >= 1.0f);
+        // Uniformly sample the lens using a concentric mapping, which preserves stratification
+        vec2 u = samplerGet2D(sampler, DIM_LENS) * 2.f - 1.f;
+        if (u.x != 0.f || u.y != 0.f) {
+            float r, theta;
+            if (fabs(u.x) > fabs(u.y)) { r = u.x; theta = float(M_PI / 4.0) * (u.y / u.x); }
+            else { r = u.y; theta = float(M_PI / 2.0) - float(M_PI / 4.0) * (u.x / u.y); }
+            p = vec3(r * cos(theta), r * sin(theta), 0.f);
+        }
     }
 
     vec3 rd = cameraLensRadius * p;
@@ -903,14 +1015,24 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
         return;
     }
 
+    /* with adaptive sampling, pixels stop taking samples once their tile converges */
+    if (LP.adaptiveTileSize > 0) {
+        uint32_t tile = adaptiveTileIndex(pixelID.x, pixelID.y, LP.frameSize.x, LP.adaptiveTileSize);
+        if (LP.adaptiveTileMask[tile] != ADAPTIVE_TILE_ACTIVE) return;
+    }
+
     auto dims = ivec2(LP.frameSize.x, LP.frameSize.x);
     uint64_t start_clock = clock();
     int numLights = LP.numLightEntities;
     int numLightSamples = LP.numLightSamples;
     bool enableDomeSampling = LP.enableDomeSampling;
     
+    // Path decisions are drawn from the low discrepancy sampler, where each frame is one sample per pixel.
+    // Delta tracking through volumes takes an unbounded number of random numbers, so uses the LCG instead.
+    SamplerState sampler = samplerInit(LP.samplerType, pixelID.x, pixelID.y, uint32_t(LP.frameID), LP.seed);
     LCGRand rng = get_rng(LP.frameID + LP.seed * 10007, make_uint2(pixelID.x, pixelID.y), make_uint2(dims.x, dims.y));
-    float time = sampleTime(lcg_randomf(rng));
+    uint32_t volumeTraces = 0;
+    float time = sampleTime(samplerGet1D(sampler, DIM_TIME));
 
     // If no camera is in use, just display some random noise...
     owl::Ray surfRay;
@@ -924,7 +1046,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
     }
     
     // Trace an initial ray through the scene
-    surfRay = generateRay(camera, camera_transform, pixelID, LP.frameSize, rng, time);
+    surfRay = generateRay(camera, camera_transform, pixelID, LP.frameSize, sampler, time);
     surfRay.tmax = tmax;
 
     float3 accum_illum = make_float3(0.f);
@@ -932,6 +1054,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
     float3 renderData = make_float3(0.f);
     float3 primaryAlbedo = make_float3(0.f);
     float3 primaryNormal = make_float3(0.f);
+    float4 primaryGuide = make_float4(0.f, 0.f, 0.f, -1.f);
     initializeRenderData(renderData);
 
     uint8_t depth = 0;
@@ -957,7 +1080,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
     volRay.tmax = (surfPayload.tHit == -1.f) ? volRay.tmax : surfPayload.tHit;
     RayPayload volPayload;
     volPayload.tHit = -1.f;
-    volPayload.rng = rng;
+    volPayload.rng = volumeTraceRng(rng, volumeTraces);
     volPayload.t0 = volRay.tmin;
     volPayload.t1 = volRay.tmax;
     volPayload.primitiveID = (debug) ? -2 : -1;
@@ -994,6 +1117,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             float3 pt1 = make_float3(tmp2 / tmp2.w) * .5f;
             mvec = pt1 - pt0;
             saveMissRenderData(renderData, depth, mvec);
+            if (depth == 0) primaryGuide = make_float4(mvec.x, mvec.y, 0.f, -1.f);
             break;
         }
 
@@ -1005,6 +1129,12 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
         else { GET(entityID, int, LP.surfaceInstanceToEntity, surfPayload.instanceID); }
 
         GET(EntityStruct entity, EntityStruct, LP.entities, entityID);
+
+        // Instances of an entity can override its material
+        if (!isVolume) {
+            GET(int instanceMaterialID, int, LP.surfaceInstanceToMaterial, surfPayload.instanceID);
+            if (instanceMaterialID >= 0) entity.material_id = instanceMaterialID;
+        }
         GET(TransformStruct transform, TransformStruct, LP.transforms, entity.transform_id);
         MeshStruct mesh;  
         VolumeStruct volume;  
@@ -1021,7 +1151,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             volRay = surfRay;
             volRay.tmax = (surfPayload.tHit == -1.f) ? volRay.tmax : surfPayload.tHit;
             volPayload.tHit = -1.f;
-            volPayload.rng = rng;
+            volPayload.rng = volumeTraceRng(rng, volumeTraces);
             volPayload.t0 = volRay.tmin;
             volPayload.t1 = volRay.tmax;
             volPayload.primitiveID = (debug) ? -3 : -1;
@@ -1048,6 +1178,16 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             mp = volPayload.mp;
             uv = make_float2(volPayload.density, length(volPayload.gradient));
         }
+        else if (mesh.numPoints > 0) {
+            float4 point;
+            loadPointData(entity.mesh_id, surfPayload.primitiveID, point);
+            float3 center = make_float3(point.x, point.y, point.z);
+            v_z = v_gz = normalize(surfPayload.mp - center);
+            // Snap the hit onto the sphere, so that rays leaving it start from its surface
+            mp = center + v_z * point.w;
+            uv = make_float2(sphereUV(make_vec3(v_z)));
+            v_x = make_float3(sphereTangent(make_vec3(v_z)));
+        }
         else {
             int3 indices;
             loadMeshTriIndices(entity.mesh_id, mesh.numTris, surfPayload.primitiveID, indices);
@@ -1063,6 +1203,13 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             GET(entityMaterial, MaterialStruct, LP.materials, entity.material_id);
             loadDisneyMaterial(entityMaterial, uv, mat, MIN_ROUGHNESS);
         }
+
+        // Point colors replace the base color of the material, and scale its alpha
+        float4 pointColor;
+        if ((volPayload.tHit < 0.f) && (mesh.numPoints > 0) && loadPointColor(entity.mesh_id, surfPayload.primitiveID, pointColor)) {
+            mat.base_color = make_float3(pointColor.x, pointColor.y, pointColor.z);
+            mat.alpha *= pointColor.w;
+        }
       
         // Transform geometry data into world space
         {
@@ -1076,7 +1223,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             v_y = cross(v_z, v_x);
             v_x = cross(v_y, v_z);
 
-            if (LP.renderDataMode != RenderDataFlags::NONE) {
+            if ((LP.renderDataMode != RenderDataFlags::NONE) || LP.writeTemporalGuides) {
                 glm::mat4 xfmt0 = to_mat4((volPayload.tHit >= 0.f) ? volPayload.localToWorldT0 : surfPayload.localToWorldT0);
                 glm::mat4 xfmt1 = to_mat4((volPayload.tHit >= 0.f) ? volPayload.localToWorldT1 : surfPayload.localToWorldT1);
                 vec4 tmp1 = LP.proj * LP.viewT0 * xfmt0 * make_vec4(mp, 1.0f);
@@ -1161,11 +1308,13 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
         if (depth == 0) {
             primaryAlbedo = mat.base_color;
             primaryNormal = v_z;
+            float tHit = (volPayload.tHit >= 0.f) ? volPayload.tHit : surfPayload.tHit;
+            primaryGuide = make_float4(diffuseMotion.x, diffuseMotion.y, tHit, float(entityID));
         }
 
         // Potentially skip forward if the hit object is transparent 
         if ((entity.light_id == -1) && (mat.alpha < 1.f)) {
-            float alpha_rnd = lcg_randomf(rng);
+            float alpha_rnd = samplerGet1D(sampler, bounceDimension(depth, DIM_ALPHA));
 
             if (alpha_rnd > mat.alpha) {
                 surfRay.origin = surfRay.origin + surfRay.direction * (surfPayload.tHit + EPSILON);
@@ -1176,7 +1325,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
                 volRay = surfRay;
                 volRay.tmax = (surfPayload.tHit == -1.f) ? volRay.tmax : surfPayload.tHit;
                 volPayload.tHit = -1.f;
-                volPayload.rng = rng;
+                volPayload.rng = volumeTraceRng(rng, volumeTraces);
                 volPayload.t0 = volRay.tmin;
                 volPayload.t1 = volRay.tmax;
                 volPayload.primitiveID = (debug) ? -4 : -1;
@@ -1220,7 +1369,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             float grad_len = uv.y;
             float p_brdf = opacity * (1.f - exp(-25.f * pow(volume.gradient_factor, 3.f) * grad_len));
             float pdf;
-            float rand_brdf = lcg_randomf(rng);
+            float rand_brdf = samplerGet1D(sampler, bounceDimension(depth, DIM_VOLUME_SCATTER));
             
             if (rand_brdf < p_brdf) {
                 useBRDF = true;
@@ -1235,15 +1384,19 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
         int sampledBsdf = -1;
         float3 bsdf;
         if (useBRDF) {
+            float lobeSample = samplerGet1D(sampler, bounceDimension(depth, DIM_BSDF_LOBE));
+            vec2 directionSample = samplerGet2D(sampler, bounceDimension(depth, DIM_BSDF_DIRECTION));
             sample_disney_brdf(
-                mat, rng, v_gz, v_z, v_bz, v_x, v_y, w_o, // inputs
-                w_i, bsdfPDF, sampledBsdf, bsdf);         // outputs
+                mat, lobeSample, make_float2(directionSample.x, directionSample.y), // inputs
+                v_gz, v_z, v_bz, v_x, v_y, w_o,
+                w_i, bsdfPDF, sampledBsdf, bsdf);                                  // outputs
         } else {
             /* a scatter event occurred */
             if (volPayload.eventID == 2) {
                 // currently isotropic. Todo: implement henyey greenstien...
-                float rand1 = lcg_randomf(rng);
-                float rand2 = lcg_randomf(rng);
+                vec2 directionSample = samplerGet2D(sampler, bounceDimension(depth, DIM_BSDF_DIRECTION));
+                float rand1 = directionSample.x;
+                float rand2 = directionSample.y;
 
                 // Sample isotropic phase function to get new ray direction           
                 float phi = 2.0f * M_PI * rand1;
@@ -1277,7 +1430,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             volRay = surfRay;
             volRay.tmax = (surfPayload.tHit == -1.f) ? volRay.tmax : surfPayload.tHit;
             volPayload.tHit = -1.f;
-            volPayload.rng = rng;
+            volPayload.rng = volumeTraceRng(rng, volumeTraces);
             volPayload.t0 = volRay.tmin;
             volPayload.t1 = volRay.tmax;
             volPayload.primitiveID = (debug) ? -4 : -1;
@@ -1292,42 +1445,48 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
         // Next, sample the light source by importance sampling the light
         const uint32_t occlusion_flags = OPTIX_RAY_FLAG_DISABLE_ANYHIT | OPTIX_RAY_FLAG_TERMINATE_ON_FIRST_HIT;
         
-        uint32_t randmax = (enableDomeSampling) ? numLights + 1 : numLights;
-        uint32_t randomID = uint32_t(min(lcg_randomf(rng) * randmax, float(randmax-1)));
+        // Pick a light, keeping the dome's share of uniform selection. With the light tree, lights are 
+        // picked by their estimated contribution to this point. Otherwise, in proportion to their power.
+        float lightSelectionPDF = 0.f;
+        float triangleSelectionPDF = 1.f;
+        uint32_t randomID;
+        if (LP.enableLightTree && LP.numLightTreeNodes > 0) {
+            glm::vec3 receiverNormal = (isVolume) ? glm::vec3(0.f) : make_vec3(v_z);
+            randomID = selectLightFromTree((LightTreeNode*)LP.lightTree.data, LP.numLightTreeNodes, numLights,
+                enableDomeSampling, make_vec3(hit_p), receiverNormal, 
+                samplerGet1D(sampler, bounceDimension(depth, DIM_LIGHT_SELECTION)), lightSelectionPDF);
+        } else {
+            randomID = selectLight((AliasTableEntry*)LP.lightSelectionTable.data, numLights, 
+                enableDomeSampling, samplerGet1D(sampler, bounceDimension(depth, DIM_LIGHT_SELECTION)), lightSelectionPDF);
+        }
         float dotNWi  = 0.f;
         float3 l_bsdf = make_float3(0.f);
         float3 lightEmission = make_float3(0.f);
         float3 lightDir = make_float3(0.f);
         float lightDistance = 1e20f;
         float falloff = 2.0f;
-        int numTris = 0;
 
         // sample background
         if (randomID == numLights) {
             sampledLightID = -1;
             if (
                 (LP.environmentMapWidth != 0) && (LP.environmentMapHeight != 0) &&
-                (LP.environmentMapRows != nullptr) && (LP.environmentMapCols != nullptr) 
+                (LP.environmentMapAlias != nullptr)
             ) 
             {
-                // Reduces noise for strangely noisy dome light textures, but at the expense 
-                // of a highly uncoalesced binary search through a 2D CDF.
-                // disabled by default to avoid the hit to performance
-                float rx = lcg_randomf(rng);
-                float ry = lcg_randomf(rng);
-                float* rows = LP.environmentMapRows;
-                float* cols = LP.environmentMapCols;
+                // Reduces noise for strangely noisy dome light textures by importance sampling 
+                // a solid angle weighted luminance map. Texels are picked in constant time 
+                // through an alias table, then jittered uniformly within their footprint.
                 int width = LP.environmentMapWidth;
                 int height = LP.environmentMapHeight;
-                float invjacobian = width * height / float(4 * M_PI);
-                float row_pdf, col_pdf;
-                unsigned x, y;
-                ry = sample_cdf(rows, height, ry, &y, &row_pdf);
-                y = max(min(y, height - 1), 0);
-                rx = sample_cdf(cols + y * width, width, rx, &x, &col_pdf);
-                lightDir = make_float3(toPolar(vec2((x /*+ rx*/) / float(width), (y/* + ry*/)/float(height))));
+                float texelPDF, rx;
+                vec2 texelSample = samplerGet2D(sampler, bounceDimension(depth, DIM_LIGHT_POSITION));
+                uint32_t texel = sampleAliasTable(LP.environmentMapAlias, width * height, texelSample.x, texelPDF, rx);
+                float ry = texelSample.y;
+                vec2 uv = vec2((texel % width + rx) / float(width), (texel / width + ry) / float(height));
+                lightDir = make_float3(toPolar(uv));
                 lightDir = glm::inverse(LP.environmentMapRotation) * lightDir;
-                lightPDF = row_pdf * col_pdf * invjacobian;
+                lightPDF = domeImportancePdf(texelPDF, uv.y, width, height);
             } 
             else 
             {            
@@ -1335,12 +1494,12 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
                 tbn = glm::column(tbn, 0, make_vec3(v_x) );
                 tbn = glm::column(tbn, 1, make_vec3(v_y) );
                 tbn = glm::column(tbn, 2, make_vec3(v_z) );            
-                const float3 hemi_dir = (cos_sample_hemisphere(make_float2(lcg_randomf(rng), lcg_randomf(rng))));
+                vec2 hemiSample = samplerGet2D(sampler, bounceDimension(depth, DIM_LIGHT_POSITION));
+                const float3 hemi_dir = (cos_sample_hemisphere(make_float2(hemiSample.x, hemiSample.y)));
                 lightDir = make_float3(tbn * make_vec3(hemi_dir));
                 lightPDF = 1.f / float(2.0 * M_PI);
             }
 
-            numTris = 1.f;
             lightEmission = (missColor(lightDir, envTex) * LP.domeLightIntensity * pow(2.f, LP.domeLightExposure));
         }
         // sample light sources
@@ -1352,7 +1511,10 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             GET( LightStruct light_light, LightStruct, LP.lights, light_entity.light_id );
             GET( TransformStruct transform, TransformStruct, LP.transforms, light_entity.transform_id );
             GET( MeshStruct mesh, MeshStruct, LP.meshes, light_entity.mesh_id );
-            uint32_t random_tri_id = uint32_t(min(lcg_randomf(rng) * mesh.numTris, float(mesh.numTris - 1)));
+            GET( uint32_t triangleOffset, uint32_t, LP.triangleSelectionOffsets, light_entity.mesh_id );
+            uint32_t random_tri_id = selectTriangle((AliasTableEntry*)LP.triangleSelectionTables.data + triangleOffset, 
+                mesh.numTris, light_light.use_surface_area, samplerGet1D(sampler, bounceDimension(depth, DIM_LIGHT_TRIANGLE)), 
+                triangleSelectionPDF);
             GET( Buffer<int3> indices, Buffer<int3>, LP.indexLists, light_entity.mesh_id );
             GET( Buffer<float3> vertices, Buffer<float3>, LP.vertexLists, light_entity.mesh_id );
             GET( Buffer<float4> normals, Buffer<float4>, LP.normalLists, light_entity.mesh_id );
@@ -1381,12 +1543,12 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             v1 = make_float3(ltw * make_float4(v1, 1.0f));
             v2 = make_float3(ltw * make_float4(v2, 1.0f));
             v3 = make_float3(ltw * make_float4(v3, 1.0f));
+            vec2 positionSample = samplerGet2D(sampler, bounceDimension(depth, DIM_LIGHT_POSITION));
             sampleTriangle(pos, n1, n2, n3, v1, v2, v3, uv1, uv2, uv3, 
-                lcg_randomf(rng), lcg_randomf(rng), dir, lightDistance, lightPDF, uv, 
+                positionSample.x, positionSample.y, dir, lightDistance, lightPDF, uv, 
                 /*double_sided*/ false, /*use surface area*/ light_light.use_surface_area);
             
             falloff = light_light.falloff;
-            numTris = mesh.numTris;
             lightDir = make_float3(dir.x, dir.y, dir.z);
             if (light_light.color_texture_id == -1) lightEmission = make_float3(light_light.r, light_light.g, light_light.b) * (light_light.intensity * pow(2.f, light_light.exposure));
             else lightEmission = sampleTexture(light_light.color_texture_id, uv, make_float3(0.f, 0.f, 0.f)) * (light_light.intensity * pow(2.f, light_light.exposure));
@@ -1407,7 +1569,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             l_bsdf = make_float3(1.f / (4.0 * M_PI)) * mat.base_color;
             dotNWi = 1.f; // no geom term for phase function
         }
-        lightPDF *= (1.f / float(numLights + 1.f)) * (1.f / float(numTris));
+        lightPDF *= lightSelectionPDF * triangleSelectionPDF;
         if ((lightPDF > 0.0) && (dotNWi > EPSILON)) {
             RayPayload surfPayload; surfPayload.instanceID = -2;
             RayPayload volPayload = surfPayload;
@@ -1417,7 +1579,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
             ray.time = time;
             owl::traceRay( LP.surfacesIAS, ray, surfPayload, occlusion_flags);
             ray.tmax = (surfPayload.instanceID == -2) ? ray.tmax : surfPayload.tHit;
-            volPayload.rng = rng;
+            volPayload.rng = volumeTraceRng(rng, volumeTraces);
             volPayload.t0 = volRay.tmin;
             volPayload.t1 = volRay.tmax;
             volPayload.primitiveID = (debug) ? -5 : -1;
@@ -1457,12 +1619,12 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
         surfRay.tmin = EPSILON;//* 100.f;
         surfPayload.instanceID = -1;
         surfPayload.tHit = -1.f;
-        surfRay.time = sampleTime(lcg_randomf(rng));
+        surfRay.time = sampleTime(samplerGet1D(sampler, bounceDimension(depth, DIM_BOUNCE_TIME)));
         owl::traceRay(LP.surfacesIAS, surfRay, surfPayload, OPTIX_RAY_FLAG_DISABLE_ANYHIT);
 
         volRay = surfRay;
         volRay.tmax = (surfPayload.tHit == -1.f) ? volRay.tmax : surfPayload.tHit;
-        volPayload.rng = rng;
+        volPayload.rng = volumeTraceRng(rng, volumeTraces);
         volPayload.t0 = volRay.tmin;
         volPayload.t1 = volRay.tmax;
         volPayload.primitiveID = (debug) ? -6 : -1;
@@ -1530,7 +1692,7 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
         // Russian Roulette
         // Randomly terminate a path with a probability inversely equal to the throughput
         float pmax = max(pathThroughput.x, max(pathThroughput.y, pathThroughput.z));
-        if (lcg_randomf(rng) > pmax) {
+        if (samplerGet1D(sampler, bounceDimension(depth, DIM_RUSSIAN_ROULETTE)) > pmax) {
             break;
         }
 
@@ -1635,4 +1797,18 @@ OPTIX_RAYGEN_PROGRAM(rayGen)()
     fbPtr[fbOfs] = accum_color;
     albedoPtr[fbOfs] = make_float4(accumAlbedo);
     normalPtr[fbOfs] = make_float4(accumNormal);    
+
+    // for adaptive sampling, also keep the mean of every other sample to estimate the remaining error
+    if ((LP.adaptiveTileSize > 0) && (LP.renderDataMode == RenderDataFlags::NONE) && ((LP.frameID % 2) == 0)) {
+        float4* halfPtr = (float4*) LP.halfBuffer;
+        float halfCount = float(LP.frameID / 2);
+        float4 prev_half = halfPtr[fbOfs];
+        halfPtr[fbOfs] = make_float4((accum_illum + halfCount * make_float3(prev_half)) / (halfCount + 1.f), 1.0f);
+    }
+
+    // the first sample describes the surface seen through this pixel, for temporal accumulation
+    if (LP.writeTemporalGuides && (LP.frameID == 0)) {
+        float4* guidePtr = (float4*) LP.mvecBuffer;
+        guidePtr[fbOfs] = primaryGuide;
+    }
 }
@@ -19,6 +19,12 @@ struct VolumeGeomData {
     uint32_t volumeID;
 };
 
+/* variables for the point cloud user geometry */
+struct PointsGeomData {
+    /* each point as its center followed by its radius */
+    float4 *points;
+};
+
 /* variables for the ray generation program */
 struct RayGenData
 {
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+enum RenderDataFlags : uint32_t { 
+  NONE = 0, 
+  DEPTH = 1, 
+  POSITION = 2,
+  NORMAL = 3,
+  ENTITY_ID = 4,
+  SCREEN_SPACE_NORMAL = 5,
+  DIFFUSE_MOTION_VECTORS = 7,
+  BASE_COLOR = 8,
+  DIFFUSE_COLOR = 9,
+  DIFFUSE_DIRECT_LIGHTING = 10,
+  DIFFUSE_INDIRECT_LIGHTING = 11,
+  GLOSSY_COLOR = 12,
+  GLOSSY_DIRECT_LIGHTING = 13,
+  GLOSSY_INDIRECT_LIGHTING = 14,
+  TRANSMISSION_COLOR = 15,
+  TRANSMISSION_DIRECT_LIGHTING = 16,
+  TRANSMISSION_INDIRECT_LIGHTING = 17,
+  RAY_DIRECTION = 18,
+  HEATMAP = 19,
+  TEXTURE_COORDINATES = 20
+};
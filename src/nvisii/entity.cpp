@@ -7,10 +7,16 @@
 #include <nvisii/volume.h>
 #include <nvisii/nvisii.h>
 
+#include <limits>
+
+#include "entity_instances.h"
+#include "scene_bounds.h"
+
 namespace nvisii {
 
 std::vector<Entity> Entity::entities;
 std::vector<EntityStruct> Entity::entityStructs;
+std::vector<std::shared_ptr<const EntityInstances>> Entity::entityInstances;
 std::map<std::string, uint32_t> Entity::lookupTable;
 std::shared_ptr<std::recursive_mutex> Entity::editMutex;
 bool Entity::factoryInitialized = false;
@@ -266,6 +272,53 @@ void Entity::setVisibility(bool camera)
 	markDirty();
 }
 
+void Entity::setInstances(const float* transforms, uint32_t transforms_length, 
+	const int32_t* material_ids, uint32_t material_ids_length)
+{
+	if ((transforms_length % 12) != 0)
+		throw std::runtime_error("Error: transforms must contain 12 floats (a row-major 3x4 matrix) per instance");
+	uint32_t count = transforms_length / 12;
+	if ((material_ids_length != 0) && (material_ids_length != count))
+		throw std::runtime_error("Error: material_ids must either be empty or contain one id per instance");
+
+	auto instances = std::make_shared<EntityInstances>();
+	instances->transforms.assign(transforms, transforms + transforms_length);
+	if (material_ids_length) {
+		std::lock_guard<std::recursive_mutex> material_lock(*Material::getEditMutex().get());
+		Material* materials = Material::getFront();
+		for (uint32_t i = 0; i < material_ids_length; ++i) {
+			int32_t mid = material_ids[i];
+			if (mid == -1) continue;
+			if ((mid < 0) || (mid >= int32_t(Material::getCount())) || !materials[mid].isInitialized())
+				throw std::runtime_error("Error: material id " + std::to_string(mid) + " does not exist");
+		}
+		instances->materialIDs.assign(material_ids, material_ids + material_ids_length);
+	}
+
+	std::lock_guard<std::recursive_mutex> lock(*Entity::getEditMutex().get());
+	entityInstances[id] = instances;
+	markDirty();
+}
+
+void Entity::clearInstances()
+{
+	std::lock_guard<std::recursive_mutex> lock(*Entity::getEditMutex().get());
+	if (!entityInstances[id]) return;
+	entityInstances[id] = nullptr;
+	markDirty();
+}
+
+uint32_t Entity::getInstanceCount()
+{
+	std::lock_guard<std::recursive_mutex> lock(*Entity::getEditMutex().get());
+	return entityInstances[id] ? entityInstances[id]->size() : 0;
+}
+
+const std::shared_ptr<const EntityInstances>* Entity::getFrontInstances()
+{
+	return entityInstances.data();
+}
+
 glm::vec3 Entity::getMinAabbCorner()
 {
 	return entityStructs[id].bbmin;
@@ -286,6 +339,7 @@ void Entity::initializeFactory(uint32_t max_components)
 	if (isFactoryInitialized()) return;
 	entities.resize(max_components);
 	entityStructs.resize(max_components);
+	entityInstances.resize(max_components);
 	editMutex = std::make_shared<std::recursive_mutex>();
 	factoryInitialized = true;
 }
@@ -325,15 +379,32 @@ void Entity::markDirty() {
 	}
 };
 
-void Entity::computeAabb()
+void Entity::computeAabb(bool updateScene)
 {
-	if ((getMesh() == nullptr) || (getTransform() == nullptr)) {
+	const EntityInstances* instances = (getLight() == nullptr) ? entityInstances[id].get() : nullptr;
+	if ((getMesh() == nullptr) || (getTransform() == nullptr) || (instances && (instances->size() == 0))) {
 		entityStructs[id].bbmin = entityStructs[id].bbmax = vec4(0.f);
 	}
 	else {
+		vec3 mbbmin = getMesh()->getMinAabbCorner();
+		vec3 mbbmax = getMesh()->getMaxAabbCorner();
+		if (instances) {
+			// Union of the mesh bounds under each instance, from the center and half extent of the mesh bounds
+			vec3 center = (mbbmin + mbbmax) * .5f, extent = (mbbmax - mbbmin) * .5f;
+			vec3 ibbmin = vec3(std::numeric_limits<float>::max()), ibbmax = -ibbmin;
+			for (uint32_t i = 0; i < instances->size(); ++i) {
+				mat4 m = instances->getTransform(i);
+				vec3 c = vec3(m * vec4(center, 1.f));
+				vec3 e = glm::abs(vec3(m[0])) * extent.x + glm::abs(vec3(m[1])) * extent.y + glm::abs(vec3(m[2])) * extent.z;
+				ibbmin = glm::min(ibbmin, c - e);
+				ibbmax = glm::max(ibbmax, c + e);
+			}
+			mbbmin = ibbmin;
+			mbbmax = ibbmax;
+		}
 		mat4 ltw = getTransform()->getLocalToWorldMatrix();
-		vec3 lbbmin = vec3(ltw * vec4(getMesh()->getMinAabbCorner(), 1.f));
-		vec3 lbbmax = vec3(ltw * vec4(getMesh()->getMaxAabbCorner(), 1.f));
+		vec3 lbbmin = vec3(ltw * vec4(mbbmin, 1.f));
+		vec3 lbbmax = vec3(ltw * vec4(mbbmax, 1.f));
 		vec3 p[8];
 		p[0] = vec3(lbbmin.x, lbbmin.y, lbbmin.z);
 		p[1] = vec3(lbbmin.x, lbbmin.y, lbbmax.z);
@@ -352,7 +423,7 @@ void Entity::computeAabb()
 		entityStructs[id].bbmax = vec4(bbmax, 1.f);
 	}
 
-	nvisii::updateSceneAabb(this);
+	if (updateScene) nvisii::updateSceneAabb(this);
 }
 
 void Entity::updateRenderables() 
@@ -415,6 +486,109 @@ Entity* Entity::create(
 	}
 }
 
+std::vector<uint32_t> Entity::createBatch(std::string name_prefix, uint32_t count,
+	const float* positions, uint32_t positions_length,
+	const float* rotations, uint32_t rotations_length,
+	const float* scales, uint32_t scales_length,
+	const int32_t* mesh_ids, uint32_t mesh_ids_length,
+	const int32_t* material_ids, uint32_t material_ids_length
+) {
+	if ((positions_length != 0) && (positions_length != 3 * count)) 
+		throw std::runtime_error("Error: positions must either be empty or contain 3 * count floats");
+	if ((rotations_length != 0) && (rotations_length != 4 * count)) 
+		throw std::runtime_error("Error: rotations must either be empty or contain 4 * count floats");
+	if ((scales_length != 0) && (scales_length != count) && (scales_length != 3 * count)) 
+		throw std::runtime_error("Error: scales must either be empty or contain count or 3 * count floats");
+	if ((mesh_ids_length > 1) && (mesh_ids_length != count)) 
+		throw std::runtime_error("Error: mesh_ids must either contain 0, 1, or count ids");
+	if ((material_ids_length > 1) && (material_ids_length != count)) 
+		throw std::runtime_error("Error: material_ids must either contain 0, 1, or count ids");
+
+	// Same order as the scene snapshot, so that the batch can't deadlock against a commit
+	std::lock_guard<std::recursive_mutex> mesh_lock(*Mesh::getEditMutex().get());
+	std::lock_guard<std::recursive_mutex> transform_lock(*Transform::getEditMutex().get());
+	std::lock_guard<std::recursive_mutex> entity_lock(*Entity::getEditMutex().get());
+	std::lock_guard<std::recursive_mutex> material_lock(*Material::getEditMutex().get());
+
+	// Validate everything up front, so that a bad batch creates nothing
+	Mesh* meshes = Mesh::getFront();
+	Material* materials = Material::getFront();
+	for (uint32_t i = 0; i < mesh_ids_length; ++i) {
+		int32_t mid = mesh_ids[i];
+		if (mid == -1) continue;
+		if ((mid < 0) || (mid >= int32_t(Mesh::getCount())) || !meshes[mid].isInitialized())
+			throw std::runtime_error("Error: mesh id " + std::to_string(mid) + " does not exist");
+	}
+	for (uint32_t i = 0; i < material_ids_length; ++i) {
+		int32_t mid = material_ids[i];
+		if (mid == -1) continue;
+		if ((mid < 0) || (mid >= int32_t(Material::getCount())) || !materials[mid].isInitialized())
+			throw std::runtime_error("Error: material id " + std::to_string(mid) + " does not exist");
+	}
+
+	std::vector<std::string> names(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		names[i] = name_prefix + "_" + std::to_string(i);
+		if (doesItemExist(lookupTable, names[i]))
+			throw std::runtime_error("Error: Entity \"" + names[i] + "\" already exists.");
+		if (doesItemExist(Transform::lookupTable, names[i]))
+			throw std::runtime_error("Error: Transform \"" + names[i] + "\" already exists.");
+	}
+
+	// One pass over each table for free locations, rather than one scan from the start per component
+	auto findAvailableIDs = [count] (auto* items, size_t maxItems, std::string type) {
+		std::vector<uint32_t> ids;
+		ids.reserve(count);
+		for (size_t i = 0; (i < maxItems) && (ids.size() < count); ++i)
+			if ((items[i].initialized == false) && (items[i].reservation == 0)) ids.push_back(uint32_t(i));
+		if (ids.size() < count) throw std::runtime_error(std::string("Error: max " + type + " limit reached."));
+		return ids;
+	};
+	std::vector<uint32_t> transformIds = findAvailableIDs(Transform::transforms.data(), Transform::transforms.size(), "Transform");
+	std::vector<uint32_t> entityIds = findAvailableIDs(entities.data(), entities.size(), "Entity");
+
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t tid = transformIds[i];
+		Transform &transform = Transform::transforms[tid];
+		transform = Transform(names[i], tid);
+		Transform::lookupTable[names[i]] = tid;
+		if (positions_length) transform.position = vec3(positions[i * 3 + 0], positions[i * 3 + 1], positions[i * 3 + 2]);
+		if (rotations_length) transform.rotation = glm::normalize(quat(rotations[i * 4 + 3], rotations[i * 4 + 0], rotations[i * 4 + 1], rotations[i * 4 + 2]));
+		if (scales_length == count) transform.scale = vec3(scales[i]);
+		else if (scales_length) transform.scale = vec3(scales[i * 3 + 0], scales[i * 3 + 1], scales[i * 3 + 2]);
+		// No entity is attached yet, so this only computes the matrices
+		transform.updateMatrix();
+
+		uint32_t eid = entityIds[i];
+		Entity &entity = entities[eid];
+		entity = Entity(names[i], eid);
+		lookupTable[names[i]] = eid;
+		EntityStruct &entityStruct = entityStructs[eid];
+		entityStruct.flags |= ENTITY_VISIBILITY_CAMERA_RAYS;
+		entityStruct.transform_id = tid;
+		transform.entities.insert(eid);
+		int32_t mesh_id = (mesh_ids_length == 0) ? -1 : mesh_ids[(mesh_ids_length == 1) ? 0 : i];
+		if (mesh_id != -1) {
+			entityStruct.mesh_id = mesh_id;
+			meshes[mesh_id].entities.insert(eid);
+		}
+		int32_t material_id = (material_ids_length == 0) ? -1 : material_ids[(material_ids_length == 1) ? 0 : i];
+		if (material_id != -1) {
+			entityStruct.material_id = material_id;
+			materials[material_id].entities.insert(eid);
+		}
+		dirtyEntities.insert(&entity);
+		entity.updateRenderables();
+		entity.computeAabb(/*updateScene=*/false);
+	}
+
+	// Grow the scene bounds once, rather than once per entity
+	resetSceneAabb();
+	if (!renderableEntities.empty()) updateSceneAabb(*renderableEntities.begin());
+
+	return entityIds;
+}
+
 std::shared_ptr<std::recursive_mutex> Entity::getEditMutex()
 {
 	return editMutex;
@@ -432,6 +606,7 @@ void Entity::remove(std::string name) {
 	entity->clearMaterial();
 	entity->clearMesh();
 	entity->clearTransform();
+	entity->clearInstances();
 	int32_t oldID = entity->getId();
 	StaticFactory::remove(editMutex, name, "Entity", lookupTable, entities.data(), entities.size());
 	dirtyEntities.insert(&entities[oldID]);
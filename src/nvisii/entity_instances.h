@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * The instances of an entity, as set by Entity::setInstances.
+ *
+ * An instanced entity renders one copy of its mesh per instance, each placed relative to the entity's
+ * transform, without a transform or entity component per copy. Only the matrices and the optional
+ * material ids are kept, about 50 bytes per instance. The arrays are never edited once built:
+ * setInstances swaps in new ones, so that scene snapshots can share them rather than copy them.
+ */
+
+namespace nvisii {
+
+struct EntityInstances {
+    /* Row-major 3x4 affine matrices, 12 floats per instance, as in an OptiX instance */
+    std::vector<float> transforms;
+
+    /* Either empty, or one material id per instance. -1 uses the material of the entity. */
+    std::vector<int32_t> materialIDs;
+
+    uint32_t size() const { return uint32_t(transforms.size() / 12); }
+
+    /* @returns the matrix of the given instance, relative to the transform of the entity */
+    glm::mat4 getTransform(uint32_t instance) const
+    {
+        const float* t = &transforms[size_t(instance) * 12];
+        return glm::mat4(
+            t[0], t[4], t[8], 0.f,
+            t[1], t[5], t[9], 0.f,
+            t[2], t[6], t[10], 0.f,
+            t[3], t[7], t[11], 1.f);
+    }
+
+    int32_t getMaterialID(uint32_t instance) const
+    {
+        return materialIDs.empty() ? -1 : materialIDs[instance];
+    }
+};
+
+};
@@ -17,6 +17,8 @@
 
 #include <nvisii/mesh.h>
 #include <nvisii/entity.h>
+#include <nvisii/utilities/trace.h>
+#include <nvisii/utilities/baked_mesh.h>
 
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
@@ -59,6 +61,7 @@ Mesh::Mesh(std::string name, uint32_t id)
 	this->meshStructs[id].show_bounding_box = 0;
 	this->meshStructs[id].numTris = 0;
 	this->meshStructs[id].numVerts = 0;
+	this->meshStructs[id].numPoints = 0;
 }
 
 std::string Mesh::toString() {
@@ -111,6 +114,14 @@ std::vector<uint32_t> Mesh::getTriangleIndices() {
 	return triangleIndices;
 }
 
+std::vector<float> Mesh::getRadii() {
+	return radii;
+}
+
+bool Mesh::isPointCloud() {
+	return radii.size() > 0;
+}
+
 void Mesh::computeMetadata()
 {
 	// Compute AABB and center
@@ -123,8 +134,10 @@ void Mesh::computeMetadata()
 	{	
 		auto p = glm::vec3(positions[i][0], positions[i][1], positions[i][2]);
 		s += glm::vec4(p[0], p[1], p[2], 0.0f);
-		meshStructs[id].bbmin = glm::vec4(glm::min(p, glm::vec3(meshStructs[id].bbmin)), 0.0);
-		meshStructs[id].bbmax = glm::vec4(glm::max(p, glm::vec3(meshStructs[id].bbmax)), 0.0);
+		// Points of a point cloud are spheres, so their bounds grow by their radius
+		float r = (radii.size() > 0) ? radii[i] : 0.f;
+		meshStructs[id].bbmin = glm::vec4(glm::min(p - r, glm::vec3(meshStructs[id].bbmin)), 0.0);
+		meshStructs[id].bbmax = glm::vec4(glm::max(p + r, glm::vec3(meshStructs[id].bbmax)), 0.0);
 	}
 	s /= (float)positions.size();
 	meshStructs[id].center = s;
@@ -133,12 +146,14 @@ void Mesh::computeMetadata()
 	meshStructs[id].bounding_sphere_radius = 0.0;
 	for (int i = 0; i < positions.size(); i += 1) {
 		glm::vec3 p = glm::vec3(positions[i][0], positions[i][1], positions[i][2]);
+		float r = (radii.size() > 0) ? radii[i] : 0.f;
 		meshStructs[id].bounding_sphere_radius = std::max(meshStructs[id].bounding_sphere_radius, 
-			glm::distance(glm::vec4(p.x, p.y, p.z, 0.0f), meshStructs[id].center));
+			glm::distance(glm::vec4(p.x, p.y, p.z, 0.0f), meshStructs[id].center) + r);
 	}
 
 	this->meshStructs[id].numTris = uint32_t(triangleIndices.size()) / 3;
 	this->meshStructs[id].numVerts = uint32_t(positions.size());
+	this->meshStructs[id].numPoints = uint32_t(radii.size());
 }
 
 glm::vec3 Mesh::getCentroid()
@@ -335,6 +350,9 @@ void Mesh::loadData(
 
 void Mesh::generateSmoothNormals()
 {
+	// Point clouds have no faces to average, their normals come from their spheres
+	if (isPointCloud()) return;
+
 	std::vector<std::vector<glm::vec4>> w_normals(positions.size());
 
 	for (uint32_t f = 0; f < triangleIndices.size(); f += 3)
@@ -390,7 +408,11 @@ void Mesh::generateSmoothNormals()
 	markDirty();
 }
 
-void Mesh::generateSmoothTangents()
+void Mesh::computeSmoothTangents(
+	const std::vector<std::array<float, 3>> &positions,
+	const std::vector<glm::vec2> &texCoords,
+	const std::vector<uint32_t> &triangleIndices,
+	std::vector<glm::vec4> &tangents)
 {
 	tangents.resize(positions.size());
 	std::vector<std::vector<glm::vec4>> w_tangents(positions.size());
@@ -490,7 +512,11 @@ void Mesh::generateSmoothTangents()
 		// normalize the final normal
 		tangents[v] = glm::normalize(glm::vec4(N.x, N.y, N.z, 0.0f));
 	}
+}
 
+void Mesh::generateSmoothTangents()
+{
+	computeSmoothTangents(positions, texCoords, triangleIndices, tangents);
 	markDirty();
 }
 
@@ -1226,7 +1252,9 @@ Mesh* Mesh::createFromObj(std::string name, std::string path)
 
 Mesh* Mesh::createFromFile(std::string name, std::string path)
 {
-	auto create = [path, name] (Mesh* mesh) {
+	// Reading and processing the file happens outside of the edit mutex, see StaticFactory::create
+	auto build = [path, name] () -> BakedMesh {
+		TraceScope trace("load mesh", "io");
 		// Check and validate the specified model file extension.
 		const char* extension = strrchr(path.c_str(), '.');
 		if (!extension)
@@ -1234,6 +1262,9 @@ Mesh* Mesh::createFromFile(std::string name, std::string path)
 				std::string("Error: \"") + name + 
 				std::string(" \" provide a file with a valid extension."));
 
+		// Meshes baked by nvisii_bake are already welded and have normals and tangents
+		if (strcmp(extension, ".nvmesh") == 0) return loadBakedMesh(path);
+
 		if (AI_FALSE == aiIsExtensionSupported(extension))
 			throw std::runtime_error(
 				std::string("Error: \"") + name + 
@@ -1256,12 +1287,7 @@ Mesh* Mesh::createFromFile(std::string name, std::string path)
 				std::string("Error: \"") + name + 
 				std::string("\" positions must be greater than 1!"));
 		
-		mesh->positions.clear();
-		mesh->colors.clear();
-		mesh->texCoords.clear();
-		mesh->normals.clear();
-		mesh->triangleIndices.clear();
-
+		BakedMesh mesh;
 		uint32_t off = 0;
 		for (uint32_t meshIdx = 0; meshIdx < scene->mNumMeshes; ++meshIdx) {
 			auto &aiMesh = scene->mMeshes[meshIdx];
@@ -1294,9 +1320,9 @@ Mesh* Mesh::createFromFile(std::string name, std::string path)
 					v.texcoord.x = texCoord.x;
 					v.texcoord.y = texCoord.y;
 				}
-				mesh->positions.push_back({v.point.x, v.point.y, v.point.z});
-				mesh->normals.push_back({v.normal.x, v.normal.y, v.normal.z, 0.f});
-				mesh->texCoords.push_back({v.texcoord.x, v.texcoord.y});
+				mesh.positions.push_back({v.point.x, v.point.y, v.point.z});
+				mesh.normals.push_back({v.normal.x, v.normal.y, v.normal.z, 0.f});
+				mesh.texCoords.push_back({v.texcoord.x, v.texcoord.y});
 			}
 
 			for (uint32_t faceIdx = 0; faceIdx < aiMesh->mNumFaces; ++faceIdx) {
@@ -1304,13 +1330,13 @@ Mesh* Mesh::createFromFile(std::string name, std::string path)
 				auto &aiFace = aiFaces[faceIdx];			
 				if (aiFace.mNumIndices != 3) continue;
 				 
-				mesh->triangleIndices.push_back(aiFace.mIndices[0] + off);
-				mesh->triangleIndices.push_back(aiFace.mIndices[1] + off);
-				mesh->triangleIndices.push_back(aiFace.mIndices[2] + off);
+				mesh.triangleIndices.push_back(aiFace.mIndices[0] + off);
+				mesh.triangleIndices.push_back(aiFace.mIndices[1] + off);
+				mesh.triangleIndices.push_back(aiFace.mIndices[2] + off);
 
-				if (((aiFace.mIndices[0] + off) >= mesh->positions.size()) || 
-					((aiFace.mIndices[1] + off) >= mesh->positions.size()) || 
-					((aiFace.mIndices[2] + off) >= mesh->positions.size()))
+				if (((aiFace.mIndices[0] + off) >= mesh.positions.size()) || 
+					((aiFace.mIndices[1] + off) >= mesh.positions.size()) || 
+					((aiFace.mIndices[2] + off) >= mesh.positions.size()))
 					throw std::runtime_error(
 						std::string("Error: \"") + name +
 						std::string("\" invalid mesh index detected!"));
@@ -1318,19 +1344,24 @@ Mesh* Mesh::createFromFile(std::string name, std::string path)
 			off += aiMesh->mNumVertices;
 		}
 
-		mesh->generateSmoothTangents();
-		mesh->computeMetadata();
+		computeSmoothTangents(mesh.positions, mesh.texCoords, mesh.triangleIndices, mesh.tangents);
 
 		aiReleaseImport(scene);
+		return mesh;
+	};
+
+	auto publish = [] (Mesh* mesh, BakedMesh &data) {
+		mesh->positions = std::move(data.positions);
+		mesh->normals = std::move(data.normals);
+		mesh->tangents = std::move(data.tangents);
+		mesh->colors = std::move(data.colors);
+		mesh->texCoords = std::move(data.texCoords);
+		mesh->triangleIndices = std::move(data.triangleIndices);
+		mesh->computeMetadata();
 		dirtyMeshes.insert(mesh);
 	};
-	
-	try {
-		return StaticFactory::create<Mesh>(editMutex, name, "Mesh", lookupTable, meshes.data(), meshes.size(), create);
-	} catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes.data(), meshes.size());
-		throw;
-	}
+
+	return StaticFactory::create<Mesh, BakedMesh>(editMutex, name, "Mesh", lookupTable, meshes.data(), meshes.size(), build, publish);
 }
 
 Mesh* Mesh::createFromData(
@@ -1363,6 +1394,90 @@ Mesh* Mesh::createFromData(
 	}
 }
 
+void Mesh::loadPoints(
+	const float* positions_, uint32_t positions_length,
+	const float* radii_, uint32_t radii_length,
+	const float* colors_, uint32_t colors_length
+)
+{
+	if ((positions_length == 0) || ((positions_length % 3) != 0))
+		throw std::runtime_error("Error: positions must contain at least one point, and 3 floats per point");
+	uint32_t count = positions_length / 3;
+	bool keepRadii = (radii_length == 0) && (radii.size() == count);
+	bool keepColors = (colors_length == 0) && (colors.size() == count);
+	if (!keepRadii && (radii_length != 1) && (radii_length != count))
+		throw std::runtime_error("Error: radii must contain either a single radius or one radius per point");
+	if ((colors_length != 0) && (colors_length != count * 3) && (colors_length != count * 4))
+		throw std::runtime_error("Error: colors must either be empty or contain 3 or 4 floats per point");
+	for (uint32_t i = 0; i < radii_length; ++i) {
+		if (!(radii_[i] > 0.f)) throw std::runtime_error("Error: point radii must be greater than zero");
+	}
+
+	positions.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+		positions[i] = {positions_[i * 3 + 0], positions_[i * 3 + 1], positions_[i * 3 + 2]};
+
+	if (!keepRadii) {
+		if (radii_length == 1) radii.assign(count, radii_[0]);
+		else radii.assign(radii_, radii_ + count);
+	}
+
+	if (colors_length != 0) {
+		uint32_t dims = colors_length / count;
+		colors.resize(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			const float* c = &colors_[i * dims];
+			colors[i] = glm::vec4(c[0], c[1], c[2], (dims == 4) ? c[3] : 1.f);
+		}
+	}
+	else if (!keepColors) std::vector<glm::vec4>().swap(colors);
+
+	// Points have no triangles or surface attributes of their own; normals, tangents
+	// and texture coordinates are computed per hit from the sphere
+	std::vector<glm::vec4>().swap(normals);
+	std::vector<glm::vec4>().swap(tangents);
+	std::vector<glm::vec2>().swap(texCoords);
+	std::vector<uint32_t>().swap(triangleIndices);
+	computeMetadata();
+}
+
+Mesh* Mesh::createPointCloud(
+	std::string name,
+	const float* positions_, uint32_t positions_length,
+	const float* radii_, uint32_t radii_length,
+	const float* colors_, uint32_t colors_length
+) {
+	if (radii_length == 0)
+		throw std::runtime_error("Error: radii must contain either a single radius or one radius per point");
+	auto create = [&] (Mesh* mesh) 
+	{
+		mesh->loadPoints(positions_, positions_length, radii_, radii_length, colors_, colors_length);
+		dirtyMeshes.insert(mesh);
+	};
+
+	try {
+		return StaticFactory::create<Mesh>(editMutex, name, "Mesh", lookupTable, meshes.data(), meshes.size(), create);
+	} catch (...) {
+		StaticFactory::removeIfExists(editMutex, name, "Mesh", lookupTable, meshes.data(), meshes.size());
+		throw;
+	}
+}
+
+void Mesh::setPoints(
+	const float* positions_, uint32_t positions_length,
+	const float* radii_, uint32_t radii_length,
+	const float* colors_, uint32_t colors_length
+) {
+	std::lock_guard<std::recursive_mutex> lock(*editMutex.get());
+	if (!isPointCloud())
+		throw std::runtime_error("Error: mesh \"" + name + "\" is not a point cloud");
+	if ((radii_length == 0) && (radii.size() * 3 != positions_length))
+		throw std::runtime_error("Error: radii must be given when the number of points changes");
+	loadPoints(positions_, positions_length, radii_, radii_length, colors_, colors_length);
+	std::lock_guard<std::recursive_mutex> entity_lock(*Entity::getEditMutex().get());
+	markDirty();
+}
+
 void Mesh::remove(std::string name) {
 	auto m = get(name);
 	if (!m) return;
@@ -1371,6 +1486,7 @@ void Mesh::remove(std::string name) {
 	std::vector<glm::vec4>().swap(m->colors);
 	std::vector<glm::vec2>().swap(m->texCoords);
 	std::vector<uint32_t>().swap(m->triangleIndices);
+	std::vector<float>().swap(m->radii);
 	int32_t oldID = m->getId();
 	StaticFactory::remove(editMutex, name, "Mesh", lookupTable, meshes.data(), meshes.size());
 	dirtyMeshes.insert(&meshes[oldID]);
@@ -19,20 +19,37 @@
 
 #include <devicecode/launch_params.h>
 #include <devicecode/path_tracer.h>
+#include <cpucode/cpu_renderer.h>
+#include "entity_instances.h"
+#include "scene_bounds.h"
+#include "scene_snapshot.h"
 
 #define PBRLUT_IMPLEMENTATION
 #include <nvisii/utilities/ggx_lookup_tables.h>
 #include <nvisii/utilities/procedural_sky.h>
+#include <nvisii/utilities/dome_importance.h>
+#include <nvisii/utilities/lru_cache.h>
+#include <nvisii/utilities/hash_combiner.h>
+#include <nvisii/utilities/light_sampling.h>
+#include <nvisii/utilities/light_tree.h>
+#include <nvisii/utilities/adaptive_sampling.h>
+#include <nvisii/utilities/render_budget.h>
+#include <nvisii/utilities/temporal_accumulation.h>
+#include <nvisii/utilities/profiler.h>
+#include <nvisii/utilities/memory_tracker.h>
+#include <nvisii/utilities/thread_pool.h>
+#include <nvisii/utilities/frame_pipeline.h>
+#include <nvisii/utilities/point_cloud.h>
 
 #include <thread>
 #include <future>
+#include <chrono>
 #include <queue>
+#include <deque>
 #include <algorithm>
 #include <cctype>
 #include <functional>
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image.h>
 #include <stb_image_write.h>
 
@@ -63,6 +80,7 @@ static bool initialized = false;
 static bool stopped = true;
 static bool lazyUpdatesEnabled = false;
 static bool verbose = true;
+static bool cpuBackend = false;
 
 static struct WindowData {
     GLFWwindow* window = nullptr;
@@ -95,6 +113,10 @@ static struct OptixData {
     OWLBuffer scratchBuffer;
     OWLBuffer mvecBuffer;
     OWLBuffer accumBuffer;
+    OWLBuffer halfBuffer;
+    OWLBuffer adaptiveTileMaskBuffer;
+    OWLBuffer historyBuffer;
+    OWLBuffer historyGuideBuffer;
 
     OWLBuffer entityBuffer;
     OWLBuffer transformBuffer;
@@ -105,13 +127,20 @@ static struct OptixData {
     OWLBuffer textureBuffer;
     OWLBuffer volumeBuffer;
     OWLBuffer lightEntitiesBuffer;
+    OWLBuffer lightSelectionBuffer;
+    OWLBuffer triangleSelectionBuffer;
+    OWLBuffer triangleSelectionOffsetsBuffer;
+    OWLBuffer lightTreeBuffer;
     OWLBuffer surfaceInstanceToEntityBuffer;
+    OWLBuffer surfaceInstanceToMaterialBuffer;
     OWLBuffer volumeInstanceToEntityBuffer;
     OWLBuffer vertexListsBuffer;
     OWLBuffer normalListsBuffer;
     OWLBuffer tangentListsBuffer;
     OWLBuffer texCoordListsBuffer;
     OWLBuffer indexListsBuffer;
+    OWLBuffer pointListsBuffer;
+    OWLBuffer pointColorListsBuffer;
     OWLBuffer textureObjectsBuffer;
     OWLBuffer volumeHandlesBuffer;
 
@@ -126,12 +155,15 @@ static struct OptixData {
     OWLMissProg missProg;
     OWLGeomType trianglesGeomType;
     OWLGeomType volumeGeomType;
+    OWLGeomType pointsGeomType;
 
     std::vector<OWLBuffer> vertexLists;
     std::vector<OWLBuffer> normalLists;
     std::vector<OWLBuffer> tangentLists;
     std::vector<OWLBuffer> texCoordLists;
     std::vector<OWLBuffer> indexLists;
+    std::vector<OWLBuffer> pointLists;
+    std::vector<OWLBuffer> pointColorLists;
     std::vector<OWLGeom> surfaceGeomList;
     std::vector<OWLGroup> surfaceBlasList;
     std::vector<OWLGeom> volumeGeomList;
@@ -142,6 +174,30 @@ static struct OptixData {
 
     std::vector<uint32_t> lightEntities;
 
+    // Per mesh triangle area alias tables, built along with the BLAS, since only the snapshot holds the vertices
+    std::vector<std::vector<AliasTableEntry>> meshTriangleTables;
+    std::vector<float> meshSurfaceAreas;
+    std::vector<glm::vec4> meshNormalCones;
+
+    // Light bounding volume hierarchy over the light entities
+    LightTree lightTree;
+
+    // Adaptive sampling settings, and the tiles still taking samples during a render
+    bool enableAdaptiveSampling = false;
+    float adaptiveErrorThreshold = .01f;
+    uint32_t adaptiveMinSamples = 16;
+    float adaptiveMaxSampleScale = 4.f;
+    uint32_t adaptiveTileSize = 16;
+    AdaptiveSampler adaptiveSampler;
+    float renderedSamplesPerPixel = 0.f;
+
+    // Temporal accumulation settings, and whether the history holds a previous frame of the same size
+    bool enableTemporalAccumulation = false;
+    float temporalMaxHistorySamples = 64.f;
+    float temporalDepthTolerance = .1f;
+    bool temporalHistoryValid = false;
+    glm::ivec2 temporalHistorySize = glm::ivec2(0);
+
     bool enableDenoiser = false;
     #if USE_OPTIX72
     bool enableKernelPrediction = true;
@@ -159,8 +215,7 @@ static struct OptixData {
 
     Texture* domeLightTexture = nullptr;
 
-    OWLBuffer environmentMapRowsBuffer;
-    OWLBuffer environmentMapColsBuffer;
+    OWLBuffer environmentMapAliasBuffer;
     OWLTexture proceduralSkyTexture;
 
     std::vector<MaterialStruct> materialStructs;
@@ -175,6 +230,7 @@ static struct NVISII {
     struct Command {
         std::function<void()> function;
         std::shared_ptr<std::promise<void>> promise;
+        uint64_t traceId = 0;
     };
 
     std::thread::id render_thread_id;
@@ -187,6 +243,39 @@ static struct NVISII {
 
 } NVISII;
 
+struct ProceduralSkyImage;
+
+/* Host side copies of the frame and dome light data, used when rendering with the CPU backend */
+static struct CPUData {
+    std::vector<glm::vec4> frameBuffer;
+    std::vector<glm::vec4> albedoBuffer;
+    std::vector<glm::vec4> normalBuffer;
+    std::vector<glm::vec4> halfBuffer;
+    std::vector<glm::vec4> guideBuffer;
+    std::vector<glm::vec4> historyBuffer;
+    std::vector<glm::vec4> historyGuideBuffer;
+
+    std::shared_ptr<const ProceduralSkyImage> proceduralSkyImage;
+    std::vector<AliasTableEntry> environmentMapAlias;
+} CPUData;
+
+/* Per stage timings and counters of the most recent frames */
+static FrameProfiler Profiler;
+
+/* Host and device memory held by each mesh, texture and volume */
+static MemoryTracker Memory;
+
+/* Frames rendered by renderAsync which have not been read back yet */
+static FramePipeline<std::vector<float>> Frames;
+
+/* Pinned host memory which asynchronous frames are read back into, one per frame in flight */
+struct ReadbackSlot {
+    glm::vec4* texels = nullptr;
+    size_t capacity = 0;
+    cudaEvent_t done = nullptr;
+};
+static std::vector<ReadbackSlot> ReadbackSlots;
+
 void applyStyle()
 {
 	ImGuiStyle* style = &ImGui::GetStyle();
@@ -260,6 +349,7 @@ void resetAccumulation() {
 }
 
 int getDeviceCount() {
+    if (cpuBackend) return 0;
     return owlGetDeviceCount(OptixData.context);
 }
 
@@ -270,12 +360,16 @@ OWLModule moduleCreate(OWLContext context, const char* ptxCode)
 
 OWLBuffer managedMemoryBufferCreate(OWLContext context, OWLDataType type, size_t count, void* init)
 {
-    return owlManagedMemoryBufferCreate(context, type, count, init);
+    OWLBuffer buffer = owlManagedMemoryBufferCreate(context, type, count, init);
+    if (init) Profiler.addCount("bytes_uploaded", double(owlBufferSizeInBytes(buffer)));
+    return buffer;
 }
 
-OWLBuffer deviceBufferCreate(OWLContext context, OWLDataType type, size_t count, void* init)
+OWLBuffer deviceBufferCreate(OWLContext context, OWLDataType type, size_t count, const void* init)
 {
-    return owlDeviceBufferCreate(context, type, count, init);
+    OWLBuffer buffer = owlDeviceBufferCreate(context, type, count, init);
+    if (init) Profiler.addCount("bytes_uploaded", double(owlBufferSizeInBytes(buffer)));
+    return buffer;
 }
 
 void bufferDestroy(OWLBuffer buffer)
@@ -295,6 +389,17 @@ const void* bufferGetPointer(OWLBuffer buffer, int deviceId)
 void bufferUpload(OWLBuffer buffer, const void *hostPtr)
 {
     owlBufferUpload(buffer, hostPtr);
+    Profiler.addCount("bytes_uploaded", double(owlBufferSizeInBytes(buffer)));
+}
+
+OWLTexture texture2DCreate(OWLContext context, OWLTexelFormat format, uint32_t width, uint32_t height, const void* texels,
+    OWLTextureFilterMode filterMode = OWL_TEXTURE_LINEAR, OWLTextureAddressMode addressMode = OWL_TEXTURE_WRAP, 
+    OWLTextureColorSpace colorSpace = OWL_COLOR_SPACE_LINEAR)
+{
+    Profiler.addCount("textures_created");
+    size_t texelSize = (format == OWL_TEXEL_FORMAT_RGBA32F) ? sizeof(glm::vec4) : sizeof(glm::u8vec4);
+    Profiler.addCount("bytes_uploaded", double(size_t(width) * size_t(height) * texelSize));
+    return owlTexture2DCreate(context, format, width, height, texels, filterMode, addressMode, colorSpace);
 }
 
 CUstream getStream(OWLContext context, int deviceId)
@@ -302,6 +407,82 @@ CUstream getStream(OWLContext context, int deviceId)
     return owlContextGetStream(context, deviceId);
 }
 
+/* GPU timings whose events have been recorded, but not yet read back */
+struct PendingGPUTiming {
+    const char* stage;
+    cudaEvent_t start;
+    cudaEvent_t stop;
+};
+static std::vector<PendingGPUTiming> pendingGPUTimings;
+/* Events of timings already read back, reused so that timing a launch does not create events every frame */
+static std::vector<cudaEvent_t> freeGPUTimerEvents;
+
+static cudaEvent_t acquireGPUTimerEvent()
+{
+    cudaEvent_t event;
+    if (freeGPUTimerEvents.empty()) cudaEventCreate(&event);
+    else {
+        event = freeGPUTimerEvents.back();
+        freeGPUTimerEvents.pop_back();
+    }
+    return event;
+}
+
+/**
+ * Measures the GPU time taken by the work submitted to the first device's stream during its lifetime,
+ * reported as "<stage>_gpu_ms". Events are only read back by resolveGPUTimings, to avoid stalling the GPU.
+ */
+class ScopedGPUTimer {
+public:
+    ScopedGPUTimer(const char* stage) : stage(stage)
+    {
+        if (cpuBackend) return;
+        start = acquireGPUTimerEvent();
+        stop = acquireGPUTimerEvent();
+        cudaEventRecord(start, getStream(OptixData.context, 0));
+    }
+
+    ~ScopedGPUTimer()
+    {
+        if (cpuBackend) return;
+        cudaEventRecord(stop, getStream(OptixData.context, 0));
+        pendingGPUTimings.push_back({stage, start, stop});
+    }
+
+private:
+    const char* stage;
+    cudaEvent_t start, stop;
+};
+
+/* Waits for all pending GPU timings, adding them to the current frame */
+static void resolveGPUTimings()
+{
+    for (auto &timing : pendingGPUTimings) {
+        float milliseconds = 0.f;
+        cudaEventSynchronize(timing.stop);
+        cudaEventElapsedTime(&milliseconds, timing.start, timing.stop);
+        Profiler.addTime(std::string(timing.stage) + "_gpu", milliseconds);
+        freeGPUTimerEvents.push_back(timing.start);
+        freeGPUTimerEvents.push_back(timing.stop);
+    }
+    pendingGPUTimings.clear();
+}
+
+/* Destroys the pooled timer events, before the context they belong to goes away */
+static void releaseGPUTimerEvents()
+{
+    resolveGPUTimings();
+    for (auto event : freeGPUTimerEvents) cudaEventDestroy(event);
+    freeGPUTimerEvents.clear();
+}
+
+/* Groups everything recorded during its lifetime into one frame of statistics */
+struct ProfiledFrame {
+    TraceScope trace = TraceScope("frame", "render");
+    ProfiledFrame() { Profiler.beginFrame(); }
+    ~ProfiledFrame() { resolveGPUTimings(); Profiler.endFrame(); }
+};
+
 OptixDeviceContext getOptixContext(OWLContext context, int deviceID)
 {
     return owlContextGetOptixContext(context, deviceID);
@@ -376,6 +557,58 @@ void groupBuildAccel(OWLGroup group)
     owlGroupBuildAccel(group);
 }
 
+/* Returns the size of an acceleration structure built over the given input, before compaction */
+static uint64_t accelSizeInBytes(const OptixBuildInput &input)
+{
+    OptixAccelBuildOptions options = {};
+    options.buildFlags = OPTIX_BUILD_FLAG_ALLOW_COMPACTION;
+    options.operation = OPTIX_BUILD_OPERATION_BUILD;
+    OptixAccelBufferSizes sizes = {};
+    OPTIX_CHECK(optixAccelComputeMemoryUsage(getOptixContext(OptixData.context, 0), &options, &input, 1, &sizes));
+    return sizes.outputSizeInBytes;
+}
+
+static uint64_t trianglesAccelSizeInBytes(uint32_t numVertices, uint32_t numTriangles)
+{
+    // Only the counts and formats are used to compute the size, so no buffers are needed
+    CUdeviceptr vertices = 0;
+    uint32_t flags = OPTIX_GEOMETRY_FLAG_NONE;
+    OptixBuildInput input = {};
+    input.type = OPTIX_BUILD_INPUT_TYPE_TRIANGLES;
+    input.triangleArray.vertexFormat = OPTIX_VERTEX_FORMAT_FLOAT3;
+    input.triangleArray.vertexStrideInBytes = sizeof(std::array<float, 3>);
+    input.triangleArray.numVertices = numVertices;
+    input.triangleArray.vertexBuffers = &vertices;
+    input.triangleArray.indexFormat = OPTIX_INDICES_FORMAT_UNSIGNED_INT3;
+    input.triangleArray.indexStrideInBytes = sizeof(ivec3);
+    input.triangleArray.numIndexTriplets = numTriangles;
+    input.triangleArray.flags = &flags;
+    input.triangleArray.numSbtRecords = 1;
+    return accelSizeInBytes(input);
+}
+
+static uint64_t userGeomAccelSizeInBytes(uint32_t numPrimitives)
+{
+    CUdeviceptr aabbs = 0;
+    uint32_t flags = OPTIX_GEOMETRY_FLAG_NONE;
+    OptixBuildInput input = {};
+    input.type = OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES;
+    input.customPrimitiveArray.aabbBuffers = &aabbs;
+    input.customPrimitiveArray.numPrimitives = numPrimitives;
+    input.customPrimitiveArray.flags = &flags;
+    input.customPrimitiveArray.numSbtRecords = 1;
+    return accelSizeInBytes(input);
+}
+
+static uint64_t instanceAccelSizeInBytes(uint32_t numInstances)
+{
+    OptixBuildInput input = {};
+    input.type = OPTIX_BUILD_INPUT_TYPE_INSTANCES;
+    input.instanceArray.numInstances = numInstances;
+    // The instances themselves are kept on the device too
+    return accelSizeInBytes(input) + uint64_t(numInstances) * sizeof(OptixInstance);
+}
+
 void instanceGroupSetChild(OWLGroup group, int whichChild, OWLGroup child)
 {
     owlInstanceGroupSetChild(group, whichChild, child); 
@@ -407,20 +640,25 @@ OWLLaunchParams launchParamsCreate(OWLContext context, size_t size, OWLVarDecl *
 
 void launchParamsSetBuffer(OWLLaunchParams params, const char* varName, OWLBuffer buffer)
 {
+    // Launch params are never created by the CPU backend
+    if (!params) return;
     owlParamsSetBuffer(params, varName, buffer);
 }
 
 void launchParamsSetRaw(OWLLaunchParams params, const char* varName, const void* data)
 {
+    if (!params) return;
     owlParamsSetRaw(params, varName, data);
 }
 
 void launchParamsSetTexture(OWLLaunchParams params, const char* varName, OWLTexture texture)
 {
+    if (!params) return;
     owlParamsSetTexture(params, varName, texture);
 }
 
 void launchParamsSetGroup(OWLLaunchParams params, const char *varName, OWLGroup group) {
+    if (!params) return;
     owlParamsSetGroup(params, varName, group);
 }
 
@@ -440,6 +678,8 @@ void synchronizeDevices()
 
 void checkForErrors()
 {
+    if (cpuBackend) return;
+
     // check for error
     cudaError_t error = cudaGetLastError();
     if(error != cudaSuccess)
@@ -488,12 +728,22 @@ void resizeOptixFrameBuffer(uint32_t width, uint32_t height)
 
     OD.LP.frameSize.x = width;
     OD.LP.frameSize.y = height;
+    if (cpuBackend) {
+        CPUData.frameBuffer.assign(width * height, glm::vec4(0.f));
+        CPUData.albedoBuffer.assign(width * height, glm::vec4(0.f));
+        CPUData.normalBuffer.assign(width * height, glm::vec4(0.f));
+        CPUData.halfBuffer.assign(width * height, glm::vec4(0.f));
+        CPUData.guideBuffer.assign(width * height, glm::vec4(0.f, 0.f, 0.f, -1.f));
+        resetAccumulation();
+        return;
+    }
     bufferResize(OD.frameBuffer, width * height);
     bufferResize(OD.normalBuffer, width * height);
     bufferResize(OD.albedoBuffer, width * height);
     bufferResize(OD.scratchBuffer, width * height);
     bufferResize(OD.mvecBuffer, width * height);    
     bufferResize(OD.accumBuffer, width * height);
+    bufferResize(OD.halfBuffer, width * height);
     
     // Reconfigure denoiser
     optixDenoiserComputeMemoryResources(OD.denoiser, OD.LP.frameSize.x, OD.LP.frameSize.y, &OD.denoiserSizes);
@@ -563,6 +813,10 @@ void initializeOptix(bool headless)
         { "scratchBuffer",           OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, scratchBuffer)},
         { "mvecBuffer",              OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, mvecBuffer)},
         { "accumPtr",                OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, accumPtr)},
+        { "halfBuffer",              OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, halfBuffer)},
+        { "adaptiveTileMask",        OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, adaptiveTileMask)},
+        { "adaptiveTileSize",        OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, adaptiveTileSize)},
+        { "writeTemporalGuides",     OWL_USER_TYPE(bool),               OWL_OFFSETOF(LaunchParams, writeTemporalGuides)},
         { "surfacesIAS",             OWL_GROUP,                         OWL_OFFSETOF(LaunchParams, surfacesIAS)},
         { "volumesIAS",              OWL_GROUP,                         OWL_OFFSETOF(LaunchParams, volumesIAS)},
         { "cameraEntity",            OWL_USER_TYPE(EntityStruct),       OWL_OFFSETOF(LaunchParams, cameraEntity)},
@@ -575,6 +829,9 @@ void initializeOptix(bool headless)
         { "textures",                OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, textures)},
         { "volumes",                 OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, volumes)},
         { "lightEntities",           OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, lightEntities)},
+        { "lightSelectionTable",     OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, lightSelectionTable)},
+        { "triangleSelectionTables", OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, triangleSelectionTables)},
+        { "triangleSelectionOffsets",OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, triangleSelectionOffsets)},
         { "vertexLists",             OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, vertexLists)},
         { "normalLists",             OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, normalLists)},
         { "tangentLists",            OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, tangentLists)},
@@ -582,6 +839,7 @@ void initializeOptix(bool headless)
         { "indexLists",              OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, indexLists)},
         { "numLightEntities",        OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, numLightEntities)},
         { "surfaceInstanceToEntity", OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, surfaceInstanceToEntity)},
+        { "surfaceInstanceToMaterial", OWL_BUFFER,                      OWL_OFFSETOF(LaunchParams, surfaceInstanceToMaterial)},
         { "volumeInstanceToEntity",  OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, volumeInstanceToEntity)},
         { "domeLightIntensity",      OWL_USER_TYPE(float),              OWL_OFFSETOF(LaunchParams, domeLightIntensity)},
         { "domeLightExposure",       OWL_USER_TYPE(float),              OWL_OFFSETOF(LaunchParams, domeLightExposure)},
@@ -603,8 +861,7 @@ void initializeOptix(bool headless)
         { "viewT1",                  OWL_USER_TYPE(glm::mat4),          OWL_OFFSETOF(LaunchParams, viewT1)},
         { "environmentMapID",        OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, environmentMapID)},
         { "environmentMapRotation",  OWL_USER_TYPE(glm::quat),          OWL_OFFSETOF(LaunchParams, environmentMapRotation)},
-        { "environmentMapRows",      OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, environmentMapRows)},
-        { "environmentMapCols",      OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, environmentMapCols)},
+        { "environmentMapAlias",     OWL_BUFPTR,                        OWL_OFFSETOF(LaunchParams, environmentMapAlias)},
         { "environmentMapWidth",     OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, environmentMapWidth)},
         { "environmentMapHeight",    OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, environmentMapHeight)},
         { "textureObjects",          OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, textureObjects)},
@@ -617,6 +874,10 @@ void initializeOptix(bool headless)
         { "sceneBBMin",              OWL_USER_TYPE(glm::vec3),          OWL_OFFSETOF(LaunchParams, sceneBBMin)},
         { "sceneBBMax",              OWL_USER_TYPE(glm::vec3),          OWL_OFFSETOF(LaunchParams, sceneBBMax)},
         { "enableDomeSampling", OWL_USER_TYPE(bool),               OWL_OFFSETOF(LaunchParams, enableDomeSampling)},
+        { "lightTree",               OWL_BUFFER,                        OWL_OFFSETOF(LaunchParams, lightTree)},
+        { "numLightTreeNodes",       OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, numLightTreeNodes)},
+        { "enableLightTree",         OWL_USER_TYPE(bool),               OWL_OFFSETOF(LaunchParams, enableLightTree)},
+        { "samplerType",             OWL_USER_TYPE(uint32_t),           OWL_OFFSETOF(LaunchParams, samplerType)},
         { /* sentinel to mark end of list */ }
     };
     OD.launchParams = launchParamsCreate(OD.context, sizeof(LaunchParams), launchParamVars, -1);
@@ -629,6 +890,10 @@ void initializeOptix(bool headless)
     if (numGPUsFound > 1) {
         OD.frameBuffer = managedMemoryBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),512*512, nullptr);
         OD.accumBuffer = managedMemoryBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),512*512, nullptr);
+        OD.halfBuffer = managedMemoryBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),512*512, nullptr);
+        OD.adaptiveTileMaskBuffer = managedMemoryBufferCreate(OD.context,OWL_USER_TYPE(uint8_t),1, nullptr);
+        OD.historyBuffer = managedMemoryBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),1, nullptr);
+        OD.historyGuideBuffer = managedMemoryBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),1, nullptr);
         OD.normalBuffer = managedMemoryBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),512*512, nullptr);
         OD.albedoBuffer = managedMemoryBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),512*512, nullptr);
         OD.scratchBuffer = managedMemoryBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),512*512, nullptr);
@@ -636,6 +901,10 @@ void initializeOptix(bool headless)
     } else {
         OD.frameBuffer = deviceBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),512*512, nullptr);
         OD.accumBuffer = deviceBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),512*512, nullptr);
+        OD.halfBuffer = deviceBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),512*512, nullptr);
+        OD.adaptiveTileMaskBuffer = deviceBufferCreate(OD.context,OWL_USER_TYPE(uint8_t),1, nullptr);
+        OD.historyBuffer = deviceBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),1, nullptr);
+        OD.historyGuideBuffer = deviceBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),1, nullptr);
         OD.normalBuffer = deviceBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),512*512, nullptr);
         OD.albedoBuffer = deviceBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),512*512, nullptr);
         OD.scratchBuffer = deviceBufferCreate(OD.context,OWL_USER_TYPE(glm::vec4),512*512, nullptr);
@@ -648,6 +917,8 @@ void initializeOptix(bool headless)
     launchParamsSetBuffer(OD.launchParams, "scratchBuffer", OD.scratchBuffer);
     launchParamsSetBuffer(OD.launchParams, "mvecBuffer", OD.mvecBuffer);
     launchParamsSetBuffer(OD.launchParams, "accumPtr", OD.accumBuffer);
+    launchParamsSetBuffer(OD.launchParams, "halfBuffer", OD.halfBuffer);
+    launchParamsSetBuffer(OD.launchParams, "adaptiveTileMask", OD.adaptiveTileMaskBuffer);
     launchParamsSetRaw(OD.launchParams, "frameSize", &OD.LP.frameSize);
 
     /* Create Component Buffers */
@@ -662,13 +933,20 @@ void initializeOptix(bool headless)
     OD.volumeBuffer              = deviceBufferCreate(OD.context, OWL_USER_TYPE(VolumeStruct),        Volume::getCount(),   nullptr);
     OD.volumeHandlesBuffer       = deviceBufferCreate(OD.context, OWL_BUFFER,                         Volume::getCount(),   nullptr);
     OD.lightEntitiesBuffer       = deviceBufferCreate(OD.context, OWL_USER_TYPE(uint32_t),            1,              nullptr);
+    OD.lightSelectionBuffer      = deviceBufferCreate(OD.context, OWL_USER_TYPE(AliasTableEntry),     1,              nullptr);
+    OD.triangleSelectionBuffer   = deviceBufferCreate(OD.context, OWL_USER_TYPE(AliasTableEntry),     1,              nullptr);
+    OD.triangleSelectionOffsetsBuffer = deviceBufferCreate(OD.context, OWL_USER_TYPE(uint32_t),       Mesh::getCount(),     nullptr);
+    OD.lightTreeBuffer           = deviceBufferCreate(OD.context, OWL_USER_TYPE(LightTreeNode),       1,              nullptr);
     OD.surfaceInstanceToEntityBuffer = deviceBufferCreate(OD.context, OWL_USER_TYPE(uint32_t),            1,              nullptr);
+    OD.surfaceInstanceToMaterialBuffer = deviceBufferCreate(OD.context, OWL_USER_TYPE(int32_t),           1,              nullptr);
     OD.volumeInstanceToEntityBuffer = deviceBufferCreate(OD.context, OWL_USER_TYPE(uint32_t),            1,              nullptr);
     OD.vertexListsBuffer         = deviceBufferCreate(OD.context, OWL_BUFFER,                         Mesh::getCount(),     nullptr);
     OD.normalListsBuffer         = deviceBufferCreate(OD.context, OWL_BUFFER,                         Mesh::getCount(),     nullptr);
     OD.tangentListsBuffer        = deviceBufferCreate(OD.context, OWL_BUFFER,                         Mesh::getCount(),     nullptr);
     OD.texCoordListsBuffer       = deviceBufferCreate(OD.context, OWL_BUFFER,                         Mesh::getCount(),     nullptr);
     OD.indexListsBuffer          = deviceBufferCreate(OD.context, OWL_BUFFER,                         Mesh::getCount(),     nullptr);
+    OD.pointListsBuffer          = deviceBufferCreate(OD.context, OWL_BUFFER,                         Mesh::getCount(),     nullptr);
+    OD.pointColorListsBuffer     = deviceBufferCreate(OD.context, OWL_BUFFER,                         Mesh::getCount(),     nullptr);
     OD.textureObjectsBuffer      = deviceBufferCreate(OD.context, OWL_TEXTURE,                        Texture::getCount() + NUM_MAT_PARAMS * Material::getCount(),   nullptr);
 
     launchParamsSetBuffer(OD.launchParams, "entities",             OD.entityBuffer);
@@ -680,13 +958,20 @@ void initializeOptix(bool headless)
     launchParamsSetBuffer(OD.launchParams, "textures",             OD.textureBuffer);
     launchParamsSetBuffer(OD.launchParams, "volumes",              OD.volumeBuffer);
     launchParamsSetBuffer(OD.launchParams, "lightEntities",        OD.lightEntitiesBuffer);
+    launchParamsSetBuffer(OD.launchParams, "lightSelectionTable",  OD.lightSelectionBuffer);
+    launchParamsSetBuffer(OD.launchParams, "triangleSelectionTables", OD.triangleSelectionBuffer);
+    launchParamsSetBuffer(OD.launchParams, "triangleSelectionOffsets", OD.triangleSelectionOffsetsBuffer);
+    launchParamsSetBuffer(OD.launchParams, "lightTree",            OD.lightTreeBuffer);
     launchParamsSetBuffer(OD.launchParams, "surfaceInstanceToEntity",  OD.surfaceInstanceToEntityBuffer);
+    launchParamsSetBuffer(OD.launchParams, "surfaceInstanceToMaterial",  OD.surfaceInstanceToMaterialBuffer);
     launchParamsSetBuffer(OD.launchParams, "volumeInstanceToEntity",  OD.volumeInstanceToEntityBuffer);
     launchParamsSetBuffer(OD.launchParams, "vertexLists",          OD.vertexListsBuffer);
     launchParamsSetBuffer(OD.launchParams, "normalLists",          OD.normalListsBuffer);
     launchParamsSetBuffer(OD.launchParams, "tangentLists",          OD.tangentListsBuffer);
     launchParamsSetBuffer(OD.launchParams, "texCoordLists",        OD.texCoordListsBuffer);
     launchParamsSetBuffer(OD.launchParams, "indexLists",           OD.indexListsBuffer);
+    launchParamsSetBuffer(OD.launchParams, "pointLists",           OD.pointListsBuffer);
+    launchParamsSetBuffer(OD.launchParams, "pointColorLists",      OD.pointColorListsBuffer);
     launchParamsSetBuffer(OD.launchParams, "textureObjects",       OD.textureObjectsBuffer);
     launchParamsSetBuffer(OD.launchParams, "volumeHandles",       OD.volumeHandlesBuffer);
 
@@ -696,7 +981,12 @@ void initializeOptix(bool headless)
     OD.tangentLists.resize(meshCount);
     OD.texCoordLists.resize(meshCount);
     OD.indexLists.resize(meshCount);
+    OD.pointLists.resize(meshCount);
+    OD.pointColorLists.resize(meshCount);
     OD.surfaceGeomList.resize(meshCount);
+    OD.meshTriangleTables.resize(meshCount);
+    OD.meshSurfaceAreas.resize(meshCount, 0.f);
+    OD.meshNormalCones.resize(meshCount, glm::vec4(0.f, 0.f, 1.f, -1.f));
     OD.surfaceBlasList.resize(meshCount);
     
     uint32_t volumeCount = Volume::getCount();
@@ -715,8 +1005,7 @@ void initializeOptix(bool headless)
     launchParamsSetRaw(OD.launchParams, "environmentMapID", &OD.LP.environmentMapID);
     launchParamsSetRaw(OD.launchParams, "environmentMapRotation", &OD.LP.environmentMapRotation);
 
-    launchParamsSetBuffer(OD.launchParams, "environmentMapRows", OD.environmentMapRowsBuffer);
-    launchParamsSetBuffer(OD.launchParams, "environmentMapCols", OD.environmentMapColsBuffer);
+    launchParamsSetBuffer(OD.launchParams, "environmentMapAlias", OD.environmentMapAliasBuffer);
     launchParamsSetRaw(OD.launchParams, "environmentMapWidth", &OD.LP.environmentMapWidth);
     launchParamsSetRaw(OD.launchParams, "environmentMapHeight", &OD.LP.environmentMapHeight);
 
@@ -771,6 +1060,16 @@ void initializeOptix(bool headless)
     owlGeomTypeSetIntersectProg(OD.volumeGeomType, /*ray type */ 0, OD.module,"VolumeIntersection");
     owlGeomTypeSetIntersectProg(OD.volumeGeomType, /*ray type */ 1, OD.module,"VolumeIntersection");
     owlGeomTypeSetBoundsProg(OD.volumeGeomType, OD.module, "VolumeBounds");
+    OWLVarDecl pointsGeomVars[] = {
+        { "points", OWL_BUFPTR, OWL_OFFSETOF(PointsGeomData, points)},
+        {/* sentinel to mark end of list */}
+    };
+    OD.pointsGeomType = owlGeomTypeCreate(OD.context, OWL_GEOM_USER, sizeof(PointsGeomData), pointsGeomVars, -1);
+    owlGeomTypeSetClosestHit(OD.pointsGeomType, /*ray type */ 0, OD.module,"PointCloud");
+    owlGeomTypeSetClosestHit(OD.pointsGeomType, /*ray type */ 1, OD.module,"ShadowRay");
+    owlGeomTypeSetIntersectProg(OD.pointsGeomType, /*ray type */ 0, OD.module,"PointIntersection");
+    owlGeomTypeSetIntersectProg(OD.pointsGeomType, /*ray type */ 1, OD.module,"PointIntersection");
+    owlGeomTypeSetBoundsProg(OD.pointsGeomType, OD.module, "PointBounds");
 
     // Setup miss prog 
     OWLVarDecl missProgVars[] = {{ /* sentinel to mark end of list */ }};
@@ -829,7 +1128,7 @@ void initializeOptix(bool headless)
 
     setDomeLightSky(glm::vec3(0,0,10));
 
-    OptixData.LP.sceneBBMin = OptixData.LP.sceneBBMax = glm::vec3(0.f);
+    resetSceneAabb();
 }
 
 void initializeImgui()
@@ -854,6 +1153,10 @@ std::future<void> enqueueCommand(std::function<void()> function)
     NVISII::Command c;
     c.function = function;
     c.promise = std::make_shared<std::promise<void>>();
+    if (TraceRecorder::isEnabled()) {
+        c.traceId = TraceRecorder::newFlowId();
+        TraceRecorder::recordFlow("command", "command", c.traceId, /* start */ true);
+    }
     auto new_future = c.promise->get_future();
     NVISII.commandQueue.push(c);
     // cv.notify_one();
@@ -881,7 +1184,11 @@ void processCommandQueue()
     std::lock_guard<std::recursive_mutex> lock(NVISII.qMutex);
     while (!NVISII.commandQueue.empty()) {
         auto item = NVISII.commandQueue.front();
-        item.function();
+        {
+            TraceScope trace("command", "command");
+            if (item.traceId) TraceRecorder::recordFlow("command", "command", item.traceId, /* start */ false);
+            item.function();
+        }
         try {
             item.promise->set_value();
         }
@@ -893,6 +1200,7 @@ void processCommandQueue()
         }
         NVISII.commandQueue.pop();
     }
+    Frames.poll();
 }
 
 void setCameraEntity(Entity* camera_entity)
@@ -937,10 +1245,10 @@ void clearDomeLightTexture()
     resetAccumulation();
     enqueueCommand([] () {
         OptixData.LP.environmentMapID = -1;
-        if (OptixData.environmentMapRowsBuffer) owlBufferRelease(OptixData.environmentMapRowsBuffer);
-        if (OptixData.environmentMapColsBuffer) owlBufferRelease(OptixData.environmentMapColsBuffer);
-        OptixData.environmentMapRowsBuffer = nullptr;
-        OptixData.environmentMapColsBuffer = nullptr;
+        if (OptixData.environmentMapAliasBuffer) owlBufferRelease(OptixData.environmentMapAliasBuffer);
+        OptixData.environmentMapAliasBuffer = nullptr;
+        CPUData.environmentMapAlias.clear();
+        CPUData.proceduralSkyImage = nullptr;
         OptixData.LP.environmentMapWidth = -1;
         OptixData.LP.environmentMapHeight = -1;  
     });
@@ -951,126 +1259,175 @@ void generateDomeCDF()
 
 }
 
-// Uv range: [0, 1]
-vec3 toPolar(vec2 uv)
+/* A procedural sky image, along with its importance map if one was requested */
+struct ProceduralSkyImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<glm::vec4> texels;
+    DomeImportanceMap importanceMap;
+};
+
+/* Everything that influences the contents of a ProceduralSkyImage */
+struct ProceduralSkyKey {
+    vec3 sunPos, skyTint;
+    float atmosphereThickness, saturation;
+    uint32_t width, height;
+    bool enableCDF;
+    uint32_t maxCDFWidth;
+
+    bool operator==(const ProceduralSkyKey &o) const {
+        return sunPos == o.sunPos && skyTint == o.skyTint && 
+            atmosphereThickness == o.atmosphereThickness && saturation == o.saturation &&
+            width == o.width && height == o.height && 
+            enableCDF == o.enableCDF && maxCDFWidth == o.maxCDFWidth;
+    }
+};
+
+struct ProceduralSkyKeyHasher {
+    std::size_t operator()(const ProceduralSkyKey &k) const {
+        std::size_t seed = 0;
+        hash_combine(seed, k.sunPos.x, k.sunPos.y, k.sunPos.z, k.skyTint.x, k.skyTint.y, k.skyTint.z, 
+            k.atmosphereThickness, k.saturation, k.width, k.height, k.enableCDF, k.maxCDFWidth);
+        return seed;
+    }
+};
+
+static struct ProceduralSkyCache {
+    std::mutex mutex;
+    LRUCache<ProceduralSkyKey, std::shared_ptr<const ProceduralSkyImage>, ProceduralSkyKeyHasher> images = 
+        LRUCache<ProceduralSkyKey, std::shared_ptr<const ProceduralSkyImage>, ProceduralSkyKeyHasher>(16);
+} ProceduralSkyCache;
+
+/* Returns a cached procedural sky image, generating and caching it if required. 
+   Generation happens outside the cache lock, so other threads can hit the cache meanwhile. */
+static std::shared_ptr<const ProceduralSkyImage> getProceduralSkyImage(const ProceduralSkyKey &key)
 {
-    float theta = 2.0 * M_PI * uv.x + - M_PI / 2.0;
-    float phi = M_PI * uv.y;
+    std::shared_ptr<const ProceduralSkyImage> image;
+    {
+        std::lock_guard<std::mutex> lock(ProceduralSkyCache.mutex);
+        if (ProceduralSkyCache.images.get(key, image)) return image;
+    }
 
-    vec3 n;
-    n.x = cos(theta) * sin(phi);
-    n.y = sin(theta) * sin(phi);
-    n.z = cos(phi);
+    auto generated = std::make_shared<ProceduralSkyImage>();
+    generated->width = key.width;
+    generated->height = key.height;
+    generated->texels.resize(size_t(key.width) * size_t(key.height));
+    generateProceduralSkyImage(generated->texels.data(), key.width, key.height, 
+        key.sunPos, key.skyTint, key.atmosphereThickness, key.saturation);
+    if (key.enableCDF) {
+        const glm::vec4* texels = generated->texels.data();
+        uint32_t width = key.width;
+        generated->importanceMap = buildDomeImportanceMap(key.width, key.height, 
+            [texels, width] (uint32_t x, uint32_t y) {
+                const glm::vec4 &t = texels[y * width + x];
+                return domeLuminance(t.r, t.g, t.b);
+            }, key.maxCDFWidth);
+    }
 
-    //n = normalize(n);
-    // n.z = -n.z;
-    // n.x = -n.x;
-    return n;
+    std::lock_guard<std::mutex> lock(ProceduralSkyCache.mutex);
+    ProceduralSkyCache.images.put(key, generated);
+    return generated;
 }
 
-void setDomeLightSky(vec3 sunPos, vec3 skyTint, float atmosphereThickness, float saturation)
+static ProceduralSkyKey makeProceduralSkyKey(vec3 sunPos, vec3 skyTint, float atmosphereThickness, float saturation, 
+    uint32_t width, uint32_t height, bool enableCDF, uint32_t maxCDFWidth)
 {
-    enqueueCommand([sunPos, skyTint, atmosphereThickness, saturation] () {
-        /* Generate procedural sky */
-        uint32_t width = 1024/2;
-        uint32_t height = 512/2;
-        std::vector<glm::vec4> texels(width * height);
-        for (uint32_t y = 0; y < height; ++y) {
-            for (uint32_t x = 0; x < width; ++x) {
-                glm::vec2 uv = glm::vec2(x / float(width), y / float(height));
-                glm::vec3 dir = toPolar(uv);
-                glm::vec3 c = ProceduralSkybox(glm::vec3(dir.x, -dir.z, dir.y), glm::vec3(sunPos.x, sunPos.z, sunPos.y), skyTint, atmosphereThickness, saturation);
-                texels[x + y * width] = glm::vec4(c.r, c.g, c.b, 1.0f);
-            }
-        }
+    if (width == 0) throw std::runtime_error("Error: procedural sky width must be greater than 0!");
+    if (height == 0) throw std::runtime_error("Error: procedural sky height must be greater than 0!");
+    ProceduralSkyKey key;
+    key.sunPos = sunPos;
+    key.skyTint = skyTint;
+    key.atmosphereThickness = atmosphereThickness;
+    key.saturation = saturation;
+    key.width = width;
+    key.height = height;
+    key.enableCDF = enableCDF;
+    key.maxCDFWidth = (enableCDF) ? maxCDFWidth : 0;
+    return key;
+}
+
+void setDomeLightSky(vec3 sunPos, vec3 skyTint, float atmosphereThickness, float saturation, 
+    uint32_t width, uint32_t height, bool enableCDF, uint32_t maxCDFWidth)
+{
+    ProceduralSkyKey key = makeProceduralSkyKey(sunPos, skyTint, atmosphereThickness, saturation, width, height, enableCDF, maxCDFWidth);
+    enqueueCommand([key] () {
+        /* Generate procedural sky, or reuse a previously generated one */
+        auto image = getProceduralSkyImage(key);
 
         //debug
-        // stbi_write_hdr("./proceduralSky.hdr", width, height, 4, (float*)texels.data());
+        // stbi_write_hdr("./proceduralSky.hdr", image->width, image->height, 4, (float*)image->texels.data());
 
         OptixData.LP.environmentMapID = -2;
-        if (OptixData.proceduralSkyTexture) {
-            owlTexture2DDestroy(OptixData.proceduralSkyTexture);
-        }
-        OptixData.proceduralSkyTexture = owlTexture2DCreate(OptixData.context, OWL_TEXEL_FORMAT_RGBA32F, width, height, texels.data());
-        owlParamsSetTexture(OptixData.launchParams, "proceduralSkyTexture", OptixData.proceduralSkyTexture);
-
-        // float invWidth = 1.f / float(width);
-        // float invHeight = 1.f / float(height);
-        // float invjacobian = width * height / float(4 * M_PI);
-
-        // auto rows = std::vector<float>(height);
-        // auto cols = std::vector<float>(width * height);
-        // for (int y = 0, i = 0; y < height; y++) {
-        //     for (int x = 0; x < width; x++, i++) {
-        //         cols[i] = std::max(texels[i].r, std::max(texels[i].g, texels[i].b)) + ((x > 0) ? cols[i - 1] : 0.f);
-        //     }
-        //     rows[y] = cols[i - 1] + ((y > 0) ? rows[y - 1] : 0.0f);
-        //     // normalize the pdf for this scanline (if it was non-zero)
-        //     if (cols[i - 1] > 0) {
-        //         for (int x = 0; x < width; x++) {
-        //             cols[i - width + x] /= cols[i - 1];
-        //         }
-        //     }
-        // }
-
-        // // normalize the pdf across all scanlines
-        // for (int y = 0; y < height; y++)
-        //     rows[y] /= rows[height - 1];
-        
-        // if (OptixData.environmentMapRowsBuffer) owlBufferRelease(OptixData.environmentMapRowsBuffer);
-        // if (OptixData.environmentMapColsBuffer) owlBufferRelease(OptixData.environmentMapColsBuffer);
-        // OptixData.environmentMapRowsBuffer = owlDeviceBufferCreate(OptixData.context, OWL_USER_TYPE(float), height, rows.data());
-        // OptixData.environmentMapColsBuffer = owlDeviceBufferCreate(OptixData.context, OWL_USER_TYPE(float), width * height, cols.data());
-        // OptixData.LP.environmentMapWidth = width;
-        // OptixData.LP.environmentMapHeight = height;  
-
-        OptixData.LP.environmentMapWidth = 0;
-        OptixData.LP.environmentMapHeight = 0;  
+        if (cpuBackend) {
+            // The CPU backend reads the texels and importance map straight from the cached image
+            CPUData.proceduralSkyImage = image;
+        }
+        else {
+            if (OptixData.proceduralSkyTexture) {
+                owlTexture2DDestroy(OptixData.proceduralSkyTexture);
+            }
+            OptixData.proceduralSkyTexture = texture2DCreate(OptixData.context, OWL_TEXEL_FORMAT_RGBA32F, image->width, image->height, image->texels.data());
+            owlParamsSetTexture(OptixData.launchParams, "proceduralSkyTexture", OptixData.proceduralSkyTexture);
+        }
+
+        if (key.enableCDF) {
+            const DomeImportanceMap &map = image->importanceMap;
+            if (OptixData.environmentMapAliasBuffer) owlBufferRelease(OptixData.environmentMapAliasBuffer);
+            OptixData.environmentMapAliasBuffer = nullptr;
+            if (!cpuBackend) OptixData.environmentMapAliasBuffer = owlDeviceBufferCreate(OptixData.context, OWL_USER_TYPE(AliasTableEntry), map.table.size(), map.table.data());
+            OptixData.LP.environmentMapWidth = map.width;
+            OptixData.LP.environmentMapHeight = map.height;  
+        }
+        else {
+            OptixData.LP.environmentMapWidth = 0;
+            OptixData.LP.environmentMapHeight = 0;  
+        }
         resetAccumulation();
     });
 }
 
-void setDomeLightTexture(Texture* texture, bool enableCDF)
+void precomputeDomeLightSky(std::vector<vec3> sunPositions, vec3 skyTint, float atmosphereThickness, float saturation, 
+    uint32_t width, uint32_t height, bool enableCDF, uint32_t maxCDFWidth)
 {
-    enqueueCommand([texture, enableCDF] () {
-        OptixData.LP.environmentMapID = texture->getId();
-        if (enableCDF) {
-            std::vector<glm::vec4> texels = texture->getFloatTexels();
-
-            int width = texture->getWidth();
-            int height = texture->getHeight();
-            int cdfWidth = width;
-            int cdfHeight = height;
-
-            float invWidth = 1.f / float(cdfWidth);
-            float invHeight = 1.f / float(cdfHeight);
-            float invjacobian = cdfWidth * cdfHeight / float(4 * M_PI);
-
-            auto rows = std::vector<float>(cdfHeight);
-            auto cols = std::vector<float>(cdfWidth * cdfHeight);
-            for (int y = 0, i = 0; y < cdfHeight; y++) {
-                for (int x = 0; x < cdfWidth; x++, i++) {
-                    glm::vec4 texel = texels[i];
-                    cols[i] = std::max(texel.r, std::max(texel.g, texel.b)) + ((x > 0) ? cols[i - 1] : 0.f);
-                }
-                rows[y] = cols[i - 1] + ((y > 0) ? rows[y - 1] : 0.0f);
-                // normalize the pdf for this scanline (if it was non-zero)
-                if (cols[i - 1] > 0) {
-                    for (int x = 0; x < cdfWidth; x++) {
-                        cols[i - cdfWidth + x] /= cols[i - 1];
-                    }
-                }
-            }
+    std::vector<ProceduralSkyKey> keys;
+    for (auto &sunPos : sunPositions) {
+        keys.push_back(makeProceduralSkyKey(sunPos, skyTint, atmosphereThickness, saturation, width, height, enableCDF, maxCDFWidth));
+    }
+    {
+        // Make sure the whole sequence fits, otherwise the first frames would be evicted by the last ones
+        std::lock_guard<std::mutex> lock(ProceduralSkyCache.mutex);
+        if (ProceduralSkyCache.images.getCapacity() < keys.size()) {
+            ProceduralSkyCache.images.setCapacity(keys.size());
+        }
+    }
+    // Each image is already generated across all hardware threads
+    for (auto &key : keys) getProceduralSkyImage(key);
+}
 
-            // normalize the pdf across all scanlines
-            for (int y = 0; y < cdfHeight; y++) rows[y] /= rows[cdfHeight - 1];
+void setDomeLightSkyCacheSize(uint32_t size)
+{
+    std::lock_guard<std::mutex> lock(ProceduralSkyCache.mutex);
+    ProceduralSkyCache.images.setCapacity(size);
+}
 
-            if (OptixData.environmentMapRowsBuffer) owlBufferRelease(OptixData.environmentMapRowsBuffer);
-            if (OptixData.environmentMapColsBuffer) owlBufferRelease(OptixData.environmentMapColsBuffer);
-            OptixData.environmentMapRowsBuffer = owlDeviceBufferCreate(OptixData.context, OWL_USER_TYPE(float), cdfHeight, rows.data());
-            OptixData.environmentMapColsBuffer = owlDeviceBufferCreate(OptixData.context, OWL_USER_TYPE(float), cdfWidth * cdfHeight, cols.data());
-            OptixData.LP.environmentMapWidth = cdfWidth;
-            OptixData.LP.environmentMapHeight = cdfHeight;  
+void setDomeLightTexture(Texture* texture, bool enableCDF, uint32_t maxCDFWidth)
+{
+    enqueueCommand([texture, enableCDF, maxCDFWidth] () {
+        OptixData.LP.environmentMapID = texture->getId();
+        if (enableCDF) {
+            // Build a sin(theta) weighted luminance importance map, read directly from the texture's texels
+            auto editMutex = Texture::getEditMutex();
+            std::lock_guard<std::recursive_mutex> lock(*editMutex.get());
+            DomeImportanceMap map = buildDomeImportanceMap(texture->getWidth(), texture->getHeight(), 
+                [texture] (uint32_t x, uint32_t y) { return texture->getLinearLuminance(x, y); }, 
+                maxCDFWidth);
+
+            if (OptixData.environmentMapAliasBuffer) owlBufferRelease(OptixData.environmentMapAliasBuffer);
+            OptixData.environmentMapAliasBuffer = nullptr;
+            if (cpuBackend) CPUData.environmentMapAlias = map.table;
+            else OptixData.environmentMapAliasBuffer = owlDeviceBufferCreate(OptixData.context, OWL_USER_TYPE(AliasTableEntry), map.table.size(), map.table.data());
+            OptixData.LP.environmentMapWidth = map.width;
+            OptixData.LP.environmentMapHeight = map.height;  
         }
         else {
             OptixData.LP.environmentMapWidth = 0;
@@ -1098,6 +1455,18 @@ void disableDomeLightSampling()
     resetAccumulation();
 }
 
+void enableLightTree()
+{
+    OptixData.LP.enableLightTree = true;
+    resetAccumulation();
+}
+
+void disableLightTree()
+{
+    OptixData.LP.enableLightTree = false;
+    resetAccumulation();
+}
+
 void setIndirectLightingClamp(float clamp)
 {
     clamp = std::max(float(clamp), float(0.f));
@@ -1150,6 +1519,20 @@ void setLightSampleCount(uint32_t count)
     resetAccumulation();
 }
 
+void setSampler(std::string sampler)
+{
+    std::string name = sampler;
+    std::transform(name.data(), name.data() + name.size(), std::addressof(name[0]), [](unsigned char c){ return std::tolower(c); });
+    if (name == std::string("independent")) OptixData.LP.samplerType = SAMPLER_INDEPENDENT;
+    else if (name == std::string("sobol")) OptixData.LP.samplerType = SAMPLER_SOBOL;
+    else if (name == std::string("pmj02")) OptixData.LP.samplerType = SAMPLER_PMJ02;
+    else if (name == std::string("blue_noise")) OptixData.LP.samplerType = SAMPLER_BLUE_NOISE;
+    else throw std::runtime_error(std::string("Error, unknown sampler : \"") + sampler + std::string("\". ")
+        + std::string("Options are \"independent\", \"sobol\", \"pmj02\" and \"blue_noise\"."));
+    launchParamsSetRaw(OptixData.launchParams, "samplerType", &OptixData.LP.samplerType);
+    resetAccumulation();
+}
+
 void samplePixelArea(vec2 xSampleInterval, vec2 ySampleInterval)
 {
     OptixData.LP.xPixelSamplingInterval = xSampleInterval;
@@ -1166,74 +1549,390 @@ void sampleTimeInterval(vec2 sampleTimeInterval)
     resetAccumulation();
 }
 
-void updateComponents()
+void enableAdaptiveSampling(float errorThreshold, uint32_t minSamples, float maxSampleScale, uint32_t tileSize)
+{
+    if (errorThreshold < 0.f) throw std::runtime_error("Error: adaptive sampling error threshold must not be negative");
+    if (maxSampleScale < 1.f) throw std::runtime_error("Error: adaptive sampling max sample scale must be at least 1");
+    if (tileSize == 0) throw std::runtime_error("Error: adaptive sampling tile size must be greater than 0");
+    OptixData.enableAdaptiveSampling = true;
+    OptixData.adaptiveErrorThreshold = errorThreshold;
+    OptixData.adaptiveMinSamples = minSamples;
+    OptixData.adaptiveMaxSampleScale = maxSampleScale;
+    OptixData.adaptiveTileSize = tileSize;
+}
+
+void disableAdaptiveSampling()
+{
+    OptixData.enableAdaptiveSampling = false;
+}
+
+float getRenderedSamplesPerPixel()
+{
+    return OptixData.renderedSamplesPerPixel;
+}
+
+std::vector<std::map<std::string, double>> getFrameStatistics(uint32_t frameCount)
+{
+    return Profiler.getFrames(frameCount);
+}
+
+void setFrameStatisticsHistorySize(uint32_t frameCount)
+{
+    Profiler.setHistorySize(frameCount);
+}
+
+void clearFrameStatistics()
+{
+    Profiler.clear();
+}
+
+void enableTracing(uint32_t eventsPerThread)
+{
+    TraceRecorder::enable(eventsPerThread);
+}
+
+void disableTracing()
+{
+    TraceRecorder::disable();
+}
+
+void clearTrace()
+{
+    TraceRecorder::clear();
+}
+
+void saveTrace(std::string path)
+{
+    TraceRecorder::save(path);
+}
+
+/* Only called on the render thread, which resizes the frame buffers, readback slots and scene buffers read here */
+static std::map<std::string, std::map<std::string, double>> computeMemoryUsage()
 {
     auto &OD = OptixData;
-    
+    std::map<std::string, MemoryTracker::Usage> usage = Memory.getUsage();
+
+    // Buffers shared by the whole scene are read directly, since their sizes are always at hand
+    auto add = [&usage] (const std::string &category, const std::string &name, uint64_t hostBytes, uint64_t deviceBytes) {
+        for (auto key : {category, category + "/" + name}) {
+            usage[key].hostBytes += hostBytes;
+            usage[key].deviceBytes += deviceBytes;
+        }
+    };
+    auto deviceBytes = [] (OWLBuffer buffer) -> uint64_t { return (!cpuBackend && buffer) ? owlBufferSizeInBytes(buffer) : 0; };
+    auto hostBytes = [] (const std::vector<glm::vec4> &buffer) -> uint64_t { return buffer.size() * sizeof(glm::vec4); };
+
+    // The preallocated component arrays, along with their device copies
+    add("factories", "entity", Entity::getCount() * (sizeof(Entity) + sizeof(EntityStruct)), deviceBytes(OD.entityBuffer));
+    add("factories", "transform", Transform::getCount() * (sizeof(Transform) + sizeof(TransformStruct)), deviceBytes(OD.transformBuffer));
+    add("factories", "camera", Camera::getCount() * (sizeof(Camera) + sizeof(CameraStruct)), deviceBytes(OD.cameraBuffer));
+    add("factories", "material", Material::getCount() * (sizeof(Material) + sizeof(MaterialStruct)), deviceBytes(OD.materialBuffer));
+    add("factories", "light", Light::getCount() * (sizeof(Light) + sizeof(LightStruct)), deviceBytes(OD.lightBuffer));
+    add("factories", "mesh", Mesh::getCount() * (sizeof(Mesh) + sizeof(MeshStruct)), 
+        deviceBytes(OD.meshBuffer) + deviceBytes(OD.vertexListsBuffer) + deviceBytes(OD.normalListsBuffer) + deviceBytes(OD.tangentListsBuffer) 
+        + deviceBytes(OD.texCoordListsBuffer) + deviceBytes(OD.indexListsBuffer) + deviceBytes(OD.pointListsBuffer) 
+        + deviceBytes(OD.pointColorListsBuffer) + deviceBytes(OD.triangleSelectionOffsetsBuffer));
+    add("factories", "texture", Texture::getCount() * (sizeof(Texture) + sizeof(TextureStruct)), 
+        deviceBytes(OD.textureBuffer) + deviceBytes(OD.textureObjectsBuffer));
+    add("factories", "volume", Volume::getCount() * (sizeof(Volume) + sizeof(VolumeStruct)), 
+        deviceBytes(OD.volumeBuffer) + deviceBytes(OD.volumeHandlesBuffer));
+
+    // Frame buffers
+    if (cpuBackend) {
+        add("frame_buffers", "frame", hostBytes(CPUData.frameBuffer), 0);
+        add("frame_buffers", "albedo", hostBytes(CPUData.albedoBuffer), 0);
+        add("frame_buffers", "normal", hostBytes(CPUData.normalBuffer), 0);
+        add("frame_buffers", "half", hostBytes(CPUData.halfBuffer), 0);
+        add("frame_buffers", "temporal_guides", hostBytes(CPUData.guideBuffer), 0);
+        add("frame_buffers", "history", hostBytes(CPUData.historyBuffer) + hostBytes(CPUData.historyGuideBuffer), 0);
+    } else {
+        add("frame_buffers", "frame", 0, deviceBytes(OD.frameBuffer));
+        add("frame_buffers", "accumulation", 0, deviceBytes(OD.accumBuffer));
+        add("frame_buffers", "half", 0, deviceBytes(OD.halfBuffer));
+        add("frame_buffers", "albedo", 0, deviceBytes(OD.albedoBuffer));
+        add("frame_buffers", "normal", 0, deviceBytes(OD.normalBuffer));
+        add("frame_buffers", "scratch", 0, deviceBytes(OD.scratchBuffer));
+        add("frame_buffers", "motion_vectors", 0, deviceBytes(OD.mvecBuffer));
+        add("frame_buffers", "adaptive_tile_mask", 0, deviceBytes(OD.adaptiveTileMaskBuffer));
+        add("frame_buffers", "history", 0, deviceBytes(OD.historyBuffer) + deviceBytes(OD.historyGuideBuffer));
+        add("frame_buffers", "denoiser", 0, deviceBytes(OD.denoiserScratchBuffer) + deviceBytes(OD.denoiserStateBuffer));
+    }
+
+    // Top level acceleration structures and light sampling tables
+    if (!cpuBackend && OD.context) {
+        add("scene", "surface_instances", 0, instanceAccelSizeInBytes(uint32_t(deviceBytes(OD.surfaceInstanceToEntityBuffer) / sizeof(uint32_t)))
+            + deviceBytes(OD.surfaceInstanceToEntityBuffer) + deviceBytes(OD.surfaceInstanceToMaterialBuffer));
+        add("scene", "volume_instances", 0, instanceAccelSizeInBytes(uint32_t(deviceBytes(OD.volumeInstanceToEntityBuffer) / sizeof(uint32_t)))
+            + deviceBytes(OD.volumeInstanceToEntityBuffer));
+        add("scene", "light_selection", 0, deviceBytes(OD.lightEntitiesBuffer) + deviceBytes(OD.lightSelectionBuffer)
+            + deviceBytes(OD.triangleSelectionBuffer) + deviceBytes(OD.lightTreeBuffer));
+        add("scene", "dome_light", 0, deviceBytes(OD.environmentMapAliasBuffer));
+    }
+
+    std::map<std::string, std::map<std::string, double>> result;
+    MemoryTracker::Usage total;
+    for (auto &u : usage) {
+        result[u.first]["host_bytes"] = double(u.second.hostBytes);
+        result[u.first]["device_bytes"] = double(u.second.deviceBytes);
+        if (u.first.find('/') != std::string::npos) continue;
+        total.hostBytes += u.second.hostBytes;
+        total.deviceBytes += u.second.deviceBytes;
+    }
+    result["total"]["host_bytes"] = double(total.hostBytes);
+    result["total"]["device_bytes"] = double(total.deviceBytes);
+    return result;
+}
+
+std::map<std::string, std::map<std::string, double>> getMemoryUsage()
+{
+    if (!initialized) return computeMemoryUsage();
+    std::map<std::string, std::map<std::string, double>> result;
+    enqueueCommandAndWait([&result] () { result = computeMemoryUsage(); });
+    return result;
+}
+
+void setThreadCount(uint32_t numThreads)
+{
+    // The render thread uses the pool while rendering on the CPU, so it is resized in between frames
+    if (initialized) enqueueCommandAndWait([numThreads] () { ThreadPool::global().resize(numThreads); });
+    else ThreadPool::global().resize(numThreads);
+}
+
+uint32_t getThreadCount()
+{
+    return ThreadPool::global().getThreadCount();
+}
+
+void enableTemporalAccumulation(float maxHistorySamples, float depthTolerance)
+{
+    if (maxHistorySamples < 0.f) throw std::runtime_error("Error: max history samples must not be negative");
+    if (depthTolerance < 0.f) throw std::runtime_error("Error: depth tolerance must not be negative");
+    OptixData.temporalMaxHistorySamples = maxHistorySamples;
+    OptixData.temporalDepthTolerance = depthTolerance;
+    if (!OptixData.enableTemporalAccumulation) OptixData.temporalHistoryValid = false;
+    OptixData.enableTemporalAccumulation = true;
+}
+
+void disableTemporalAccumulation()
+{
+    OptixData.enableTemporalAccumulation = false;
+    OptixData.temporalHistoryValid = false;
+}
+
+void clearTemporalHistory()
+{
+    OptixData.temporalHistoryValid = false;
+}
+
+/* Edits accumulate here until they are committed, and are applied to the published scene at the next update */
+static struct SceneCommits {
+    std::mutex mutex;
+    std::mutex captureMutex;
+    std::deque<SceneSnapshot> pending;
+    uint64_t generation = 0;
+    std::atomic<bool> manual{false};
+} Commits;
+
+/* The scene the renderer reads from. Only touched by the render thread. */
+static PublishedScene Published;
+
+/* 
+ * Captures the edits made since the previous commit and queues them for the renderer.
+ * @returns the generation of the commit, which contains all edits made before it
+ */
+static uint64_t commitScene()
+{
+    // Captures must be queued in the order they were taken
+    std::lock_guard<std::mutex> captureLock(Commits.captureMutex);
+    SceneSnapshot snapshot = captureScene();
+    std::lock_guard<std::mutex> lock(Commits.mutex);
+    snapshot.generation = ++Commits.generation;
+    if (!snapshot.empty()) Commits.pending.push_back(std::move(snapshot));
+    return Commits.generation;
+}
+
+/* @returns the commits up to and including the given generation, folded into one, and removes them from the queue */
+static SceneSnapshot takeCommits(uint64_t generation)
+{
+    std::lock_guard<std::mutex> lock(Commits.mutex);
+    SceneSnapshot changes;
+    while (!Commits.pending.empty() && Commits.pending.front().generation <= generation) {
+        changes.merge(std::move(Commits.pending.front()));
+        Commits.pending.pop_front();
+    }
+    return changes;
+}
+
+void commit()
+{
+    commitScene();
+}
+
+void enableManualCommit()
+{
+    Commits.manual = true;
+}
+
+void disableManualCommit()
+{
+    Commits.manual = false;
+}
+
+bool isManualCommitEnabled()
+{
+    return Commits.manual;
+}
+
+/* Updates the host memory held by changed meshes, textures and volumes, forgetting those which were removed */
+static void trackComponentHostMemory(const SceneSnapshot &changes)
+{
+    for (auto &m : changes.meshes) {
+        if (m.removed) { Memory.remove("mesh", m.id); continue; }
+        // positions, normals, tangents, colors and texture coordinates, followed by triangle indices, or by point radii
+        uint64_t vertexSize = sizeof(std::array<float, 3>) + 3 * sizeof(vec4) + sizeof(vec2);
+        uint64_t bytes = uint64_t(m.positions.size()) * vertexSize + uint64_t(m.triangleIndices.size()) * sizeof(uint32_t)
+            + uint64_t(m.radii.size()) * sizeof(float);
+        Memory.setHostBytes("mesh", m.id, m.name, bytes);
+    }
+    for (auto &t : changes.textures) {
+        if (t.removed) { Memory.remove("texture", t.id); continue; }
+        uint64_t texelSize = t.isHDR() ? sizeof(vec4) : sizeof(u8vec4);
+        Memory.setHostBytes("texture", t.id, t.name, uint64_t(t.width) * t.height * texelSize);
+    }
+    for (auto &v : changes.volumes) {
+        if (v.removed) { Memory.remove("volume", v.id); continue; }
+        Memory.setHostBytes("volume", v.id, v.name, v.gridHdlPtr->size());
+    }
+}
+
+/* Applies the given commits to the published scene, and brings the renderer up to date with it */
+static void updateComponents(const SceneSnapshot &changes)
+{
+    auto &OD = OptixData;
+    ScopedTimer timer(Profiler, "update_components");
+
+    Published.apply(changes);
+    trackComponentHostMemory(changes);
+
     if (OptixData.LP.cameraEntity.initialized) {
-        auto transform = Transform::getFront()[OptixData.LP.cameraEntity.transform_id];
-        auto camera = Camera::getFront()[OptixData.LP.cameraEntity.camera_id];
-        OptixData.LP.proj = camera.getProjection();
-        OptixData.LP.viewT0 = transform.getWorldToLocalMatrix(/*previous = */ true);
-        OptixData.LP.viewT1 = transform.getWorldToLocalMatrix(/*previous = */ false);
-    }
-
-    // If any of the components are dirty, reset accumulation
-    bool anyUpdated = false;
-    anyUpdated |= Mesh::areAnyDirty();
-    anyUpdated |= Material::areAnyDirty();
-    anyUpdated |= Camera::areAnyDirty();
-    anyUpdated |= Transform::areAnyDirty();
-    anyUpdated |= Light::areAnyDirty();
-    anyUpdated |= Texture::areAnyDirty();
-    anyUpdated |= Entity::areAnyDirty();
-    anyUpdated |= Volume::areAnyDirty();
-
-    if (!anyUpdated) return;
+        int32_t tid = OptixData.LP.cameraEntity.transform_id;
+        int32_t cid = OptixData.LP.cameraEntity.camera_id;
+        if (tid >= 0 && tid < int32_t(Published.transformStructs.size()) && cid >= 0 && cid < int32_t(Published.cameraStructs.size())) {
+            OptixData.LP.proj = Published.cameraStructs[cid].proj;
+            OptixData.LP.viewT0 = glm::inverse(Published.transformStructs[tid].localToWorldPrev);
+            OptixData.LP.viewT1 = glm::inverse(Published.transformStructs[tid].localToWorld);
+        }
+    }
+
+    // The CPU backend keeps its own copy of the scene
+    if (cpuBackend) {
+        if (cpuUpdateComponents(changes, Published)) resetAccumulation();
+        return;
+    }
+
+    // If any of the components changed, reset accumulation
+    if (changes.empty()) return;
     resetAccumulation();
-    
-    std::recursive_mutex dummyMutex;
-    std::lock_guard<std::recursive_mutex> mesh_lock(Mesh::areAnyDirty()           ? *Mesh::getEditMutex().get() : dummyMutex);
-    std::lock_guard<std::recursive_mutex> camera_lock(Camera::areAnyDirty()       ? *Camera::getEditMutex().get() : dummyMutex);
-    std::lock_guard<std::recursive_mutex> transform_lock(Transform::areAnyDirty() ? *Transform::getEditMutex().get() : dummyMutex);
-    std::lock_guard<std::recursive_mutex> entity_lock(Entity::areAnyDirty()       ? *Entity::getEditMutex().get() : dummyMutex);
-    std::lock_guard<std::recursive_mutex> light_lock(Light::areAnyDirty()         ? *Light::getEditMutex().get() : dummyMutex);
-    std::lock_guard<std::recursive_mutex> texture_lock(Texture::areAnyDirty()     ? *Texture::getEditMutex().get() : dummyMutex);
-    std::lock_guard<std::recursive_mutex> volume_lock(Volume::areAnyDirty()       ? *Volume::getEditMutex().get() : dummyMutex);
+
+    // Light selection depends on light emission, light placement and the emitting geometry
+    bool lightSelectionDirty = changes.areMeshesDirty() || changes.areTransformsDirty() || changes.areLightsDirty() || changes.areEntitiesDirty();
+    // If only light transforms changed, the light tree can be refit rather than rebuilt
+    bool lightTreeRefitOnly = !(changes.areMeshesDirty() || changes.areLightsDirty() || changes.areEntitiesDirty());
+
+    // Nothing below reads the components, so edits can continue while the renderer builds and uploads
 
     // Manage Meshes: Build / Rebuild BLAS
-    auto dirtyMeshes = Mesh::getDirtyMeshes();
-    if (dirtyMeshes.size() > 0) {
-        for (auto &m : dirtyMeshes) {
-            // First, release any resources from a previous, stale mesh.
-            if (OD.vertexLists[m->getAddress()]) { 
-                owlBufferRelease(OD.vertexLists[m->getAddress()]); 
-                OD.vertexLists[m->getAddress()] = nullptr; 
+    if (changes.meshes.size() > 0) {
+        ScopedTimer meshTimer(Profiler, "mesh_update");
+        Profiler.addCount("meshes_updated", double(changes.meshes.size()));
+        for (auto &m : changes.meshes) {
+            uint32_t id = m.id;
+            // Point clouds which kept their number of points, eg the particles of a simulation, are updated 
+            // in place: the points are uploaded into the existing buffer, and the BLAS is rebuilt over the same geometry.
+            bool isPointCloud = !m.removed && (m.radii.size() > 0);
+            if (isPointCloud && OD.pointLists[id] && OD.surfaceBlasList[id]
+                && (owlBufferSizeInBytes(OD.pointLists[id]) == m.radii.size() * sizeof(vec4))) {
+                std::vector<vec4> points = packPoints(m.positions, m.radii);
+                bufferUpload(OD.pointLists[id], points.data());
+                if (OD.pointColorLists[id] && (owlBufferSizeInBytes(OD.pointColorLists[id]) == m.colors.size() * sizeof(vec4))) {
+                    bufferUpload(OD.pointColorLists[id], m.colors.data());
+                } else {
+                    if (OD.pointColorLists[id]) { owlBufferRelease(OD.pointColorLists[id]); OD.pointColorLists[id] = nullptr; }
+                    if (m.colors.size() > 0) OD.pointColorLists[id] = deviceBufferCreate(OD.context, OWL_USER_TYPE(vec4), m.colors.size(), m.colors.data());
+                }
+                groupBuildAccel(OD.surfaceBlasList[id]);
+                Profiler.addCount("point_cloud_updates");
+
+                uint64_t pointBytes = owlBufferSizeInBytes(OD.pointLists[id]) 
+                    + (OD.pointColorLists[id] ? owlBufferSizeInBytes(OD.pointColorLists[id]) : 0)
+                    + userGeomAccelSizeInBytes(uint32_t(m.radii.size()));
+                Memory.setDeviceBytes("mesh", id, m.name, pointBytes);
+                continue;
             }
-            if (OD.normalLists[m->getAddress()]) { owlBufferRelease(OD.normalLists[m->getAddress()]); OD.normalLists[m->getAddress()] = nullptr; }
-            if (OD.tangentLists[m->getAddress()]) { owlBufferRelease(OD.tangentLists[m->getAddress()]); OD.tangentLists[m->getAddress()] = nullptr; }
-            if (OD.texCoordLists[m->getAddress()]) { owlBufferRelease(OD.texCoordLists[m->getAddress()]); OD.texCoordLists[m->getAddress()] = nullptr; }
-            if (OD.indexLists[m->getAddress()]) { owlBufferRelease(OD.indexLists[m->getAddress()]); OD.indexLists[m->getAddress()] = nullptr; }
-            if (OD.surfaceGeomList[m->getAddress()]) { owlGeomRelease(OD.surfaceGeomList[m->getAddress()]); OD.surfaceGeomList[m->getAddress()] = nullptr; }
-            if (OD.surfaceBlasList[m->getAddress()]) { owlGroupRelease(OD.surfaceBlasList[m->getAddress()]); OD.surfaceBlasList[m->getAddress()] = nullptr; }
+
+            // First, release any resources from a previous, stale mesh.
+            if (OD.vertexLists[id]) { owlBufferRelease(OD.vertexLists[id]); OD.vertexLists[id] = nullptr; }
+            if (OD.normalLists[id]) { owlBufferRelease(OD.normalLists[id]); OD.normalLists[id] = nullptr; }
+            if (OD.tangentLists[id]) { owlBufferRelease(OD.tangentLists[id]); OD.tangentLists[id] = nullptr; }
+            if (OD.texCoordLists[id]) { owlBufferRelease(OD.texCoordLists[id]); OD.texCoordLists[id] = nullptr; }
+            if (OD.indexLists[id]) { owlBufferRelease(OD.indexLists[id]); OD.indexLists[id] = nullptr; }
+            if (OD.pointLists[id]) { owlBufferRelease(OD.pointLists[id]); OD.pointLists[id] = nullptr; }
+            if (OD.pointColorLists[id]) { owlBufferRelease(OD.pointColorLists[id]); OD.pointColorLists[id] = nullptr; }
+            if (OD.surfaceGeomList[id]) { owlGeomRelease(OD.surfaceGeomList[id]); OD.surfaceGeomList[id] = nullptr; }
+            if (OD.surfaceBlasList[id]) { owlGroupRelease(OD.surfaceBlasList[id]); OD.surfaceBlasList[id] = nullptr; }
+            std::vector<AliasTableEntry>().swap(OD.meshTriangleTables[id]);
             
-            // At this point, if the mesh no longer exists, move to the next dirty mesh.
-            if (!m->isInitialized()) continue;
-            if (m->getTriangleIndices().size() == 0) throw std::runtime_error("ERROR: indices is 0");
+            // At this point, if the mesh no longer exists, move to the next changed mesh.
+            if (m.removed) continue;
+
+            // Point clouds are a user geometry of spheres, intersected by PointIntersection, with no triangles to sample as lights
+            if (isPointCloud) {
+                std::vector<vec4> points = packPoints(m.positions, m.radii);
+                OD.pointLists[id] = deviceBufferCreate(OD.context, OWL_USER_TYPE(vec4), points.size(), points.data());
+                if (m.colors.size() > 0) OD.pointColorLists[id] = deviceBufferCreate(OD.context, OWL_USER_TYPE(vec4), m.colors.size(), m.colors.data());
+
+                OD.surfaceGeomList[id] = geomCreate(OD.context, OD.pointsGeomType);
+                owlGeomSetPrimCount(OD.surfaceGeomList[id], points.size());
+                geomSetBuffer(OD.surfaceGeomList[id], "points", OD.pointLists[id]);
+                OD.surfaceBlasList[id] = owlUserGeomGroupCreate(OD.context, 1, &OD.surfaceGeomList[id]);
+                groupBuildAccel(OD.surfaceBlasList[id]);
+                Profiler.addCount("blas_builds");
+                OD.meshSurfaceAreas[id] = 0.f;
+
+                uint64_t pointBytes = owlBufferSizeInBytes(OD.pointLists[id]) 
+                    + (OD.pointColorLists[id] ? owlBufferSizeInBytes(OD.pointColorLists[id]) : 0)
+                    + userGeomAccelSizeInBytes(uint32_t(points.size()));
+                Memory.setDeviceBytes("mesh", id, m.name, pointBytes);
+                continue;
+            }
+            if (m.triangleIndices.size() == 0) throw std::runtime_error("ERROR: indices is 0");
 
             // Next, allocate resources for the new mesh.
-            OD.vertexLists[m->getAddress()]  = deviceBufferCreate(OD.context, OWL_USER_TYPE(vec3), m->getVertices().size(), m->getVertices().data());
-            OD.normalLists[m->getAddress()]   = deviceBufferCreate(OD.context, OWL_USER_TYPE(vec4), m->getNormals().size(), m->getNormals().data());
-            OD.tangentLists[m->getAddress()]   = deviceBufferCreate(OD.context, OWL_USER_TYPE(vec4), m->getTangents().size(), m->getTangents().data());
-            OD.texCoordLists[m->getAddress()] = deviceBufferCreate(OD.context, OWL_USER_TYPE(vec2), m->getTexCoords().size(), m->getTexCoords().data());
-            OD.indexLists[m->getAddress()]   = deviceBufferCreate(OD.context, OWL_USER_TYPE(uint32_t), m->getTriangleIndices().size(), m->getTriangleIndices().data());
+            OD.vertexLists[id]   = deviceBufferCreate(OD.context, OWL_USER_TYPE(vec3), m.positions.size(), m.positions.data());
+            OD.normalLists[id]   = deviceBufferCreate(OD.context, OWL_USER_TYPE(vec4), m.normals.size(), m.normals.data());
+            OD.tangentLists[id]  = deviceBufferCreate(OD.context, OWL_USER_TYPE(vec4), m.tangents.size(), m.tangents.data());
+            OD.texCoordLists[id] = deviceBufferCreate(OD.context, OWL_USER_TYPE(vec2), m.texCoords.size(), m.texCoords.data());
+            OD.indexLists[id]    = deviceBufferCreate(OD.context, OWL_USER_TYPE(uint32_t), m.triangleIndices.size(), m.triangleIndices.data());
             
             // Create geometry and build BLAS
-            OD.surfaceGeomList[m->getAddress()] = geomCreate(OD.context, OD.trianglesGeomType);
-            trianglesSetVertices(OD.surfaceGeomList[m->getAddress()], OD.vertexLists[m->getAddress()], m->getVertices().size(), sizeof(std::array<float, 3>), 0);
-            trianglesSetIndices(OD.surfaceGeomList[m->getAddress()], OD.indexLists[m->getAddress()], m->getTriangleIndices().size() / 3, sizeof(ivec3), 0);
-            OD.surfaceBlasList[m->getAddress()] = trianglesGeomGroupCreate(OD.context, 1, &OD.surfaceGeomList[m->getAddress()]);
-            groupBuildAccel(OD.surfaceBlasList[m->getAddress()]);          
+            OD.surfaceGeomList[id] = geomCreate(OD.context, OD.trianglesGeomType);
+            trianglesSetVertices(OD.surfaceGeomList[id], OD.vertexLists[id], m.positions.size(), sizeof(std::array<float, 3>), 0);
+            trianglesSetIndices(OD.surfaceGeomList[id], OD.indexLists[id], m.triangleIndices.size() / 3, sizeof(ivec3), 0);
+            OD.surfaceBlasList[id] = trianglesGeomGroupCreate(OD.context, 1, &OD.surfaceGeomList[id]);
+            groupBuildAccel(OD.surfaceBlasList[id]);          
+            Profiler.addCount("blas_builds");
+
+            // The snapshot's copy of the mesh is gone after this update, so build the light sampling tables now
+            std::vector<float> areas = computeTriangleAreas(m.positions, m.triangleIndices);
+            OD.meshTriangleTables[id].resize(areas.size());
+            OD.meshSurfaceAreas[id] = float(buildAliasTable(areas.data(), uint32_t(areas.size()), OD.meshTriangleTables[id].data()));
+            OD.meshNormalCones[id] = computeNormalCone(m.positions, m.normals, m.triangleIndices);
+
+            uint64_t meshBytes = owlBufferSizeInBytes(OD.vertexLists[id]) + owlBufferSizeInBytes(OD.normalLists[id])
+                + owlBufferSizeInBytes(OD.tangentLists[id]) + owlBufferSizeInBytes(OD.texCoordLists[id])
+                + owlBufferSizeInBytes(OD.indexLists[id])
+                + trianglesAccelSizeInBytes(uint32_t(m.positions.size()), uint32_t(m.triangleIndices.size() / 3));
+            Memory.setDeviceBytes("mesh", id, m.name, meshBytes);
         }
 
         bufferUpload(OD.vertexListsBuffer, OD.vertexLists.data());
@@ -1241,69 +1940,62 @@ void updateComponents()
         bufferUpload(OD.indexListsBuffer, OD.indexLists.data());
         bufferUpload(OD.normalListsBuffer, OD.normalLists.data());
         bufferUpload(OD.tangentListsBuffer, OD.tangentLists.data());
-        Mesh::updateComponents();
-        bufferUpload(OptixData.meshBuffer, Mesh::getFrontStruct());
-    }    
+        bufferUpload(OD.pointListsBuffer, OD.pointLists.data());
+        bufferUpload(OD.pointColorListsBuffer, OD.pointColorLists.data());
+    }
+    if (changes.areMeshesDirty()) bufferUpload(OptixData.meshBuffer, Published.meshStructs.data());
 
     // Manage Volumes: Build / Rebuild BLAS
-    auto dirtyVolumes = Volume::getDirtyVolumes();
-    if (dirtyVolumes.size() > 0) {
-        for (auto &v : dirtyVolumes) {
+    if (changes.volumes.size() > 0) {
+        ScopedTimer volumeTimer(Profiler, "volume_update");
+        Profiler.addCount("volumes_updated", double(changes.volumes.size()));
+        for (auto &v : changes.volumes) {
+            uint32_t volumeID = v.id;
             // First, release any resources from a previous, stale volume
-            if (OD.volumeHandles[v->getAddress()]) owlBufferDestroy(OD.volumeHandles[v->getAddress()]);
-            if (OD.volumeGeomList[v->getAddress()]) { owlGeomRelease(OD.volumeGeomList[v->getAddress()]); OD.volumeGeomList[v->getAddress()] = nullptr; }
-            if (OD.volumeBlasList[v->getAddress()]) { owlGroupRelease(OD.volumeBlasList[v->getAddress()]); OD.volumeBlasList[v->getAddress()] = nullptr; }
+            if (OD.volumeHandles[volumeID]) { owlBufferDestroy(OD.volumeHandles[volumeID]); OD.volumeHandles[volumeID] = nullptr; }
+            if (OD.volumeGeomList[volumeID]) { owlGeomRelease(OD.volumeGeomList[volumeID]); OD.volumeGeomList[volumeID] = nullptr; }
+            if (OD.volumeBlasList[volumeID]) { owlGroupRelease(OD.volumeBlasList[volumeID]); OD.volumeBlasList[volumeID] = nullptr; }
 
-            // At this point, if the volume no longer exists, move to the next dirty volume.
-            if (!v->isInitialized()) continue;
+            // At this point, if the volume no longer exists, move to the next changed volume.
+            if (v.removed) continue;
             
             // Next, allocate resources for the new volume.
-            auto gridHdlPtr = v->getNanoVDBGridHandle();
+            auto gridHdlPtr = v.gridHdlPtr;
             const nanovdb::FloatGrid* grid = reinterpret_cast<nanovdb::FloatGrid*>(gridHdlPtr.get()->data());
-            std::cout<<grid->checksum()<<std::endl;
             nanovdb::isValid(*grid, true, true);
 
-            // auto acc = grid->tree().getAccessor();
-            // auto bbox = tree.root().bbox();
-            auto bbox = grid->tree().bbox().asReal<float>();
-            // int nodecount = grid->tree().nodeCount(3);
-            // std::cout<<nodecount<<std::endl;
-            std::cout<<bbox.min()[0]<<bbox.min()[1]<<bbox.min()[2]<<bbox.max()[0]<<bbox.max()[1]<<bbox.max()[2]<<std::endl;
-
-            OD.volumeHandles[v->getAddress()] = owlDeviceBufferCreate(OD.context, OWL_USER_TYPE(uint8_t), gridHdlPtr.get()->size(), nullptr);
-            owlBufferUpload(OD.volumeHandles[v->getAddress()], gridHdlPtr.get()->data());
-            printf("%hhx\n",gridHdlPtr.get()->data()[0]);
-            const void* d_gridData = owlBufferGetPointer(OD.volumeHandles[v->getAddress()], 0);
-            uint8_t first_byte;
-            cudaMemcpy((void*)&first_byte, d_gridData, 1, cudaMemcpyDeviceToHost);
-            printf("%hhx\n",first_byte);
-
+            OD.volumeHandles[volumeID] = owlDeviceBufferCreate(OD.context, OWL_USER_TYPE(uint8_t), gridHdlPtr.get()->size(), nullptr);
+            bufferUpload(OD.volumeHandles[volumeID], gridHdlPtr.get()->data());
 
             // Create geometry and build BLAS
-            uint32_t volumeID = v->getAddress();
-            OD.volumeGeomList[v->getAddress()] = geomCreate(OD.context, OD.volumeGeomType);
-            owlGeomSetPrimCount(OD.volumeGeomList[v->getAddress()], 1); // for now, only one prim per volume. This might change...
-            glm::vec4 tmpbbmin = glm::vec4(v->getMinAabbCorner(3, 0), 1.f);
-            glm::vec4 tmpbbmax = glm::vec4(v->getMaxAabbCorner(3, 0), 1.f);
-            owlGeomSetRaw(OD.volumeGeomList[v->getAddress()], "bbmin", &tmpbbmin);
-            owlGeomSetRaw(OD.volumeGeomList[v->getAddress()], "bbmax", &tmpbbmax);
-            owlGeomSetRaw(OD.volumeGeomList[v->getAddress()], "volumeID", &volumeID);
-            OD.volumeBlasList[v->getAddress()] = owlUserGeomGroupCreate(OD.context, 1, &OD.volumeGeomList[v->getAddress()]);
-            groupBuildAccel(OD.volumeBlasList[v->getAddress()]);    
-        }
-        Volume::updateComponents();
-        owlBufferUpload(OptixData.volumeBuffer, Volume::getFrontStruct());
-        owlBufferUpload(OD.volumeHandlesBuffer, OD.volumeHandles.data());
+            OD.volumeGeomList[volumeID] = geomCreate(OD.context, OD.volumeGeomType);
+            owlGeomSetPrimCount(OD.volumeGeomList[volumeID], 1); // for now, only one prim per volume. This might change...
+            glm::vec4 tmpbbmin = glm::vec4(v.bbmin, 1.f);
+            glm::vec4 tmpbbmax = glm::vec4(v.bbmax, 1.f);
+            owlGeomSetRaw(OD.volumeGeomList[volumeID], "bbmin", &tmpbbmin);
+            owlGeomSetRaw(OD.volumeGeomList[volumeID], "bbmax", &tmpbbmax);
+            owlGeomSetRaw(OD.volumeGeomList[volumeID], "volumeID", &volumeID);
+            OD.volumeBlasList[volumeID] = owlUserGeomGroupCreate(OD.context, 1, &OD.volumeGeomList[volumeID]);
+            groupBuildAccel(OD.volumeBlasList[volumeID]);    
+            Profiler.addCount("blas_builds");
+
+            uint64_t volumeBytes = owlBufferSizeInBytes(OD.volumeHandles[volumeID]) + userGeomAccelSizeInBytes(1);
+            Memory.setDeviceBytes("volume", volumeID, v.name, volumeBytes);
+        }
+        bufferUpload(OD.volumeHandlesBuffer, OD.volumeHandles.data());
     }
+    if (changes.areVolumesDirty()) bufferUpload(OptixData.volumeBuffer, Published.volumeStructs.data());
 
     // Manage Entities: Build / Rebuild TLAS
-    auto dirtyEntities = Entity::getDirtyEntities();
-    if (dirtyEntities.size() > 0) {
+    if (changes.areEntitiesDirty()) {
+        ScopedTimer entityTimer(Profiler, "entity_update");
+        Profiler.addCount("entities_updated", double(changes.numEntitiesChanged));
         // Surface instances
         std::vector<OWLGroup> surfaceInstances;
-        std::vector<glm::mat4> t0SurfaceTransforms;
-        std::vector<glm::mat4> t1SurfaceTransforms;
+        std::vector<owl4x3f> t0OwlSurfaceTransforms;
+        std::vector<owl4x3f> t1OwlSurfaceTransforms;
         std::vector<uint32_t> surfaceInstanceToEntity;
+        std::vector<int32_t> surfaceInstanceToMaterial;
         
         // Volume instances
         std::vector<OWLGroup> volumeInstances;
@@ -1314,55 +2006,63 @@ void updateComponents()
         // Todo: curves...
 
         // Aggregate instanced geometry and transformations 
-        Entity* entities = Entity::getFront();
-        for (uint32_t eid = 0; eid < Entity::getCount(); ++eid) {
-            // if (!entities[eid].isDirty()) continue; // if any entities are dirty, need to rebuild entire TLAS 
-
+        for (uint32_t eid = 0; eid < uint32_t(Published.entityStructs.size()); ++eid) {
             // For an entity to go into a TLAS, it needs:
             // 1. a transform, to place it into the TLAS.
             // 2. geometry, either a mesh or a volume.
             // 3. a material or a light, to control surface appearance
-            if (!entities[eid].isInitialized()) continue;
-            if (!entities[eid].getTransform()) continue;
-            if (!(entities[eid].getMesh() || entities[eid].getVolume())) continue;
-            if (!entities[eid].getMaterial() && !entities[eid].getLight()) continue;
+            int32_t tid = Published.getTransformID(eid);
+            int32_t mid = Published.getMeshID(eid);
+            int32_t vid = Published.getVolumeID(eid);
+            if (tid < 0) continue;
+            if (mid < 0 && vid < 0) continue;
+            if (Published.getMaterialID(eid) < 0 && Published.getLightID(eid) < 0) continue;
 
             // Get instance transformation
-            glm::mat4 prevLocalToWorld = entities[eid].getTransform()->getLocalToWorldMatrix(/*previous = */true);
-            glm::mat4 localToWorld = entities[eid].getTransform()->getLocalToWorldMatrix(/*previous = */false);
-
-            // Add any instanced mesh geometry to the list
-            if (entities[eid].getMesh()) {
-                uint32_t address = entities[eid].getMesh()->getAddress();
-                OWLGroup blas = OD.surfaceBlasList[address];
-                if (!blas) {
-                    // Not sure why, but the mesh this entity references hasn't been constructed yet.
-                    // Mark it as dirty. It should be available in a subsequent frame
-                    entities[eid].getMesh()->markDirty(); return; 
-                }
-                surfaceInstances.push_back(blas);
+            glm::mat4 prevLocalToWorld = Published.transformStructs[tid].localToWorldPrev;
+            glm::mat4 localToWorld = Published.transformStructs[tid].localToWorld;
+
+            // Add any instanced mesh geometry to the list. Geometry without a BLAS has no triangles to hit.
+            const EntityInstances* instances = Published.getInstances(eid);
+            if (mid >= 0 && OD.surfaceBlasList[mid] && !instances) {
+                surfaceInstances.push_back(OD.surfaceBlasList[mid]);
                 surfaceInstanceToEntity.push_back(eid);
-                t0SurfaceTransforms.push_back(prevLocalToWorld);
-                t1SurfaceTransforms.push_back(localToWorld);
+                surfaceInstanceToMaterial.push_back(-1);
+                t0OwlSurfaceTransforms.push_back(glmToOWL(prevLocalToWorld));
+                t1OwlSurfaceTransforms.push_back(glmToOWL(localToWorld));
+            }
+            // Entities with instances expand into one TLAS instance each, all sharing the BLAS of the entity
+            else if (mid >= 0 && OD.surfaceBlasList[mid]) {
+                size_t first = surfaceInstances.size();
+                size_t count = instances->size();
+                surfaceInstances.resize(first + count, OD.surfaceBlasList[mid]);
+                surfaceInstanceToEntity.resize(first + count, eid);
+                surfaceInstanceToMaterial.resize(first + count);
+                t0OwlSurfaceTransforms.resize(first + count);
+                t1OwlSurfaceTransforms.resize(first + count);
+                ThreadPool::global().parallelFor(0, count, [&] (uint64_t i) {
+                    glm::mat4 instanceToLocal = instances->getTransform(uint32_t(i));
+                    glm::mat4 t0 = prevLocalToWorld * instanceToLocal;
+                    glm::mat4 t1 = localToWorld * instanceToLocal;
+                    t0OwlSurfaceTransforms[first + i] = glmToOWL(t0);
+                    t1OwlSurfaceTransforms[first + i] = glmToOWL(t1);
+                    // Instances of removed materials fall back to the material of the entity
+                    int32_t instanceMaterial = instances->getMaterialID(uint32_t(i));
+                    bool alive = (instanceMaterial >= 0) && (instanceMaterial < int32_t(Published.materialAlive.size()))
+                        && Published.materialAlive[instanceMaterial];
+                    surfaceInstanceToMaterial[first + i] = alive ? instanceMaterial : -1;
+                }, 4096);
             }
             
             // Add any instanced volume geometry to the list
-            if (entities[eid].getVolume()) {
-                uint32_t address = entities[eid].getVolume()->getAddress();
-                OWLGroup blas = OD.volumeBlasList[address];
-                if (!blas) {
-                    // Same as meshes, if BLAS doesn't exist, force BLAS build and try again.
-                    entities[eid].getMesh()->markDirty(); return; 
-                }
-                volumeInstances.push_back(blas);
+            if (vid >= 0 && OD.volumeBlasList[vid]) {
+                volumeInstances.push_back(OD.volumeBlasList[vid]);
                 volumeInstanceToEntity.push_back(eid);
                 t0VolumeTransforms.push_back(prevLocalToWorld);
                 t1VolumeTransforms.push_back(localToWorld);
             }     
         }
 
-        std::vector<owl4x3f>     t0OwlSurfaceTransforms;
-        std::vector<owl4x3f>     t1OwlSurfaceTransforms;
         std::vector<owl4x3f>     t0OwlVolumeTransforms;
         std::vector<owl4x3f>     t1OwlVolumeTransforms;
         auto oldSurfaceIAS = OD.surfacesIAS;
@@ -1384,18 +2084,15 @@ void updateComponents()
             groupBuildAccel(OD.volumesIAS);
         }
 
-        // Set surface transforms to IAS, upload surface instance to entity map
+        // Set surface children and transforms to IAS in bulk, upload surface instance to entity and material maps
         if (surfaceInstances.size() > 0) {
-            OD.surfacesIAS = instanceGroupCreate(OD.context, surfaceInstances.size());
-            for (uint32_t iid = 0; iid < surfaceInstances.size(); ++iid) {
-                instanceGroupSetChild(OD.surfacesIAS, iid, surfaceInstances[iid]);                 
-                t0OwlSurfaceTransforms.push_back(glmToOWL(t0SurfaceTransforms[iid]));
-                t1OwlSurfaceTransforms.push_back(glmToOWL(t1SurfaceTransforms[iid]));
-            }            
+            OD.surfacesIAS = instanceGroupCreate(OD.context, surfaceInstances.size(), surfaceInstances.data());
             owlInstanceGroupSetTransforms(OD.surfacesIAS,0,(const float*)t0OwlSurfaceTransforms.data());
             owlInstanceGroupSetTransforms(OD.surfacesIAS,1,(const float*)t1OwlSurfaceTransforms.data());
             bufferResize(OD.surfaceInstanceToEntityBuffer, surfaceInstanceToEntity.size());
             bufferUpload(OD.surfaceInstanceToEntityBuffer, surfaceInstanceToEntity.data());
+            bufferResize(OD.surfaceInstanceToMaterialBuffer, surfaceInstanceToMaterial.size());
+            bufferUpload(OD.surfaceInstanceToMaterialBuffer, surfaceInstanceToMaterial.data());
         }       
 
         // Set volume transforms to IAS, upload volume instance to entity map
@@ -1417,6 +2114,7 @@ void updateComponents()
         launchParamsSetGroup(OD.launchParams, "volumesIAS", OD.volumesIAS);
         groupBuildAccel(OD.surfacesIAS);
         launchParamsSetGroup(OD.launchParams, "surfacesIAS", OD.surfacesIAS);
+        Profiler.addCount("tlas_builds", 2);
 
         // Now that IAS have changed, we need to rebuild SBT
         buildSBT(OD.context);
@@ -1427,11 +2125,12 @@ void updateComponents()
     
         // Aggregate entities that are light sources (todo: consider emissive volumes...)
         OD.lightEntities.resize(0);
-        for (uint32_t eid = 0; eid < Entity::getCount(); ++eid) {
-            if (!entities[eid].isInitialized()) continue;
-            if (!entities[eid].getTransform()) continue;
-            if (!entities[eid].getLight()) continue;
-            if (!entities[eid].getMesh()) continue;
+        for (uint32_t eid = 0; eid < uint32_t(Published.entityStructs.size()); ++eid) {
+            if (Published.getTransformID(eid) < 0) continue;
+            if (Published.getLightID(eid) < 0) continue;
+            if (Published.getMeshID(eid) < 0) continue;
+            // Point clouds have no triangles to sample, so emissive points are only seen when hit
+            if (Published.meshStructs[Published.getMeshID(eid)].numPoints > 0) continue;
             OD.lightEntities.push_back(eid);
         }
         bufferResize(OptixData.lightEntitiesBuffer, OD.lightEntities.size());
@@ -1440,73 +2139,60 @@ void updateComponents()
         launchParamsSetRaw(OD.launchParams, "numLightEntities", &OD.LP.numLightEntities);
 
         // Finally, upload entity structs to the GPU.
-        Entity::updateComponents();
-        bufferUpload(OptixData.entityBuffer,    Entity::getFrontStruct());
+        bufferUpload(OptixData.entityBuffer, Published.entityStructs.data());
     }
 
     // Manage textures and materials
-    if (Texture::areAnyDirty() || Material::areAnyDirty()) {
-        std::lock_guard<std::recursive_mutex> material_lock(Material::areAnyDirty()   ? *Material::getEditMutex().get() : dummyMutex);
+    if (changes.areTexturesDirty() || changes.areMaterialsDirty()) {
+        ScopedTimer textureTimer(Profiler, "texture_material_update");
 
         // Allocate cuda textures for all texture components
-        auto dirtyTextures = Texture::getDirtyTextures();
-        for (auto &texture : dirtyTextures) {
-            int tid = texture->getAddress();
+        Profiler.addCount("textures_updated", double(changes.textures.size()));
+        for (auto &texture : changes.textures) {
+            int tid = texture.id;
             if (OD.textureObjects[tid]) { 
                 owlTexture2DDestroy(OD.textureObjects[tid]); 
                 OD.textureObjects[tid] = 0; 
             }
-            if (!texture->isInitialized()) continue;
-            bool isHDR = texture->isHDR();
-            bool isLinear = texture->isLinear();
-            uint32_t width = texture->getWidth();
-            uint32_t height = texture->getHeight();
+            if (texture.removed) continue;
+            bool isHDR = texture.isHDR();
+            uint32_t width = texture.width;
+            uint32_t height = texture.height;
             OWLTexelFormat format = ((isHDR) ? OWL_TEXEL_FORMAT_RGBA32F : OWL_TEXEL_FORMAT_RGBA8);
-            OWLTextureColorSpace colorSpace = ((isLinear) ? OWL_COLOR_SPACE_LINEAR: OWL_COLOR_SPACE_SRGB);
+            OWLTextureColorSpace colorSpace = ((texture.linear) ? OWL_COLOR_SPACE_LINEAR: OWL_COLOR_SPACE_SRGB);
             if (width < 1 || height < 1 || 
-                (isHDR && texture->getFloatTexels().size() != width * height) || 
-                (!isHDR && texture->getByteTexels().size() != width * height)) 
+                (isHDR && texture.floatTexels.size() != width * height) || 
+                (!isHDR && texture.byteTexels.size() != width * height)) 
             {
-                std::cout<<"Internal error: corrupt texture. Attempting to recover..." <<std::endl;
-                return; 
-            }
-            if (isHDR) {
-                auto texels = texture->getFloatTexels();
-                OD.textureObjects[tid] = owlTexture2DCreate(
-                    OD.context, 
-                    format,
-                    width, height, texels.data(),
-                    OWL_TEXTURE_LINEAR, 
-                    OWL_TEXTURE_WRAP,
-                    colorSpace
-                );
+                std::cout<<"Internal error: corrupt texture \"" << texture.name << "\". Skipping..." <<std::endl;
+                continue;
             }
-            else {
-                auto texels = texture->getByteTexels();
-                OD.textureObjects[tid] = owlTexture2DCreate(
-                    OD.context, 
-                    format,
-                    width, height, texels.data(),
-                    OWL_TEXTURE_LINEAR, 
-                    OWL_TEXTURE_WRAP,
-                    colorSpace
-                );
-            }
-            
+            uint64_t texelSize = isHDR ? sizeof(vec4) : sizeof(u8vec4);
+            Memory.setDeviceBytes("texture", tid, texture.name, uint64_t(width) * height * texelSize);
+            const void* texels = isHDR ? (const void*) texture.floatTexels.data() : (const void*) texture.byteTexels.data();
+            OD.textureObjects[tid] = texture2DCreate(
+                OD.context, 
+                format,
+                width, height, texels,
+                OWL_TEXTURE_LINEAR, 
+                OWL_TEXTURE_WRAP,
+                colorSpace
+            );
+        }
+        if (changes.areTexturesDirty()) {
+            memcpy(OptixData.textureStructs.data(), Published.textureStructs.data(), Published.textureStructs.size() * sizeof(TextureStruct));
         }
 
         // Create additional cuda textures for material constants
 
         // Manage materials
         {
-            Material* materials = Material::getFront();
-            MaterialStruct* matStructs = Material::getFrontStruct();
-            
-            for (uint32_t mid = 0; mid < Material::getCount(); ++mid) {
-                if (!materials[mid].isInitialized()) continue;
-                if (!materials[mid].isDirty()) continue;
+            uint32_t numTextures = uint32_t(Published.textureStructs.size());
+            for (auto &material : changes.materials) {
+                uint32_t mid = material.id;
+                Profiler.addCount("materials_updated");
 
-                OptixData.materialStructs[mid] = matStructs[mid];
+                OptixData.materialStructs[mid] = material.ids;
 
                 auto genRGBATex = [&OD](int index, vec4 c, vec4 defaultVal) {
                     if (OD.textureObjects[index]) { 
@@ -1514,7 +2200,7 @@ void updateComponents()
                         OD.textureObjects[index] = 0; 
                     }
                     if (glm::all(glm::equal(c, defaultVal))) return;
-                    OD.textureObjects[index] = owlTexture2DCreate(
+                    OD.textureObjects[index] = texture2DCreate(
                         OD.context, OWL_TEXEL_FORMAT_RGBA32F,
                         1,1, &c, OWL_TEXTURE_LINEAR, OWL_TEXTURE_WRAP, OWL_COLOR_SPACE_LINEAR);
                     OptixData.textureStructs[index] = TextureStruct();
@@ -1522,29 +2208,29 @@ void updateComponents()
                     OptixData.textureStructs[index].height = 1;
                 };
 
-                int off = Texture::getCount() + mid * NUM_MAT_PARAMS;
-                auto &m = materials[mid];
-                auto &ms = matStructs[mid];
+                int off = numTextures + mid * NUM_MAT_PARAMS;
+                const vec4* c = material.constants;
+                auto &ms = material.ids;
                 auto &odms = OptixData.materialStructs[mid];
-                if (ms.transmission_roughness_texture_id == -1) { genRGBATex(off + 0, vec4(m.getTransmissionRoughness()), vec4(0.f)); }
-                if (ms.base_color_texture_id == -1)             { genRGBATex(off + 1, vec4(m.getBaseColor(), 1.f), vec4(.8f, .8f, .8f, 1.f)); }
-                if (ms.roughness_texture_id == -1)              { genRGBATex(off + 2, vec4(m.getRoughness()), vec4(.5f)); }
-                if (ms.alpha_texture_id == -1)                  { genRGBATex(off + 3, vec4(m.getAlpha()), vec4(1.f)); }
-                if (ms.normal_map_texture_id == -1)             { genRGBATex(off + 4, vec4(0.5f, .5f, 1.f, 0.f), vec4(0.5f, .5f, 1.f, 0.f)); }
-                if (ms.subsurface_color_texture_id == -1)       { genRGBATex(off + 5, vec4(m.getSubsurfaceColor(), 1.f), glm::vec4(0.8f, 0.8f, 0.8f, 1.f)); }
-                if (ms.subsurface_radius_texture_id == -1)      { genRGBATex(off + 6, vec4(m.getSubsurfaceRadius(), 1.f), glm::vec4(1.0f, .2f, .1f, 1.f)); }
-                if (ms.subsurface_texture_id == -1)             { genRGBATex(off + 7, vec4(m.getSubsurface()), glm::vec4(0.f)); }
-                if (ms.metallic_texture_id == -1)               { genRGBATex(off + 8, vec4(m.getMetallic()), glm::vec4(0.f)); }
-                if (ms.specular_texture_id == -1)               { genRGBATex(off + 9, vec4(m.getSpecular()), glm::vec4(.5f)); }
-                if (ms.specular_tint_texture_id == -1)          { genRGBATex(off + 10, vec4(m.getSpecularTint()), glm::vec4(0.f)); }
-                if (ms.anisotropic_texture_id == -1)            { genRGBATex(off + 11, vec4(m.getAnisotropic()), glm::vec4(0.f)); }
-                if (ms.anisotropic_rotation_texture_id == -1)   { genRGBATex(off + 12, vec4(m.getAnisotropicRotation()), glm::vec4(0.f)); }
-                if (ms.sheen_texture_id == -1)                  { genRGBATex(off + 13, vec4(m.getSheen()), glm::vec4(0.f)); }
-                if (ms.sheen_tint_texture_id == -1)             { genRGBATex(off + 14, vec4(m.getSheenTint()), glm::vec4(0.5f)); }
-                if (ms.clearcoat_texture_id == -1)              { genRGBATex(off + 15, vec4(m.getClearcoat()), glm::vec4(0.f)); }
-                if (ms.clearcoat_roughness_texture_id == -1)    { genRGBATex(off + 16, vec4(m.getClearcoatRoughness()), glm::vec4(0.3f)); }
-                if (ms.ior_texture_id == -1)                    { genRGBATex(off + 17, vec4(m.getIor()), glm::vec4(1.45f)); }
-                if (ms.transmission_texture_id == -1)           { genRGBATex(off + 18, vec4(m.getTransmission()), glm::vec4(0.f)); }
+                if (ms.transmission_roughness_texture_id == -1) { genRGBATex(off + 0, c[0], vec4(0.f)); }
+                if (ms.base_color_texture_id == -1)             { genRGBATex(off + 1, c[1], vec4(.8f, .8f, .8f, 1.f)); }
+                if (ms.roughness_texture_id == -1)              { genRGBATex(off + 2, c[2], vec4(.5f)); }
+                if (ms.alpha_texture_id == -1)                  { genRGBATex(off + 3, c[3], vec4(1.f)); }
+                if (ms.normal_map_texture_id == -1)             { genRGBATex(off + 4, c[4], vec4(0.5f, .5f, 1.f, 0.f)); }
+                if (ms.subsurface_color_texture_id == -1)       { genRGBATex(off + 5, c[5], glm::vec4(0.8f, 0.8f, 0.8f, 1.f)); }
+                if (ms.subsurface_radius_texture_id == -1)      { genRGBATex(off + 6, c[6], glm::vec4(1.0f, .2f, .1f, 1.f)); }
+                if (ms.subsurface_texture_id == -1)             { genRGBATex(off + 7, c[7], glm::vec4(0.f)); }
+                if (ms.metallic_texture_id == -1)               { genRGBATex(off + 8, c[8], glm::vec4(0.f)); }
+                if (ms.specular_texture_id == -1)               { genRGBATex(off + 9, c[9], glm::vec4(.5f)); }
+                if (ms.specular_tint_texture_id == -1)          { genRGBATex(off + 10, c[10], glm::vec4(0.f)); }
+                if (ms.anisotropic_texture_id == -1)            { genRGBATex(off + 11, c[11], glm::vec4(0.f)); }
+                if (ms.anisotropic_rotation_texture_id == -1)   { genRGBATex(off + 12, c[12], glm::vec4(0.f)); }
+                if (ms.sheen_texture_id == -1)                  { genRGBATex(off + 13, c[13], glm::vec4(0.f)); }
+                if (ms.sheen_tint_texture_id == -1)             { genRGBATex(off + 14, c[14], glm::vec4(0.5f)); }
+                if (ms.clearcoat_texture_id == -1)              { genRGBATex(off + 15, c[15], glm::vec4(0.f)); }
+                if (ms.clearcoat_roughness_texture_id == -1)    { genRGBATex(off + 16, c[16], glm::vec4(0.3f)); }
+                if (ms.ior_texture_id == -1)                    { genRGBATex(off + 17, c[17], glm::vec4(1.45f)); }
+                if (ms.transmission_texture_id == -1)           { genRGBATex(off + 18, c[18], glm::vec4(0.f)); }
                 
                 if (ms.transmission_roughness_texture_id == -1) { odms.transmission_roughness_texture_id = off + 0; }
                 if (ms.base_color_texture_id == -1)             { odms.base_color_texture_id = off + 1; }
@@ -1567,51 +2253,99 @@ void updateComponents()
                 if (ms.transmission_texture_id == -1)           { odms.transmission_texture_id = off + 18; }
             }
 
-            Material::updateComponents();
             bufferUpload(OptixData.materialBuffer, OptixData.materialStructs.data());
         }
         
         bufferUpload(OD.textureObjectsBuffer, OD.textureObjects.data());
-        Texture::updateComponents();
-        memcpy(OptixData.textureStructs.data(), Texture::getFrontStruct(), Texture::getCount() * sizeof(TextureStruct));
         bufferUpload(OptixData.textureBuffer, OptixData.textureStructs.data());
     }
     
     // Manage transforms
-    auto dirtyTransforms = Transform::getDirtyTransforms();
-    if (dirtyTransforms.size() > 0) {
-        Transform::updateComponents();
-        
-        // // for each device
-        // for (uint32_t id = 0; id < owlGetDeviceCount(OptixData.context); ++id)
-        // {
-        //     cudaSetDevice(id);
-
-        //     TransformStruct* devTransforms = (TransformStruct*)owlBufferGetPointer(OptixData.transformBuffer, id);
-        //     TransformStruct* transformStructs = Transform::getFrontStruct();
-        //     for (auto &t : dirtyTransforms) {
-        //         if (!t->isInitialized()) continue;
-        //         CUDA_CHECK(cudaMemcpy(&devTransforms[t->getAddress()], &transformStructs[t->getAddress()], sizeof(TransformStruct), cudaMemcpyHostToDevice));
-        //     }
-        // }
-
-        // cudaSetDevice(0);
-        owlBufferUpload(OptixData.transformBuffer, Transform::getFrontStruct());
+    if (changes.areTransformsDirty()) {
+        ScopedTimer transformTimer(Profiler, "transform_update");
+        Profiler.addCount("transforms_updated", double(changes.numTransformsChanged));
+        bufferUpload(OptixData.transformBuffer, Published.transformStructs.data());
     }   
 
     // Manage Cameras
-    if (Camera::areAnyDirty()) {
-        Camera::updateComponents();
-        bufferUpload(OptixData.cameraBuffer,    Camera::getFrontStruct());
+    if (changes.areCamerasDirty()) {
+        bufferUpload(OptixData.cameraBuffer, Published.cameraStructs.data());
     }    
 
     // Manage lights
-    if (Light::areAnyDirty()) {
-        Light::updateComponents();
-        bufferUpload(OptixData.lightBuffer,     Light::getFrontStruct());
+    if (changes.areLightsDirty()) {
+        bufferUpload(OptixData.lightBuffer, Published.lightStructs.data());
+    }
+
+    // Manage light selection: power weighted light table, area weighted triangle tables
+    if (lightSelectionDirty) {
+        ScopedTimer lightTimer(Profiler, "light_selection_update");
+        uint32_t numMeshes = uint32_t(Published.meshStructs.size());
+        std::vector<float> lightPowers(OD.lightEntities.size());
+        std::vector<uint32_t> triangleOffsets(numMeshes, 0);
+        std::vector<AliasTableEntry> triangleTables;
+        std::vector<bool> meshAdded(numMeshes, false);
+        std::vector<LightTreeEmitter> emitters(OD.lightEntities.size());
+        for (uint32_t i = 0; i < OD.lightEntities.size(); ++i) {
+            uint32_t eid = OD.lightEntities[i];
+            int32_t mid = Published.getMeshID(eid);
+            int32_t lid = Published.getLightID(eid);
+            int32_t tid = Published.getTransformID(eid);
+            if (mid < 0 || lid < 0 || tid < 0) continue;
+            auto &table = OD.meshTriangleTables[mid];
+            if (!meshAdded[mid]) {
+                meshAdded[mid] = true;
+                triangleOffsets[mid] = uint32_t(triangleTables.size());
+                triangleTables.insert(triangleTables.end(), table.begin(), table.end());
+            }
+
+            // Approximate the world space area by the average scaling of the light's transform
+            glm::mat4 localToWorld = Published.transformStructs[tid].localToWorld;
+            glm::mat3 ltw = glm::mat3(localToWorld);
+            float areaScale = powf(fabs(glm::determinant(ltw)), 2.f / 3.f);
+            lightPowers[i] = estimateLightPower(Published.lightStructs[lid], OD.meshSurfaceAreas[mid] * areaScale);
+
+            // World space bounds and emission cone for the light tree
+            glm::vec3 lmin = glm::vec3(Published.meshStructs[mid].bbmin), lmax = glm::vec3(Published.meshStructs[mid].bbmax);
+            LightTreeEmitter &emitter = emitters[i];
+            emitter.bbmin = glm::vec3(1e30f); emitter.bbmax = glm::vec3(-1e30f);
+            for (uint32_t c = 0; c < 8; ++c) {
+                glm::vec3 corner((c & 1) ? lmax.x : lmin.x, (c & 2) ? lmax.y : lmin.y, (c & 4) ? lmax.z : lmin.z);
+                glm::vec3 w = glm::vec3(localToWorld * glm::vec4(corner, 1.f));
+                emitter.bbmin = glm::min(emitter.bbmin, w);
+                emitter.bbmax = glm::max(emitter.bbmax, w);
+            }
+            glm::vec3 axis = glm::transpose(glm::inverse(ltw)) * glm::vec3(OD.meshNormalCones[mid]);
+            emitter.axis = (glm::length(axis) > 0.f) ? glm::normalize(axis) : glm::vec3(0.f, 0.f, 1.f);
+            emitter.cosThetaO = OD.meshNormalCones[mid].w;
+            emitter.cosThetaE = 0.f; // one sided, cosine weighted emission
+            emitter.power = lightPowers[i];
+        }
+        if (lightTreeRefitOnly) OD.lightTree.refit(emitters);
+        else OD.lightTree.build(emitters);
+        std::vector<LightTreeNode> lightTreeNodes = OD.lightTree.nodes;
+        if (lightTreeNodes.empty()) lightTreeNodes.resize(1);
+        bufferResize(OD.lightTreeBuffer, lightTreeNodes.size());
+        bufferUpload(OD.lightTreeBuffer, lightTreeNodes.data());
+        OD.LP.numLightTreeNodes = uint32_t(OD.lightTree.nodes.size());
+        launchParamsSetRaw(OD.launchParams, "numLightTreeNodes", &OD.LP.numLightTreeNodes);
+        std::vector<AliasTableEntry> lightTable = buildAliasTable(lightPowers);
+        if (lightTable.empty()) lightTable.resize(1);
+        if (triangleTables.empty()) triangleTables.resize(1);
+        bufferResize(OD.lightSelectionBuffer, lightTable.size());
+        bufferUpload(OD.lightSelectionBuffer, lightTable.data());
+        bufferResize(OD.triangleSelectionBuffer, triangleTables.size());
+        bufferUpload(OD.triangleSelectionBuffer, triangleTables.data());
+        bufferUpload(OD.triangleSelectionOffsetsBuffer, triangleOffsets.data());
     }
 }
 
+void updateComponents()
+{
+    if (!Commits.manual) commitScene();
+    updateComponents(takeCommits(UINT64_MAX));
+}
+
 void updateLaunchParams()
 {
     launchParamsSetRaw(OptixData.launchParams, "frameID", &OptixData.LP.frameID);
@@ -1623,17 +2357,22 @@ void updateLaunchParams()
     launchParamsSetRaw(OptixData.launchParams, "renderDataMode", &OptixData.LP.renderDataMode);
     launchParamsSetRaw(OptixData.launchParams, "renderDataBounce", &OptixData.LP.renderDataBounce);
     launchParamsSetRaw(OptixData.launchParams, "enableDomeSampling", &OptixData.LP.enableDomeSampling);
+    launchParamsSetRaw(OptixData.launchParams, "enableLightTree", &OptixData.LP.enableLightTree);
+    launchParamsSetRaw(OptixData.launchParams, "samplerType", &OptixData.LP.samplerType);
     launchParamsSetRaw(OptixData.launchParams, "seed", &OptixData.LP.seed);
+    launchParamsSetRaw(OptixData.launchParams, "adaptiveTileSize", &OptixData.LP.adaptiveTileSize);
+    launchParamsSetRaw(OptixData.launchParams, "writeTemporalGuides", &OptixData.LP.writeTemporalGuides);
     launchParamsSetRaw(OptixData.launchParams, "proj", &OptixData.LP.proj);
     launchParamsSetRaw(OptixData.launchParams, "viewT0", &OptixData.LP.viewT0);
     launchParamsSetRaw(OptixData.launchParams, "viewT1", &OptixData.LP.viewT1);
 
     launchParamsSetRaw(OptixData.launchParams, "environmentMapID", &OptixData.LP.environmentMapID);
     launchParamsSetRaw(OptixData.launchParams, "environmentMapRotation", &OptixData.LP.environmentMapRotation);
-    launchParamsSetBuffer(OptixData.launchParams, "environmentMapRows", OptixData.environmentMapRowsBuffer);
-    launchParamsSetBuffer(OptixData.launchParams, "environmentMapCols", OptixData.environmentMapColsBuffer);
+    launchParamsSetBuffer(OptixData.launchParams, "environmentMapAlias", OptixData.environmentMapAliasBuffer);
     launchParamsSetRaw(OptixData.launchParams, "environmentMapWidth", &OptixData.LP.environmentMapWidth);
     launchParamsSetRaw(OptixData.launchParams, "environmentMapHeight", &OptixData.LP.environmentMapHeight);
+    OptixData.LP.sceneBBMin = Published.sceneBBMin;
+    OptixData.LP.sceneBBMax = Published.sceneBBMax;
     launchParamsSetRaw(OptixData.launchParams, "sceneBBMin", &OptixData.LP.sceneBBMin);
     launchParamsSetRaw(OptixData.launchParams, "sceneBBMax", &OptixData.LP.sceneBBMax);
 
@@ -1641,6 +2380,8 @@ void updateLaunchParams()
 }
 
 void denoiseImage() {
+    ScopedTimer timer(Profiler, "denoise");
+    ScopedGPUTimer gpuTimer("denoise");
     synchronizeDevices();
 
     auto &OD = OptixData;
@@ -1838,6 +2579,9 @@ void configureDenoiser(bool useAlbedoGuide, bool useNormalGuide, bool useKernelP
         throw std::runtime_error("Error, unsupported denoiser configuration."
             "If normal guide is enabled, albedo guide must also be enabled.");
     }
+    if (cpuBackend) {
+        throw std::runtime_error("Error, the denoiser is not supported by the cpu backend.");
+    }
 
     enqueueCommand([useAlbedoGuide, useNormalGuide, useKernelPrediction](){
         OptixData.enableAlbedoGuide = useAlbedoGuide;
@@ -1915,10 +2659,179 @@ void configureDenoiser(bool useAlbedoGuide, bool useNormalGuide, bool useKernelP
     });
 }
 
+/* Gathers the frame state for the CPU backend from the launch parameters kept by the setters above */
+static CPULaunchParams getCPULaunchParams()
+{
+    auto &LP = OptixData.LP;
+    CPULaunchParams CLP;
+    CLP.frameSize = LP.frameSize;
+    CLP.frameID = LP.frameID;
+    CLP.seed = LP.seed;
+    CLP.samplerType = LP.samplerType;
+    CLP.domeLightIntensity = LP.domeLightIntensity;
+    CLP.domeLightExposure = LP.domeLightExposure;
+    CLP.domeLightColor = LP.domeLightColor;
+    CLP.enableDomeSampling = LP.enableDomeSampling;
+    CLP.directClamp = LP.directClamp;
+    CLP.indirectClamp = LP.indirectClamp;
+    CLP.maxDiffuseDepth = LP.maxDiffuseDepth;
+    CLP.maxGlossyDepth = LP.maxGlossyDepth;
+    CLP.maxTransparencyDepth = LP.maxTransparencyDepth;
+    CLP.maxTransmissionDepth = LP.maxTransmissionDepth;
+    CLP.xPixelSamplingInterval = LP.xPixelSamplingInterval;
+    CLP.yPixelSamplingInterval = LP.yPixelSamplingInterval;
+    CLP.timeSamplingInterval = LP.timeSamplingInterval;
+    CLP.cameraEntity = LP.cameraEntity;
+    CLP.proj = LP.proj;
+    CLP.viewT0 = LP.viewT0;
+    CLP.viewT1 = LP.viewT1;
+    CLP.environmentMapID = LP.environmentMapID;
+    CLP.environmentMapRotation = LP.environmentMapRotation;
+    CLP.environmentMapWidth = LP.environmentMapWidth;
+    CLP.environmentMapHeight = LP.environmentMapHeight;
+    if (LP.environmentMapID == -2 && CPUData.proceduralSkyImage) {
+        auto &image = CPUData.proceduralSkyImage;
+        CLP.proceduralSkyTexels = image->texels.data();
+        CLP.proceduralSkyWidth = image->width;
+        CLP.proceduralSkyHeight = image->height;
+        if (!image->importanceMap.table.empty()) CLP.environmentMapAlias = image->importanceMap.table.data();
+    }
+    else if (!CPUData.environmentMapAlias.empty()) {
+        CLP.environmentMapAlias = CPUData.environmentMapAlias.data();
+    }
+    CLP.renderDataMode = LP.renderDataMode;
+    CLP.renderDataBounce = LP.renderDataBounce;
+    if (LP.adaptiveTileSize > 0) {
+        CLP.adaptiveTileSize = LP.adaptiveTileSize;
+        CLP.adaptiveTileMask = OptixData.adaptiveSampler.getTileMask().data();
+    }
+    CLP.writeTemporalGuides = LP.writeTemporalGuides;
+    return CLP;
+}
+
+/* Takes one sample per pixel with the CPU backend, accumulating into the CPU frame buffers */
+static void cpuRenderFrame()
+{
+    ScopedTimer timer(Profiler, "launch");
+    cpuRender(getCPULaunchParams(), 1, CPUData.frameBuffer.data(), CPUData.albedoBuffer.data(), CPUData.normalBuffer.data(),
+        CPUData.halfBuffer.data(), CPUData.guideBuffer.data());
+    OptixData.LP.frameID ++;
+}
+
+static void uploadAdaptiveTileMask()
+{
+    // The CPU backend reads the mask straight from the adaptive sampler
+    if (cpuBackend) return;
+    auto &mask = OptixData.adaptiveSampler.getTileMask();
+    bufferResize(OptixData.adaptiveTileMaskBuffer, mask.size());
+    bufferUpload(OptixData.adaptiveTileMaskBuffer, mask.data());
+}
+
+/* Starts adaptively sampling a frame, which takes samplesPerPixel samples per pixel on average */
+static void beginAdaptiveSampling(uint32_t width, uint32_t height, uint32_t samplesPerPixel)
+{
+    auto &OD = OptixData;
+    uint32_t maxSamples = uint32_t(ceilf(float(samplesPerPixel) * OD.adaptiveMaxSampleScale));
+    OD.adaptiveSampler.reset(width, height, OD.adaptiveTileSize, OD.adaptiveErrorThreshold,
+        std::min(OD.adaptiveMinSamples, samplesPerPixel), maxSamples, uint64_t(samplesPerPixel) * width * height);
+    uploadAdaptiveTileMask();
+    OD.LP.adaptiveTileSize = OD.adaptiveTileSize;
+}
+
+/* Accounts for the pass just rendered, and periodically stops sampling the tiles that converged */
+static void updateAdaptiveSampling()
+{
+    auto &OD = OptixData;
+    OD.adaptiveSampler.advance();
+    if (!OD.adaptiveSampler.needsConvergenceUpdate()) return;
+    ScopedTimer timer(Profiler, "adaptive_update");
+
+    bool anyConverged;
+    if (cpuBackend) {
+        anyConverged = OD.adaptiveSampler.updateConvergence(CPUData.frameBuffer.data(), CPUData.halfBuffer.data());
+    }
+    else {
+        // The accumulation buffer holds the raw mean, even when the frame buffer is denoised
+        size_t numPixels = size_t(OD.LP.frameSize.x) * size_t(OD.LP.frameSize.y);
+        std::vector<glm::vec4> mean(numPixels), halfMean(numPixels);
+        synchronizeDevices();
+        cudaMemcpy(mean.data(), bufferGetPointer(OD.accumBuffer, 0), numPixels * sizeof(glm::vec4), cudaMemcpyDeviceToHost);
+        cudaMemcpy(halfMean.data(), bufferGetPointer(OD.halfBuffer, 0), numPixels * sizeof(glm::vec4), cudaMemcpyDeviceToHost);
+        anyConverged = OD.adaptiveSampler.updateConvergence(mean.data(), halfMean.data());
+    }
+    if (anyConverged) uploadAdaptiveTileMask();
+}
+
+static void endAdaptiveSampling()
+{
+    OptixData.LP.adaptiveTileSize = 0;
+}
+
+void temporalAccumulateCUDA(const glm::vec4 *sampleBuffer, const glm::vec4 *guideBuffer,
+    const glm::vec4 *historyBuffer, const glm::vec4 *historyGuideBuffer,
+    glm::vec4 *imageBuffer, glm::vec4 *newHistoryBuffer,
+    float sampleCount, float maxHistorySamples, float depthTolerance, int width, int height, cudaStream_t stream);
+
+/* Blends the frame just rendered with the reprojected history of previous frames, then makes it the new history */
+static void accumulateTemporally(float sampleCount)
+{
+    auto &OD = OptixData;
+    ScopedTimer timer(Profiler, "temporal_accumulation");
+    ScopedGPUTimer gpuTimer("temporal_accumulation");
+    int width = OD.LP.frameSize.x, height = OD.LP.frameSize.y;
+    size_t numPixels = size_t(width) * size_t(height);
+    bool historyValid = OD.temporalHistoryValid && (OD.temporalHistorySize == OD.LP.frameSize);
+
+    if (cpuBackend) {
+        std::vector<glm::vec4> newHistory(numPixels);
+        temporalAccumulate(width, height, CPUData.frameBuffer.data(), CPUData.guideBuffer.data(),
+            (historyValid) ? CPUData.historyBuffer.data() : nullptr, 
+            (historyValid) ? CPUData.historyGuideBuffer.data() : nullptr,
+            sampleCount, OD.temporalMaxHistorySamples, OD.temporalDepthTolerance,
+            CPUData.frameBuffer.data(), newHistory.data());
+        CPUData.historyBuffer.swap(newHistory);
+        CPUData.historyGuideBuffer = CPUData.guideBuffer;
+    }
+    else {
+        // Resizing discards the contents of a buffer, so the history is only resized along with the frame
+        if (!historyValid) {
+            bufferResize(OD.historyBuffer, numPixels);
+            bufferResize(OD.historyGuideBuffer, numPixels);
+        }
+        synchronizeDevices();
+
+        // The new history goes to the scratch buffer first, since the kernel reads the old history around each pixel
+        glm::vec4* historyPtr = (glm::vec4*) bufferGetPointer(OD.historyBuffer, 0);
+        glm::vec4* historyGuidePtr = (glm::vec4*) bufferGetPointer(OD.historyGuideBuffer, 0);
+        glm::vec4* scratchPtr = (glm::vec4*) bufferGetPointer(OD.scratchBuffer, 0);
+        glm::vec4* guidePtr = (glm::vec4*) bufferGetPointer(OD.mvecBuffer, 0);
+        // Everything goes on the stream the GPU timer records on, so that it measures this work
+        auto cudaStream = getStream(OD.context, 0);
+        temporalAccumulateCUDA(
+            (const glm::vec4*) bufferGetPointer(OD.accumBuffer, 0), guidePtr,
+            (historyValid) ? historyPtr : nullptr, (historyValid) ? historyGuidePtr : nullptr,
+            (glm::vec4*) bufferGetPointer(OD.frameBuffer, 0), scratchPtr,
+            sampleCount, OD.temporalMaxHistorySamples, OD.temporalDepthTolerance, width, height, cudaStream);
+        cudaMemcpyAsync(historyPtr, scratchPtr, numPixels * sizeof(glm::vec4), cudaMemcpyDeviceToDevice, cudaStream);
+        cudaMemcpyAsync(historyGuidePtr, guidePtr, numPixels * sizeof(glm::vec4), cudaMemcpyDeviceToDevice, cudaStream);
+        synchronizeDevices();
+
+        if (OD.enableDenoiser) denoiseImage();
+    }
+
+    OD.temporalHistoryValid = true;
+    OD.temporalHistorySize = OD.LP.frameSize;
+}
+
 std::vector<float> readFrameBuffer() {
     std::vector<float> frameBuffer(OptixData.LP.frameSize.x * OptixData.LP.frameSize.y * 4);
 
     enqueueCommandAndWait([&frameBuffer] () {
+        if (cpuBackend) {
+            memcpy(frameBuffer.data(), CPUData.frameBuffer.data(), frameBuffer.size() * sizeof(float));
+            return;
+        }
+
         int num_devices = getDeviceCount();
         synchronizeDevices();
 
@@ -1935,75 +2848,269 @@ std::vector<float> readFrameBuffer() {
     return frameBuffer;
 }
 
-std::vector<float> render(uint32_t width, uint32_t height, uint32_t samplesPerPixel, uint32_t seed) {
-    if ((width < 1) || (height < 1)) throw std::runtime_error("Error, invalid width/height");
-    std::vector<float> frameBuffer(width * height * 4);
+/* 
+ * Renders a frame of the scene with the given commits applied, into the frame buffer.
+ * Only called on the render thread.
+ */
+static void renderFrame(const SceneSnapshot &changes, uint32_t width, uint32_t height, uint32_t samplesPerPixel, uint32_t seed, float timeBudgetMs)
+{
+    // Earlier asynchronous frames may still be reading back the frame buffer
+    Frames.flush();
 
-    enqueueCommandAndWait([&frameBuffer, width, height, samplesPerPixel, seed] () {
-        if (!NVISII.headlessMode) {
-            if ((width != WindowData.currentSize.x) || (height != WindowData.currentSize.y))
-            {
-                using namespace Libraries;
-                auto glfw = GLFW::Get();
-                glfw->resize_window("NVISII", width, height);
-                initializeFrameBuffer(width, height);
-            }
+    if (!NVISII.headlessMode) {
+        if ((width != WindowData.currentSize.x) || (height != WindowData.currentSize.y))
+        {
+            using namespace Libraries;
+            auto glfw = GLFW::Get();
+            glfw->resize_window("NVISII", width, height);
+            initializeFrameBuffer(width, height);
         }
-        
-        OptixData.LP.seed = seed;
+    }
+    
+    OptixData.LP.seed = seed;
 
-        resizeOptixFrameBuffer(width, height);
-        resetAccumulation();
-        updateComponents();
+    resizeOptixFrameBuffer(width, height);
+    resetAccumulation();
+    updateComponents(changes);
 
-        for (uint32_t i = 0; i < samplesPerPixel; ++i) {
-            // std::cout<<i<<std::endl;
-            if (!NVISII.headlessMode) {
-                auto glfw = Libraries::GLFW::Get();
-                glfw->poll_events();
-                glfw->swap_buffers("NVISII");
-                glClearColor(1,1,1,1);
-                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            }
+    bool adaptive = OptixData.enableAdaptiveSampling;
+    if (adaptive) beginAdaptiveSampling(width, height, samplesPerPixel);
+    bool temporal = OptixData.enableTemporalAccumulation;
+    OptixData.LP.writeTemporalGuides = temporal;
+
+    // With adaptive sampling, the adaptive sampler limits the number of passes instead
+    RenderBudget budget;
+    budget.begin(timeBudgetMs, (adaptive) ? UINT32_MAX : samplesPerPixel);
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; budget.shouldContinue() && !(adaptive && OptixData.adaptiveSampler.isDone()); ++i) {
+        // std::cout<<i<<std::endl;
+        if (!NVISII.headlessMode) {
+            auto glfw = Libraries::GLFW::Get();
+            glfw->poll_events();
+            glfw->swap_buffers("NVISII");
+            glClearColor(1,1,1,1);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
 
+        if (cpuBackend) {
+            cpuRenderFrame();
+        }
+        else {
             updateLaunchParams();
-            owlLaunch2D(OptixData.rayGen, OptixData.LP.frameSize.x * OptixData.LP.frameSize.y, 1, OptixData.launchParams);
+            {
+                ScopedTimer launchTimer(Profiler, "launch");
+                ScopedGPUTimer launchGPUTimer("launch");
+                owlLaunch2D(OptixData.rayGen, OptixData.LP.frameSize.x * OptixData.LP.frameSize.y, 1, OptixData.launchParams);
+            }
             if (OptixData.enableDenoiser)
             {
                 denoiseImage();
             }
+        }
 
-            if (!NVISII.headlessMode) {
-                drawFrameBufferToWindow();
-                glfwSetWindowTitle(WindowData.window, 
-                    (std::to_string(i) + std::string("/") + std::to_string(samplesPerPixel)).c_str());
-            }
-
-            if (verbose) {
-                std::cout<< "\r" << i << "/" << samplesPerPixel;
-            }
-        }      
         if (!NVISII.headlessMode) {
+            drawFrameBufferToWindow();
             glfwSetWindowTitle(WindowData.window, 
-                (std::to_string(samplesPerPixel) + std::string("/") + std::to_string(samplesPerPixel) 
-                + std::string(" - done!")).c_str());
+                (std::to_string(i) + std::string("/") + std::to_string(samplesPerPixel)).c_str());
         }
-        
+
+        if (adaptive) updateAdaptiveSampling();
+
+        // Launches are asynchronous, so wait for the pass to finish before timing it
+        if (budget.hasTimeBudget() && !cpuBackend) synchronizeDevices();
+        budget.endPass(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count());
+
         if (verbose) {
-            std::cout<<"\r "<< samplesPerPixel << "/" << samplesPerPixel <<" - done!" << std::endl;
+            std::cout<< "\r" << i << "/" << samplesPerPixel;
+            if (adaptive) std::cout << " (" << OptixData.adaptiveSampler.getActiveTileCount() << " tiles active)";
+        }
+    }      
+    if (adaptive) endAdaptiveSampling();
+    OptixData.renderedSamplesPerPixel = (adaptive) ? 
+        OptixData.adaptiveSampler.getAverageSamplesPerPixel() : float(budget.getPassCount());
+    if (temporal) {
+        accumulateTemporally(std::max(OptixData.renderedSamplesPerPixel, 1.f));
+        OptixData.LP.writeTemporalGuides = false;
+    }
+    Profiler.setValue("samples_per_pixel", OptixData.renderedSamplesPerPixel);
+    if (!NVISII.headlessMode) {
+        glfwSetWindowTitle(WindowData.window, 
+            (std::to_string(samplesPerPixel) + std::string("/") + std::to_string(samplesPerPixel) 
+            + std::string(" - done!")).c_str());
+    }
+    
+    if (verbose) {
+        std::cout<<"\r "<< samplesPerPixel << "/" << samplesPerPixel <<" - done!" << std::endl;
+        if (budget.isOutOfTime()) {
+            std::cout << "Time budget of " << timeBudgetMs << "ms reached after " << budget.getPassCount() << " passes" << std::endl;
+        }
+        if (adaptive) {
+            std::cout << "Adaptive sampling took " << OptixData.adaptiveSampler.getAverageSamplesPerPixel() 
+                << " samples per pixel on average, over " << OptixData.adaptiveSampler.getPassCount() << " passes" << std::endl;
         }
+    }
+}
 
-        synchronizeDevices();
+/* Copies the frame buffer to the host, waiting for it. Only called on the render thread. */
+static void copyFrameBufferToHost(float* destination, uint32_t width, uint32_t height)
+{
+    ScopedTimer readbackTimer(Profiler, "readback");
+    if (cpuBackend) {
+        memcpy(destination, CPUData.frameBuffer.data(), width * height * sizeof(glm::vec4));
+        return;
+    }
 
-        const glm::vec4 *fb = (const glm::vec4*) bufferGetPointer(OptixData.frameBuffer,0);
-        cudaMemcpyAsync(frameBuffer.data(), fb, width * height * sizeof(glm::vec4), cudaMemcpyDeviceToHost);
+    synchronizeDevices();
 
-        synchronizeDevices();
+    const glm::vec4 *fb = (const glm::vec4*) bufferGetPointer(OptixData.frameBuffer,0);
+    cudaMemcpyAsync(destination, fb, width * height * sizeof(glm::vec4), cudaMemcpyDeviceToHost);
+
+    synchronizeDevices();
+}
+
+/* Starts copying the frame buffer into a readback slot, without waiting for it. Only called on the render thread. */
+static FramePipeline<std::vector<float>>::Readback startReadback(uint32_t slot, uint32_t width, uint32_t height)
+{
+    ScopedTimer readbackTimer(Profiler, "readback");
+    size_t count = size_t(width) * height;
+    FramePipeline<std::vector<float>>::Readback readback;
+    if (cpuBackend) {
+        auto texels = std::make_shared<std::vector<float>>(count * 4);
+        memcpy(texels->data(), CPUData.frameBuffer.data(), count * sizeof(glm::vec4));
+        readback.isDone = [] () { return true; };
+        readback.take = [texels] () { return std::move(*texels); };
+        return readback;
+    }
+
+    if (slot >= ReadbackSlots.size()) ReadbackSlots.resize(slot + 1);
+    ReadbackSlot &s = ReadbackSlots[slot];
+    if (s.capacity < count) {
+        if (s.texels) cudaFreeHost(s.texels);
+        s.texels = nullptr;
+        s.capacity = 0;
+        if (cudaMallocHost((void**)&s.texels, count * sizeof(glm::vec4)) != cudaSuccess) {
+            throw std::runtime_error("Error: unable to allocate pinned host memory for reading back a frame");
+        }
+        s.capacity = count;
+        Memory.setHostBytes("readback", slot, "readback slot " + std::to_string(slot), count * sizeof(glm::vec4));
+    }
+    if (!s.done) cudaEventCreateWithFlags(&s.done, cudaEventDisableTiming);
+
+    // Launches run on OWL's streams, so they have to finish before the copy on the default stream starts
+    synchronizeDevices();
+    const glm::vec4 *fb = (const glm::vec4*) bufferGetPointer(OptixData.frameBuffer,0);
+    cudaMemcpyAsync(s.texels, fb, count * sizeof(glm::vec4), cudaMemcpyDeviceToHost);
+    cudaEventRecord(s.done);
+
+    glm::vec4* texels = s.texels;
+    cudaEvent_t done = s.done;
+    readback.isDone = [done] () { return cudaEventQuery(done) != cudaErrorNotReady; };
+    readback.take = [texels, count] () { return std::vector<float>((const float*) texels, (const float*) (texels + count)); };
+    return readback;
+}
+
+/* Frees the readback slots, once no readback uses them anymore */
+static void releaseReadbackSlots()
+{
+    Frames.flush();
+    for (auto &slot : ReadbackSlots) {
+        if (slot.texels) cudaFreeHost(slot.texels);
+        if (slot.done) cudaEventDestroy(slot.done);
+    }
+    for (uint32_t i = 0; i < ReadbackSlots.size(); ++i) Memory.remove("readback", i);
+    ReadbackSlots.clear();
+}
+
+std::vector<float> render(uint32_t width, uint32_t height, uint32_t samplesPerPixel, uint32_t seed, float timeBudgetMs) {
+    if ((width < 1) || (height < 1)) throw std::runtime_error("Error, invalid width/height");
+    if (timeBudgetMs < 0.f) throw std::runtime_error("Error, time budget must not be negative");
+    std::vector<float> frameBuffer(width * height * 4);
+
+    enqueueCommandAndWait([&frameBuffer, width, height, samplesPerPixel, seed, timeBudgetMs] () {
+        ProfiledFrame frame;
+        if (!Commits.manual) commitScene();
+        renderFrame(takeCommits(UINT64_MAX), width, height, samplesPerPixel, seed, timeBudgetMs);
+        copyFrameBufferToHost(frameBuffer.data(), width, height);
     });
 
     return frameBuffer;
 }
 
+RenderHandle::RenderHandle(uint64_t frameID, std::shared_future<std::vector<float>> future)
+    : frameID(frameID), future(future) {}
+
+void RenderHandle::wait()
+{
+    if (!future.valid()) throw std::runtime_error("Error: this render handle does not refer to a frame");
+    // Frames finish on the render thread, so waiting there has to keep it going
+    if (NVISII.render_thread_id == std::this_thread::get_id()) {
+        while (!ready()) processCommandQueue();
+        return;
+    }
+    future.wait();
+}
+
+bool RenderHandle::ready()
+{
+    return future.valid() && (future.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+}
+
+std::vector<float> RenderHandle::get()
+{
+    wait();
+    return future.get();
+}
+
+uint64_t RenderHandle::getFrameID()
+{
+    return frameID;
+}
+
+RenderHandle renderAsync(uint32_t width, uint32_t height, uint32_t samplesPerPixel, uint32_t seed, float timeBudgetMs) {
+    if ((width < 1) || (height < 1)) throw std::runtime_error("Error, invalid width/height");
+    if (timeBudgetMs < 0.f) throw std::runtime_error("Error, time budget must not be negative");
+    bool onRenderThread = (NVISII.render_thread_id == std::this_thread::get_id());
+    if (!onRenderThread && NVISII.callback) {
+        throw std::runtime_error(
+            std::string("Error: calling render_async while callback set, which could deadlock once the maximum ")
+            + std::string("number of frames is in flight. Either temporarily clear the callback, or alternatively ")
+            + std::string("call this function from within the callback.")
+        );
+    }
+
+    // The frame shows the scene as it is now, whatever edits come after this call
+    uint64_t generation;
+    if (Commits.manual) {
+        std::lock_guard<std::mutex> lock(Commits.mutex);
+        generation = Commits.generation;
+    }
+    else generation = commitScene();
+
+    auto frame = Frames.acquire(onRenderThread ? std::function<void()>(processCommandQueue) : nullptr);
+    enqueueCommand([frame, generation, width, height, samplesPerPixel, seed, timeBudgetMs] () {
+        ProfiledFrame profiledFrame;
+        try {
+            renderFrame(takeCommits(generation), width, height, samplesPerPixel, seed, timeBudgetMs);
+            Frames.submit(frame.id, startReadback(frame.slot, width, height));
+        }
+        catch (...) {
+            Frames.fail(frame.id, std::current_exception());
+        }
+    });
+    return RenderHandle(frame.id, frame.future);
+}
+
+void setMaxFramesInFlight(uint32_t count)
+{
+    Frames.setMaxFramesInFlight(count);
+}
+
+uint32_t getMaxFramesInFlight()
+{
+    return Frames.getMaxFramesInFlight();
+}
+
 std::string trim(const std::string& line)
 {
     const char* WhiteSpace = " \t\v\r\n";
@@ -2017,6 +3124,8 @@ std::vector<float> renderData(uint32_t width, uint32_t height, uint32_t startFra
     std::vector<float> frameBuffer(width * height * 4);
 
     enqueueCommandAndWait([&frameBuffer, width, height, startFrame, frameCount, bounce, _option, seed] () {
+        ProfiledFrame frame;
+        Frames.flush();
         if (!NVISII.headlessMode) {
             if ((width != WindowData.currentSize.x) || (height != WindowData.currentSize.y))
             {
@@ -2112,8 +3221,17 @@ std::vector<float> renderData(uint32_t width, uint32_t height, uint32_t startFra
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
             }
 
+            if (cpuBackend) {
+                cpuRenderFrame();
+                continue;
+            }
+
             updateLaunchParams();
-            owlLaunch2D(OptixData.rayGen, OptixData.LP.frameSize.x * OptixData.LP.frameSize.y, 1, OptixData.launchParams);
+            {
+                ScopedTimer launchTimer(Profiler, "launch");
+                ScopedGPUTimer launchGPUTimer("launch");
+                owlLaunch2D(OptixData.rayGen, OptixData.LP.frameSize.x * OptixData.LP.frameSize.y, 1, OptixData.launchParams);
+            }
             // Dont run denoiser to raw data rendering
             // if (OptixData.enableDenoiser)
             // {
@@ -2125,6 +3243,14 @@ std::vector<float> renderData(uint32_t width, uint32_t height, uint32_t startFra
             }
         }
 
+        ScopedTimer readbackTimer(Profiler, "readback");
+        if (cpuBackend) {
+            memcpy(frameBuffer.data(), CPUData.frameBuffer.data(), width * height * sizeof(glm::vec4));
+            OptixData.LP.renderDataMode = 0;
+            OptixData.LP.renderDataBounce = 0;
+            return;
+        }
+
         synchronizeDevices();
 
         const glm::vec4 *fb = (const glm::vec4*) bufferGetPointer(OptixData.frameBuffer,0);
@@ -2149,6 +3275,7 @@ void renderDataToFile(uint32_t width, uint32_t height, uint32_t startFrame, uint
     std::vector<float> fb = renderData(width, height, startFrame, frameCount, bounce, field);
     std::string extension = getFileExtension(imagePath);
     if ((extension.compare("exr") == 0) || (extension.compare("EXR") == 0)) {
+        TraceScope trace("encode image", "io");
         std::vector<float> colors(4 * width * height);
         for (size_t y = 0; y < height; ++y) {
             for (size_t x = 0; x < width; ++x) {     
@@ -2172,10 +3299,12 @@ void renderDataToFile(uint32_t width, uint32_t height, uint32_t startFrame, uint
         }
     }
     else if ((extension.compare("hdr") == 0) || (extension.compare("HDR") == 0)) {
+        TraceScope trace("encode image", "io");
         stbi_flip_vertically_on_write(true);
         stbi_write_hdr(imagePath.c_str(), width, height, /* num channels*/ 4, fb.data());
     }
     else if ((extension.compare("png") == 0) || (extension.compare("PNG") == 0)) {
+        TraceScope trace("encode image", "io");
         std::vector<uint8_t> colors(4 * width * height);
         for (size_t i = 0; i < (width * height); ++i) {     
             vec3 color = vec3(fb[i * 4 + 0], fb[i * 4 + 1], fb[i * 4 + 2]);
@@ -2267,6 +3396,7 @@ void renderToFile(uint32_t width, uint32_t height, uint32_t samplesPerPixel, std
     std::vector<float> fb = render(width, height, samplesPerPixel, seed);
     std::string extension = getFileExtension(imagePath);
     if ((extension.compare("exr") == 0) || (extension.compare("EXR") == 0)) {
+        TraceScope trace("encode image", "io");
         std::vector<float> colors(4 * width * height);
         for (size_t y = 0; y < height; ++y) {
             for (size_t x = 0; x < width; ++x) {     
@@ -2290,10 +3420,12 @@ void renderToFile(uint32_t width, uint32_t height, uint32_t samplesPerPixel, std
         }
     }
     else if ((extension.compare("hdr") == 0) || (extension.compare("HDR") == 0)) {
+        TraceScope trace("encode image", "io");
         stbi_flip_vertically_on_write(true);
         stbi_write_hdr(imagePath.c_str(), width, height, /* num channels*/ 4, fb.data());
     }
     else if ((extension.compare("png") == 0) || (extension.compare("PNG") == 0)) {
+        TraceScope trace("encode image", "io");
         std::vector<uint8_t> colors(4 * width * height);
         for (size_t i = 0; i < (width * height); ++i) {     
             vec3 color = vec3(fb[i * 4 + 0], fb[i * 4 + 1], fb[i * 4 + 2]);
@@ -2341,9 +3473,13 @@ void initializeComponentFactories(
     Light::initializeFactory(maxLights);
     Texture::initializeFactory(maxTextures);
     Volume::initializeFactory(maxVolumes);
-}
 
-void reproject(glm::vec4 *samplesBuffer, glm::vec4 *t0AlbedoBuffer, glm::vec4 *t1AlbedoBuffer, glm::vec4 *mvecBuffer, glm::vec4 *scratchBuffer, glm::vec4 *imageBuffer, int width, int height);
+    {
+        std::lock_guard<std::mutex> lock(Commits.mutex);
+        Commits.pending.clear();
+    }
+    Published.reset();
+}
 
 
 static bool initializeInteractiveDeprecatedShown = false;
@@ -2379,6 +3515,7 @@ void initializeInteractive(
 
     auto loop = [windowOnTop]() {
         NVISII.render_thread_id = std::this_thread::get_id();
+        TraceRecorder::setThreadName("nvisii render");
         NVISII.headlessMode = false;
 
         auto glfw = Libraries::GLFW::Get();
@@ -2408,25 +3545,22 @@ void initializeInteractive(
             static double stop=0;
             start = glfwGetTime();
 
-            if (!lazyUpdatesEnabled) {
+            // Asynchronous frames render the scene as it was when they were requested, so leave it alone until they are done
+            if (!lazyUpdatesEnabled && Frames.getFramesInFlight() == 0) {
+                ProfiledFrame frame;
                 updateFrameBuffer();
                 updateComponents();
                 updateLaunchParams();
-                owlLaunch2D(OptixData.rayGen, OptixData.LP.frameSize.x * OptixData.LP.frameSize.y, 1, OptixData.launchParams);
+                {
+                    ScopedTimer launchTimer(Profiler, "launch");
+                    ScopedGPUTimer launchGPUTimer("launch");
+                    owlLaunch2D(OptixData.rayGen, OptixData.LP.frameSize.x * OptixData.LP.frameSize.y, 1, OptixData.launchParams);
+                }
                 if (OptixData.enableDenoiser)
                 {
                     denoiseImage();
                 }        
             }
-            // glm::vec4* samplePtr = (glm::vec4*) bufferGetPointer(OptixData.accumBuffer,0);
-            // glm::vec4* mvecPtr = (glm::vec4*) bufferGetPointer(OptixData.mvecBuffer,0);
-            // glm::vec4* t0AlbPtr = (glm::vec4*) bufferGetPointer(OptixData.scratchBuffer,0);
-            // glm::vec4* t1AlbPtr = (glm::vec4*) bufferGetPointer(OptixData.albedoBuffer,0);
-            // glm::vec4* fbPtr = (glm::vec4*) bufferGetPointer(OptixData.frameBuffer,0);
-            // glm::vec4* sPtr = (glm::vec4*) bufferGetPointer(OptixData.normalBuffer,0);
-            // int width = OptixData.LP.frameSize.x;
-            // int height = OptixData.LP.frameSize.y;
-            // reproject(samplePtr, t0AlbPtr, t1AlbPtr, mvecPtr, sPtr, fbPtr, width, height);
 
             drawFrameBufferToWindow();
             stop = glfwGetTime();
@@ -2449,6 +3583,10 @@ void initializeInteractive(
         ImGui::DestroyContext();
         if (glfw->does_window_exist("NVISII")) glfw->destroy_window("NVISII");
 
+        Frames.failAll(std::make_exception_ptr(std::runtime_error("Error: nvisii was deinitialized before the frame was rendered")));
+        releaseReadbackSlots();
+        releaseGPUTimerEvents();
+
         owlContextDestroy(OptixData.context);
     };
 
@@ -2488,9 +3626,10 @@ void initializeHeadless(
 
     auto loop = []() {
         NVISII.render_thread_id = std::this_thread::get_id();
+        TraceRecorder::setThreadName("nvisii render");
         NVISII.headlessMode = true;
 
-        initializeOptix(/*headless = */ true);
+        if (!cpuBackend) initializeOptix(/*headless = */ true);
 
         while (!stopped)
         {
@@ -2501,8 +3640,17 @@ void initializeHeadless(
             if (stopped) break;
         }
 
+        Frames.failAll(std::make_exception_ptr(std::runtime_error("Error: nvisii was deinitialized before the frame was rendered")));
+        releaseReadbackSlots();
+
+        if (cpuBackend) {
+            cpuReleaseScene();
+            return;
+        }
+
         if (OptixData.denoiser)
             OPTIX_CHECK(optixDenoiserDestroy(OptixData.denoiser));
+        releaseGPUTimerEvents();
         
         owlContextDestroy(OptixData.context);
     };
@@ -2525,8 +3673,34 @@ void initialize(
     uint32_t maxMaterials,
     uint32_t maxLights,
     uint32_t maxTextures,
-    uint32_t maxVolumes) 
+    uint32_t maxVolumes,
+    std::string _backend,
+    uint32_t numThreads) 
 {
+    // don't initialize more than once
+    if (initialized == true) {
+        throw std::runtime_error("Error: already initialized!");
+    }
+
+    setThreadCount(numThreads);
+
+    std::string backend = _backend;
+    std::transform(backend.data(), backend.data() + backend.size(), std::addressof(backend[0]), [](unsigned char c){ return std::tolower(c); });
+    if (backend == std::string("optix")) {
+        cpuBackend = false;
+    }
+    else if (backend == std::string("cpu")) {
+        cpuBackend = true;
+        if (!headless) {
+            std::cout<<"Warning, the cpu backend does not support interactive mode. Running headless instead." << std::endl;
+            headless = true;
+        }
+    }
+    else {
+        throw std::runtime_error(std::string("Error, unknown backend : \"") + _backend + std::string("\". ")
+            + std::string("Available backends are \"optix\" and \"cpu\""));
+    }
+
     lazyUpdatesEnabled = _lazyUpdatesEnabled;
     // prevents deprecated warning from showing
     initializeInteractiveDeprecatedShown = true;
@@ -2559,6 +3733,7 @@ void registerCallback(std::function<void()> callback){
 void clearAll()
 {
     setCameraEntity(nullptr);
+    clearRandomizers();
     Entity::clearAll();
     Transform::clearAll();
     Material::clearAll();
@@ -2569,39 +3744,6 @@ void clearAll()
     Volume::clearAll();
 }
 
-glm::vec3 getSceneMinAabbCorner() {
-    return OptixData.LP.sceneBBMin;
-}
-
-glm::vec3 getSceneMaxAabbCorner() {
-    return OptixData.LP.sceneBBMax;
-}
-
-glm::vec3 getSceneAabbCenter() {
-    return OptixData.LP.sceneBBMin + (OptixData.LP.sceneBBMax - OptixData.LP.sceneBBMin) * .5f;
-}
-
-void updateSceneAabb(Entity* entity)
-{
-    // If updated entity AABB lies within scene AABB, return. 
-    glm::vec3 bbmin = entity->getMinAabbCorner();
-    glm::vec3 bbmax = entity->getMaxAabbCorner();
-
-    if (glm::all(glm::greaterThan(bbmin, glm::vec3(OptixData.LP.sceneBBMin))) && 
-        glm::all(glm::lessThan(bbmax, glm::vec3(OptixData.LP.sceneBBMax)))) return;
-
-    // otherwise, recompute scene AABB
-    bool first = true;
-    auto entities = Entity::getRenderableEntities();
-    for (auto &e : entities) {
-        OptixData.LP.sceneBBMin = (first) ? e->getMinAabbCorner() : 
-          glm::min(OptixData.LP.sceneBBMin, e->getMinAabbCorner());
-        OptixData.LP.sceneBBMax = (first) ? e->getMaxAabbCorner() : 
-          glm::max(OptixData.LP.sceneBBMax, e->getMaxAabbCorner());
-        first = false;
-    }
-}
-
 void enableUpdates()
 {
     enqueueCommand([] () { lazyUpdatesEnabled = false; });
@@ -2636,6 +3778,10 @@ void deinitialize()
     }
     initialized = false;
     checkForErrors();
+    cpuBackend = false;
+    Commits.manual = false;
+    Profiler.clear();
+    Memory.clear();
 }
 
 bool isButtonPressed(std::string button) {
@@ -1,56 +1,40 @@
 #include <nvisii/nvisii.h>
+#include <nvisii/utilities/temporal_accumulation.h>
 #include <optix_stubs.h>
 
 // In the future, this file can be used for stuff that uses the CUDA Thrust library
 
+namespace nvisii {
+
 __global__
-void _reproject(glm::vec4 *sampleBuffer, glm::vec4 *t0AlbedoBuffer, glm::vec4 *t1AlbedoBuffer, glm::vec4 *mvecBuffer, glm::vec4 *scratchBuffer, glm::vec4 *imageBuffer, bool copy, int width, int height)
+void _temporalAccumulate(const glm::vec4 *sampleBuffer, const glm::vec4 *guideBuffer,
+    const glm::vec4 *historyBuffer, const glm::vec4 *historyGuideBuffer,
+    glm::vec4 *imageBuffer, glm::vec4 *newHistoryBuffer,
+    float sampleCount, float maxHistorySamples, float depthTolerance, int width, int height)
 {
     // Compute column and row indices.
     const int c = blockIdx.x * blockDim.x + threadIdx.x;
     const int r = blockIdx.y * blockDim.y + threadIdx.y;
+    if ((c >= width) || (r >= height)) return;
     const int i = r * width + c; // 1D flat index
-    if (i >= (width * height)) return;
-
-    if (copy == true) {
-        scratchBuffer[i] = imageBuffer[i];
-        return;
-    }
-
-    glm::vec2 mvec = -glm::vec2(mvecBuffer[i]) * glm::vec2(width, height);
-    glm::vec2 p = glm::vec2(c, r);// / glm::vec2(width, height);
-
-    // mvec = -mvec * glm::vec4(width, height, 0, 0);
-    // mvec.x = 0.0f;
-
-    float weight = .95;
-
-    glm::ivec2 reproj = ivec2(p + mvec);
-    if (any(greaterThan(reproj, ivec2(width - 1, height - 1)))) weight = 0.0f;
-    if (any(lessThan(reproj, ivec2(0, 0)))) weight = 0.0f;
-    if (mvecBuffer[i].w < 0) weight = 0.f;
 
-    const int i_reproj = reproj.y * width + reproj.x; // 1D flat index 
-
-    glm::vec4 oldCol = scratchBuffer[i_reproj];
-    glm::vec4 curCol = sampleBuffer[i];
-
-    glm::vec4 oldAlb = t0AlbedoBuffer[i_reproj];
-    glm::vec4 curAlb = t1AlbedoBuffer[i];
-
-    if (!glm::all(glm::equal(oldAlb, curAlb))) weight = 0.f;
-
-    glm::vec4 newCol = glm::mix(curCol, oldCol, glm::vec4(weight));
-    imageBuffer[i] = newCol;
+    glm::vec4 col = temporalAccumulatePixel(c, r, width, height, sampleBuffer, guideBuffer,
+        historyBuffer, historyGuideBuffer, sampleCount, maxHistorySamples, depthTolerance);
+    newHistoryBuffer[i] = col;
+    imageBuffer[i] = glm::vec4(glm::vec3(col), 1.f);
 }
 
-void reproject(glm::vec4 *sampleBuffer, glm::vec4 *t0AlbedoBuffer, glm::vec4 *t1AlbedoBuffer, glm::vec4 *mvecBuffer, glm::vec4 *scratchBuffer, glm::vec4 *imageBuffer, int width, int height)
+void temporalAccumulateCUDA(const glm::vec4 *sampleBuffer, const glm::vec4 *guideBuffer,
+    const glm::vec4 *historyBuffer, const glm::vec4 *historyGuideBuffer,
+    glm::vec4 *imageBuffer, glm::vec4 *newHistoryBuffer,
+    float sampleCount, float maxHistorySamples, float depthTolerance, int width, int height, cudaStream_t stream)
 {
-    // TEMPORARY, reproject
-    dim3 blockSize(32,32);
+    dim3 blockSize(16,16);
     int bx = (width + blockSize.x - 1) / blockSize.x;
     int by = (height + blockSize.y - 1) / blockSize.y;
     dim3 gridSize = dim3 (bx, by);
-    _reproject<<<gridSize,blockSize>>>(sampleBuffer, t0AlbedoBuffer, t1AlbedoBuffer, mvecBuffer, scratchBuffer, imageBuffer, true, width, height);
-    _reproject<<<gridSize,blockSize>>>(sampleBuffer, t0AlbedoBuffer, t1AlbedoBuffer, mvecBuffer, scratchBuffer, imageBuffer, false, width, height);
-}
\ No newline at end of file
+    _temporalAccumulate<<<gridSize,blockSize,0,stream>>>(sampleBuffer, guideBuffer, historyBuffer, historyGuideBuffer,
+        imageBuffer, newHistoryBuffer, sampleCount, maxHistorySamples, depthTolerance, width, height);
+}
+
+};
@@ -1,4 +1,5 @@
 #include <nvisii/nvisii.h>
+#include <nvisii/utilities/trace.h>
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -42,6 +43,7 @@ std::string dirnameOf(const std::string& fname)
 
 Scene importScene(std::string path, glm::vec3 position, glm::vec3 scale, glm::quat rotation, std::vector<std::string> args)
 {
+    TraceScope trace("import scene", "io");
     bool updatesEnabled = areUpdatesEnabled();
 
     disableUpdates();
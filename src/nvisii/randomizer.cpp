@@ -0,0 +1,343 @@
+#include <nvisii/nvisii.h>
+#include <nvisii/utilities/sampler.h>
+#include <nvisii/utilities/thread_pool.h>
+#include <nvisii/utilities/trace.h>
+
+#include "randomizer.h"
+#include "scene_bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace nvisii {
+
+std::mutex Randomizer::mutex;
+std::vector<RandomizerConfig> Randomizer::randomizers;
+uint32_t Randomizer::seed = 0;
+
+enum RandomizerTarget : uint32_t {
+    RANDOMIZER_TRANSFORM = 0,
+    RANDOMIZER_MATERIAL = 1,
+    RANDOMIZER_LIGHT = 2
+};
+
+/* An attribute that can be randomized. Exactly one of the apply functions is set, depending on the target. */
+struct RandomizerAttribute {
+    const char* name;
+    RandomizerTarget target;
+    /* The number of floats a value takes */
+    uint32_t dimensions;
+    void (*applyTransform)(Transform &transform, const float* v);
+    void (*applyMaterial)(Material &material, const float* v);
+    void (*applyLight)(Light &light, const float* v);
+};
+
+/* Defined in a member function, so that the transform appliers below can write private fields */
+const RandomizerAttribute* Randomizer::getAttributes(uint32_t &count)
+{
+    static const RandomizerAttribute attributes[] = {
+        {"position", RANDOMIZER_TRANSFORM, 3, [] (Transform &t, const float* v) { t.position = vec3(v[0], v[1], v[2]); }, nullptr, nullptr},
+        {"rotation", RANDOMIZER_TRANSFORM, 4, [] (Transform &t, const float* v) { t.rotation = glm::normalize(quat(v[3], v[0], v[1], v[2])); }, nullptr, nullptr},
+        {"scale", RANDOMIZER_TRANSFORM, 3, [] (Transform &t, const float* v) { t.scale = vec3(v[0], v[1], v[2]); }, nullptr, nullptr},
+        {"uniform_scale", RANDOMIZER_TRANSFORM, 1, [] (Transform &t, const float* v) { t.scale = vec3(v[0]); }, nullptr, nullptr},
+        {"base_color", RANDOMIZER_MATERIAL, 3, nullptr, [] (Material &m, const float* v) { m.setBaseColor(vec3(v[0], v[1], v[2])); }, nullptr},
+        {"subsurface_color", RANDOMIZER_MATERIAL, 3, nullptr, [] (Material &m, const float* v) { m.setSubsurfaceColor(vec3(v[0], v[1], v[2])); }, nullptr},
+        {"subsurface_radius", RANDOMIZER_MATERIAL, 3, nullptr, [] (Material &m, const float* v) { m.setSubsurfaceRadius(vec3(v[0], v[1], v[2])); }, nullptr},
+        {"alpha", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setAlpha(v[0]); }, nullptr},
+        {"subsurface", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setSubsurface(v[0]); }, nullptr},
+        {"metallic", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setMetallic(v[0]); }, nullptr},
+        {"specular", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setSpecular(v[0]); }, nullptr},
+        {"specular_tint", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setSpecularTint(v[0]); }, nullptr},
+        {"roughness", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setRoughness(v[0]); }, nullptr},
+        {"anisotropic", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setAnisotropic(v[0]); }, nullptr},
+        {"anisotropic_rotation", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setAnisotropicRotation(v[0]); }, nullptr},
+        {"sheen", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setSheen(v[0]); }, nullptr},
+        {"sheen_tint", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setSheenTint(v[0]); }, nullptr},
+        {"clearcoat", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setClearcoat(v[0]); }, nullptr},
+        {"clearcoat_roughness", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setClearcoatRoughness(v[0]); }, nullptr},
+        {"ior", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setIor(v[0]); }, nullptr},
+        {"transmission", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setTransmission(v[0]); }, nullptr},
+        {"transmission_roughness", RANDOMIZER_MATERIAL, 1, nullptr, [] (Material &m, const float* v) { m.setTransmissionRoughness(v[0]); }, nullptr},
+        {"light_color", RANDOMIZER_LIGHT, 3, nullptr, nullptr, [] (Light &l, const float* v) { l.setColor(vec3(v[0], v[1], v[2])); }},
+        {"light_temperature", RANDOMIZER_LIGHT, 1, nullptr, nullptr, [] (Light &l, const float* v) { l.setTemperature(v[0]); }},
+        {"light_intensity", RANDOMIZER_LIGHT, 1, nullptr, nullptr, [] (Light &l, const float* v) { l.setIntensity(v[0]); }},
+        {"light_exposure", RANDOMIZER_LIGHT, 1, nullptr, nullptr, [] (Light &l, const float* v) { l.setExposure(v[0]); }},
+        {"light_falloff", RANDOMIZER_LIGHT, 1, nullptr, nullptr, [] (Light &l, const float* v) { l.setFalloff(v[0]); }},
+    };
+    count = uint32_t(sizeof(attributes) / sizeof(attributes[0]));
+    return attributes;
+}
+
+/* The index of "rotation" in the attribute table, which is drawn either as a uniform orientation or as euler angles */
+static const uint32_t RANDOMIZER_ROTATION = 1;
+
+/* A number in [0, 1), the dimension'th draw for the given key */
+static float randomizerUniform(uint32_t key, uint32_t dimension)
+{
+    return float(samplerHashCombine(key, dimension) >> 8) * (1.f / 16777216.f);
+}
+
+/* A normally distributed number, from the dimension'th pair of draws for the given key (Box-Muller) */
+static float randomizerNormal(uint32_t key, uint32_t dimension)
+{
+    float u1 = float((samplerHashCombine(key, 2 * dimension) >> 8) + 1) * (1.f / 16777216.f);
+    float u2 = randomizerUniform(key, 2 * dimension + 1);
+    return sqrtf(-2.f * logf(u1)) * cosf(6.28318531f * u2);
+}
+
+static vec3 randomizerHsvToRgb(vec3 c)
+{
+    vec3 p = glm::abs(glm::fract(vec3(c.x) + vec3(1.f, 2.f / 3.f, 1.f / 3.f)) * 6.f - vec3(3.f));
+    return c.z * glm::mix(vec3(1.f), glm::clamp(p - vec3(1.f), 0.f, 1.f), c.y);
+}
+
+/* Draws one value of the attribute into v */
+static void sampleRandomizer(const RandomizerConfig &r, const RandomizerAttribute &a, uint32_t key, float* v)
+{
+    const std::vector<float> &p = r.parameters;
+    bool rotation = (r.attribute == RANDOMIZER_ROTATION);
+
+    if (r.distribution == RANDOMIZER_CHOICE) {
+        uint32_t count = uint32_t(p.size()) / a.dimensions;
+        uint32_t choice = std::min(uint32_t(randomizerUniform(key, 0) * count), count - 1);
+        for (uint32_t i = 0; i < a.dimensions; ++i) v[i] = p[choice * a.dimensions + i];
+        return;
+    }
+
+    if (rotation && (p.size() == 0)) {
+        // A uniformly distributed orientation (Shoemake, "Uniform random rotations")
+        float u1 = randomizerUniform(key, 0), u2 = randomizerUniform(key, 1), u3 = randomizerUniform(key, 2);
+        float a1 = sqrtf(1.f - u1), a2 = sqrtf(u1);
+        v[0] = a1 * sinf(6.28318531f * u2);
+        v[1] = a1 * cosf(6.28318531f * u2);
+        v[2] = a2 * sinf(6.28318531f * u3);
+        v[3] = a2 * cosf(6.28318531f * u3);
+        return;
+    }
+
+    // Rotations are otherwise drawn as euler angles, then converted
+    uint32_t dimensions = (rotation) ? 3 : a.dimensions;
+    float draw[4];
+    bool broadcast = (p.size() == 2);
+    for (uint32_t i = 0; i < dimensions; ++i) {
+        float p0 = (broadcast) ? p[0] : p[i];
+        float p1 = (broadcast) ? p[1] : p[dimensions + i];
+        if (r.distribution == RANDOMIZER_NORMAL) draw[i] = p0 + p1 * randomizerNormal(key, i);
+        else draw[i] = p0 + (p1 - p0) * randomizerUniform(key, i);
+    }
+
+    if (r.distribution == RANDOMIZER_UNIFORM_HSV) {
+        vec3 rgb = randomizerHsvToRgb(vec3(draw[0], draw[1], draw[2]));
+        v[0] = rgb.r; v[1] = rgb.g; v[2] = rgb.b;
+    }
+    else if (rotation) {
+        quat q = quat(vec3(draw[0], draw[1], draw[2]));
+        v[0] = q.x; v[1] = q.y; v[2] = q.z; v[3] = q.w;
+    }
+    else for (uint32_t i = 0; i < dimensions; ++i) v[i] = draw[i];
+}
+
+const std::string* Randomizer::resolveEntities(const std::vector<std::string> &names, std::vector<uint32_t> &ids)
+{
+    const std::string* missing = nullptr;
+    auto &lookupTable = Entity::lookupTable;
+    ids.clear();
+    for (const auto &name : names) {
+        size_t before = ids.size();
+        if (!name.empty() && name.back() == '*') {
+            std::string prefix = name.substr(0, name.size() - 1);
+            auto it = lookupTable.lower_bound(prefix);
+            for (; (it != lookupTable.end()) && (it->first.compare(0, prefix.size(), prefix) == 0); ++it)
+                ids.push_back(it->second);
+        } else {
+            auto it = lookupTable.find(name);
+            if (it != lookupTable.end()) ids.push_back(it->second);
+        }
+        if ((ids.size() == before) && !missing) missing = &name;
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return missing;
+}
+
+uint32_t Randomizer::add(const std::string &attribute, const std::vector<std::string> &entities,
+    const std::string &distribution, const std::vector<float> &parameters)
+{
+    uint32_t numAttributes;
+    const RandomizerAttribute* attributes = getAttributes(numAttributes);
+    RandomizerConfig r;
+    r.attribute = numAttributes;
+    for (uint32_t i = 0; i < numAttributes; ++i)
+        if (attribute == attributes[i].name) r.attribute = i;
+    if (r.attribute == numAttributes)
+        throw std::runtime_error("Error: \"" + attribute + "\" is not an attribute that can be randomized");
+    const RandomizerAttribute &a = attributes[r.attribute];
+    bool rotation = (r.attribute == RANDOMIZER_ROTATION);
+
+    if (distribution == "uniform") r.distribution = RANDOMIZER_UNIFORM;
+    else if (distribution == "normal") r.distribution = RANDOMIZER_NORMAL;
+    else if (distribution == "choice") r.distribution = RANDOMIZER_CHOICE;
+    else if (distribution == "uniform_hsv") r.distribution = RANDOMIZER_UNIFORM_HSV;
+    else throw std::runtime_error("Error: unknown distribution \"" + distribution + "\". Valid distributions are uniform, normal, choice, and uniform_hsv");
+
+    // Validate the parameters now, so that randomize can't fail halfway through a frame
+    size_t n = parameters.size();
+    uint32_t dimensions = (rotation) ? 3 : a.dimensions;
+    if (r.distribution == RANDOMIZER_CHOICE) {
+        if ((n == 0) || (n % a.dimensions != 0))
+            throw std::runtime_error("Error: the choice distribution for " + attribute + " needs a non empty list of values with " + std::to_string(a.dimensions) + " floats each");
+    }
+    else if (r.distribution == RANDOMIZER_UNIFORM_HSV) {
+        if ((a.dimensions != 3) || (rotation) || (a.target == RANDOMIZER_TRANSFORM))
+            throw std::runtime_error("Error: the uniform_hsv distribution can only be used with colors");
+        if (n != 6)
+            throw std::runtime_error("Error: the uniform_hsv distribution needs 6 parameters, the minimum and then the maximum hue, saturation and value");
+    }
+    else if (!((n == 2) || (n == 2 * dimensions) || (rotation && (n == 0) && (r.distribution == RANDOMIZER_UNIFORM)))) {
+        throw std::runtime_error("Error: the " + distribution + " distribution for " + attribute + " needs either 2 or " +
+            std::to_string(2 * dimensions) + " parameters" + ((rotation) ? " (euler angles), or none for uniform rotations" : ""));
+    }
+    r.parameters = parameters;
+    r.entityNames = entities;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    {
+        // Names are resolved again every time the randomizer is applied, but must match something now
+        std::lock_guard<std::recursive_mutex> entity_lock(*Entity::getEditMutex().get());
+        std::vector<uint32_t> ids;
+        const std::string* missing = resolveEntities(r.entityNames, ids);
+        if (missing && !missing->empty() && missing->back() == '*')
+            throw std::runtime_error("Error: no Entity matches \"" + *missing + "\"");
+        if (missing)
+            throw std::runtime_error("Error: Entity \"" + *missing + "\" does not exist.");
+    }
+
+    randomizers.push_back(std::move(r));
+    return uint32_t(randomizers.size() - 1);
+}
+
+void Randomizer::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    randomizers.clear();
+}
+
+void Randomizer::setSeed(uint32_t newSeed)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    seed = newSeed;
+}
+
+void Randomizer::randomize(uint32_t frame)
+{
+    TraceScope trace("randomize", "randomizer");
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Same order as the scene snapshot, so that randomizing can't deadlock against a commit
+    std::lock_guard<std::recursive_mutex> mesh_lock(*Mesh::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> transform_lock(*Transform::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> entity_lock(*Entity::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> light_lock(*Light::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> material_lock(*Material::getEditMutex().get());
+
+    uint32_t numAttributes;
+    const RandomizerAttribute* attributes = getAttributes(numAttributes);
+    auto &entities = Entity::entities;
+    auto &entityStructs = Entity::entityStructs;
+    auto &transforms = Transform::transforms;
+    std::vector<uint8_t> touched(transforms.size(), 0);
+    std::vector<uint32_t> ids;
+    std::vector<float> values;
+
+    uint32_t frameKey = samplerHashCombine(samplerHash(seed), frame);
+    for (uint32_t ri = 0; ri < uint32_t(randomizers.size()); ++ri) {
+        const RandomizerConfig &r = randomizers[ri];
+        const RandomizerAttribute &a = attributes[r.attribute];
+        uint32_t randomizerKey = samplerHashCombine(frameKey, ri);
+
+        // Entities may have been created or removed since the randomizer was added. Names which no longer match are skipped.
+        resolveEntities(r.entityNames, ids);
+
+        // Every draw depends only on its key, so they can be made in any order
+        values.resize(ids.size() * a.dimensions);
+        ThreadPool::global().parallelFor(0, ids.size(), [&] (uint64_t i) {
+            uint32_t key = samplerHashCombine(randomizerKey, ids[i]);
+            sampleRandomizer(r, a, key, &values[i * a.dimensions]);
+        });
+
+        // Entities may share materials and lights, so writes happen in a fixed order, on this thread
+        for (size_t i = 0; i < ids.size(); ++i) {
+            uint32_t eid = ids[i];
+            if (!entities[eid].isInitialized()) continue;
+            const EntityStruct &e = entityStructs[eid];
+            const float* v = &values[i * a.dimensions];
+            if ((a.target == RANDOMIZER_TRANSFORM) && (e.transform_id != -1) && transforms[e.transform_id].isInitialized()) {
+                a.applyTransform(transforms[e.transform_id], v);
+                touched[e.transform_id] = 1;
+            }
+            else if ((a.target == RANDOMIZER_MATERIAL) && (e.material_id != -1) && Material::materials[e.material_id].isInitialized()) {
+                a.applyMaterial(Material::materials[e.material_id], v);
+            }
+            else if ((a.target == RANDOMIZER_LIGHT) && (e.light_id != -1) && Light::lights[e.light_id].isInitialized()) {
+                a.applyLight(Light::lights[e.light_id], v);
+            }
+        }
+    }
+
+    // Transforms outside of a hierarchy only depend on themselves, so their matrices are recomputed in parallel.
+    // The rest go through the usual update, which also refreshes their children.
+    std::vector<uint32_t> independent;
+    bool anyTouched = false;
+    for (uint32_t tid = 0; tid < uint32_t(touched.size()); ++tid) {
+        if (!touched[tid]) continue;
+        anyTouched = true;
+        Transform &t = transforms[tid];
+        if ((t.parent == -1) && t.children.empty()) independent.push_back(tid);
+        else t.updateMatrix();
+    }
+    if (!anyTouched) return;
+
+    ThreadPool::global().parallelFor(0, independent.size(), [&] (uint64_t i) {
+        Transform &t = transforms[independent[i]];
+        t.computeLocalMatrices();
+        t.computeWorldMatrices();
+    });
+
+    std::vector<Entity*> moved;
+    for (uint32_t tid : independent) {
+        Transform::dirtyTransforms.insert(&transforms[tid]);
+        for (auto eid : transforms[tid].entities) moved.push_back(&entities[eid]);
+    }
+
+    // Each entity has a single transform, so no two of these write the same bounds
+    ThreadPool::global().parallelFor(0, moved.size(), [&] (uint64_t i) {
+        moved[i]->computeAabb(/*updateScene=*/false);
+    });
+    for (auto entity : moved) Entity::dirtyEntities.insert(entity);
+
+    // Grow the scene bounds once, rather than once per entity
+    resetSceneAabb();
+    if (!Entity::renderableEntities.empty()) updateSceneAabb(*Entity::renderableEntities.begin());
+}
+
+uint32_t addRandomizer(std::string attribute, std::vector<std::string> entities, std::string distribution, std::vector<float> parameters)
+{
+    return Randomizer::add(attribute, entities, distribution, parameters);
+}
+
+void clearRandomizers()
+{
+    Randomizer::clear();
+}
+
+void setRandomizerSeed(uint32_t seed)
+{
+    Randomizer::setSeed(seed);
+}
+
+void randomize(uint32_t frame)
+{
+    Randomizer::randomize(frame);
+}
+
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Domain randomization, driven by addRandomizer and randomize.
+ *
+ * A randomizer draws one attribute (eg, "position" or "roughness") of a set of entities from a
+ * distribution. Every draw is a hash of the seed, the frame, the randomizer and the entity id, rather
+ * than the next number of a sequential generator, so a frame can be reproduced on its own, and the
+ * draws can be made in any order, over all threads. The draws are then written straight into the
+ * transforms, materials and lights, which are updated in bulk rather than one setter at a time.
+ */
+
+namespace nvisii {
+
+struct RandomizerAttribute;
+
+enum RandomizerDistribution : uint32_t {
+    RANDOMIZER_UNIFORM = 0,
+    RANDOMIZER_NORMAL = 1,
+    RANDOMIZER_CHOICE = 2,
+    RANDOMIZER_UNIFORM_HSV = 3
+};
+
+struct RandomizerConfig {
+    /* An index into the table of attributes in randomizer.cpp */
+    uint32_t attribute;
+    RandomizerDistribution distribution;
+    std::vector<float> parameters;
+    /* Entity names and prefixes, resolved every time the randomizer is applied */
+    std::vector<std::string> entityNames;
+};
+
+/* Friend of the transform, material, light and entity components, so that draws can be written without going through the setters */
+class Randomizer {
+public:
+    /* @returns the index of the new randomizer. Throws if the attribute, distribution or parameters are invalid. */
+    static uint32_t add(const std::string &attribute, const std::vector<std::string> &entities,
+        const std::string &distribution, const std::vector<float> &parameters);
+
+    static void clear();
+
+    static void setSeed(uint32_t seed);
+
+    /* Applies every randomizer, in the order they were added. Locks every affected component type. */
+    static void randomize(uint32_t frame);
+
+private:
+    /* @returns the table of attributes that can be randomized, and its length in count */
+    static const RandomizerAttribute* getAttributes(uint32_t &count);
+
+    /*
+     * Looks up the ids of the named entities, sorted and without duplicates. Names ending in '*' match every entity
+     * starting with the rest of the name. The entity edit mutex must be held.
+     * @returns the first name which matched no entity, or nullptr if they all did
+     */
+    static const std::string* resolveEntities(const std::vector<std::string> &names, std::vector<uint32_t> &ids);
+
+    static std::mutex mutex;
+    static std::vector<RandomizerConfig> randomizers;
+    static uint32_t seed;
+};
+
+};
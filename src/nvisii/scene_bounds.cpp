@@ -0,0 +1,48 @@
+#include <nvisii/nvisii.h>
+
+#include "scene_bounds.h"
+
+namespace nvisii {
+
+static glm::vec3 sceneBBMin = glm::vec3(0.f);
+static glm::vec3 sceneBBMax = glm::vec3(0.f);
+
+void resetSceneAabb()
+{
+    sceneBBMin = sceneBBMax = glm::vec3(0.f);
+}
+
+glm::vec3 getSceneMinAabbCorner() {
+    return sceneBBMin;
+}
+
+glm::vec3 getSceneMaxAabbCorner() {
+    return sceneBBMax;
+}
+
+glm::vec3 getSceneAabbCenter() {
+    return sceneBBMin + (sceneBBMax - sceneBBMin) * .5f;
+}
+
+void updateSceneAabb(Entity* entity)
+{
+    // If updated entity AABB lies within scene AABB, return. 
+    glm::vec3 bbmin = entity->getMinAabbCorner();
+    glm::vec3 bbmax = entity->getMaxAabbCorner();
+
+    if (glm::all(glm::greaterThan(bbmin, sceneBBMin)) && 
+        glm::all(glm::lessThan(bbmax, sceneBBMax))) return;
+
+    // otherwise, recompute scene AABB
+    bool first = true;
+    auto entities = Entity::getRenderableEntities();
+    for (auto &e : entities) {
+        sceneBBMin = (first) ? e->getMinAabbCorner() : 
+          glm::min(sceneBBMin, e->getMinAabbCorner());
+        sceneBBMax = (first) ? e->getMaxAabbCorner() : 
+          glm::max(sceneBBMax, e->getMaxAabbCorner());
+        first = false;
+    }
+}
+
+};
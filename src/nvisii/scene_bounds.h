@@ -0,0 +1,17 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+/**
+ * The bounds of all renderable entities, as returned by getSceneMinAabbCorner and
+ * getSceneMaxAabbCorner. They are kept with the components rather than the renderer,
+ * so that nvisii_core can maintain them without CUDA, and the renderer copies them
+ * into its launch parameters every frame.
+ */
+
+namespace nvisii {
+
+/* Forgets the current scene bounds, eg when the renderer is (re)initialized */
+void resetSceneAabb();
+
+};
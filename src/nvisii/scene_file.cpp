@@ -0,0 +1,688 @@
+#include <nvisii/nvisii.h>
+#include <nvisii/utilities/trace.h>
+
+#include "entity_instances.h"
+#include "scene_bounds.h"
+#include "scene_file.h"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <type_traits>
+
+namespace nvisii {
+
+static uint64_t alignSceneFileOffset(uint64_t offset)
+{
+    return (offset + 15) & ~uint64_t(15);
+}
+
+/* Gathers the sections of a scene file. Payloads are only referenced, so components must stay locked until written. */
+struct SceneFileWriter {
+    std::string strings;
+    std::vector<std::pair<const void*, uint64_t>> chunks;
+    uint64_t dataSize = 0;
+
+    SceneFileComponent addComponent(uint32_t id, const std::string &name)
+    {
+        SceneFileComponent component;
+        component.id = id;
+        component.nameLength = uint32_t(name.size());
+        component.nameOffset = strings.size();
+        strings += name;
+        return component;
+    }
+
+    /* @returns the offset of the first of the given arrays in the data section. The arrays are written back to back. */
+    template<typename T>
+    uint64_t addData(const std::vector<T> &data)
+    {
+        uint64_t offset = dataSize;
+        chunks.push_back({data.data(), data.size() * sizeof(T)});
+        dataSize += data.size() * sizeof(T);
+        return offset;
+    }
+
+    /* Starts the payload of the next component on a 16 byte boundary */
+    void align()
+    {
+        uint64_t aligned = alignSceneFileOffset(dataSize);
+        if (aligned != dataSize) chunks.push_back({nullptr, aligned - dataSize});
+        dataSize = aligned;
+    }
+};
+
+void SceneFile::save(const std::string &path)
+{
+    TraceScope trace("save scene", "io");
+
+    std::lock_guard<std::recursive_mutex> mesh_lock(*Mesh::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> camera_lock(*Camera::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> transform_lock(*Transform::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> entity_lock(*Entity::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> light_lock(*Light::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> texture_lock(*Texture::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> volume_lock(*Volume::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> material_lock(*Material::getEditMutex().get());
+
+    SceneFileWriter writer;
+
+    std::vector<SceneFileEntity> entities;
+    for (uint32_t id = 0; id < Entity::getCount(); ++id) {
+        Entity &e = Entity::entities[id];
+        if (!e.isInitialized()) continue;
+        SceneFileEntity r;
+        r.component = writer.addComponent(id, e.name);
+        r.data = Entity::entityStructs[id];
+        r.active = e.active ? 1 : 0;
+        const EntityInstances* instances = Entity::entityInstances[id].get();
+        r.hasInstances = instances ? 1 : 0;
+        r.numInstances = instances ? instances->size() : 0;
+        r.numInstanceMaterials = instances ? uint32_t(instances->materialIDs.size()) : 0;
+        r.instanceDataOffset = 0;
+        if (instances) {
+            writer.align();
+            r.instanceDataOffset = writer.addData(instances->transforms);
+            writer.addData(instances->materialIDs);
+        }
+        entities.push_back(r);
+    }
+
+    std::vector<SceneFileTransform> transforms;
+    for (uint32_t id = 0; id < Transform::getCount(); ++id) {
+        Transform &t = Transform::transforms[id];
+        if (!t.isInitialized()) continue;
+        SceneFileTransform r;
+        r.component = writer.addComponent(id, t.name);
+        r.data = Transform::transformStructs[id];
+        r.parent = t.parent;
+        r.useRelativeLinearMotionBlur = t.useRelativeLinearMotionBlur ? 1 : 0;
+        r.useRelativeAngularMotionBlur = t.useRelativeAngularMotionBlur ? 1 : 0;
+        r.useRelativeScalarMotionBlur = t.useRelativeScalarMotionBlur ? 1 : 0;
+        r.scale = t.scale;
+        r.position = t.position;
+        r.rotation = t.rotation;
+        r.prevScale = t.prevScale;
+        r.prevPosition = t.prevPosition;
+        r.prevRotation = t.prevRotation;
+        r.linearMotion = t.linearMotion;
+        r.angularMotion = t.angularMotion;
+        r.scalarMotion = t.scalarMotion;
+        r.localToParentTransform = t.localToParentTransform;
+        r.localToParentMatrix = t.localToParentMatrix;
+        r.parentToLocalMatrix = t.parentToLocalMatrix;
+        r.prevLocalToParentTransform = t.prevLocalToParentTransform;
+        r.prevLocalToParentMatrix = t.prevLocalToParentMatrix;
+        r.prevParentToLocalMatrix = t.prevParentToLocalMatrix;
+        r.localToWorldMatrix = t.localToWorldMatrix;
+        r.worldToLocalMatrix = t.worldToLocalMatrix;
+        r.prevLocalToWorldMatrix = t.prevLocalToWorldMatrix;
+        r.prevWorldToLocalMatrix = t.prevWorldToLocalMatrix;
+        transforms.push_back(r);
+    }
+
+    std::vector<SceneFileMaterial> materials;
+    for (uint32_t id = 0; id < Material::getCount(); ++id) {
+        Material &m = Material::materials[id];
+        if (!m.isInitialized()) continue;
+        SceneFileMaterial r;
+        r.component = writer.addComponent(id, m.name);
+        r.data = Material::materialStructs[id];
+        r.baseColor = m.base_color;
+        r.subsurfaceRadius = m.subsurface_radius;
+        r.subsurfaceColor = m.subsurface_color;
+        r.subsurface = m.subsurface;
+        r.metallic = m.metallic;
+        r.specular = m.specular;
+        r.specularTint = m.specular_tint;
+        r.roughness = m.roughness;
+        r.anisotropic = m.anisotropic;
+        r.anisotropicRotation = m.anisotropic_rotation;
+        r.sheen = m.sheen;
+        r.sheenTint = m.sheen_tint;
+        r.clearcoat = m.clearcoat;
+        r.clearcoatRoughness = m.clearcoat_roughness;
+        r.ior = m.ior;
+        r.transmission = m.transmission;
+        r.transmissionRoughness = m.transmission_roughness;
+        materials.push_back(r);
+    }
+
+    std::vector<SceneFileCamera> cameras;
+    for (uint32_t id = 0; id < Camera::getCount(); ++id) {
+        Camera &c = Camera::cameras[id];
+        if (!c.isInitialized()) continue;
+        SceneFileCamera r;
+        r.component = writer.addComponent(id, c.name);
+        r.data = Camera::cameraStructs[id];
+        cameras.push_back(r);
+    }
+
+    std::vector<SceneFileLight> lights;
+    for (uint32_t id = 0; id < Light::getCount(); ++id) {
+        Light &l = Light::lights[id];
+        if (!l.isInitialized()) continue;
+        SceneFileLight r;
+        r.component = writer.addComponent(id, l.name);
+        r.data = Light::lightStructs[id];
+        lights.push_back(r);
+    }
+
+    std::vector<SceneFileMesh> meshes;
+    for (uint32_t id = 0; id < Mesh::getCount(); ++id) {
+        Mesh &m = Mesh::meshes[id];
+        if (!m.isInitialized()) continue;
+        SceneFileMesh r;
+        r.component = writer.addComponent(id, m.name);
+        r.data = Mesh::meshStructs[id];
+        r.numPositions = uint32_t(m.positions.size());
+        r.numNormals = uint32_t(m.normals.size());
+        r.numTangents = uint32_t(m.tangents.size());
+        r.numColors = uint32_t(m.colors.size());
+        r.numTexCoords = uint32_t(m.texCoords.size());
+        r.numIndices = uint32_t(m.triangleIndices.size());
+        r.numRadii = uint32_t(m.radii.size());
+        writer.align();
+        r.dataOffset = writer.addData(m.positions);
+        writer.addData(m.normals);
+        writer.addData(m.tangents);
+        writer.addData(m.colors);
+        writer.addData(m.texCoords);
+        writer.addData(m.triangleIndices);
+        writer.addData(m.radii);
+        meshes.push_back(r);
+    }
+
+    std::vector<SceneFileTexture> textures;
+    for (uint32_t id = 0; id < Texture::getCount(); ++id) {
+        Texture &t = Texture::textures[id];
+        if (!t.isInitialized()) continue;
+        SceneFileTexture r;
+        r.component = writer.addComponent(id, t.name);
+        r.data = Texture::textureStructs[id];
+        r.linear = t.linear ? 1 : 0;
+        r.hdr = t.floatTexels.size() > 0 ? 1 : 0;
+        r.numTexels = r.hdr ? t.floatTexels.size() : t.byteTexels.size();
+        writer.align();
+        r.dataOffset = r.hdr ? writer.addData(t.floatTexels) : writer.addData(t.byteTexels);
+        textures.push_back(r);
+    }
+
+    std::vector<SceneFileVolume> volumes;
+    for (uint32_t id = 0; id < Volume::getCount(); ++id) {
+        Volume &v = Volume::volumes[id];
+        if (!v.isInitialized() || !v.gridHdlPtr) continue;
+        SceneFileVolume r;
+        r.component = writer.addComponent(id, v.name);
+        r.data = Volume::volumeStructs[id];
+        r.gridSize = v.gridHdlPtr->size();
+        writer.align();
+        r.dataOffset = writer.dataSize;
+        writer.chunks.push_back({v.gridHdlPtr->data(), r.gridSize});
+        writer.dataSize += r.gridSize;
+        volumes.push_back(r);
+    }
+
+    // Lay out the sections, each on a 16 byte boundary
+    SceneFileSection sections[SCENE_FILE_NUM_SECTIONS];
+    const void* sectionData[SCENE_FILE_NUM_SECTIONS];
+    auto setSection = [&] (SceneFileSectionType type, const void* data, uint64_t count, uint64_t size) {
+        sections[type].type = type;
+        sections[type].count = uint32_t(count);
+        sections[type].size = size;
+        sectionData[type] = data;
+    };
+    setSection(SCENE_FILE_STRINGS, writer.strings.data(), writer.strings.size(), writer.strings.size());
+    setSection(SCENE_FILE_ENTITIES, entities.data(), entities.size(), entities.size() * sizeof(SceneFileEntity));
+    setSection(SCENE_FILE_TRANSFORMS, transforms.data(), transforms.size(), transforms.size() * sizeof(SceneFileTransform));
+    setSection(SCENE_FILE_MATERIALS, materials.data(), materials.size(), materials.size() * sizeof(SceneFileMaterial));
+    setSection(SCENE_FILE_CAMERAS, cameras.data(), cameras.size(), cameras.size() * sizeof(SceneFileCamera));
+    setSection(SCENE_FILE_LIGHTS, lights.data(), lights.size(), lights.size() * sizeof(SceneFileLight));
+    setSection(SCENE_FILE_MESHES, meshes.data(), meshes.size(), meshes.size() * sizeof(SceneFileMesh));
+    setSection(SCENE_FILE_TEXTURES, textures.data(), textures.size(), textures.size() * sizeof(SceneFileTexture));
+    setSection(SCENE_FILE_VOLUMES, volumes.data(), volumes.size(), volumes.size() * sizeof(SceneFileVolume));
+    setSection(SCENE_FILE_DATA, nullptr, 0, writer.dataSize);
+
+    uint64_t offset = sizeof(SceneFileHeader) + sizeof(sections);
+    for (auto &section : sections) {
+        offset = alignSceneFileOffset(offset);
+        section.offset = offset;
+        offset += section.size;
+    }
+
+    SceneFileHeader header;
+    memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+    header.version = SCENE_FILE_VERSION;
+    header.numSections = SCENE_FILE_NUM_SECTIONS;
+    header.fileSize = offset;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error(std::string("Error: unable to open scene \"") + path + "\"");
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)sections, sizeof(sections));
+
+    static const char padding[16] = {};
+    uint64_t written = sizeof(header) + sizeof(sections);
+    for (uint32_t i = 0; i < SCENE_FILE_NUM_SECTIONS; ++i) {
+        file.write(padding, sections[i].offset - written);
+        if (i == SCENE_FILE_DATA) {
+            for (auto &chunk : writer.chunks) {
+                if (chunk.first) file.write((const char*)chunk.first, chunk.second);
+                else file.write(padding, chunk.second);
+            }
+        }
+        else file.write((const char*)sectionData[i], sections[i].size);
+        written = sections[i].offset + sections[i].size;
+    }
+    if (!file) throw std::runtime_error(std::string("Error: unable to write scene \"") + path + "\"");
+}
+
+/* A scene file read into memory, with every section checked to lie within the file */
+struct SceneFileContents {
+    std::string path;
+    std::vector<uint8_t> bytes;
+    const SceneFileSection* sections = nullptr;
+
+    [[noreturn]] void corrupt() const
+    {
+        throw std::runtime_error(std::string("Error: scene \"") + path + "\" is truncated or corrupt");
+    }
+
+    template<typename Record>
+    const Record* getRecords(SceneFileSectionType type, uint32_t &count) const
+    {
+        count = sections[type].count;
+        if (sections[type].size != uint64_t(count) * sizeof(Record)) corrupt();
+        return (const Record*)(bytes.data() + sections[type].offset);
+    }
+
+    std::string getName(const SceneFileComponent &component) const
+    {
+        const SceneFileSection &strings = sections[SCENE_FILE_STRINGS];
+        if (component.nameLength > strings.size || component.nameOffset > strings.size - component.nameLength) corrupt();
+        return std::string((const char*)bytes.data() + strings.offset + component.nameOffset, component.nameLength);
+    }
+
+    /* @returns a pointer to size bytes at offset in the data section */
+    const uint8_t* getData(uint64_t offset, uint64_t size) const
+    {
+        const SceneFileSection &data = sections[SCENE_FILE_DATA];
+        if (offset > data.size || size > data.size - offset) corrupt();
+        return bytes.data() + data.offset + offset;
+    }
+};
+
+static SceneFileContents readSceneFile(const std::string &path)
+{
+    SceneFileContents contents;
+    contents.path = path;
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) throw std::runtime_error(std::string("Error: unable to open scene \"") + path + "\"");
+    uint64_t fileSize = uint64_t(file.tellg());
+    file.seekg(0);
+
+    SceneFileHeader header;
+    if (fileSize < sizeof(header) || !file.read((char*)&header, sizeof(header))
+        || memcmp(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic)) != 0)
+        throw std::runtime_error(std::string("Error: \"") + path + "\" is not a scene file");
+    if (header.version != SCENE_FILE_VERSION)
+        throw std::runtime_error(std::string("Error: scene \"") + path + "\" has version "
+            + std::to_string(header.version) + ", expected " + std::to_string(SCENE_FILE_VERSION) + ". Please save it again.");
+    if (header.fileSize != fileSize || header.numSections != SCENE_FILE_NUM_SECTIONS) contents.corrupt();
+
+    contents.bytes.resize(fileSize);
+    file.seekg(0);
+    if (!file.read((char*)contents.bytes.data(), fileSize))
+        throw std::runtime_error(std::string("Error: unable to read scene \"") + path + "\"");
+
+    contents.sections = (const SceneFileSection*)(contents.bytes.data() + sizeof(SceneFileHeader));
+    if (fileSize < sizeof(SceneFileHeader) + SCENE_FILE_NUM_SECTIONS * sizeof(SceneFileSection)) contents.corrupt();
+    for (uint32_t i = 0; i < SCENE_FILE_NUM_SECTIONS; ++i) {
+        const SceneFileSection &section = contents.sections[i];
+        if (section.type != i || (section.offset % 16) != 0) contents.corrupt();
+        if (section.offset > fileSize || section.size > fileSize - section.offset) contents.corrupt();
+    }
+    return contents;
+}
+
+/* @returns true if id is -1 or refers to a component in the file, as flagged in present */
+static bool isSceneFileReference(int32_t id, const std::vector<uint8_t> &present)
+{
+    return id == -1 || (id >= 0 && uint32_t(id) < present.size() && present[id]);
+}
+
+void SceneFile::load(const std::string &path)
+{
+    TraceScope trace("load scene", "io");
+
+    SceneFileContents contents = readSceneFile(path);
+
+    std::lock_guard<std::recursive_mutex> mesh_lock(*Mesh::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> camera_lock(*Camera::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> transform_lock(*Transform::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> entity_lock(*Entity::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> light_lock(*Light::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> texture_lock(*Texture::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> volume_lock(*Volume::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> material_lock(*Material::getEditMutex().get());
+
+    uint32_t numEntities, numTransforms, numMaterials, numCameras, numLights, numMeshes, numTextures, numVolumes;
+    auto entityRecords = contents.getRecords<SceneFileEntity>(SCENE_FILE_ENTITIES, numEntities);
+    auto transformRecords = contents.getRecords<SceneFileTransform>(SCENE_FILE_TRANSFORMS, numTransforms);
+    auto materialRecords = contents.getRecords<SceneFileMaterial>(SCENE_FILE_MATERIALS, numMaterials);
+    auto cameraRecords = contents.getRecords<SceneFileCamera>(SCENE_FILE_CAMERAS, numCameras);
+    auto lightRecords = contents.getRecords<SceneFileLight>(SCENE_FILE_LIGHTS, numLights);
+    auto meshRecords = contents.getRecords<SceneFileMesh>(SCENE_FILE_MESHES, numMeshes);
+    auto textureRecords = contents.getRecords<SceneFileTexture>(SCENE_FILE_TEXTURES, numTextures);
+    auto volumeRecords = contents.getRecords<SceneFileVolume>(SCENE_FILE_VOLUMES, numVolumes);
+
+    // Validate everything up front, so that a bad file leaves the current scene alone.
+    // Every record must go to a location which exists in, and is not reserved by a create in, its factory,
+    // under a name which is unique in the file and not held by a component which is still being created.
+    // @returns which locations of the factory the file holds a component for
+    auto checkIDs = [&contents] (auto* records, uint32_t count, auto* items, uint32_t maxItems,
+        const std::map<std::string, uint32_t> &lookupTable, const char* typeName) {
+        std::vector<uint8_t> present(maxItems, 0);
+        std::set<std::string> names;
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t id = records[i].component.id;
+            if (id >= maxItems)
+                throw std::runtime_error(std::string("Error: scene \"") + contents.path + "\" needs more than " + std::to_string(id)
+                    + " " + typeName + " components, but only " + std::to_string(maxItems) + " were allowed at initialization");
+            if (present[id]) contents.corrupt();
+            present[id] = 1;
+            if (items[id].reservation != 0)
+                throw std::runtime_error(std::string("Error: cannot load scene \"") + contents.path + "\" while a "
+                    + typeName + " is still being created");
+            std::string name = contents.getName(records[i].component);
+            if (!names.insert(name).second) contents.corrupt();
+            auto held = lookupTable.find(name);
+            if (held != lookupTable.end() && items[held->second].reservation != 0)
+                throw std::runtime_error(std::string("Error: cannot load scene \"") + contents.path + "\" while a " + typeName
+                    + " named \"" + name + "\" is still being created");
+        }
+        return present;
+    };
+    checkIDs(entityRecords, numEntities, Entity::entities.data(), Entity::getCount(), Entity::lookupTable, "entity");
+    auto transformsPresent = checkIDs(transformRecords, numTransforms, Transform::transforms.data(), Transform::getCount(), Transform::lookupTable, "transform");
+    auto materialsPresent = checkIDs(materialRecords, numMaterials, Material::materials.data(), Material::getCount(), Material::lookupTable, "material");
+    auto camerasPresent = checkIDs(cameraRecords, numCameras, Camera::cameras.data(), Camera::getCount(), Camera::lookupTable, "camera");
+    auto lightsPresent = checkIDs(lightRecords, numLights, Light::lights.data(), Light::getCount(), Light::lookupTable, "light");
+    auto meshesPresent = checkIDs(meshRecords, numMeshes, Mesh::meshes.data(), Mesh::getCount(), Mesh::lookupTable, "mesh");
+    auto texturesPresent = checkIDs(textureRecords, numTextures, Texture::textures.data(), Texture::getCount(), Texture::lookupTable, "texture");
+    auto volumesPresent = checkIDs(volumeRecords, numVolumes, Volume::volumes.data(), Volume::getCount(), Volume::lookupTable, "volume");
+
+    // Every reference must be to a component in the file, since the current scene is cleared
+    for (uint32_t i = 0; i < numEntities; ++i) {
+        const EntityStruct &s = entityRecords[i].data;
+        if (!isSceneFileReference(s.transform_id, transformsPresent) || !isSceneFileReference(s.camera_id, camerasPresent)
+            || !isSceneFileReference(s.material_id, materialsPresent) || !isSceneFileReference(s.light_id, lightsPresent)
+            || !isSceneFileReference(s.mesh_id, meshesPresent) || !isSceneFileReference(s.volume_id, volumesPresent))
+            contents.corrupt();
+        const SceneFileEntity &r = entityRecords[i];
+        if (!r.hasInstances) continue;
+        if (r.numInstanceMaterials != 0 && r.numInstanceMaterials != r.numInstances) contents.corrupt();
+        uint64_t size = uint64_t(r.numInstances) * 12 * sizeof(float);
+        auto materialIDs = (const int32_t*)(contents.getData(r.instanceDataOffset, size + uint64_t(r.numInstanceMaterials) * sizeof(int32_t)) + size);
+        for (uint32_t j = 0; j < r.numInstanceMaterials; ++j) {
+            if (!isSceneFileReference(materialIDs[j], materialsPresent)) contents.corrupt();
+        }
+    }
+    for (uint32_t i = 0; i < numTransforms; ++i) {
+        if (!isSceneFileReference(transformRecords[i].parent, transformsPresent)) contents.corrupt();
+    }
+    for (uint32_t i = 0; i < numMaterials; ++i) {
+        const MaterialStruct &s = materialRecords[i].data;
+        for (int32_t tid : {s.transmission_roughness_texture_id, s.base_color_texture_id, s.roughness_texture_id,
+            s.alpha_texture_id, s.normal_map_texture_id, s.subsurface_color_texture_id, s.subsurface_radius_texture_id,
+            s.subsurface_texture_id, s.metallic_texture_id, s.specular_texture_id, s.specular_tint_texture_id,
+            s.anisotropic_texture_id, s.anisotropic_rotation_texture_id, s.sheen_texture_id, s.sheen_tint_texture_id,
+            s.clearcoat_texture_id, s.clearcoat_roughness_texture_id, s.ior_texture_id, s.transmission_texture_id})
+            if (!isSceneFileReference(tid, texturesPresent)) contents.corrupt();
+    }
+    for (uint32_t i = 0; i < numLights; ++i) {
+        if (!isSceneFileReference(lightRecords[i].data.color_texture_id, texturesPresent)) contents.corrupt();
+    }
+    for (uint32_t i = 0; i < numMeshes; ++i) {
+        const SceneFileMesh &r = meshRecords[i];
+        uint64_t size = uint64_t(r.numPositions) * sizeof(std::array<float, 3>)
+            + (uint64_t(r.numNormals) + r.numTangents + r.numColors) * sizeof(glm::vec4)
+            + uint64_t(r.numTexCoords) * sizeof(glm::vec2);
+        // Point clouds have one radius per position, and no indices
+        if ((r.numRadii != 0) && ((r.numRadii != r.numPositions) || (r.numIndices != 0))) contents.corrupt();
+        uint64_t indexSize = uint64_t(r.numIndices) * sizeof(uint32_t);
+        auto indices = (const uint32_t*)(contents.getData(r.dataOffset, size + indexSize + uint64_t(r.numRadii) * sizeof(float)) + size);
+        for (uint32_t j = 0; j < r.numIndices; ++j) {
+            if (indices[j] >= r.numPositions) contents.corrupt();
+        }
+    }
+    for (uint32_t i = 0; i < numTextures; ++i) {
+        const SceneFileTexture &r = textureRecords[i];
+        if (r.numTexels > (uint64_t(1) << 40)) contents.corrupt();
+        contents.getData(r.dataOffset, r.numTexels * (r.hdr ? sizeof(glm::vec4) : sizeof(glm::u8vec4)));
+    }
+    for (uint32_t i = 0; i < numVolumes; ++i) {
+        const SceneFileVolume &r = volumeRecords[i];
+        if (r.gridSize < sizeof(nanovdb::GridData)) contents.corrupt();
+        auto grid = (const nanovdb::GridData*)contents.getData(r.dataOffset, r.gridSize);
+        if (grid->mMagic != NANOVDB_MAGIC_NUMBER) contents.corrupt();
+    }
+
+    Entity::clearAll();
+    Transform::clearAll();
+    Material::clearAll();
+    Texture::clearAll();
+    Mesh::clearAll();
+    Camera::clearAll();
+    Light::clearAll();
+    Volume::clearAll();
+
+    // Names were checked above to be unique, and free once the scene is cleared
+    auto claimName = [&] (std::map<std::string, uint32_t> &lookupTable, const std::string &name, uint32_t id, const char* typeName) {
+        if (!lookupTable.emplace(name, id).second)
+            throw std::runtime_error(std::string("Error: cannot load scene \"") + path + "\" while a " + typeName
+                + " named \"" + name + "\" is still being created");
+    };
+
+    for (uint32_t i = 0; i < numTransforms; ++i) {
+        const SceneFileTransform &r = transformRecords[i];
+        uint32_t id = r.component.id;
+        std::string name = contents.getName(r.component);
+        claimName(Transform::lookupTable, name, id, "transform");
+        Transform &t = Transform::transforms[id];
+        t = Transform(name, id);
+        Transform::transformStructs[id] = r.data;
+        t.parent = r.parent;
+        t.useRelativeLinearMotionBlur = r.useRelativeLinearMotionBlur != 0;
+        t.useRelativeAngularMotionBlur = r.useRelativeAngularMotionBlur != 0;
+        t.useRelativeScalarMotionBlur = r.useRelativeScalarMotionBlur != 0;
+        t.scale = r.scale;
+        t.position = r.position;
+        t.rotation = r.rotation;
+        t.prevScale = r.prevScale;
+        t.prevPosition = r.prevPosition;
+        t.prevRotation = r.prevRotation;
+        t.linearMotion = r.linearMotion;
+        t.angularMotion = r.angularMotion;
+        t.scalarMotion = r.scalarMotion;
+        t.localToParentTransform = r.localToParentTransform;
+        t.localToParentMatrix = r.localToParentMatrix;
+        t.parentToLocalMatrix = r.parentToLocalMatrix;
+        t.prevLocalToParentTransform = r.prevLocalToParentTransform;
+        t.prevLocalToParentMatrix = r.prevLocalToParentMatrix;
+        t.prevParentToLocalMatrix = r.prevParentToLocalMatrix;
+        t.localToWorldMatrix = r.localToWorldMatrix;
+        t.worldToLocalMatrix = r.worldToLocalMatrix;
+        t.prevLocalToWorldMatrix = r.prevLocalToWorldMatrix;
+        t.prevWorldToLocalMatrix = r.prevWorldToLocalMatrix;
+        Transform::dirtyTransforms.insert(&t);
+    }
+    for (uint32_t i = 0; i < numTransforms; ++i) {
+        const SceneFileTransform &r = transformRecords[i];
+        if (r.parent >= 0) Transform::transforms[r.parent].children.insert(r.component.id);
+    }
+
+    for (uint32_t i = 0; i < numTextures; ++i) {
+        const SceneFileTexture &r = textureRecords[i];
+        uint32_t id = r.component.id;
+        std::string name = contents.getName(r.component);
+        claimName(Texture::lookupTable, name, id, "texture");
+        Texture &t = Texture::textures[id];
+        t = Texture(name, id);
+        Texture::textureStructs[id] = r.data;
+        t.linear = r.linear != 0;
+        if (r.hdr) {
+            auto texels = (const glm::vec4*)contents.getData(r.dataOffset, r.numTexels * sizeof(glm::vec4));
+            t.floatTexels.assign(texels, texels + r.numTexels);
+        }
+        else {
+            auto texels = (const glm::u8vec4*)contents.getData(r.dataOffset, r.numTexels * sizeof(glm::u8vec4));
+            t.byteTexels.assign(texels, texels + r.numTexels);
+        }
+        Texture::dirtyTextures.insert(&t);
+    }
+
+    for (uint32_t i = 0; i < numMaterials; ++i) {
+        const SceneFileMaterial &r = materialRecords[i];
+        uint32_t id = r.component.id;
+        std::string name = contents.getName(r.component);
+        claimName(Material::lookupTable, name, id, "material");
+        Material &m = Material::materials[id];
+        m = Material(name, id);
+        const MaterialStruct &s = r.data;
+        Material::materialStructs[id] = s;
+        m.base_color = r.baseColor;
+        m.subsurface_radius = r.subsurfaceRadius;
+        m.subsurface_color = r.subsurfaceColor;
+        m.subsurface = r.subsurface;
+        m.metallic = r.metallic;
+        m.specular = r.specular;
+        m.specular_tint = r.specularTint;
+        m.roughness = r.roughness;
+        m.anisotropic = r.anisotropic;
+        m.anisotropic_rotation = r.anisotropicRotation;
+        m.sheen = r.sheen;
+        m.sheen_tint = r.sheenTint;
+        m.clearcoat = r.clearcoat;
+        m.clearcoat_roughness = r.clearcoatRoughness;
+        m.ior = r.ior;
+        m.transmission = r.transmission;
+        m.transmission_roughness = r.transmissionRoughness;
+        for (int32_t tid : {s.transmission_roughness_texture_id, s.base_color_texture_id, s.roughness_texture_id,
+            s.alpha_texture_id, s.normal_map_texture_id, s.subsurface_color_texture_id, s.subsurface_radius_texture_id,
+            s.subsurface_texture_id, s.metallic_texture_id, s.specular_texture_id, s.specular_tint_texture_id,
+            s.anisotropic_texture_id, s.anisotropic_rotation_texture_id, s.sheen_texture_id, s.sheen_tint_texture_id,
+            s.clearcoat_texture_id, s.clearcoat_roughness_texture_id, s.ior_texture_id, s.transmission_texture_id})
+            if (tid >= 0) Texture::textures[tid].materials.insert(id);
+        m.markDirty();
+    }
+
+    for (uint32_t i = 0; i < numCameras; ++i) {
+        const SceneFileCamera &r = cameraRecords[i];
+        uint32_t id = r.component.id;
+        std::string name = contents.getName(r.component);
+        claimName(Camera::lookupTable, name, id, "camera");
+        Camera::cameras[id] = Camera(name, id);
+        Camera::cameraStructs[id] = r.data;
+        Camera::cameras[id].markDirty();
+    }
+
+    for (uint32_t i = 0; i < numLights; ++i) {
+        const SceneFileLight &r = lightRecords[i];
+        uint32_t id = r.component.id;
+        std::string name = contents.getName(r.component);
+        claimName(Light::lookupTable, name, id, "light");
+        Light::lights[id] = Light(name, id);
+        Light::lightStructs[id] = r.data;
+        if (r.data.color_texture_id >= 0) Texture::textures[r.data.color_texture_id].lights.insert(id);
+        Light::lights[id].markDirty();
+    }
+
+    for (uint32_t i = 0; i < numMeshes; ++i) {
+        const SceneFileMesh &r = meshRecords[i];
+        uint32_t id = r.component.id;
+        std::string name = contents.getName(r.component);
+        claimName(Mesh::lookupTable, name, id, "mesh");
+        Mesh &m = Mesh::meshes[id];
+        m = Mesh(name, id);
+        Mesh::meshStructs[id] = r.data;
+
+        const uint8_t* data = contents.getData(r.dataOffset, 0);
+        auto take = [&data] (auto &list, uint32_t count) {
+            typedef typename std::remove_reference<decltype(list)>::type::value_type Element;
+            list.assign((const Element*)data, (const Element*)data + count);
+            data += uint64_t(count) * sizeof(Element);
+        };
+        take(m.positions, r.numPositions);
+        take(m.normals, r.numNormals);
+        take(m.tangents, r.numTangents);
+        take(m.colors, r.numColors);
+        take(m.texCoords, r.numTexCoords);
+        take(m.triangleIndices, r.numIndices);
+        take(m.radii, r.numRadii);
+        Mesh::dirtyMeshes.insert(&m);
+    }
+
+    for (uint32_t i = 0; i < numVolumes; ++i) {
+        const SceneFileVolume &r = volumeRecords[i];
+        uint32_t id = r.component.id;
+        std::string name = contents.getName(r.component);
+        claimName(Volume::lookupTable, name, id, "volume");
+        Volume &v = Volume::volumes[id];
+        v = Volume(name, id);
+        Volume::volumeStructs[id] = r.data;
+        nanovdb::HostBuffer buffer = nanovdb::HostBuffer::create(r.gridSize);
+        memcpy(buffer.data(), contents.getData(r.dataOffset, r.gridSize), r.gridSize);
+        v.gridHdlPtr = std::make_shared<nanovdb::GridHandle<>>(std::move(buffer));
+        Volume::dirtyVolumes.insert(&v);
+    }
+
+    // Entities go last, since whether they are renderable depends on the components they use
+    for (uint32_t i = 0; i < numEntities; ++i) {
+        const SceneFileEntity &r = entityRecords[i];
+        uint32_t id = r.component.id;
+        std::string name = contents.getName(r.component);
+        claimName(Entity::lookupTable, name, id, "entity");
+        Entity &e = Entity::entities[id];
+        e = Entity(name, id);
+        const EntityStruct &s = r.data;
+        Entity::entityStructs[id] = s;
+        e.active = r.active != 0;
+        if (s.transform_id >= 0) Transform::transforms[s.transform_id].entities.insert(id);
+        if (s.camera_id >= 0) Camera::cameras[s.camera_id].entities.insert(id);
+        if (s.material_id >= 0) Material::materials[s.material_id].entities.insert(id);
+        if (s.light_id >= 0) Light::lights[s.light_id].entities.insert(id);
+        if (s.mesh_id >= 0) Mesh::meshes[s.mesh_id].entities.insert(id);
+        if (s.volume_id >= 0) Volume::volumes[s.volume_id].entities.insert(id);
+        if (r.hasInstances) {
+            auto instances = std::make_shared<EntityInstances>();
+            auto transforms = (const float*)contents.getData(r.instanceDataOffset, uint64_t(r.numInstances) * 12 * sizeof(float));
+            instances->transforms.assign(transforms, transforms + uint64_t(r.numInstances) * 12);
+            auto materialIDs = (const int32_t*)(transforms + uint64_t(r.numInstances) * 12);
+            instances->materialIDs.assign(materialIDs, materialIDs + r.numInstanceMaterials);
+            Entity::entityInstances[id] = instances;
+        }
+        Entity::dirtyEntities.insert(&e);
+        e.updateRenderables();
+    }
+
+    // Entity bounds were saved along with their structs, so only the scene bounds need recomputing
+    resetSceneAabb();
+    if (!Entity::renderableEntities.empty()) updateSceneAabb(*Entity::renderableEntities.begin());
+}
+
+void saveScene(std::string file_path)
+{
+    SceneFile::save(file_path);
+}
+
+void loadScene(std::string file_path)
+{
+    SceneFile::load(file_path);
+}
+
+};
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <nvisii/entity_struct.h>
+#include <nvisii/transform_struct.h>
+#include <nvisii/camera_struct.h>
+#include <nvisii/material_struct.h>
+#include <nvisii/light_struct.h>
+#include <nvisii/mesh_struct.h>
+#include <nvisii/texture_struct.h>
+#include <nvisii/volume_struct.h>
+
+/**
+ * Reads and writes ".nvscene" files, made by saveScene and loaded by loadScene.
+ *
+ * A scene file holds every component of every factory the way the components hold it in memory:
+ * names, struct arrays, entity bindings, the transform hierarchy with its cached matrices, material
+ * constants, and the mesh, texture and volume payloads. Loading one is a single read followed by
+ * copies into the factories, with nothing to recompute.
+ *
+ * The file starts with a SceneFileHeader, followed by a table of SceneFileSections. Each section is
+ * a tightly packed array of fixed size records, starting on a 16 byte boundary, so that a section can
+ * be used in place from a memory mapped file. Names live in the strings section, and the per vertex
+ * data, texels and grids live in the data section, at offsets relative to the start of that section.
+ * Everything is in little endian byte order.
+ */
+
+namespace nvisii {
+
+struct SceneFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t numSections;
+    uint64_t fileSize;
+};
+
+enum SceneFileSectionType : uint32_t {
+    SCENE_FILE_STRINGS = 0,
+    SCENE_FILE_ENTITIES = 1,
+    SCENE_FILE_TRANSFORMS = 2,
+    SCENE_FILE_MATERIALS = 3,
+    SCENE_FILE_CAMERAS = 4,
+    SCENE_FILE_LIGHTS = 5,
+    SCENE_FILE_MESHES = 6,
+    SCENE_FILE_TEXTURES = 7,
+    SCENE_FILE_VOLUMES = 8,
+    SCENE_FILE_DATA = 9,
+    SCENE_FILE_NUM_SECTIONS = 10
+};
+
+struct SceneFileSection {
+    uint32_t type;
+    /* The number of records, or the number of bytes for the strings and data sections */
+    uint32_t count;
+    /* From the start of the file */
+    uint64_t offset;
+    uint64_t size;
+};
+
+/* Leads every record. Components keep their ids, so that the ids entities refer to stay valid. */
+struct SceneFileComponent {
+    uint32_t id;
+    uint32_t nameLength;
+    uint64_t nameOffset;
+};
+
+/* Followed in the data section by the instance matrices and material ids, if the entity has instances */
+struct SceneFileEntity {
+    SceneFileComponent component;
+    EntityStruct data;
+    uint32_t active;
+    uint32_t hasInstances;
+    uint32_t numInstances;
+    uint32_t numInstanceMaterials;
+    uint64_t instanceDataOffset;
+};
+
+struct SceneFileTransform {
+    SceneFileComponent component;
+    TransformStruct data;
+    int32_t parent;
+    uint32_t useRelativeLinearMotionBlur;
+    uint32_t useRelativeAngularMotionBlur;
+    uint32_t useRelativeScalarMotionBlur;
+    glm::vec3 scale;
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 prevScale;
+    glm::vec3 prevPosition;
+    glm::quat prevRotation;
+    glm::vec3 linearMotion;
+    glm::quat angularMotion;
+    glm::vec3 scalarMotion;
+    glm::mat4 localToParentTransform;
+    glm::mat4 localToParentMatrix;
+    glm::mat4 parentToLocalMatrix;
+    glm::mat4 prevLocalToParentTransform;
+    glm::mat4 prevLocalToParentMatrix;
+    glm::mat4 prevParentToLocalMatrix;
+    glm::mat4 localToWorldMatrix;
+    glm::mat4 worldToLocalMatrix;
+    glm::mat4 prevLocalToWorldMatrix;
+    glm::mat4 prevWorldToLocalMatrix;
+};
+
+struct SceneFileMaterial {
+    SceneFileComponent component;
+    MaterialStruct data;
+    glm::vec4 baseColor;
+    glm::vec4 subsurfaceRadius;
+    glm::vec4 subsurfaceColor;
+    float subsurface;
+    float metallic;
+    float specular;
+    float specularTint;
+    float roughness;
+    float anisotropic;
+    float anisotropicRotation;
+    float sheen;
+    float sheenTint;
+    float clearcoat;
+    float clearcoatRoughness;
+    float ior;
+    float transmission;
+    float transmissionRoughness;
+};
+
+struct SceneFileCamera {
+    SceneFileComponent component;
+    CameraStruct data;
+};
+
+struct SceneFileLight {
+    SceneFileComponent component;
+    LightStruct data;
+};
+
+/* Followed in the data section by the positions, normals, tangents, colors, texture coordinates, indices and point radii */
+struct SceneFileMesh {
+    SceneFileComponent component;
+    MeshStruct data;
+    uint32_t numPositions;
+    uint32_t numNormals;
+    uint32_t numTangents;
+    uint32_t numColors;
+    uint32_t numTexCoords;
+    uint32_t numIndices;
+    uint32_t numRadii;
+    uint64_t dataOffset;
+};
+
+/* Followed in the data section by either vec4 or u8vec4 texels, depending on hdr */
+struct SceneFileTexture {
+    SceneFileComponent component;
+    TextureStruct data;
+    uint32_t linear;
+    uint32_t hdr;
+    uint64_t numTexels;
+    uint64_t dataOffset;
+};
+
+/* Followed in the data section by the NanoVDB grid buffer */
+struct SceneFileVolume {
+    SceneFileComponent component;
+    VolumeStruct data;
+    uint64_t gridSize;
+    uint64_t dataOffset;
+};
+
+static const char SCENE_FILE_MAGIC[8] = {'N', 'V', 'S', 'C', 'E', 'N', 'E', 0};
+static const uint32_t SCENE_FILE_VERSION = 3;
+
+/* Friend of every component, so that scenes can be saved and restored without going through the setters */
+class SceneFile {
+public:
+    /* Writes every component to path. Locks every component type while writing. */
+    static void save(const std::string &path);
+
+    /* Replaces every component with the ones stored at path, and marks them all dirty */
+    static void load(const std::string &path);
+};
+
+};
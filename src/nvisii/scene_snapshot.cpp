@@ -0,0 +1,310 @@
+#include <nvisii/nvisii.h>
+
+#include "scene_snapshot.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace nvisii {
+
+/* Replaces the entries of older with those of newer which have the same id, and appends the rest */
+template<typename T>
+static void mergeById(std::vector<T> &older, std::vector<T> &&newer)
+{
+    std::unordered_map<uint32_t, size_t> index;
+    for (size_t i = 0; i < older.size(); ++i) index[older[i].id] = i;
+    for (auto &item : newer) {
+        auto it = index.find(item.id);
+        if (it != index.end()) older[it->second] = std::move(item);
+        else {
+            index[item.id] = older.size();
+            older.push_back(std::move(item));
+        }
+    }
+}
+
+/* Replaces older with newer, unless newer is empty */
+template<typename T>
+static void mergeArray(std::vector<T> &older, std::vector<T> &&newer)
+{
+    if (!newer.empty()) older = std::move(newer);
+}
+
+bool SceneSnapshot::empty() const
+{
+    return !(areEntitiesDirty() || areTransformsDirty() || areCamerasDirty() || areLightsDirty() ||
+        areMeshesDirty() || areTexturesDirty() || areVolumesDirty() || areMaterialsDirty());
+}
+
+void SceneSnapshot::merge(SceneSnapshot &&newer)
+{
+    generation = newer.generation;
+    mergeById(meshes, std::move(newer.meshes));
+    mergeById(textures, std::move(newer.textures));
+    mergeById(volumes, std::move(newer.volumes));
+    mergeById(materials, std::move(newer.materials));
+    mergeArray(entityStructs, std::move(newer.entityStructs));
+    mergeArray(transformStructs, std::move(newer.transformStructs));
+    mergeArray(cameraStructs, std::move(newer.cameraStructs));
+    mergeArray(lightStructs, std::move(newer.lightStructs));
+    mergeArray(meshStructs, std::move(newer.meshStructs));
+    mergeArray(textureStructs, std::move(newer.textureStructs));
+    mergeArray(volumeStructs, std::move(newer.volumeStructs));
+    mergeArray(entityInstances, std::move(newer.entityInstances));
+    mergeArray(entityAlive, std::move(newer.entityAlive));
+    mergeArray(transformAlive, std::move(newer.transformAlive));
+    mergeArray(meshAlive, std::move(newer.meshAlive));
+    mergeArray(volumeAlive, std::move(newer.volumeAlive));
+    mergeArray(materialAlive, std::move(newer.materialAlive));
+    mergeArray(lightAlive, std::move(newer.lightAlive));
+    numEntitiesChanged += newer.numEntitiesChanged;
+    numTransformsChanged += newer.numTransformsChanged;
+    sceneBBMin = newer.sceneBBMin;
+    sceneBBMax = newer.sceneBBMax;
+}
+
+void PublishedScene::reset()
+{
+    generation = 0;
+    entityStructs.assign(Entity::getCount(), EntityStruct());
+    transformStructs.assign(Transform::getCount(), TransformStruct());
+    cameraStructs.assign(Camera::getCount(), CameraStruct());
+    lightStructs.assign(Light::getCount(), LightStruct());
+    meshStructs.assign(Mesh::getCount(), MeshStruct());
+    textureStructs.assign(Texture::getCount(), TextureStruct());
+    volumeStructs.assign(Volume::getCount(), VolumeStruct());
+    entityInstances.assign(Entity::getCount(), nullptr);
+    entityAlive.assign(Entity::getCount(), 0);
+    transformAlive.assign(Transform::getCount(), 0);
+    meshAlive.assign(Mesh::getCount(), 0);
+    volumeAlive.assign(Volume::getCount(), 0);
+    materialAlive.assign(Material::getCount(), 0);
+    lightAlive.assign(Light::getCount(), 0);
+    sceneBBMin = sceneBBMax = glm::vec3(0.f);
+}
+
+void PublishedScene::apply(const SceneSnapshot &snapshot)
+{
+    // An uncommitted snapshot carries no bounds either
+    if (snapshot.generation == 0) return;
+    generation = snapshot.generation;
+    if (!snapshot.entityStructs.empty()) entityStructs = snapshot.entityStructs;
+    if (!snapshot.transformStructs.empty()) transformStructs = snapshot.transformStructs;
+    if (!snapshot.cameraStructs.empty()) cameraStructs = snapshot.cameraStructs;
+    if (!snapshot.lightStructs.empty()) lightStructs = snapshot.lightStructs;
+    if (!snapshot.meshStructs.empty()) meshStructs = snapshot.meshStructs;
+    if (!snapshot.textureStructs.empty()) textureStructs = snapshot.textureStructs;
+    if (!snapshot.volumeStructs.empty()) volumeStructs = snapshot.volumeStructs;
+    if (!snapshot.entityInstances.empty()) entityInstances = snapshot.entityInstances;
+    if (!snapshot.entityAlive.empty()) entityAlive = snapshot.entityAlive;
+    if (!snapshot.transformAlive.empty()) transformAlive = snapshot.transformAlive;
+    if (!snapshot.meshAlive.empty()) meshAlive = snapshot.meshAlive;
+    if (!snapshot.volumeAlive.empty()) volumeAlive = snapshot.volumeAlive;
+    if (!snapshot.materialAlive.empty()) materialAlive = snapshot.materialAlive;
+    if (!snapshot.lightAlive.empty()) lightAlive = snapshot.lightAlive;
+    sceneBBMin = snapshot.sceneBBMin;
+    sceneBBMax = snapshot.sceneBBMax;
+}
+
+static int32_t getIfAlive(const std::vector<uint8_t> &alive, int32_t id)
+{
+    if ((id < 0) || (id >= int32_t(alive.size())) || !alive[id]) return -1;
+    return id;
+}
+
+bool PublishedScene::isEntityInitialized(uint32_t entityID) const
+{
+    return (entityID < entityAlive.size()) && entityAlive[entityID];
+}
+
+int32_t PublishedScene::getTransformID(uint32_t entityID) const
+{
+    if (!isEntityInitialized(entityID)) return -1;
+    return getIfAlive(transformAlive, entityStructs[entityID].transform_id);
+}
+
+int32_t PublishedScene::getMeshID(uint32_t entityID) const
+{
+    if (!isEntityInitialized(entityID)) return -1;
+    return getIfAlive(meshAlive, entityStructs[entityID].mesh_id);
+}
+
+int32_t PublishedScene::getVolumeID(uint32_t entityID) const
+{
+    if (!isEntityInitialized(entityID)) return -1;
+    return getIfAlive(volumeAlive, entityStructs[entityID].volume_id);
+}
+
+int32_t PublishedScene::getMaterialID(uint32_t entityID) const
+{
+    if (!isEntityInitialized(entityID)) return -1;
+    return getIfAlive(materialAlive, entityStructs[entityID].material_id);
+}
+
+int32_t PublishedScene::getLightID(uint32_t entityID) const
+{
+    if (!isEntityInitialized(entityID)) return -1;
+    return getIfAlive(lightAlive, entityStructs[entityID].light_id);
+}
+
+const EntityInstances* PublishedScene::getInstances(uint32_t entityID) const
+{
+    if (!isEntityInitialized(entityID) || (entityID >= entityInstances.size())) return nullptr;
+    if (getLightID(entityID) >= 0) return nullptr;
+    return entityInstances[entityID].get();
+}
+
+template<typename T>
+static std::vector<uint8_t> getAliveFlags(T* components, uint32_t count)
+{
+    std::vector<uint8_t> alive(count);
+    for (uint32_t i = 0; i < count; ++i) alive[i] = components[i].isInitialized() ? 1 : 0;
+    return alive;
+}
+
+/* Same layout as the constant textures the OptiX backend generates per material */
+static void getMaterialConstants(Material &m, glm::vec4 constants[NUM_MAT_PARAMS])
+{
+    constants[0] = glm::vec4(m.getTransmissionRoughness());
+    constants[1] = glm::vec4(m.getBaseColor(), 1.f);
+    constants[2] = glm::vec4(m.getRoughness());
+    constants[3] = glm::vec4(m.getAlpha());
+    constants[4] = glm::vec4(0.5f, .5f, 1.f, 0.f);
+    constants[5] = glm::vec4(m.getSubsurfaceColor(), 1.f);
+    constants[6] = glm::vec4(m.getSubsurfaceRadius(), 1.f);
+    constants[7] = glm::vec4(m.getSubsurface());
+    constants[8] = glm::vec4(m.getMetallic());
+    constants[9] = glm::vec4(m.getSpecular());
+    constants[10] = glm::vec4(m.getSpecularTint());
+    constants[11] = glm::vec4(m.getAnisotropic());
+    constants[12] = glm::vec4(m.getAnisotropicRotation());
+    constants[13] = glm::vec4(m.getSheen());
+    constants[14] = glm::vec4(m.getSheenTint());
+    constants[15] = glm::vec4(m.getClearcoat());
+    constants[16] = glm::vec4(m.getClearcoatRoughness());
+    constants[17] = glm::vec4(m.getIor());
+    constants[18] = glm::vec4(m.getTransmission());
+}
+
+SceneSnapshot captureScene()
+{
+    SceneSnapshot snapshot;
+
+    std::lock_guard<std::recursive_mutex> mesh_lock(*Mesh::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> camera_lock(*Camera::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> transform_lock(*Transform::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> entity_lock(*Entity::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> light_lock(*Light::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> texture_lock(*Texture::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> volume_lock(*Volume::getEditMutex().get());
+    std::lock_guard<std::recursive_mutex> material_lock(*Material::getEditMutex().get());
+
+    if (Mesh::areAnyDirty()) {
+        for (auto &m : Mesh::getDirtyMeshes()) {
+            MeshSnapshot ms;
+            ms.id = m->getAddress();
+            ms.name = m->getName();
+            ms.removed = !m->isInitialized();
+            if (!ms.removed) {
+                ms.positions = m->getVertices();
+                ms.normals = m->getNormals();
+                ms.tangents = m->getTangents();
+                ms.texCoords = m->getTexCoords();
+                ms.triangleIndices = m->getTriangleIndices();
+                if (m->isPointCloud()) {
+                    ms.radii = m->getRadii();
+                    ms.colors = m->getColors();
+                }
+            }
+            snapshot.meshes.push_back(std::move(ms));
+        }
+        Mesh::updateComponents();
+        snapshot.meshStructs.assign(Mesh::getFrontStruct(), Mesh::getFrontStruct() + Mesh::getCount());
+        snapshot.meshAlive = getAliveFlags(Mesh::getFront(), Mesh::getCount());
+    }
+
+    if (Texture::areAnyDirty()) {
+        for (auto &t : Texture::getDirtyTextures()) {
+            TextureSnapshot ts;
+            ts.id = t->getAddress();
+            ts.name = t->getName();
+            ts.removed = !t->isInitialized();
+            if (!ts.removed) {
+                ts.linear = t->isLinear();
+                ts.width = t->getWidth();
+                ts.height = t->getHeight();
+                if (t->isHDR()) ts.floatTexels = t->getFloatTexels();
+                else ts.byteTexels = t->getByteTexels();
+            }
+            snapshot.textures.push_back(std::move(ts));
+        }
+        Texture::updateComponents();
+        snapshot.textureStructs.assign(Texture::getFrontStruct(), Texture::getFrontStruct() + Texture::getCount());
+    }
+
+    if (Volume::areAnyDirty()) {
+        for (auto &v : Volume::getDirtyVolumes()) {
+            VolumeSnapshot vs;
+            vs.id = v->getAddress();
+            vs.name = v->getName();
+            vs.removed = !v->isInitialized();
+            if (!vs.removed) {
+                vs.gridHdlPtr = v->getNanoVDBGridHandle();
+                vs.bbmin = v->getMinAabbCorner(3, 0);
+                vs.bbmax = v->getMaxAabbCorner(3, 0);
+            }
+            snapshot.volumes.push_back(std::move(vs));
+        }
+        Volume::updateComponents();
+        snapshot.volumeStructs.assign(Volume::getFrontStruct(), Volume::getFrontStruct() + Volume::getCount());
+        snapshot.volumeAlive = getAliveFlags(Volume::getFront(), Volume::getCount());
+    }
+
+    if (Material::areAnyDirty()) {
+        Material* materials = Material::getFront();
+        MaterialStruct* matStructs = Material::getFrontStruct();
+        for (uint32_t mid = 0; mid < Material::getCount(); ++mid) {
+            if (!materials[mid].isInitialized()) continue;
+            if (!materials[mid].isDirty()) continue;
+            MaterialSnapshot ms;
+            ms.id = mid;
+            ms.ids = matStructs[mid];
+            getMaterialConstants(materials[mid], ms.constants);
+            snapshot.materials.push_back(ms);
+        }
+        Material::updateComponents();
+        snapshot.materialAlive = getAliveFlags(materials, Material::getCount());
+    }
+
+    if (Entity::areAnyDirty()) {
+        snapshot.numEntitiesChanged = uint32_t(Entity::getDirtyEntities().size());
+        Entity::updateComponents();
+        snapshot.entityStructs.assign(Entity::getFrontStruct(), Entity::getFrontStruct() + Entity::getCount());
+        snapshot.entityInstances.assign(Entity::getFrontInstances(), Entity::getFrontInstances() + Entity::getCount());
+        snapshot.entityAlive = getAliveFlags(Entity::getFront(), Entity::getCount());
+    }
+
+    if (Transform::areAnyDirty()) {
+        snapshot.numTransformsChanged = uint32_t(Transform::getDirtyTransforms().size());
+        Transform::updateComponents();
+        snapshot.transformStructs.assign(Transform::getFrontStruct(), Transform::getFrontStruct() + Transform::getCount());
+        snapshot.transformAlive = getAliveFlags(Transform::getFront(), Transform::getCount());
+    }
+
+    if (Camera::areAnyDirty()) {
+        Camera::updateComponents();
+        snapshot.cameraStructs.assign(Camera::getFrontStruct(), Camera::getFrontStruct() + Camera::getCount());
+    }
+
+    if (Light::areAnyDirty()) {
+        Light::updateComponents();
+        snapshot.lightStructs.assign(Light::getFrontStruct(), Light::getFrontStruct() + Light::getCount());
+        snapshot.lightAlive = getAliveFlags(Light::getFront(), Light::getCount());
+    }
+
+    snapshot.sceneBBMin = getSceneMinAabbCorner();
+    snapshot.sceneBBMax = getSceneMaxAabbCorner();
+    return snapshot;
+}
+
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <nvisii/entity_struct.h>
+#include <nvisii/transform_struct.h>
+#include <nvisii/camera_struct.h>
+#include <nvisii/material_struct.h>
+#include <nvisii/light_struct.h>
+#include <nvisii/mesh_struct.h>
+#include <nvisii/texture_struct.h>
+#include <nvisii/volume_struct.h>
+
+#include <nanovdb/util/GridHandle.h>
+
+/**
+ * Scene snapshots decouple editing the components from rendering them.
+ *
+ * captureScene() copies everything that changed since the previous capture out of the components,
+ * holding the component locks only for the copy, and marks the components clean. The renderer folds
+ * snapshots into its PublishedScene and builds its acceleration structures and device buffers from
+ * that, without ever touching the components. Edits made after a capture therefore never show up in
+ * a frame rendered from it, and the renderer never blocks an edit while it uploads or builds.
+ */
+
+namespace nvisii {
+
+struct EntityInstances;
+
+/* A mesh which changed. Removed meshes carry no data. */
+struct MeshSnapshot {
+    uint32_t id = 0;
+    bool removed = false;
+    std::string name;
+    std::vector<std::array<float, 3>> positions;
+    std::vector<glm::vec4> normals;
+    std::vector<glm::vec4> tangents;
+    std::vector<glm::vec2> texCoords;
+    std::vector<uint32_t> triangleIndices;
+    /* Point clouds only: one radius and either no color or one color per point */
+    std::vector<float> radii;
+    std::vector<glm::vec4> colors;
+};
+
+/* A texture which changed. Removed textures carry no data. */
+struct TextureSnapshot {
+    uint32_t id = 0;
+    bool removed = false;
+    std::string name;
+    bool linear = false;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<glm::vec4> floatTexels;
+    std::vector<glm::u8vec4> byteTexels;
+
+    bool isHDR() const { return floatTexels.size() > 0; }
+};
+
+/* A volume which changed. Removed volumes carry no data. */
+struct VolumeSnapshot {
+    uint32_t id = 0;
+    bool removed = false;
+    std::string name;
+    std::shared_ptr<nanovdb::GridHandle<>> gridHdlPtr;
+    glm::vec3 bbmin = glm::vec3(0.f);
+    glm::vec3 bbmax = glm::vec3(0.f);
+};
+
+/* A material which changed, along with the constants used for any parameter without a texture */
+struct MaterialSnapshot {
+    uint32_t id = 0;
+    MaterialStruct ids;
+    glm::vec4 constants[NUM_MAT_PARAMS];
+};
+
+/* The changes made to the scene between two captures */
+struct SceneSnapshot {
+    /* Increases with every commit. Zero if never committed. */
+    uint64_t generation = 0;
+
+    std::vector<MeshSnapshot> meshes;
+    std::vector<TextureSnapshot> textures;
+    std::vector<VolumeSnapshot> volumes;
+    std::vector<MaterialSnapshot> materials;
+
+    /* For each component type with any change, a copy of all of its structs. Empty otherwise. */
+    std::vector<EntityStruct> entityStructs;
+    std::vector<TransformStruct> transformStructs;
+    std::vector<CameraStruct> cameraStructs;
+    std::vector<LightStruct> lightStructs;
+    std::vector<MeshStruct> meshStructs;
+    std::vector<TextureStruct> textureStructs;
+    std::vector<VolumeStruct> volumeStructs;
+
+    /* If any entity changed, the instances of every entity. Shared with the entities rather than copied, since they are never edited. */
+    std::vector<std::shared_ptr<const EntityInstances>> entityInstances;
+
+    /*
+     * For each component type with any change, whether each component exists. Entities keep the ids of
+     * components which were removed, so these are needed to skip them the way Entity::getMesh() and
+     * friends do. Empty otherwise.
+     */
+    std::vector<uint8_t> entityAlive;
+    std::vector<uint8_t> transformAlive;
+    std::vector<uint8_t> meshAlive;
+    std::vector<uint8_t> volumeAlive;
+    std::vector<uint8_t> materialAlive;
+    std::vector<uint8_t> lightAlive;
+
+    /* The number of entities and transforms which changed, for the profiler */
+    uint32_t numEntitiesChanged = 0;
+    uint32_t numTransformsChanged = 0;
+
+    glm::vec3 sceneBBMin = glm::vec3(0.f);
+    glm::vec3 sceneBBMax = glm::vec3(0.f);
+
+    bool areEntitiesDirty() const { return !entityAlive.empty(); }
+    bool areTransformsDirty() const { return !transformAlive.empty(); }
+    bool areCamerasDirty() const { return !cameraStructs.empty(); }
+    bool areLightsDirty() const { return !lightAlive.empty(); }
+    bool areMeshesDirty() const { return !meshAlive.empty(); }
+    bool areTexturesDirty() const { return !textureStructs.empty(); }
+    bool areVolumesDirty() const { return !volumeAlive.empty(); }
+    bool areMaterialsDirty() const { return !materialAlive.empty(); }
+
+    /* @returns true if nothing changed */
+    bool empty() const;
+
+    /* Folds a newer snapshot into this one, as if both had been captured at once */
+    void merge(SceneSnapshot &&newer);
+};
+
+/**
+ * The scene as the renderer sees it: every snapshot applied so far, folded together.
+ * Only the struct arrays and the existence of components are kept. Mesh, texture and volume data
+ * goes straight from the snapshots to the renderer.
+ */
+struct PublishedScene {
+    uint64_t generation = 0;
+
+    std::vector<EntityStruct> entityStructs;
+    std::vector<TransformStruct> transformStructs;
+    std::vector<CameraStruct> cameraStructs;
+    std::vector<LightStruct> lightStructs;
+    std::vector<MeshStruct> meshStructs;
+    std::vector<TextureStruct> textureStructs;
+    std::vector<VolumeStruct> volumeStructs;
+    std::vector<std::shared_ptr<const EntityInstances>> entityInstances;
+
+    std::vector<uint8_t> entityAlive;
+    std::vector<uint8_t> transformAlive;
+    std::vector<uint8_t> meshAlive;
+    std::vector<uint8_t> volumeAlive;
+    std::vector<uint8_t> materialAlive;
+    std::vector<uint8_t> lightAlive;
+
+    glm::vec3 sceneBBMin = glm::vec3(0.f);
+    glm::vec3 sceneBBMax = glm::vec3(0.f);
+
+    /* Empties the scene, sizing every array to the number of components of its type */
+    void reset();
+
+    /* Takes over the struct arrays and existence flags of a snapshot */
+    void apply(const SceneSnapshot &snapshot);
+
+    bool isEntityInitialized(uint32_t entityID) const;
+
+    /* @returns the id of the component an entity references, or -1 if it references none or a removed one */
+    int32_t getTransformID(uint32_t entityID) const;
+    int32_t getMeshID(uint32_t entityID) const;
+    int32_t getVolumeID(uint32_t entityID) const;
+    int32_t getMaterialID(uint32_t entityID) const;
+    int32_t getLightID(uint32_t entityID) const;
+
+    /* @returns the instances of an entity, or nullptr if it has none. Entities with a light are never instanced. */
+    const EntityInstances* getInstances(uint32_t entityID) const;
+};
+
+/**
+ * Copies every component which changed since the previous capture into a snapshot, and marks them clean.
+ * Locks every component type while copying. The generation of the snapshot is left at zero.
+ */
+SceneSnapshot captureScene();
+
+};
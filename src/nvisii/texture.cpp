@@ -2,8 +2,13 @@
 #include <nvisii/light.h>
 #include <nvisii/material.h>
 
+// The stb implementations live here rather than in nvisii.cpp, so that nvisii_core links without the renderer
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image.h>
 #include <stb_image_write.h>
+#include <nvisii/utilities/trace.h>
+#include <nvisii/utilities/noise.h>
 #include <cstring>
 
 #include <algorithm>
@@ -77,6 +82,23 @@ std::vector<u8vec4> Texture::getByteTexels() {
     return texels8;
 }
 
+float Texture::getLinearLuminance(uint32_t x, uint32_t y) {
+    uint32_t i = y * textureStructs[id].width + x;
+    if (floatTexels.size() > 0) {
+        const vec4 &t = floatTexels[i];
+        return 0.2126f * t.r + 0.7152f * t.g + 0.0722f * t.b;
+    }
+    // 8 bit texels only take on 256 values, so cache their linear equivalent
+    static const std::vector<float> srgbToLinear = [] () {
+        std::vector<float> lut(256);
+        for (uint32_t c = 0; c < 256; ++c) lut[c] = glm::convertSRGBToLinear(vec4(c / 255.f)).r;
+        return lut;
+    }();
+    const u8vec4 &t = byteTexels[i];
+    if (linear) return (0.2126f * t.r + 0.7152f * t.g + 0.0722f * t.b) / 255.f;
+    return 0.2126f * srgbToLinear[t.r] + 0.7152f * srgbToLinear[t.g] + 0.0722f * srgbToLinear[t.b];
+}
+
 uint32_t Texture::getWidth() {
     return textureStructs[id].width;
 }
@@ -174,7 +196,19 @@ Texture* Texture::createFromImage(std::string name, std::string path, bool linea
 }
 
 Texture* Texture::createFromFile(std::string name, std::string path, bool linear) {
-    auto create = [path, linear] (Texture* l) {
+    // The texels and texture struct fields read from the file, before they are published to the texture
+    struct TextureFileData {
+        uint32_t width = 0, height = 0;
+        bool linear = false;
+        bool rightHanded = true;
+        std::vector<vec4> floatTexels;
+        std::vector<u8vec4> byteTexels;
+    };
+
+    // Reading and decoding the file happens outside of the edit mutex, see StaticFactory::create
+    auto build = [path, linear] () -> TextureFileData {
+        TraceScope trace("load texture", "io");
+        TextureFileData data;
         // first, check the extension
         std::string extension = std::string(strrchr(path.c_str(), '.'));
         std::transform(extension.data(), extension.data() + extension.size(), 
@@ -194,11 +228,15 @@ Texture* Texture::createFromFile(std::string name, std::string path, bool linear
                 throw std::runtime_error( std::string("Error: image " + path + " is empty"));
 
             // gli detects whether or not a texture is srgb. Ignore "linear" parameter above.
-            l->linear = (!gli::is_srgb(format));
+            data.linear = (!gli::is_srgb(format));
+            // KTX files store their exact format, while DDS files often mislabel sRGB block compressed textures as linear
+            bool trustFormat = (extension.compare(".ktx") == 0);
 
             if (gli::is_compressed(format)) {
                 if ((format != gli::FORMAT_RGBA_DXT1_UNORM_BLOCK8) &&
+                    (format != gli::FORMAT_RGBA_DXT1_SRGB_BLOCK8) &&
                     (format != gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16) &&
+                    (format != gli::FORMAT_RGBA_DXT5_SRGB_BLOCK16) &&
                     (format != gli::FORMAT_R_ATI1N_UNORM_BLOCK8) &&
                     (format != gli::FORMAT_RG_ATI2N_UNORM_BLOCK16)
                 )
@@ -206,12 +244,15 @@ Texture* Texture::createFromFile(std::string name, std::string path, bool linear
                         "Supported formats are " + 
                         "FORMAT_RGBA32_SFLOAT_PACK32, " +
                         "FORMAT_RGBA8_SRGB_PACK8, " +
+                        "FORMAT_RGBA8_UNORM_PACK8, " +
                         "FORMAT_R32_SFLOAT_PACK32, " +
                         "FORMAT_R8_SRGB_PACK8, " +
                         "FORMAT_RG32_SFLOAT_PACK32, " +
-                        "FORMAT_RG8_SRGB_PACK8" + 
+                        "FORMAT_RG8_SRGB_PACK8, " + 
                         "FORMAT_RGBA_DXT1_UNORM_BLOCK8, " +
+                        "FORMAT_RGBA_DXT1_SRGB_BLOCK8, " +
                         "FORMAT_RGBA_DXT5_UNORM_BLOCK16, " +
+                        "FORMAT_RGBA_DXT5_SRGB_BLOCK16, " +
                         "FORMAT_R_ATI1N_UNORM_BLOCK8, " +
                         "FORMAT_RG_ATI2N_UNORM_BLOCK16")); 
 
@@ -236,8 +277,8 @@ Texture* Texture::createFromFile(std::string name, std::string path, bool linear
                     gli::extent2d DecompressedBlockCoord;
                     for(BlockCoord.y = 0, TexelCoord.y = 0; BlockCoord.y < LevelExtentInBlocks.y; ++BlockCoord.y, TexelCoord.y += BlockExtent.y) {
                         for(BlockCoord.x = 0, TexelCoord.x = 0; BlockCoord.x < LevelExtentInBlocks.x; ++BlockCoord.x, TexelCoord.x += BlockExtent.x) {
-                            if (format == gli::FORMAT_RGBA_DXT1_UNORM_BLOCK8) {
-                                l->linear = false; // hack for buggy importer...
+                            if ((format == gli::FORMAT_RGBA_DXT1_UNORM_BLOCK8) || (format == gli::FORMAT_RGBA_DXT1_SRGB_BLOCK8)) {
+                                if (!trustFormat) data.linear = false; // hack for buggy importer...
                                 const gli::detail::dxt1_block *DXT1Block = TextureCompressed.data<gli::detail::dxt1_block>(0, 0, Level) + (BlockCoord.y * LevelExtentInBlocks.x + BlockCoord.x);
                                 const gli::detail::texel_block4x4 DecompressedBlock = gli::detail::decompress_dxt1_block(*DXT1Block);
                                 for(DecompressedBlockCoord.y = 0; DecompressedBlockCoord.y < glm::min(4, LevelExtent.y); ++DecompressedBlockCoord.y) {
@@ -246,8 +287,8 @@ Texture* Texture::createFromFile(std::string name, std::string path, bool linear
                                     }
                                 }
                             }
-                            else if (format == gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16) {
-                                l->linear = false; // hack for buggy importer...
+                            else if ((format == gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16) || (format == gli::FORMAT_RGBA_DXT5_SRGB_BLOCK16)) {
+                                if (!trustFormat) data.linear = false; // hack for buggy importer...
                                 const gli::detail::dxt5_block *DXT5Block = TextureCompressed.data<gli::detail::dxt5_block>(0, 0, Level) + (BlockCoord.y * LevelExtentInBlocks.x + BlockCoord.x);
                                 const gli::detail::texel_block4x4 DecompressedBlock = gli::detail::decompress_dxt5_block(*DXT5Block);
                                 for(DecompressedBlockCoord.y = 0; DecompressedBlockCoord.y < glm::min(4, LevelExtent.y); ++DecompressedBlockCoord.y) {
@@ -281,67 +322,62 @@ Texture* Texture::createFromFile(std::string name, std::string path, bool linear
                 TextureLocalDecompressed = gli::flip(TextureLocalDecompressed);
                 
                 int lvl = 0;
-                textureStructs[l->getId()].width = (uint32_t)(TextureLocalDecompressed.extent(lvl).x);
-                textureStructs[l->getId()].height = (uint32_t)(TextureLocalDecompressed.extent(lvl).y);
+                data.width = (uint32_t)(TextureLocalDecompressed.extent(lvl).x);
+                data.height = (uint32_t)(TextureLocalDecompressed.extent(lvl).y);
                 
                 // for directX normal maps
-                if (extension.compare(".dds") == 0) textureStructs[l->getId()].rightHanded = false;
+                if (extension.compare(".dds") == 0) data.rightHanded = false;
 
                 auto image = TextureLocalDecompressed[lvl]; // get mipmap 0
                 if (gli::is_float(format)) {
-                    l->floatTexels.resize(textureStructs[l->getId()].width * textureStructs[l->getId()].height);
-                    memcpy(l->floatTexels.data(), image.data(), (uint32_t)image.size());
+                    data.floatTexels.resize(data.width * data.height);
+                    memcpy(data.floatTexels.data(), image.data(), (uint32_t)image.size());
                 } else {
-                    l->byteTexels.resize(textureStructs[l->getId()].width * textureStructs[l->getId()].height);
-                    std::vector<vec4> temp(textureStructs[l->getId()].width * textureStructs[l->getId()].height);
+                    data.byteTexels.resize(data.width * data.height);
+                    std::vector<vec4> temp(data.width * data.height);
                     memcpy(temp.data(), image.data(), (uint32_t)image.size());
-                    for (uint32_t i = 0; i < temp.size(); ++i) l->byteTexels[i] = u8vec4(temp[i] * 255.f);
+                    for (uint32_t i = 0; i < temp.size(); ++i) data.byteTexels[i] = u8vec4(temp[i] * 255.f);
                 }            
             }
             else {
                 tex2D = gli::flip(tex2D);
-                textureStructs[l->getId()].width = (uint32_t)(tex2D.extent().x);
-                textureStructs[l->getId()].height = (uint32_t)(tex2D.extent().y);
+                data.width = (uint32_t)(tex2D.extent().x);
+                data.height = (uint32_t)(tex2D.extent().y);
                 auto image = tex2D[0]; // get mipmap 0
                 if (format == gli::FORMAT_RGBA32_SFLOAT_PACK32) {
-                    l->floatTexels.resize(textureStructs[l->getId()].width * textureStructs[l->getId()].height);
-                    memcpy(l->floatTexels.data(), image.data(), (uint32_t)image.size());
+                    data.floatTexels.resize(data.width * data.height);
+                    memcpy(data.floatTexels.data(), image.data(), (uint32_t)image.size());
                 }
-                else if (format == gli::FORMAT_RGBA8_SRGB_PACK8) {
-                    l->byteTexels.resize(textureStructs[l->getId()].width * textureStructs[l->getId()].height);
-                    memcpy(l->byteTexels.data(), image.data(), (uint32_t)image.size());
+                else if ((format == gli::FORMAT_RGBA8_SRGB_PACK8) || (format == gli::FORMAT_RGBA8_UNORM_PACK8)) {
+                    data.byteTexels.resize(data.width * data.height);
+                    memcpy(data.byteTexels.data(), image.data(), (uint32_t)image.size());
                 }
-                if (format == gli::FORMAT_R32_SFLOAT_PACK32) {
+                else if ((format == gli::FORMAT_R32_SFLOAT_PACK32) || (format == gli::FORMAT_RG32_SFLOAT_PACK32)) {
                     tex2D = gli::convert(tex2D, gli::format::FORMAT_RGBA32_SFLOAT_PACK32);
-                    l->floatTexels.resize(textureStructs[l->getId()].width * textureStructs[l->getId()].height);
-                    memcpy(l->floatTexels.data(), image.data(), (uint32_t)image.size());
+                    image = tex2D[0];
+                    data.floatTexels.resize(data.width * data.height);
+                    memcpy(data.floatTexels.data(), image.data(), (uint32_t)image.size());
                 }
-                else if (format == gli::FORMAT_R8_SRGB_PACK8) {
+                else if ((format == gli::FORMAT_R8_SRGB_PACK8) || (format == gli::FORMAT_RG8_SRGB_PACK8)) {
                     tex2D = gli::convert(tex2D, gli::format::FORMAT_RGBA8_SRGB_PACK8);
-                    l->byteTexels.resize(textureStructs[l->getId()].width * textureStructs[l->getId()].height);
-                    memcpy(l->byteTexels.data(), image.data(), (uint32_t)image.size());
-                }
-                if (format == gli::FORMAT_RG32_SFLOAT_PACK32) {
-                    tex2D = gli::convert(tex2D, gli::format::FORMAT_RGBA32_SFLOAT_PACK32);
-                    l->floatTexels.resize(textureStructs[l->getId()].width * textureStructs[l->getId()].height);
-                    memcpy(l->floatTexels.data(), image.data(), (uint32_t)image.size());
-                }
-                else if (format == gli::FORMAT_RG8_SRGB_PACK8) {
-                    tex2D = gli::convert(tex2D, gli::format::FORMAT_RGBA8_SRGB_PACK8);
-                    l->byteTexels.resize(textureStructs[l->getId()].width * textureStructs[l->getId()].height);
-                    memcpy(l->byteTexels.data(), image.data(), (uint32_t)image.size());
+                    image = tex2D[0];
+                    data.byteTexels.resize(data.width * data.height);
+                    memcpy(data.byteTexels.data(), image.data(), (uint32_t)image.size());
                 }
                 else {
                     throw std::runtime_error(std::string("Error: image " + path + " uses an unsupported format. " + 
                         "Supported formats are " + 
                         "FORMAT_RGBA32_SFLOAT_PACK32, " +
                         "FORMAT_RGBA8_SRGB_PACK8, " +
+                        "FORMAT_RGBA8_UNORM_PACK8, " +
                         "FORMAT_R32_SFLOAT_PACK32, " +
                         "FORMAT_R8_SRGB_PACK8, " +
                         "FORMAT_RG32_SFLOAT_PACK32, " +
-                        "FORMAT_RG8_SRGB_PACK8" + 
+                        "FORMAT_RG8_SRGB_PACK8, " + 
                         "FORMAT_RGBA_DXT1_UNORM_BLOCK8, " +
+                        "FORMAT_RGBA_DXT1_SRGB_BLOCK8, " +
                         "FORMAT_RGBA_DXT5_UNORM_BLOCK16, " +
+                        "FORMAT_RGBA_DXT5_SRGB_BLOCK16, " +
                         "FORMAT_R_ATI1N_UNORM_BLOCK8, " +
                         "FORMAT_RG_ATI2N_UNORM_BLOCK16"));
                 }
@@ -351,20 +387,20 @@ Texture* Texture::createFromFile(std::string name, std::string path, bool linear
             if (extension.compare(".hdr") == 0) {
                 int x, y, num_channels;
                 stbi_set_flip_vertically_on_load(true);
-                l->linear = true; // Since we convert HDR images from srgb to linear, srgb is always false here.
+                data.linear = true; // Since we convert HDR images from srgb to linear, srgb is always false here.
                 float* pixels = stbi_loadf(path.c_str(), &x, &y, &num_channels, STBI_rgb_alpha);
                 if (!pixels) { 
                     std::string reason (stbi_failure_reason());
                     throw std::runtime_error(std::string("Error: failed to load texture image \"") + path + std::string("\". Reason: ") + reason); 
                 }
-                l->floatTexels.resize(x * y);
-                memcpy(l->floatTexels.data(), pixels, x * y * 4 * sizeof(float));
-                textureStructs[l->getId()].width = x;
-                textureStructs[l->getId()].height = y;
+                data.floatTexels.resize(x * y);
+                memcpy(data.floatTexels.data(), pixels, x * y * 4 * sizeof(float));
+                data.width = x;
+                data.height = y;
                 stbi_image_free(pixels);
             }
             else {
-                l->linear = linear; // if linear is true, treat the texture contents as if it were not sRGB.
+                data.linear = linear; // if linear is true, treat the texture contents as if it were not sRGB.
                 int x, y, num_channels;
                 stbi_set_flip_vertically_on_load(true);
                 stbi_uc* pixels = stbi_load(path.c_str(), &x, &y, &num_channels, STBI_rgb_alpha);
@@ -372,23 +408,28 @@ Texture* Texture::createFromFile(std::string name, std::string path, bool linear
                     std::string reason (stbi_failure_reason());
                     throw std::runtime_error(std::string("Error: failed to load texture image \"") + path + std::string("\". Reason: ") + reason); 
                 }
-                l->byteTexels.resize(x * y);
-                memcpy(l->byteTexels.data(), pixels, x * y * 4 * sizeof(stbi_uc));
-                textureStructs[l->getId()].width = x;
-                textureStructs[l->getId()].height = y;
+                data.byteTexels.resize(x * y);
+                memcpy(data.byteTexels.data(), pixels, x * y * 4 * sizeof(stbi_uc));
+                data.width = x;
+                data.height = y;
                 stbi_image_free(pixels);
             }
         }
 
+        return data;
+    };
+
+    auto publish = [] (Texture* l, TextureFileData &data) {
+        textureStructs[l->getId()].width = data.width;
+        textureStructs[l->getId()].height = data.height;
+        textureStructs[l->getId()].rightHanded = data.rightHanded;
+        l->linear = data.linear;
+        l->floatTexels = std::move(data.floatTexels);
+        l->byteTexels = std::move(data.byteTexels);
         l->markDirty();
     };
 
-    try {
-        return StaticFactory::create<Texture>(editMutex, name, "Texture", lookupTable, textures.data(), textures.size(), create);
-    } catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Texture", lookupTable, textures.data(), textures.size());
-		throw;
-	}
+    return StaticFactory::create<Texture, TextureFileData>(editMutex, name, "Texture", lookupTable, textures.data(), textures.size(), build, publish);
 }
 
 Texture* Texture::createFromData(std::string name, uint32_t width, uint32_t height, const float* data, uint32_t length, bool linear, bool hdr)
@@ -429,6 +470,107 @@ Texture* Texture::createFromData(std::string name, uint32_t width, uint32_t heig
 	}
 }
 
+Texture* Texture::createNoiseTexture(std::string name, uint32_t width, uint32_t height, const NoiseParameters &parameters, bool hdr)
+{
+    if (width == 0) { throw std::runtime_error("Error: width must be greater than 0!"); }
+    if (height == 0) { throw std::runtime_error("Error: height must be greater than 0!"); }
+    if (!(parameters.frequency > 0.f)) { throw std::runtime_error("Error: noise frequency must be greater than 0!"); }
+    if (parameters.octaves < 1 || parameters.octaves > 16) { throw std::runtime_error("Error: noise octaves must be between 1 and 16!"); }
+    if (!(parameters.lacunarity > 0.f)) { throw std::runtime_error("Error: noise lacunarity must be greater than 0!"); }
+    if (parameters.tileable && parameters.type == NOISE_SIMPLEX) { throw std::runtime_error("Error: simplex noise cannot be tileable!"); }
+
+    struct TextureNoiseData {
+        std::vector<vec4> floatTexels;
+        std::vector<u8vec4> byteTexels;
+    };
+
+    // Generating the noise happens outside of the edit mutex, see StaticFactory::create
+    auto build = [width, height, parameters, hdr] () -> TextureNoiseData {
+        TraceScope trace("generate noise texture", "texture");
+        TextureNoiseData data;
+        if (hdr) {
+            data.floatTexels.resize(size_t(width) * size_t(height));
+            generateNoiseImage(data.floatTexels.data(), width, height, parameters);
+        } else {
+            data.byteTexels.resize(size_t(width) * size_t(height));
+            generateNoiseImage(data.byteTexels.data(), width, height, parameters);
+        }
+        return data;
+    };
+
+    auto publish = [width, height] (Texture* l, TextureNoiseData &data) {
+        textureStructs[l->getId()].width = width;
+        textureStructs[l->getId()].height = height;
+        // noise values are data rather than colors, so they are never gamma corrected
+        l->linear = true;
+        l->floatTexels = std::move(data.floatTexels);
+        l->byteTexels = std::move(data.byteTexels);
+        l->markDirty();
+    };
+
+    return StaticFactory::create<Texture, TextureNoiseData>(editMutex, name, "Texture", lookupTable, textures.data(), textures.size(), build, publish);
+}
+
+Texture* Texture::createNoise(std::string name, uint32_t width, uint32_t height, uint32_t seed, 
+    float frequency, uint32_t octaves, float lacunarity, float gain, bool simplex, bool tileable, bool hdr)
+{
+    NoiseParameters parameters;
+    parameters.type = (simplex) ? NOISE_SIMPLEX : NOISE_GRADIENT;
+    parameters.seed = seed;
+    parameters.frequency = frequency;
+    parameters.octaves = octaves;
+    parameters.lacunarity = lacunarity;
+    parameters.gain = gain;
+    parameters.tileable = tileable;
+    return createNoiseTexture(name, width, height, parameters, hdr);
+}
+
+Texture* Texture::createNoiseTurbulence(std::string name, uint32_t width, uint32_t height, uint32_t seed, 
+    float frequency, uint32_t octaves, float lacunarity, float gain, bool simplex, bool tileable, bool hdr)
+{
+    NoiseParameters parameters;
+    parameters.type = (simplex) ? NOISE_SIMPLEX : NOISE_GRADIENT;
+    parameters.seed = seed;
+    parameters.frequency = frequency;
+    parameters.octaves = octaves;
+    parameters.lacunarity = lacunarity;
+    parameters.gain = gain;
+    parameters.turbulence = true;
+    parameters.tileable = tileable;
+    return createNoiseTexture(name, width, height, parameters, hdr);
+}
+
+Texture* Texture::createNoiseCellular(std::string name, uint32_t width, uint32_t height, uint32_t seed, 
+    float frequency, uint32_t octaves, float lacunarity, float gain, float jitter, bool tileable, bool hdr)
+{
+    if (jitter < 0.f || jitter > 1.f) { throw std::runtime_error("Error: cellular noise jitter must be between 0 and 1!"); }
+    NoiseParameters parameters;
+    parameters.type = NOISE_CELLULAR;
+    parameters.seed = seed;
+    parameters.frequency = frequency;
+    parameters.octaves = octaves;
+    parameters.lacunarity = lacunarity;
+    parameters.gain = gain;
+    parameters.jitter = jitter;
+    parameters.tileable = tileable;
+    return createNoiseTexture(name, width, height, parameters, hdr);
+}
+
+Texture* Texture::createNoiseWarped(std::string name, uint32_t width, uint32_t height, uint32_t seed, 
+    float frequency, uint32_t octaves, float lacunarity, float gain, float warp, bool tileable, bool hdr)
+{
+    NoiseParameters parameters;
+    parameters.type = NOISE_GRADIENT;
+    parameters.seed = seed;
+    parameters.frequency = frequency;
+    parameters.octaves = octaves;
+    parameters.lacunarity = lacunarity;
+    parameters.gain = gain;
+    parameters.warp = warp;
+    parameters.tileable = tileable;
+    return createNoiseTexture(name, width, height, parameters, hdr);
+}
+
 vec3 rgb2hsv(vec3 c)
 {
     vec4 K = vec4(0.0, -1.0 / 3.0, 2.0 / 3.0, -1.0);
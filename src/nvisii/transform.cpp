@@ -660,6 +660,13 @@ void Transform::updateScale()
 }
 
 void Transform::updateMatrix()
+{
+	computeLocalMatrices();
+	updateChildren();
+	markDirty();
+}
+
+void Transform::computeLocalMatrices()
 {
 	localToParentMatrix = (localToParentTransform * getLocalToParentTranslationMatrix(false) * getLocalToParentRotationMatrix(false) * getLocalToParentScaleMatrix(false));
 	parentToLocalMatrix = (getParentToLocalScaleMatrix(false) * getParentToLocalRotationMatrix(false) * getParentToLocalTranslationMatrix(false) * glm::inverse(localToParentTransform));
@@ -676,9 +683,6 @@ void Transform::updateMatrix()
 	// prevUp = glm::vec3(prevLocalToParentMatrix[1]);
 	// prevForward = glm::vec3(prevLocalToParentMatrix[2]);
 	// prevPosition = glm::vec3(prevLocalToParentMatrix[3]);
-
-	updateChildren();
-	markDirty();
 }
 
 glm::mat4 Transform::computeWorldToLocalMatrix(bool previous)
@@ -702,6 +706,12 @@ glm::mat4 Transform::computeWorldToLocalMatrix(bool previous)
 // }
 
 void Transform::updateWorldMatrix()
+{
+	computeWorldMatrices();
+	markDirty();
+}
+
+void Transform::computeWorldMatrices()
 {
 	if (parent == -1) {
 		worldToLocalMatrix = parentToLocalMatrix;
@@ -729,7 +739,6 @@ void Transform::updateWorldMatrix()
 		// glm::decompose(prevLocalToWorldMatrix, prevWorldScale, prevWorldRotation, prevWorldTranslation, prevWorldSkew, prevWorldPerspective);
 		// glm::decompose(nextLocalToWorldMatrix, worldScale, worldRotation, worldTranslation, worldSkew, worldPerspective);
 	}
-	markDirty();
 }
 
 glm::mat4 Transform::getParentToLocalMatrix(bool previous)
@@ -1,4 +1,5 @@
 #include <nvisii/volume.h>
+#include <nvisii/utilities/trace.h>
 
 #include <cstring>
 #include <algorithm>
@@ -110,7 +111,9 @@ bool fileExists(const char* file) {
 
 /* Static Factory Implementations */
 Volume* Volume::createFromFile(std::string name, std::string path) {
-    auto create = [path] (Volume* v) {
+    // Reading the grid happens outside of the edit mutex, see StaticFactory::create
+    auto build = [path] () -> std::shared_ptr<nanovdb::GridHandle<>> {
+        TraceScope trace("load volume", "io");
         if (!fileExists(path.c_str())) {
             throw std::runtime_error(std::string("Error: file does not exist ") + path);
         }
@@ -139,21 +142,20 @@ Volume* Volume::createFromFile(std::string name, std::string path) {
                 throw std::runtime_error("Error: unable to read nvdb grid!");
             }
 
-            v->gridHdlPtr = std::make_shared<nanovdb::GridHandle<>>(std::move(gridHdl));
+            return std::make_shared<nanovdb::GridHandle<>>(std::move(gridHdl));
         }
         else {
             throw std::runtime_error(std::string("Error: unsupported format ") + 
                 extension);
         }
+    };
+
+    auto publish = [] (Volume* v, std::shared_ptr<nanovdb::GridHandle<>> &gridHdlPtr) {
+        v->gridHdlPtr = gridHdlPtr;
         v->markDirty();
     };
 
-    try {
-        return StaticFactory::create<Volume>(editMutex, name, "Volume", lookupTable, volumes.data(), volumes.size(), create);
-    } catch (...) {
-		StaticFactory::removeIfExists(editMutex, name, "Volume", lookupTable, volumes.data(), volumes.size());
-		throw;
-	}
+    return StaticFactory::create<Volume, std::shared_ptr<nanovdb::GridHandle<>>>(editMutex, name, "Volume", lookupTable, volumes.data(), volumes.size(), build, publish);
 }
 
 Volume *Volume::createSphere(std::string name)
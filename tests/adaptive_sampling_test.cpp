@@ -0,0 +1,119 @@
+// Drives AdaptiveSampler with a synthetic progressive render, where some tiles are noisy and the rest
+// are flat, and checks that flat tiles retire early, noisy tiles keep the samples they free up, and
+// the sample accounting matches what was actually rendered.
+
+#include <nvisii/utilities/adaptive_sampling.h>
+
+#include "check.h"
+
+#include <random>
+
+/* A progressive render of an image whose top rows are noisy and whose other rows are flat grey */
+struct SyntheticRender {
+    uint32_t width, height, noisyRows;
+    std::vector<glm::vec4> sum, evenSum, mean, halfMean;
+    std::vector<uint32_t> counts;
+    std::mt19937 rng = std::mt19937(1);
+
+    SyntheticRender(uint32_t width, uint32_t height, uint32_t noisyRows)
+        : width(width), height(height), noisyRows(noisyRows), sum(width * height, glm::vec4(0.f)),
+          evenSum(width * height, glm::vec4(0.f)), mean(width * height), halfMean(width * height), counts(width * height, 0) {}
+
+    /* Takes one sample for every pixel whose tile is active. Rows are stored bottom first, like the frame buffer. */
+    void pass(const AdaptiveSampler &sampler)
+    {
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        const auto &mask = sampler.getTileMask();
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t x = 0; x < width; ++x) {
+                if (mask[adaptiveTileIndex(x, y, width, sampler.getTileSize())] != ADAPTIVE_TILE_ACTIVE) continue;
+                size_t i = size_t(height - 1 - y) * width + x;
+                float value = (y < noisyRows) ? 4.f * uniform(rng) * uniform(rng) : .5f;
+                glm::vec4 sample(value, value, value, 1.f);
+                if ((counts[i] & 1u) == 0) evenSum[i] += sample;
+                sum[i] += sample;
+                counts[i]++;
+                mean[i] = sum[i] / float(counts[i]);
+                halfMean[i] = evenSum[i] / float((counts[i] + 1) / 2);
+            }
+        }
+    }
+};
+
+static void testConvergence()
+{
+    // Not a multiple of the tile size, so that the edge tiles are partial
+    const uint32_t width = 70, height = 50, tileSize = 16, noisyRows = 16;
+    SyntheticRender render(width, height, noisyRows);
+    AdaptiveSampler sampler;
+    uint64_t budget = uint64_t(width) * height * 64;
+    sampler.reset(width, height, tileSize, .02f, 8, 256, budget);
+    CHECK(sampler.getActiveTileCount() == 5 * 4);
+
+    uint32_t updates = 0;
+    while (!sampler.isDone()) {
+        render.pass(sampler);
+        sampler.advance();
+        if (sampler.needsConvergenceUpdate()) {
+            sampler.updateConvergence(render.mean.data(), render.halfMean.data());
+            updates++;
+        }
+    }
+    CHECK(updates > 1);
+
+    // Samples are only counted for the pixels which took them
+    uint64_t rendered = 0;
+    for (uint32_t count : render.counts) rendered += count;
+    CHECK(sampler.getSamplesTaken() == rendered);
+    CHECK_NEAR(sampler.getAverageSamplesPerPixel(), double(rendered) / (width * height), 1e-3);
+
+    // The budget may only be exceeded by the pass which crossed it
+    CHECK(sampler.getSamplesTaken() < budget + uint64_t(width) * height);
+
+    // Flat tiles retire at their first update, and the noisy top row of tiles gets the samples they freed
+    const auto &mask = sampler.getTileMask();
+    const auto &errors = sampler.getTileErrors();
+    uint32_t flatCount = render.counts[0], noisyCount = render.counts[size_t(height - 1) * width];
+    CHECK(flatCount == 8);
+    CHECK(noisyCount > 64);
+    for (uint32_t tile = 5; tile < mask.size(); ++tile) {
+        CHECK(mask[tile] == ADAPTIVE_TILE_CONVERGED);
+        CHECK(errors[tile] < .02f);
+    }
+    for (uint32_t tile = 0; tile < 5; ++tile) CHECK(errors[tile] > 0.f);
+}
+
+static void testLimits()
+{
+    SyntheticRender render(32, 32, 32);
+    AdaptiveSampler sampler;
+
+    // No pixel takes more than the maximum, even if it never converges
+    sampler.reset(32, 32, 8, 0.f, 2, 12, uint64_t(1) << 40);
+    while (!sampler.isDone()) {
+        render.pass(sampler);
+        sampler.advance();
+        if (sampler.needsConvergenceUpdate()) sampler.updateConvergence(render.mean.data(), render.halfMean.data());
+    }
+    CHECK(sampler.getPassCount() == 12);
+    for (uint32_t count : render.counts) CHECK(count == 12);
+
+    // Nothing converges before every pixel took the minimum number of samples
+    sampler.reset(32, 32, 8, 1e10f, 6, 100, uint64_t(1) << 40);
+    for (uint32_t pass = 0; pass < 5; ++pass) {
+        sampler.advance();
+        CHECK(!sampler.needsConvergenceUpdate());
+    }
+    CHECK(sampler.getActiveTileCount() == 16);
+
+    CHECK(adaptiveTileIndex(17, 9, 40, 8) == 1 * 5 + 2);
+    CHECK(adaptivePixelError(1.f, 1.f, 1.f, 1.f, 1.f, 1.f) == 0.f);
+    CHECK(adaptivePixelError(0.f, 0.f, 0.f, .1f, 0.f, 0.f) > 0.f);
+}
+
+int main()
+{
+    testConvergence();
+    testLimits();
+    return checkResult();
+}
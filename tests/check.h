@@ -0,0 +1,67 @@
+#pragma once
+
+// Checks for the host side tests. A failed check is reported and counted rather than aborting, so
+// that one run shows every failure, and main returns checkResult() for ctest to see.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static int checkFailures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        checkFailures++; \
+    } \
+} while (0)
+
+#define CHECK_NEAR(a, b, tolerance) do { \
+    double checkA = double(a), checkB = double(b); \
+    if (!(std::fabs(checkA - checkB) <= double(tolerance))) { \
+        fprintf(stderr, "%s:%d: check failed: %s is %g, expected %s = %g within %g\n", __FILE__, __LINE__, \
+            #a, checkA, #b, checkB, double(tolerance)); \
+        checkFailures++; \
+    } \
+} while (0)
+
+/** @returns the number of failed checks, after printing a summary */
+inline int checkResult()
+{
+    if (checkFailures) fprintf(stderr, "%d check(s) failed\n", checkFailures);
+    else fprintf(stderr, "all checks passed\n");
+    return checkFailures;
+}
+
+/**
+ * Pearson's chi-square statistic of observed counts against expected counts. Bins expecting fewer
+ * than five samples are merged, as the statistic is unreliable for them.
+ * @param dof Returns the degrees of freedom of the merged bins
+ */
+inline double chiSquare(const std::vector<double> &observed, const std::vector<double> &expected, int &dof)
+{
+    double statistic = 0.0, mergedObserved = 0.0, mergedExpected = 0.0;
+    int bins = 0;
+    for (size_t i = 0; i < observed.size(); ++i) {
+        mergedObserved += observed[i];
+        mergedExpected += expected[i];
+        if (mergedExpected < 5.0) continue;
+        statistic += (mergedObserved - mergedExpected) * (mergedObserved - mergedExpected) / mergedExpected;
+        mergedObserved = mergedExpected = 0.0;
+        bins++;
+    }
+    if (mergedExpected > 0.0) {
+        statistic += (mergedObserved - mergedExpected) * (mergedObserved - mergedExpected) / mergedExpected;
+        bins++;
+    }
+    dof = (bins > 1) ? bins - 1 : 1;
+    return statistic;
+}
+
+/** @returns the chi-square value exceeded with probability 0.001, by the Wilson-Hilferty approximation */
+inline double chiSquareCritical(int dof)
+{
+    double k = double(dof), z = 3.09;
+    double t = 1.0 - 2.0 / (9.0 * k) + z * std::sqrt(2.0 / (9.0 * k));
+    return k * t * t * t;
+}
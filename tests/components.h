@@ -0,0 +1,34 @@
+#pragma once
+
+// Sets up the component factories for the tests which create entities, without starting the
+// renderer, the same way nvisii_bake does.
+
+#include <nvisii/nvisii.h>
+
+inline void initializeComponents(uint32_t maxComponents = 64)
+{
+    using namespace nvisii;
+    Entity::initializeFactory(maxComponents);
+    Transform::initializeFactory(maxComponents);
+    Material::initializeFactory(maxComponents);
+    Mesh::initializeFactory(maxComponents);
+    Camera::initializeFactory(maxComponents);
+    Light::initializeFactory(maxComponents);
+    Texture::initializeFactory(maxComponents);
+    Volume::initializeFactory(maxComponents);
+}
+
+/* Removes every component, like clearAll, which lives with the renderer */
+inline void clearComponents()
+{
+    using namespace nvisii;
+    clearRandomizers();
+    Entity::clearAll();
+    Transform::clearAll();
+    Material::clearAll();
+    Texture::clearAll();
+    Mesh::clearAll();
+    Camera::clearAll();
+    Light::clearAll();
+    Volume::clearAll();
+}
@@ -0,0 +1,95 @@
+// Renders a box under a constant dome with the CPU backend, from the components through a committed
+// scene snapshot, and checks that pixels which miss see the dome, pixels which hit see the box, and
+// that rendering the same samples twice gives the same image.
+
+#include "components.h"
+#include "scene_snapshot.h"
+#include <cpucode/cpu_renderer.h>
+
+#include "check.h"
+
+using namespace nvisii;
+
+static const int width = 8, height = 8;
+
+struct Image {
+    std::vector<glm::vec4> color = std::vector<glm::vec4>(width * height, glm::vec4(0.f));
+    std::vector<glm::vec4> albedo = std::vector<glm::vec4>(width * height, glm::vec4(0.f));
+    std::vector<glm::vec4> normal = std::vector<glm::vec4>(width * height, glm::vec4(0.f));
+
+    /* Rows are stored bottom first, like the frame buffers */
+    const glm::vec4 &at(std::vector<glm::vec4> &buffer, int x, int y) { return buffer[(height - 1 - y) * width + x]; }
+};
+
+static Image render(const CPULaunchParams &LP, uint32_t samples)
+{
+    Image image;
+    cpuRender(LP, samples, image.color.data(), image.albedo.data(), image.normal.data());
+    return image;
+}
+
+static void testBoxUnderDome()
+{
+    initializeComponents();
+
+    Entity* camera = Entity::create("camera", Transform::create("camera"), nullptr, nullptr, nullptr,
+        Camera::create("camera", 0.785398f, 1.f));
+    camera->getTransform()->lookAt(glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f, 0.f, 5.f));
+    Entity::create("box", Transform::create("box"), Material::create("box", glm::vec3(.8f, .1f, .1f), 1.f),
+        Mesh::createBox("box", glm::vec3(.5f)));
+
+    SceneSnapshot changes = captureScene();
+    changes.generation = 1;
+    PublishedScene scene;
+    scene.reset();
+    scene.apply(changes);
+    CHECK(cpuUpdateComponents(changes, scene));
+
+    CPULaunchParams LP;
+    LP.frameSize = glm::ivec2(width, height);
+    LP.domeLightColor = glm::vec3(.5f, .6f, .7f);
+    LP.maxDiffuseDepth = 4;
+    LP.cameraEntity = scene.entityStructs[camera->getId()];
+    int32_t tid = LP.cameraEntity.transform_id, cid = LP.cameraEntity.camera_id;
+    LP.proj = scene.cameraStructs[cid].proj;
+    LP.viewT0 = LP.viewT1 = glm::inverse(scene.transformStructs[tid].localToWorld);
+
+    Image image = render(LP, 16);
+    for (auto &c : image.color) CHECK(std::isfinite(c.r) && std::isfinite(c.g) && std::isfinite(c.b));
+
+    // The corners miss the box, and see the dome directly
+    glm::vec4 corner = image.at(image.color, 0, 0);
+    CHECK_NEAR(corner.r, .5f, 1e-5);
+    CHECK_NEAR(corner.g, .6f, 1e-5);
+    CHECK_NEAR(corner.b, .7f, 1e-5);
+    CHECK(image.at(image.albedo, width - 1, height - 1) == glm::vec4(.5f, .6f, .7f, 1.f));
+
+    // The center sees the red box, lit by the dome, which it can not be brighter than
+    glm::vec4 center = image.at(image.color, width / 2, height / 2);
+    glm::vec4 centerAlbedo = image.at(image.albedo, width / 2, height / 2);
+    CHECK_NEAR(centerAlbedo.r, .8f, 1e-3);
+    CHECK_NEAR(centerAlbedo.g, .1f, 1e-3);
+    CHECK(center.r > 0.f);
+    CHECK(center.r > center.g);
+    CHECK(center.r < .5f);
+    CHECK(image.at(image.normal, width / 2, height / 2) != glm::vec4(0.f));
+
+    // Every sample depends only on its pixel and number, whichever thread renders it
+    Image again = render(LP, 16);
+    CHECK(again.color == image.color);
+
+    // Samples continue where the previous call stopped
+    Image progressive = render(LP, 8);
+    LP.frameID = 8;
+    cpuRender(LP, 8, progressive.color.data(), progressive.albedo.data(), progressive.normal.data());
+    for (size_t i = 0; i < image.color.size(); ++i) CHECK_NEAR(progressive.color[i].r, image.color[i].r, 1e-5);
+
+    cpuReleaseScene();
+    clearComponents();
+}
+
+int main()
+{
+    testBoxUnderDome();
+    return checkResult();
+}
@@ -0,0 +1,224 @@
+// Validates the host build of the Disney BSDF: the directions sample_disney_brdf picks must follow the
+// density they are drawn with (a chi-square test over bins of the sphere), the reflection lobes must be
+// reciprocal, and the sample weights must not create energy.
+
+#include <devicecode/disney_bsdf.h>
+
+#include "check.h"
+
+#include <random>
+
+static const float pi = 3.14159265358979f;
+static const float3 normal = make_float3(0.f, 0.f, 1.f);
+static const float3 tangent = make_float3(1.f, 0.f, 0.f);
+static const float3 bitangent = make_float3(0.f, 1.f, 0.f);
+
+static DisneyMaterial makeMaterial(float roughness, float metallic, float anisotropy, float clearcoat,
+    float transmission = 0.f, float sheen = 0.f)
+{
+    DisneyMaterial mat = {};
+    mat.base_color = make_float3(.8f, .8f, .8f);
+    mat.subsurface_color = make_float3(.8f, .8f, .8f);
+    mat.metallic = metallic;
+    mat.specular = .5f;
+    mat.roughness = roughness;
+    mat.anisotropy = anisotropy;
+    mat.clearcoat = clearcoat;
+    mat.clearcoat_gloss = 0.f;
+    mat.sheen = sheen;
+    mat.sheen_tint = .5f;
+    mat.specular_transmission = transmission;
+    mat.transmission_roughness = .7f;
+    mat.ior = 1.45f;
+    mat.alpha = 1.f;
+    return mat;
+}
+
+/* A direction from its polar angle cosine and azimuth, in the frame of the normal */
+static float3 direction(float cosTheta, float phi)
+{
+    float sinTheta = sqrtf(std::max(0.f, 1.f - cosTheta * cosTheta));
+    return make_float3(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+}
+
+static float evaluatePdf(const DisneyMaterial &mat, const float3 &w_o, const float3 &w_i)
+{
+    float pdf;
+    float3 w_h = normalize(w_i + w_o);
+    disney_pdf(mat, normal, normal, normal, tangent, bitangent, w_o, w_i, w_h, pdf);
+    return pdf;
+}
+
+static float3 evaluateBsdf(const DisneyMaterial &mat, const float3 &w_o, const float3 &w_i)
+{
+    float3 bsdf;
+    float3 w_h = normalize(w_i + w_o);
+    disney_brdf(mat, normal, normal, normal, tangent, bitangent, w_o, w_i, w_h, bsdf);
+    return bsdf;
+}
+
+/*
+ * The density of directions refracted through GGX half vectors drawn proportional to D(h) cos(theta_h),
+ * from w_o outside the surface, by the half vector Jacobian of Walter et al. (Eq 17). disney_pdf reports
+ * the bare distribution for this lobe, so sampled refractions are checked against this instead.
+ */
+static float refractionDensity(const DisneyMaterial &mat, const float3 &w_o, const float3 &w_i)
+{
+    float alpha = max(MIN_ALPHA, mat.transmission_roughness * mat.transmission_roughness);
+    float3 w_h = normalize(-(w_o + mat.ior * w_i));
+    float o_dot_h = dot(w_o, w_h), i_dot_h = dot(w_i, w_h);
+    if (w_h.z <= 0.f || o_dot_h <= 0.f || i_dot_h >= 0.f) return 0.f;
+    float denominator = o_dot_h + mat.ior * i_dot_h;
+    return gtr_2(w_h.z, alpha) * w_h.z * mat.ior * mat.ior * -i_dot_h / (denominator * denominator);
+}
+
+/*
+ * The density sample_disney_brdf draws directions with. Lobes are picked uniformly, while disney_pdf
+ * divides its sum by a component count lowered for metals and transmission, so the reported pdf is
+ * rescaled by the ratio of the two.
+ */
+static float samplingDensity(const DisneyMaterial &mat, const float3 &w_o, const float3 &w_i)
+{
+    float lobes = (mat.specular_transmission > 0.f) ? 4.f : 3.f;
+    float components = 3.f - lerp(mat.specular_transmission, mat.metallic, mat.metallic);
+    if (w_i.z > 0.f) return evaluatePdf(mat, w_o, w_i) * components / lobes;
+    if (mat.specular_transmission == 0.f) return 0.f;
+    return refractionDensity(mat, w_o, w_i) / lobes;
+}
+
+/*
+ * Bins sampled directions over equal solid angle cells of the upper hemisphere, or of the whole sphere
+ * for transmissive materials, and compares the counts against the sampling density integrated over
+ * each cell. Samples which fail land in a bin of their own, expected to hold whatever the density
+ * leaves of the unit total.
+ */
+static void checkSampling(const DisneyMaterial &mat, const float3 &w_o, uint32_t seed)
+{
+    bool transmissive = mat.specular_transmission > 0.f;
+    const uint32_t thetaBins = transmissive ? 32 : 16, phiBins = 32, subdivisions = 32;
+    const uint32_t numBins = thetaBins * phiBins;
+    const uint32_t numSamples = 1000000;
+    const float cosMin = transmissive ? -1.f : 0.f;
+
+    std::vector<double> expected(numBins + 1, 0.0), observed(numBins + 1, 0.0);
+    double total = 0.0;
+    for (uint32_t t = 0; t < thetaBins; ++t) {
+        for (uint32_t p = 0; p < phiBins; ++p) {
+            // Integrated over the polar angle rather than its cosine, to resolve the glossy peaks near the normal
+            double integral = 0.0;
+            float thetaMin = acosf(cosMin + (1.f - cosMin) * float(t + 1) / thetaBins);
+            float thetaMax = acosf(cosMin + (1.f - cosMin) * float(t) / thetaBins);
+            float dTheta = (thetaMax - thetaMin) / subdivisions, dPhi = 2.f * pi / (phiBins * subdivisions);
+            for (uint32_t i = 0; i < subdivisions; ++i) {
+                float theta = thetaMin + (i + .5f) * dTheta;
+                for (uint32_t j = 0; j < subdivisions; ++j) {
+                    float phi = 2.f * pi * (p + (j + .5f) / subdivisions) / phiBins;
+                    integral += samplingDensity(mat, w_o, direction(cosf(theta), phi)) * sinf(theta) * dTheta * dPhi;
+                }
+            }
+            expected[t * phiBins + p] = integral;
+            total += integral;
+        }
+    }
+    CHECK(total <= 1.02);
+    CHECK(total > .5);
+    expected[numBins] = std::max(0.0, 1.0 - total);
+    for (auto &e : expected) e *= numSamples;
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(0.f, .99999994f);
+    double weightSum = 0.0;
+    for (uint32_t s = 0; s < numSamples; ++s) {
+        float3 w_i, bsdf;
+        float pdf;
+        int lobe;
+        sample_disney_brdf(mat, uniform(rng), make_float2(uniform(rng), uniform(rng)),
+            normal, normal, normal, tangent, bitangent, w_o, w_i, pdf, lobe, bsdf);
+        // Refractions that leave on the side of w_o are not part of either density, and count as failures
+        bool refracted = lobe == DISNEY_TRANSMISSION_BRDF;
+        if (!(pdf > 0.f) || (refracted ? w_i.z >= 0.f : w_i.z <= 0.f)) { observed[numBins] += 1.0; continue; }
+        CHECK_NEAR(length(w_i), 1.f, 1e-3);
+        float cosTheta = std::max(cosMin, std::min(w_i.z, .99999994f));
+        float phi = atan2f(w_i.y, w_i.x);
+        if (phi < 0.f) phi += 2.f * pi;
+        uint32_t t = std::min(thetaBins - 1, uint32_t((cosTheta - cosMin) / (1.f - cosMin) * thetaBins));
+        uint32_t p = std::min(phiBins - 1, uint32_t(phi / (2.f * pi) * phiBins));
+        observed[t * phiBins + p] += 1.0;
+        weightSum += (bsdf.x + bsdf.y + bsdf.z) / 3.f / pdf;
+    }
+
+    int dof;
+    double statistic = chiSquare(observed, expected, dof);
+    CHECK(statistic < chiSquareCritical(dof));
+    if (!(statistic < chiSquareCritical(dof))) fprintf(stderr, "chi-square is %g over %d degrees of freedom\n", statistic, dof);
+
+    // The estimated albedo of a grey material, which should neither create nor lose most of the energy
+    double albedo = weightSum / numSamples;
+    CHECK(albedo < 1.05);
+    CHECK(albedo > .3);
+    if (!(albedo < 1.05 && albedo > .3)) fprintf(stderr, "albedo is %g\n", albedo);
+}
+
+static void testSampling()
+{
+    float3 normalIncidence = make_float3(0.f, 0.f, 1.f);
+    float3 oblique = normalize(make_float3(.6f, .2f, .5f));
+    checkSampling(makeMaterial(.5f, 0.f, 0.f, 0.f), normalIncidence, 1);
+    checkSampling(makeMaterial(.5f, 0.f, 0.f, 0.f), oblique, 2);
+    checkSampling(makeMaterial(.4f, 0.f, 0.f, 1.f), oblique, 3);
+    checkSampling(makeMaterial(.4f, 0.f, .6f, 0.f), oblique, 4);
+    checkSampling(makeMaterial(.3f, 1.f, 0.f, 0.f), oblique, 5);
+    checkSampling(makeMaterial(.5f, .5f, 0.f, 0.f), normalIncidence, 6);
+    checkSampling(makeMaterial(.5f, 0.f, 0.f, 0.f, 0.f, 1.f), oblique, 7);
+    checkSampling(makeMaterial(.5f, 0.f, 0.f, 0.f, 1.f), normalIncidence, 8);
+    checkSampling(makeMaterial(.5f, 0.f, 0.f, 0.f, .5f), normalize(make_float3(.2f, .1f, .9f)), 9);
+}
+
+/*
+ * The reflection lobes must give the same value with the two directions swapped. disney_brdf folds in the
+ * cosine of w_i, which is divided back out before comparing.
+ */
+static void testReciprocity()
+{
+    DisneyMaterial materials[] = {
+        makeMaterial(.5f, 0.f, 0.f, 0.f),
+        makeMaterial(.2f, 1.f, 0.f, 0.f),
+        makeMaterial(.4f, .5f, .6f, 0.f),
+        makeMaterial(.6f, 0.f, 0.f, 1.f),
+        makeMaterial(.5f, 0.f, 0.f, 0.f, 0.f, 1.f),
+        makeMaterial(.3f, .2f, 0.f, .5f, 0.f, .5f),
+    };
+    materials[0].flatness = .5f;
+
+    std::mt19937 rng(10);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    for (const auto &mat : materials) {
+        for (int i = 0; i < 1000; ++i) {
+            float3 a = direction(.05f + .95f * uniform(rng), 2.f * pi * uniform(rng));
+            float3 b = direction(.05f + .95f * uniform(rng), 2.f * pi * uniform(rng));
+            float3 forward = evaluateBsdf(mat, a, b) / b.z;
+            float3 backward = evaluateBsdf(mat, b, a) / a.z;
+            CHECK_NEAR(forward.x, backward.x, 1e-3f * std::max(1.f, forward.x));
+            CHECK_NEAR(forward.y, backward.y, 1e-3f * std::max(1.f, forward.y));
+            CHECK_NEAR(forward.z, backward.z, 1e-3f * std::max(1.f, forward.z));
+        }
+    }
+}
+
+static void testLambertian()
+{
+    // Cosine weighted sampling has a pdf of cos(theta) / pi
+    float3 w = cos_sample_hemisphere(make_float2(.3f, .7f));
+    CHECK_NEAR(length(w), 1.f, 1e-5);
+    CHECK(w.z > 0.f);
+    CHECK_NEAR(lambertian_pdf(w, normal), w.z / pi, 1e-5);
+    CHECK(lambertian_pdf(make_float3(0.f, 0.f, -1.f), normal) == 0.f);
+}
+
+int main()
+{
+    testLambertian();
+    testReciprocity();
+    testSampling();
+    return checkResult();
+}
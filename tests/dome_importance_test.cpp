@@ -0,0 +1,154 @@
+// Checks the dome light importance map on a synthetic lat/long image: the solid angle pdf must integrate
+// to one over the sphere, follow luminance times solid angle, and match how often directions are drawn
+// through the alias table, both at full resolution and for a downsampled map.
+
+#include <nvisii/utilities/dome_importance.h>
+#include <glm/glm.hpp>
+
+#include "check.h"
+
+#include <random>
+
+static const float pi = 3.14159265358979f;
+static const uint32_t imageWidth = 64, imageHeight = 32;
+
+/* A dim sky with a horizontal gradient and a small, very bright sun */
+static float luminance(uint32_t x, uint32_t y)
+{
+    if (x >= 40 && x < 44 && y >= 8 && y < 11) return 50.f;
+    return .1f + .05f * float(x % 16) + ((y > 20) ? .3f : 0.f);
+}
+
+/* The direction at texture coordinates uv of a lat/long map, with v = 0 at the +z pole */
+static glm::vec3 toDirection(glm::vec2 uv)
+{
+    float phi = 2.f * pi * uv.x, theta = pi * uv.y;
+    return glm::vec3(sinf(theta) * cosf(phi), sinf(theta) * sinf(phi), cosf(theta));
+}
+
+/* The solid angle pdf of the map at texture coordinates uv, as used when a BSDF sample reaches the dome */
+static float evaluatePdf(const DomeImportanceMap &map, glm::vec2 uv)
+{
+    uint32_t x = std::min(map.width - 1, uint32_t(uv.x * map.width));
+    uint32_t y = std::min(map.height - 1, uint32_t(uv.y * map.height));
+    return domeImportancePdf(map.table[y * map.width + x].pdf, uv.y, int(map.width), int(map.height));
+}
+
+/* The length of the overlap of two intervals */
+static double overlap(double a0, double a1, double b0, double b1) { return std::max(0.0, std::min(a1, b1) - std::max(a0, b0)); }
+
+static void checkMap(const DomeImportanceMap &map, uint32_t seed)
+{
+    // The pdf integrated over the sphere in solid angle, on a grid much finer than the map
+    const uint32_t thetaSteps = 1024, phiSteps = 2048;
+    double total = 0.0;
+    for (uint32_t t = 0; t < thetaSteps; ++t) {
+        float theta = pi * (t + .5f) / thetaSteps;
+        for (uint32_t p = 0; p < phiSteps; ++p) {
+            float phi = 2.f * pi * (p + .5f) / phiSteps;
+            total += evaluatePdf(map, glm::vec2(phi / (2.f * pi), theta / pi)) * sinf(theta) * (pi / thetaSteps) * (2.f * pi / phiSteps);
+        }
+    }
+    CHECK_NEAR(total, 1.0, 1e-3);
+
+    // Equal solid angle bins. The pdf times sin(theta) is constant over each texel, so the
+    // probability of a bin is that of each texel it overlaps times the fraction it covers.
+    const uint32_t thetaBins = 16, phiBins = 32;
+    std::vector<double> expected(thetaBins * phiBins, 0.0);
+    for (uint32_t t = 0; t < thetaBins; ++t) {
+        double v0 = acos(1.0 - 2.0 * t / thetaBins) / pi, v1 = acos(1.0 - 2.0 * (t + 1) / thetaBins) / pi;
+        for (uint32_t p = 0; p < phiBins; ++p) {
+            double u0 = double(p) / phiBins, u1 = double(p + 1) / phiBins;
+            for (uint32_t y = 0; y < map.height; ++y) {
+                double dv = overlap(v0, v1, double(y) / map.height, double(y + 1) / map.height) * map.height;
+                if (dv <= 0.0) continue;
+                for (uint32_t x = 0; x < map.width; ++x) {
+                    double du = overlap(u0, u1, double(x) / map.width, double(x + 1) / map.width) * map.width;
+                    expected[t * phiBins + p] += map.table[y * map.width + x].pdf * du * dv;
+                }
+            }
+        }
+    }
+
+    // Directions drawn through the alias table, jittered within their texel as the renderers do
+    const uint32_t numSamples = 500000;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(0.f, .99999994f);
+    std::vector<double> observed(expected.size(), 0.0);
+    for (uint32_t s = 0; s < numSamples; ++s) {
+        float texelPdf, rx;
+        uint32_t texel = sampleAliasTable(map.table.data(), uint32_t(map.table.size()), uniform(rng), texelPdf, rx);
+        glm::vec2 uv((texel % map.width + rx) / float(map.width), (texel / map.width + uniform(rng)) / float(map.height));
+        float pdf = domeImportancePdf(texelPdf, uv.y, int(map.width), int(map.height));
+        CHECK(pdf > 0.f);
+        CHECK_NEAR(pdf, evaluatePdf(map, uv), 1e-4 * pdf);
+
+        glm::vec3 w = toDirection(uv);
+        float phi = atan2f(w.y, w.x);
+        if (phi < 0.f) phi += 2.f * pi;
+        uint32_t t = std::min(thetaBins - 1, uint32_t((1.f - w.z) * .5f * thetaBins));
+        uint32_t p = std::min(phiBins - 1, uint32_t(phi / (2.f * pi) * phiBins));
+        observed[t * phiBins + p] += 1.0;
+    }
+    for (auto &e : expected) e *= numSamples;
+    int dof;
+    double statistic = chiSquare(observed, expected, dof);
+    CHECK(statistic < chiSquareCritical(dof));
+    if (!(statistic < chiSquareCritical(dof))) fprintf(stderr, "chi-square is %g over %d degrees of freedom\n", statistic, dof);
+}
+
+static void testFullResolution()
+{
+    DomeImportanceMap map = buildDomeImportanceMap(imageWidth, imageHeight, luminance);
+    CHECK(map.width == imageWidth && map.height == imageHeight);
+    CHECK(map.table.size() == imageWidth * imageHeight);
+
+    // Texels are weighted by luminance and by the solid angle of their row
+    auto texelPdf = [&] (uint32_t x, uint32_t y) { return map.table[y * map.width + x].pdf; };
+    CHECK_NEAR(texelPdf(41, 9) / texelPdf(20, 9), 50.f / luminance(20, 9), 1e-3);
+    float sin0 = sinf(pi * .5f / imageHeight), sin16 = sinf(pi * 16.5f / imageHeight);
+    CHECK_NEAR(texelPdf(3, 0) / texelPdf(3, 16), sin0 / sin16, 1e-4);
+
+    checkMap(map, 1);
+}
+
+static void testDownsampled()
+{
+    // Each cell of the map averages the 4 * 4 texels it covers
+    DomeImportanceMap map = buildDomeImportanceMap(imageWidth, imageHeight, luminance, 16);
+    CHECK(map.width == 16 && map.height == 8);
+    CHECK(map.table.size() == 16 * 8);
+    auto cellWeight = [&] (uint32_t cx, uint32_t cy) {
+        double sum = 0.0;
+        for (uint32_t y = cy * 4; y < cy * 4 + 4; ++y) for (uint32_t x = cx * 4; x < cx * 4 + 4; ++x) sum += luminance(x, y);
+        return sum / 16.0 * sin(pi * (cy + .5) / 8.0);
+    };
+    CHECK_NEAR(map.table[2 * 16 + 10].pdf / map.table[5 * 16 + 3].pdf, cellWeight(10, 2) / cellWeight(3, 5), 1e-3);
+
+    // No downsampling is needed for maps which are already small enough
+    CHECK(buildDomeImportanceMap(imageWidth, imageHeight, luminance, 128).width == imageWidth);
+
+    checkMap(map, 2);
+}
+
+static void testUniform()
+{
+    // A constant dome gives every direction about the same density, 1 / (4 pi), exactly so at texel centers
+    DomeImportanceMap map = buildDomeImportanceMap(imageWidth, imageHeight, [] (uint32_t, uint32_t) { return 1.f; });
+    for (float y : {8.f, 16.f, 22.f}) CHECK_NEAR(evaluatePdf(map, glm::vec2(.3f, (y + .5f) / imageHeight)), 1.f / (4.f * pi), 1e-3);
+
+    // Negative and nan texels are ignored rather than poisoning the table
+    DomeImportanceMap poisoned = buildDomeImportanceMap(4, 2, [] (uint32_t x, uint32_t) { return (x == 0) ? -1.f : (x == 1) ? NAN : 1.f; });
+    CHECK(poisoned.table[0].pdf == 0.f && poisoned.table[1].pdf == 0.f);
+    CHECK_NEAR(poisoned.table[2].pdf, .25f, 1e-6);
+
+    CHECK(buildDomeImportanceMap(0, 0, luminance).table.empty());
+}
+
+int main()
+{
+    testFullResolution();
+    testDownsampled();
+    testUniform();
+    return checkResult();
+}
@@ -0,0 +1,195 @@
+// Drives FramePipeline with a mock renderer: results must come back in the order frames were acquired,
+// no more frames than allowed may be in flight, readback slots must not be reused before their frame
+// finished, and errors must reach the future of the frame they belong to.
+
+#include <nvisii/utilities/frame_pipeline.h>
+
+#include "check.h"
+
+#include <atomic>
+#include <chrono>
+
+typedef FramePipeline<uint64_t> Pipeline;
+
+/* A readback which finishes when the test says so, returning the frame's id times ten */
+static Pipeline::Readback mockReadback(uint64_t id, std::shared_ptr<std::atomic<bool>> done)
+{
+    Pipeline::Readback readback;
+    readback.isDone = [done] () { return done->load(); };
+    readback.take = [id] () { return id * 10; };
+    return readback;
+}
+
+static void testOrdering()
+{
+    Pipeline pipeline(3);
+    std::vector<Pipeline::Frame> frames;
+    std::vector<std::shared_ptr<std::atomic<bool>>> done;
+    for (int i = 0; i < 3; ++i) {
+        frames.push_back(pipeline.acquire());
+        done.push_back(std::make_shared<std::atomic<bool>>(false));
+        pipeline.submit(frames.back().id, mockReadback(frames.back().id, done.back()));
+    }
+    CHECK(pipeline.getFramesInFlight() == 3);
+    CHECK(frames[0].slot != frames[1].slot && frames[1].slot != frames[2].slot && frames[0].slot != frames[2].slot);
+
+    // Later readbacks finishing first must wait for the earlier ones
+    *done[2] = true;
+    *done[1] = true;
+    CHECK(pipeline.poll() == 0);
+    CHECK(frames[1].future.wait_for(std::chrono::seconds(0)) != std::future_status::ready);
+    *done[0] = true;
+    CHECK(pipeline.poll() == 3);
+    for (auto &frame : frames) CHECK(frame.future.get() == frame.id * 10);
+    CHECK(pipeline.getFramesInFlight() == 0);
+}
+
+static void testLimitAndPump()
+{
+    // A single thread which finishes its own frames while waiting for a slot
+    Pipeline pipeline(2);
+    std::vector<std::shared_ptr<std::atomic<bool>>> done;
+    std::vector<Pipeline::Frame> frames;
+    uint32_t pumps = 0;
+    for (int i = 0; i < 6; ++i) {
+        frames.push_back(pipeline.acquire([&] () {
+            pumps++;
+            // Readbacks finish some time after they were submitted
+            if (pumps % 3 == 0) for (auto &d : done) *d = true;
+            pipeline.poll();
+        }));
+        CHECK(pipeline.getFramesInFlight() <= 2);
+        CHECK(frames.back().slot < 2);
+        done.push_back(std::make_shared<std::atomic<bool>>(false));
+        pipeline.submit(frames.back().id, mockReadback(frames.back().id, done.back()));
+    }
+    CHECK(pumps > 0);
+    for (auto &d : done) *d = true;
+    pipeline.flush();
+    for (auto &frame : frames) CHECK(frame.future.get() == frame.id * 10);
+
+    bool threw = false;
+    try { pipeline.setMaxFramesInFlight(0); } catch (std::runtime_error &) { threw = true; }
+    CHECK(threw);
+    pipeline.setMaxFramesInFlight(4);
+    CHECK(pipeline.getMaxFramesInFlight() == 4);
+}
+
+static void testErrors()
+{
+    Pipeline pipeline(4);
+    auto done = std::make_shared<std::atomic<bool>>(true);
+
+    // A failed frame rethrows its error, and the frames after it still finish
+    Pipeline::Frame failed = pipeline.acquire();
+    Pipeline::Frame next = pipeline.acquire();
+    pipeline.fail(failed.id, std::make_exception_ptr(std::runtime_error("render failed")));
+    pipeline.submit(next.id, mockReadback(next.id, done));
+    CHECK(pipeline.poll() == 2);
+    bool threw = false;
+    try { failed.future.get(); } catch (std::runtime_error &) { threw = true; }
+    CHECK(threw);
+    CHECK(next.future.get() == next.id * 10);
+
+    // A readback which throws passes its exception on
+    Pipeline::Frame throwing = pipeline.acquire();
+    Pipeline::Readback readback;
+    readback.isDone = [] () { return true; };
+    readback.take = [] () -> uint64_t { throw std::runtime_error("readback failed"); };
+    pipeline.submit(throwing.id, readback);
+    pipeline.poll();
+    threw = false;
+    try { throwing.future.get(); } catch (std::runtime_error &) { threw = true; }
+    CHECK(threw);
+
+    // Frames which were never submitted fail when the renderer goes away, submitted ones still finish
+    Pipeline::Frame submitted = pipeline.acquire();
+    Pipeline::Frame pending = pipeline.acquire();
+    pipeline.submit(submitted.id, mockReadback(submitted.id, done));
+    pipeline.failAll(std::make_exception_ptr(std::runtime_error("deinitialized")));
+    CHECK(submitted.future.get() == submitted.id * 10);
+    threw = false;
+    try { pending.future.get(); } catch (std::runtime_error &) { threw = true; }
+    CHECK(threw);
+    CHECK(pipeline.getFramesInFlight() == 0);
+
+    threw = false;
+    try { pipeline.submit(12345, mockReadback(12345, done)); } catch (std::runtime_error &) { threw = true; }
+    CHECK(threw);
+}
+
+static void testRenderThread()
+{
+    // A mock render thread renders and reads back frames in the background, finishing them as they complete
+    const uint32_t maxInFlight = 3, numFrames = 200;
+    Pipeline pipeline(maxInFlight);
+    std::mutex queueMutex;
+    std::condition_variable queued;
+    std::deque<Pipeline::Frame> queue;
+    std::atomic<uint32_t> maxSeenInFlight(0);
+    bool stop = false;
+
+    std::thread renderer([&] () {
+        std::vector<std::shared_ptr<std::atomic<bool>>> readbacks;
+        uint32_t tick = 0;
+        while (true) {
+            Pipeline::Frame frame;
+            bool haveFrame = false;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queued.wait_for(lock, std::chrono::microseconds(50), [&] () { return stop || !queue.empty(); });
+                if (!queue.empty()) { frame = queue.front(); queue.pop_front(); haveFrame = true; }
+                else if (stop && pipeline.getFramesInFlight() == 0) break;
+            }
+            if (haveFrame) {
+                auto done = std::make_shared<std::atomic<bool>>(false);
+                readbacks.push_back(done);
+                pipeline.submit(frame.id, mockReadback(frame.id, done));
+            }
+            // Readbacks complete a few ticks later, sometimes out of order
+            tick++;
+            for (size_t i = 0; i < readbacks.size(); ++i) if ((tick + i) % 3 == 0) *readbacks[i] = true;
+            if (tick % 7 == 0) for (auto &d : readbacks) *d = true;
+            pipeline.poll();
+        }
+    });
+
+    std::vector<Pipeline::Frame> frames;
+    std::vector<int64_t> slotOwners(maxInFlight, -1);
+    for (uint32_t i = 0; i < numFrames; ++i) {
+        Pipeline::Frame frame = pipeline.acquire();
+        uint32_t inFlight = pipeline.getFramesInFlight();
+        if (inFlight > maxSeenInFlight) maxSeenInFlight = inFlight;
+        CHECK(frame.slot < maxInFlight);
+        if (frame.slot >= maxInFlight) continue;
+        // The frame which had this slot before must have finished
+        if (slotOwners[frame.slot] >= 0) {
+            CHECK(frames[slotOwners[frame.slot]].future.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+        }
+        slotOwners[frame.slot] = int64_t(frames.size());
+        frames.push_back(frame);
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(frame);
+        }
+        queued.notify_one();
+    }
+    for (auto &frame : frames) CHECK(frame.future.get() == frame.id * 10);
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stop = true;
+    }
+    queued.notify_one();
+    renderer.join();
+    CHECK(maxSeenInFlight <= maxInFlight);
+    CHECK(frames.size() == numFrames);
+}
+
+int main()
+{
+    testOrdering();
+    testLimitAndPump();
+    testErrors();
+    testRenderThread();
+    return checkResult();
+}
@@ -0,0 +1,145 @@
+// Checks power and area weighted light selection: alias tables must pick each bin as often as its
+// pdf says, and the pdfs selectLight reports must match selectLightPdf and the dome's share.
+
+#include <nvisii/utilities/light_sampling.h>
+
+#include "check.h"
+
+#include <random>
+
+/* Draws from an alias table and compares how often each bin is picked against its weight */
+static void checkAliasTableFrequencies(const std::vector<float> &weights, std::mt19937 &rng)
+{
+    std::vector<AliasTableEntry> table = buildAliasTable(weights);
+    double sum = 0.0;
+    for (float w : weights) sum += w;
+
+    double pdfSum = 0.0;
+    for (size_t i = 0; i < weights.size(); ++i) {
+        CHECK_NEAR(table[i].pdf, weights[i] / sum, 1e-6);
+        CHECK(table[i].threshold >= 0.f && table[i].threshold <= 1.f);
+        CHECK(table[i].alias < weights.size());
+        pdfSum += table[i].pdf;
+    }
+    CHECK_NEAR(pdfSum, 1.0, 1e-5);
+
+    const uint32_t numSamples = 500000;
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    std::vector<double> observed(weights.size(), 0.0), expected(weights.size(), 0.0);
+    for (uint32_t s = 0; s < numSamples; ++s) {
+        float pdf, remapped;
+        uint32_t bin = sampleAliasTable(table.data(), uint32_t(table.size()), std::min(uniform(rng), 0.99999994f), pdf, remapped);
+        CHECK(bin < weights.size());
+        if (bin >= weights.size()) continue;
+        CHECK(weights[bin] > 0.f);
+        CHECK(pdf == table[bin].pdf);
+        CHECK(remapped >= 0.f && remapped < 1.f);
+        observed[bin] += 1.0;
+    }
+    for (size_t i = 0; i < weights.size(); ++i) expected[i] = weights[i] / sum * numSamples;
+    int dof;
+    double statistic = chiSquare(observed, expected, dof);
+    CHECK(statistic < chiSquareCritical(dof));
+}
+
+static void testAliasTable()
+{
+    std::mt19937 rng(3);
+    checkAliasTableFrequencies({1.f, 2.f, 3.f, 4.f}, rng);
+    // Very uneven weights, with bins that must never be picked
+    checkAliasTableFrequencies({1000.f, 0.f, 1.f, .01f, 0.f, 50.f, 7.f, 7.f}, rng);
+
+    std::uniform_real_distribution<float> weight(0.f, 1.f);
+    std::vector<float> weights(257);
+    for (auto &w : weights) w = weight(rng) * weight(rng);
+    checkAliasTableFrequencies(weights, rng);
+
+    // Without any weight, every bin is equally likely
+    std::vector<AliasTableEntry> uniformTable = buildAliasTable(std::vector<float>(5, 0.f));
+    for (auto &entry : uniformTable) CHECK_NEAR(entry.pdf, .2f, 1e-6);
+}
+
+static void testSelectLight()
+{
+    std::vector<float> powers = {4.f, 1.f, 0.f, 3.f};
+    std::vector<AliasTableEntry> table = buildAliasTable(powers);
+    const uint32_t numLights = uint32_t(powers.size());
+
+    for (bool domeEnabled : {false, true}) {
+        double pdfSum = 0.0;
+        for (uint32_t i = 0; i <= numLights; ++i) pdfSum += selectLightPdf(table.data(), numLights, domeEnabled, i);
+        CHECK_NEAR(pdfSum, 1.0, 1e-5);
+        CHECK_NEAR(selectLightPdf(table.data(), numLights, domeEnabled, numLights), domeEnabled ? .2f : 0.f, 1e-6);
+
+        std::mt19937 rng(domeEnabled ? 11 : 5);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        const uint32_t numSamples = 200000;
+        std::vector<double> observed(numLights + 1, 0.0), expected(numLights + 1, 0.0);
+        for (uint32_t s = 0; s < numSamples; ++s) {
+            float pdf;
+            uint32_t light = selectLight(table.data(), numLights, domeEnabled, std::min(uniform(rng), 0.99999994f), pdf);
+            CHECK(light <= numLights);
+            if (light > numLights) continue;
+            CHECK_NEAR(pdf, selectLightPdf(table.data(), numLights, domeEnabled, light), 1e-6);
+            observed[light] += 1.0;
+        }
+        for (uint32_t i = 0; i <= numLights; ++i) expected[i] = selectLightPdf(table.data(), numLights, domeEnabled, i) * numSamples;
+        int dof;
+        double statistic = chiSquare(observed, expected, dof);
+        CHECK(statistic < chiSquareCritical(dof));
+    }
+
+    // Only the dome can be picked without area lights
+    float pdf;
+    CHECK(selectLight(nullptr, 0, true, .5f, pdf) == 0);
+    CHECK_NEAR(pdf, 1.f, 1e-6);
+}
+
+static void testTriangles()
+{
+    // A unit right triangle, and one four times its size
+    std::vector<std::array<float, 3>> vertices = {
+        {{0.f, 0.f, 0.f}}, {{1.f, 0.f, 0.f}}, {{0.f, 1.f, 0.f}},
+        {{0.f, 0.f, 1.f}}, {{2.f, 0.f, 1.f}}, {{0.f, 2.f, 1.f}},
+    };
+    std::vector<uint32_t> indices = {0, 1, 2, 3, 4, 5};
+    std::vector<float> areas = computeTriangleAreas(vertices, indices);
+    CHECK(areas.size() == 2);
+    CHECK_NEAR(areas[0], .5f, 1e-6);
+    CHECK_NEAR(areas[1], 2.f, 1e-6);
+
+    std::vector<AliasTableEntry> table = buildAliasTable(areas);
+    float pdf;
+    selectTriangle(table.data(), 2, true, .9f, pdf);
+    CHECK(pdf == .2f || pdf == .8f);
+    selectTriangle(table.data(), 2, false, .9f, pdf);
+    CHECK_NEAR(pdf, .5f, 1e-6);
+
+    // Facing +z everywhere, so the normal cone is a single direction
+    std::vector<glm::vec4> normals(vertices.size(), glm::vec4(0.f, 0.f, 1.f, 0.f));
+    glm::vec4 cone = computeNormalCone(vertices, normals, indices);
+    CHECK_NEAR(cone.z, 1.f, 1e-5);
+    CHECK_NEAR(cone.w, 1.f, 1e-5);
+}
+
+static void testLightPower()
+{
+    LightStruct light;
+    light.r = light.g = light.b = 1.f;
+    light.intensity = 2.f;
+    light.exposure = 1.f;
+    CHECK_NEAR(estimateLightPower(light, 10.f), 4.f, 1e-5);
+    light.use_surface_area = true;
+    CHECK_NEAR(estimateLightPower(light, 10.f), 40.f, 1e-4);
+    light.intensity = -1.f;
+    CHECK(estimateLightPower(light, 10.f) == 0.f);
+}
+
+int main()
+{
+    testAliasTable();
+    testSelectLight();
+    testTriangles();
+    testLightPower();
+    return checkResult();
+}
@@ -0,0 +1,123 @@
+// Checks the light tree against the pdfs it reports: the pdf sampleLightTree returns for an emitter
+// must match lightTreePdf for that emitter's trail, and emitters must be picked as often as their
+// pdfs say, both after a build and after a refit.
+
+#include <nvisii/utilities/light_tree.h>
+
+#include "check.h"
+
+#include <random>
+
+static std::vector<LightTreeEmitter> makeEmitters(uint32_t count, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> position(-10.f, 10.f), size(.01f, .5f), unit(-1.f, 1.f), power(.1f, 10.f);
+    std::vector<LightTreeEmitter> emitters(count);
+    for (auto &e : emitters) {
+        glm::vec3 center(position(rng), position(rng), position(rng));
+        e.bbmin = center - glm::vec3(size(rng));
+        e.bbmax = center + glm::vec3(size(rng));
+        glm::vec3 axis(unit(rng), unit(rng), unit(rng));
+        e.axis = (glm::dot(axis, axis) > 1e-6f) ? glm::normalize(axis) : glm::vec3(0.f, 0.f, 1.f);
+        e.cosThetaO = 1.f;
+        e.cosThetaE = 0.f;
+        e.power = power(rng);
+    }
+    // One emitter with no power, which must never be picked
+    emitters[count / 2].power = 0.f;
+    return emitters;
+}
+
+/* Compares the pdfs the tree reports at p against how often sampleLightTreeReference picks each emitter */
+static void checkSelection(const LightTree &tree, const std::vector<LightTreeEmitter> &emitters, glm::vec3 p, glm::vec3 n, std::mt19937 &rng)
+{
+    const uint32_t numNodes = uint32_t(tree.nodes.size());
+    std::vector<double> pdfs(emitters.size() + 1, 0.0);
+    double total = 0.0;
+    for (uint32_t i = 0; i < emitters.size(); ++i) {
+        if (tree.leaves[i] == LIGHT_TREE_INVALID_EMITTER) continue;
+        pdfs[i] = lightTreePdf(tree.nodes.data(), numNodes, tree.trails[i], p, n);
+        CHECK(pdfs[i] >= 0.0 && pdfs[i] <= 1.0);
+        total += pdfs[i];
+    }
+    CHECK(total <= 1.0 + 1e-4);
+    // The last bin counts the samples where no emitter could light p
+    pdfs.back() = std::max(0.0, 1.0 - total);
+
+    const uint32_t numSamples = 200000;
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    std::vector<double> observed(pdfs.size(), 0.0), expected(pdfs.size(), 0.0);
+    for (uint32_t s = 0; s < numSamples; ++s) {
+        float pdf;
+        uint32_t emitter = sampleLightTreeReference(tree, p, n, std::min(uniform(rng), 0.99999994f), pdf);
+        if (emitter == LIGHT_TREE_INVALID_EMITTER) {
+            CHECK(pdf == 0.f);
+            observed.back() += 1.0;
+            continue;
+        }
+        CHECK(emitter < emitters.size() && emitters[emitter].power > 0.f);
+        if (emitter >= emitters.size()) continue;
+        CHECK_NEAR(pdf, pdfs[emitter], 1e-4 * pdfs[emitter] + 1e-7);
+        observed[emitter] += 1.0;
+    }
+    for (size_t i = 0; i < pdfs.size(); ++i) expected[i] = pdfs[i] * numSamples;
+    int dof;
+    double statistic = chiSquare(observed, expected, dof);
+    CHECK(statistic < chiSquareCritical(dof));
+}
+
+static void testSelection()
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(-12.f, 12.f);
+    std::vector<LightTreeEmitter> emitters = makeEmitters(64, rng);
+    LightTree tree;
+    tree.build(emitters);
+    CHECK(tree.nodes.size() == 2 * (emitters.size() - 1) - 1);
+    CHECK(tree.leaves[emitters.size() / 2] == LIGHT_TREE_INVALID_EMITTER);
+
+    for (int i = 0; i < 4; ++i) {
+        glm::vec3 p(position(rng), position(rng), position(rng));
+        checkSelection(tree, emitters, p, glm::vec3(0.f), rng);
+        checkSelection(tree, emitters, p, glm::vec3(0.f, 0.f, 1.f), rng);
+    }
+
+    // Move the emitters, keeping the topology
+    for (auto &e : emitters) {
+        e.bbmin += glm::vec3(1.f, -2.f, .5f);
+        e.bbmax += glm::vec3(1.f, -2.f, .5f);
+        e.power *= 2.f;
+    }
+    tree.refit(emitters);
+    checkSelection(tree, emitters, glm::vec3(0.f), glm::vec3(0.f), rng);
+}
+
+static void testImportanceWithinBounds()
+{
+    // Within the bounds, the distance is clamped to the radius of the bounds
+    LightTreeNode node;
+    node.bbmin = glm::vec3(-.5f);
+    node.bbmax = glm::vec3(.5f);
+    node.power = 3.f;
+    node.cosThetaO = -1.f;
+    node.cosThetaE = 0.f;
+    float importance = lightTreeImportance(node, glm::vec3(0.f), glm::vec3(0.f));
+    CHECK_NEAR(importance, 3.f / .75f, 1e-4);
+
+    // Far away, it falls off with the squared distance
+    float nearImportance = lightTreeImportance(node, glm::vec3(10.f, 0.f, 0.f), glm::vec3(0.f));
+    float farImportance = lightTreeImportance(node, glm::vec3(20.f, 0.f, 0.f), glm::vec3(0.f));
+    CHECK(nearImportance > 0.f);
+    CHECK_NEAR(farImportance / nearImportance, .25f, 1e-3);
+
+    // One sided emitters facing away from a point cannot light it
+    node.cosThetaO = 1.f;
+    node.axis = glm::vec3(1.f, 0.f, 0.f);
+    CHECK(lightTreeImportance(node, glm::vec3(-10.f, 0.f, 0.f), glm::vec3(0.f)) == 0.f);
+}
+
+int main()
+{
+    testSelection();
+    testImportanceWithinBounds();
+    return checkResult();
+}
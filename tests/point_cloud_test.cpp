@@ -0,0 +1,144 @@
+// Checks the point cloud sphere intersection against known hits, including rays which start inside a
+// sphere and small spheres far from the origin, and checks that BVH traversal over a random point cloud
+// finds the same closest hits as testing every sphere.
+
+#include <nvisii/utilities/point_cloud.h>
+
+#include "check.h"
+
+#include <random>
+
+static void testIntersectSphere()
+{
+    glm::vec3 center(0.f), origin(0.f, 0.f, -5.f);
+    float t;
+
+    // Directions need not be normalized
+    CHECK(intersectSphere(origin, glm::vec3(0.f, 0.f, 2.f), center, 1.f, 0.f, 1e30f, t));
+    CHECK_NEAR(t, 2.f, 1e-5);
+    CHECK(intersectSphere(origin, glm::vec3(0.f, 0.f, 1.f), center, 1.f, 0.f, 1e30f, t));
+    CHECK_NEAR(t, 4.f, 1e-5);
+
+    // A ray starting inside the sphere hits its far side
+    CHECK(intersectSphere(glm::vec3(0.f), glm::vec3(1.f, 0.f, 0.f), center, 1.f, 0.f, 1e30f, t));
+    CHECK_NEAR(t, 1.f, 1e-5);
+
+    // Misses, and hits outside of the ray interval
+    CHECK(!intersectSphere(origin, glm::vec3(0.f, 1.f, 0.f), center, 1.f, 0.f, 1e30f, t));
+    CHECK(!intersectSphere(glm::vec3(2.f, 0.f, -5.f), glm::vec3(0.f, 0.f, 1.f), center, 1.f, 0.f, 1e30f, t));
+    CHECK(!intersectSphere(origin, glm::vec3(0.f, 0.f, 1.f), center, 1.f, 0.f, 3.f, t));
+    CHECK(!intersectSphere(origin, glm::vec3(0.f, 0.f, -1.f), center, 1.f, 0.f, 1e30f, t));
+    CHECK(intersectSphere(origin, glm::vec3(0.f, 0.f, 1.f), center, 1.f, 5.f, 1e30f, t));
+    CHECK_NEAR(t, 6.f, 1e-5);
+
+    // A small sphere far from the ray origin is still hit, at the right distance
+    glm::vec3 far(0.f, 0.f, 10000.f);
+    CHECK(intersectSphere(glm::vec3(.0005f, 0.f, 0.f), glm::vec3(0.f, 0.f, 1.f), far, .001f, 0.f, 1e30f, t));
+    CHECK_NEAR(t, 10000.f - sqrtf(.001f * .001f - .0005f * .0005f), 1e-2);
+    CHECK(!intersectSphere(glm::vec3(.0015f, 0.f, 0.f), glm::vec3(0.f, 0.f, 1.f), far, .001f, 0.f, 1e30f, t));
+}
+
+static void testSphereFrames()
+{
+    glm::vec2 uv = sphereUV(glm::vec3(1.f, 0.f, 0.f));
+    CHECK_NEAR(uv.x, .5f, 1e-6);
+    CHECK_NEAR(uv.y, .5f, 1e-6);
+    uv = sphereUV(glm::vec3(0.f, 1.f, 0.f));
+    CHECK_NEAR(uv.x, .75f, 1e-6);
+    CHECK_NEAR(sphereUV(glm::vec3(0.f, 0.f, 1.f)).y, 0.f, 1e-6);
+    CHECK_NEAR(sphereUV(glm::vec3(0.f, 0.f, -1.f)).y, 1.f, 1e-6);
+
+    // The tangent follows increasing u, and stays a unit vector at the poles
+    glm::vec3 n = glm::normalize(glm::vec3(.3f, .4f, .5f));
+    glm::vec3 tangent = sphereTangent(n);
+    CHECK_NEAR(glm::length(tangent), 1.f, 1e-5);
+    CHECK_NEAR(glm::dot(tangent, n), 0.f, 1e-5);
+    glm::vec3 nearby = glm::normalize(n + 1e-3f * tangent);
+    CHECK(sphereUV(nearby).x > sphereUV(n).x);
+    CHECK(sphereTangent(glm::vec3(0.f, 0.f, 1.f)) == glm::vec3(1.f, 0.f, 0.f));
+    CHECK(sphereTangent(glm::vec3(0.f, 0.f, -1.f)) == glm::vec3(1.f, 0.f, 0.f));
+
+    auto points = packPoints({{{1.f, 2.f, 3.f}}, {{4.f, 5.f, 6.f}}}, {.5f, .25f});
+    CHECK(points.size() == 2);
+    CHECK(points[1] == glm::vec4(4.f, 5.f, 6.f, .25f));
+}
+
+/* The closest sphere hit by testing every sphere, or -1 */
+static int bruteForce(const std::vector<glm::vec4> &points, glm::vec3 origin, glm::vec3 direction, float &tmax)
+{
+    int closest = -1;
+    for (size_t i = 0; i < points.size(); ++i) {
+        float t;
+        if (!intersectSphere(origin, direction, glm::vec3(points[i]), points[i].w, 0.f, tmax, t)) continue;
+        tmax = t;
+        closest = int(i);
+    }
+    return closest;
+}
+
+static void testBVH()
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+    std::vector<std::array<float, 3>> positions(2000);
+    std::vector<float> radii(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i) {
+        positions[i] = {{10.f * uniform(rng), 10.f * uniform(rng), 10.f * uniform(rng)}};
+        radii[i] = .05f + .2f * (uniform(rng) + 1.f);
+    }
+    auto points = packPoints(positions, radii);
+    BVH bvh;
+    buildPointCloudBVH(points, bvh);
+    CHECK(bvh.getMinAabbCorner().x >= -10.5f && bvh.getMaxAabbCorner().x <= 10.5f);
+
+    uint32_t hits = 0, mismatches = 0, anyHitMismatches = 0;
+    for (int r = 0; r < 2000; ++r) {
+        glm::vec3 origin(12.f * uniform(rng), 12.f * uniform(rng), 12.f * uniform(rng));
+        glm::vec3 direction(uniform(rng), uniform(rng), uniform(rng));
+        if (glm::length(direction) < 1e-3f) continue;
+
+        float expectedT = 1e30f;
+        int expected = bruteForce(points, origin, direction, expectedT);
+
+        float tmax = 1e30f;
+        int found = -1;
+        bool hit = bvh.traverse(origin, direction, 0.f, tmax, [&] (uint32_t point, float tmin, float &tmax) {
+            float t;
+            const glm::vec4 &p = points[point];
+            if (!intersectSphere(origin, direction, glm::vec3(p), p.w, tmin, tmax, t)) return false;
+            tmax = t;
+            found = int(point);
+            return true;
+        });
+        if (hit != (expected >= 0) || found != expected || (hit && fabsf(tmax - expectedT) > 1e-4f)) mismatches++;
+        if (hit) hits++;
+
+        // Any hit traversal, as used for shadow rays, agrees on whether there is a hit at all
+        float anyTmax = 1e30f;
+        bool anyHit = bvh.traverse(origin, direction, 0.f, anyTmax, [&] (uint32_t point, float tmin, float &tmax) {
+            float t;
+            const glm::vec4 &p = points[point];
+            if (!intersectSphere(origin, direction, glm::vec3(p), p.w, tmin, tmax, t)) return false;
+            tmax = t;
+            return true;
+        }, true);
+        if (anyHit != hit) anyHitMismatches++;
+    }
+    CHECK(mismatches == 0);
+    CHECK(anyHitMismatches == 0);
+    CHECK(hits > 100);
+
+    // An empty point cloud is never hit
+    BVH empty;
+    buildPointCloudBVH({}, empty);
+    float tmax = 1e30f;
+    CHECK(!empty.traverse(glm::vec3(0.f), glm::vec3(1.f, 0.f, 0.f), 0.f, tmax, [] (uint32_t, float, float &) { return true; }));
+}
+
+int main()
+{
+    testIntersectSphere();
+    testSphereFrames();
+    testBVH();
+    return checkResult();
+}
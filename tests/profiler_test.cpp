@@ -0,0 +1,114 @@
+// Checks the frame profiler's plumbing: timings and counters of stages which run several times a frame
+// accumulate, frames are numbered and timed as they end, and only the most recent frames are kept,
+// oldest first.
+
+#include <nvisii/utilities/profiler.h>
+
+#include "check.h"
+
+#include <thread>
+
+static void testAccumulation()
+{
+    FrameProfiler profiler;
+    profiler.addTime("launch", 1.5);
+    profiler.addTime("launch", 2.5);
+    profiler.addTime("denoise", 3.0);
+    profiler.addCount("samples");
+    profiler.addCount("samples", 4.0);
+    profiler.setValue("entities", 7.0);
+    profiler.setValue("entities", 9.0);
+    profiler.endFrame();
+
+    auto frames = profiler.getFrames(1);
+    CHECK(frames.size() == 1);
+    CHECK_NEAR(frames[0]["launch_ms"], 4.0, 1e-12);
+    CHECK_NEAR(frames[0]["denoise_ms"], 3.0, 1e-12);
+    CHECK_NEAR(frames[0]["samples"], 5.0, 1e-12);
+    CHECK_NEAR(frames[0]["entities"], 9.0, 1e-12);
+
+    // Stages start from zero again in the next frame
+    profiler.addTime("launch", 1.0);
+    profiler.endFrame();
+    frames = profiler.getFrames(1);
+    CHECK_NEAR(frames[0]["launch_ms"], 1.0, 1e-12);
+    CHECK(frames[0].count("samples") == 0);
+
+    // Counters added from many threads at once are all kept
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) threads.emplace_back([&] () { for (int i = 0; i < 1000; ++i) profiler.addCount("updates"); });
+    for (auto &thread : threads) thread.join();
+    profiler.endFrame();
+    CHECK_NEAR(profiler.getFrames(1)[0]["updates"], 4000.0, 1e-12);
+}
+
+static void testNumbering()
+{
+    FrameProfiler profiler;
+
+    // Frames without beginFrame have no frame time
+    profiler.endFrame();
+    CHECK(profiler.getFrames(1)[0].count("frame_ms") == 0);
+
+    profiler.beginFrame();
+    {
+        ScopedTimer timer(profiler, "update");
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    profiler.endFrame();
+    auto frame = profiler.getFrames(1)[0];
+    CHECK(frame["frame"] == 1.0);
+    CHECK(frame["update_ms"] >= 2.0);
+    CHECK(frame["frame_ms"] >= frame["update_ms"]);
+
+    // clear restarts the numbering, and drops the frame in progress
+    profiler.addCount("stale");
+    profiler.clear();
+    CHECK(profiler.getFrames(10).empty());
+    profiler.endFrame();
+    frame = profiler.getFrames(1)[0];
+    CHECK(frame["frame"] == 0.0);
+    CHECK(frame.count("stale") == 0);
+}
+
+static void testHistory()
+{
+    FrameProfiler profiler;
+    CHECK(profiler.getHistorySize() == 120);
+    profiler.setHistorySize(5);
+    for (int i = 0; i < 12; ++i) {
+        profiler.addCount("index", double(i));
+        profiler.endFrame();
+    }
+
+    // Only the most recent frames are kept, and returned oldest first
+    auto frames = profiler.getFrames(100);
+    CHECK(frames.size() == 5);
+    for (size_t i = 0; i < frames.size(); ++i) {
+        CHECK(frames[i]["frame"] == double(7 + i));
+        CHECK(frames[i]["index"] == double(7 + i));
+    }
+    frames = profiler.getFrames(2);
+    CHECK(frames.size() == 2);
+    CHECK(frames[0]["frame"] == 10.0);
+    CHECK(frames[1]["frame"] == 11.0);
+    CHECK(profiler.getFrames(0).empty());
+
+    // Shrinking the history discards the oldest frames right away
+    profiler.setHistorySize(3);
+    frames = profiler.getFrames(100);
+    CHECK(frames.size() == 3);
+    CHECK(frames[0]["frame"] == 9.0);
+    profiler.setHistorySize(0);
+    CHECK(profiler.getFrames(100).empty());
+    profiler.endFrame();
+    CHECK(profiler.getFrames(100).empty());
+}
+
+int main()
+{
+    testAccumulation();
+    testNumbering();
+    testHistory();
+    return checkResult();
+}
@@ -0,0 +1,149 @@
+// Checks that randomize draws the same transforms, materials and lights for a given seed and frame, bit for
+// bit, whatever the number of threads and whatever was randomized before, and that other frames and other
+// seeds draw other values.
+
+#include "components.h"
+#include "randomizer.h"
+
+#include <nvisii/utilities/thread_pool.h>
+
+#include "check.h"
+
+#include <cstring>
+
+using namespace nvisii;
+
+static const uint32_t numObjects = 200;
+
+/* Objects with their own transforms and materials, a few pairs sharing a material, a parented transform, and some lights */
+static void createScene()
+{
+    Mesh* triangle = Mesh::createFromData("triangle", {0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f, 0.f});
+    Material* shared = Material::create("shared");
+    for (uint32_t i = 0; i < numObjects; ++i) {
+        std::string name = "obj_" + std::to_string(i);
+        Material* material = (i % 50 < 2) ? shared : Material::create(name);
+        Light* light = (i % 10 == 0) ? Light::create(name) : nullptr;
+        Entity::create(name, Transform::create(name), material, triangle, light);
+    }
+    Transform::get("obj_1")->setParent(Transform::get("obj_0"));
+}
+
+static void addRandomizers()
+{
+    addRandomizer("position", {"obj_*"}, "uniform", {-1.f, -2.f, -3.f, 1.f, 2.f, 3.f});
+    addRandomizer("rotation", {"obj_*"}, "uniform");
+    addRandomizer("scale", {"obj_*"}, "normal", {1.f, .1f});
+    addRandomizer("base_color", {"obj_*"}, "uniform_hsv", {0.f, .5f, .5f, 1.f, 1.f, 1.f});
+    addRandomizer("roughness", {"obj_*"}, "uniform", {0.f, 1.f});
+    addRandomizer("metallic", {"obj_*"}, "choice", {0.f, .5f, 1.f});
+    addRandomizer("light_intensity", {"obj_*"}, "uniform", {1.f, 10.f});
+    addRandomizer("light_color", {"obj_*"}, "uniform", {0.f, 1.f});
+}
+
+/* Every randomized value, in a fixed order, to be compared bit for bit */
+static std::vector<float> capture()
+{
+    std::vector<float> values;
+    auto append = [&values] (const float* v, size_t count) { values.insert(values.end(), v, v + count); };
+    for (uint32_t i = 0; i < numObjects; ++i) {
+        Entity* entity = Entity::get("obj_" + std::to_string(i));
+        Transform* transform = entity->getTransform();
+        glm::vec3 position = transform->getPosition(), scale = transform->getScale();
+        glm::quat rotation = transform->getRotation();
+        glm::mat4 localToWorld = transform->getLocalToWorldMatrix();
+        append(&position.x, 3);
+        append(&scale.x, 3);
+        append(&rotation.x, 4);
+        append(&localToWorld[0][0], 16);
+
+        Material* material = entity->getMaterial();
+        glm::vec3 color = material->getBaseColor();
+        append(&color.x, 3);
+        values.push_back(material->getRoughness());
+        values.push_back(material->getMetallic());
+
+        if (Light* light = entity->getLight()) {
+            glm::vec3 lightColor = light->getColor();
+            append(&lightColor.x, 3);
+            values.push_back(light->getIntensity());
+        }
+    }
+    return values;
+}
+
+static bool identical(const std::vector<float> &a, const std::vector<float> &b)
+{
+    return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+/* @returns the number of values which differ between a and b */
+static size_t countDifferences(const std::vector<float> &a, const std::vector<float> &b)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < std::min(a.size(), b.size()); ++i) count += (memcmp(&a[i], &b[i], sizeof(float)) != 0);
+    return count;
+}
+
+static void testDeterminism()
+{
+    clearComponents();
+    createScene();
+    addRandomizers();
+    setRandomizerSeed(7);
+
+    // setThreadCount resizes the global pool, which is what randomize draws and updates on
+    ThreadPool::global().resize(1);
+    randomize(3);
+    std::vector<float> single = capture();
+
+    ThreadPool::global().resize(4);
+    randomize(3);
+    CHECK(identical(capture(), single));
+
+    // A frame does not depend on the frames randomized before it
+    randomize(4);
+    std::vector<float> nextFrame = capture();
+    CHECK(nextFrame.size() == single.size());
+    CHECK(countDifferences(nextFrame, single) > single.size() / 2);
+    randomize(3);
+    CHECK(identical(capture(), single));
+
+    ThreadPool::global().resize(1);
+    randomize(4);
+    CHECK(identical(capture(), nextFrame));
+
+    setRandomizerSeed(8);
+    randomize(3);
+    std::vector<float> otherSeed = capture();
+    CHECK(countDifferences(otherSeed, single) > single.size() / 2);
+    CHECK(countDifferences(otherSeed, nextFrame) > single.size() / 2);
+
+    ThreadPool::global().resize(0);
+    clearComponents();
+}
+
+/* Within a frame, every entity gets its own draw */
+static void testEntitiesDiffer()
+{
+    clearComponents();
+    createScene();
+    addRandomizers();
+    setRandomizerSeed(7);
+    randomize(3);
+    glm::vec3 first = Transform::get("obj_2")->getPosition();
+    uint32_t same = 0;
+    for (uint32_t i = 3; i < numObjects; ++i) same += (Transform::get("obj_" + std::to_string(i))->getPosition() == first);
+    CHECK(same == 0);
+    CHECK(first.x >= -1.f && first.x <= 1.f);
+    CHECK(first.z >= -3.f && first.z <= 3.f);
+    clearComponents();
+}
+
+int main()
+{
+    initializeComponents(256);
+    testDeterminism();
+    testEntitiesDiffer();
+    return checkResult();
+}
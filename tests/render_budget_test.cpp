@@ -0,0 +1,66 @@
+// Drives RenderBudget with a synthetic clock, and checks that renders stop as close to their deadline
+// as the pass time allows without going over, except for the first pass, which always runs.
+
+#include <nvisii/utilities/render_budget.h>
+
+#include "check.h"
+
+#include <functional>
+
+/* Renders passes of the given durations until the budget says to stop, returning the elapsed time */
+static double run(RenderBudget &budget, double timeBudgetMs, uint32_t maxPasses, std::function<double(uint32_t)> passMs)
+{
+    budget.begin(timeBudgetMs, maxPasses);
+    double elapsed = 0.0;
+    while (budget.shouldContinue()) {
+        elapsed += passMs(budget.getPassCount());
+        budget.endPass(elapsed);
+    }
+    return elapsed;
+}
+
+static void testPassLimit()
+{
+    RenderBudget budget;
+    run(budget, 0.0, 16, [] (uint32_t) { return 10.0; });
+    CHECK(budget.getPassCount() == 16);
+    CHECK(!budget.hasTimeBudget());
+    CHECK(!budget.isOutOfTime());
+
+    // Reaching the pass limit within the time budget is not running out of time
+    run(budget, 1000.0, 16, [] (uint32_t) { return 10.0; });
+    CHECK(budget.getPassCount() == 16);
+    CHECK(!budget.isOutOfTime());
+}
+
+static void testTimeLimit()
+{
+    RenderBudget budget;
+    double elapsed = run(budget, 100.0, 1000, [] (uint32_t) { return 10.0; });
+    CHECK(budget.getPassCount() == 10);
+    CHECK(elapsed <= 100.0);
+    CHECK(budget.isOutOfTime());
+    CHECK_NEAR(budget.getEstimatedPassMs(), 10.0, 1e-9);
+    CHECK_NEAR(budget.getElapsedMs(), elapsed, 1e-9);
+
+    // A slow first pass, such as one that builds the scene, does not stop the faster passes after it
+    elapsed = run(budget, 100.0, 1000, [] (uint32_t pass) { return (pass == 0) ? 50.0 : 5.0; });
+    CHECK(elapsed <= 100.0);
+    CHECK(elapsed > 90.0);
+
+    // The first pass always runs, even when it alone exceeds the budget
+    elapsed = run(budget, 10.0, 1000, [] (uint32_t) { return 25.0; });
+    CHECK(budget.getPassCount() == 1);
+    CHECK(budget.isOutOfTime());
+
+    // Passes that slow down as the render goes on still end within the budget
+    elapsed = run(budget, 200.0, 1000, [] (uint32_t pass) { return 2.0 + pass; });
+    CHECK(elapsed <= 200.0 + 1e-9);
+}
+
+int main()
+{
+    testPassLimit();
+    testTimeLimit();
+    return checkResult();
+}
@@ -0,0 +1,114 @@
+// Checks the low discrepancy samplers: samples must be deterministic, within [0, 1), and the first
+// power of two samples of a pixel must be stratified in every dimension, and for the Sobol and PMJ02
+// samplers over the elementary intervals of a pair of dimensions.
+
+#include <nvisii/utilities/sampler.h>
+
+#include "check.h"
+
+#include <algorithm>
+
+/* The star discrepancy of a set of 1D points */
+static double starDiscrepancy(std::vector<float> points)
+{
+    std::sort(points.begin(), points.end());
+    double n = double(points.size()), discrepancy = 0.0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        discrepancy = std::max(discrepancy, double(i + 1) / n - points[i]);
+        discrepancy = std::max(discrepancy, points[i] - double(i) / n);
+    }
+    return discrepancy;
+}
+
+/*
+ * @returns true if the n points form a (t,m,2)-net: every 2^a by 2^b cell with 2^(a + b) = n / 2^t
+ * holds exactly 2^t of them. With t = 0, every elementary interval holds exactly one point.
+ */
+static bool isNet(const std::vector<glm::vec2> &points, uint32_t log2n, uint32_t t)
+{
+    uint32_t numCells = 1u << (log2n - t);
+    for (uint32_t a = 0; a <= log2n - t; ++a) {
+        uint32_t cellsX = 1u << a, cellsY = numCells / cellsX;
+        std::vector<uint32_t> counts(numCells, 0);
+        for (auto &p : points) {
+            uint32_t x = std::min(cellsX - 1, uint32_t(p.x * cellsX));
+            uint32_t y = std::min(cellsY - 1, uint32_t(p.y * cellsY));
+            counts[y * cellsX + x]++;
+        }
+        for (uint32_t count : counts) if (count != (1u << t)) return false;
+    }
+    return true;
+}
+
+static void testDeterminism()
+{
+    for (uint32_t type : {SAMPLER_INDEPENDENT, SAMPLER_SOBOL, SAMPLER_PMJ02, SAMPLER_BLUE_NOISE}) {
+        SamplerState a = samplerInit(type, 17, 4, 9, 1234);
+        SamplerState b = samplerInit(type, 17, 4, 9, 1234);
+        SamplerState otherSeed = samplerInit(type, 17, 4, 9, 1235);
+        uint32_t differences = 0;
+        for (uint32_t dimension = 0; dimension < 32; ++dimension) {
+            float value = samplerGet1D(a, dimension);
+            CHECK(value >= 0.f && value < 1.f);
+            CHECK(value == samplerGet1D(b, dimension));
+            glm::vec2 value2D = samplerGet2D(a, dimension);
+            CHECK(value2D.x >= 0.f && value2D.x < 1.f && value2D.y >= 0.f && value2D.y < 1.f);
+            CHECK(value2D == samplerGet2D(b, dimension));
+            if (value != samplerGet1D(otherSeed, dimension)) differences++;
+        }
+        // A new seed gives a new sequence
+        CHECK(differences > 28);
+    }
+}
+
+static void testStratification()
+{
+    const uint32_t log2n = 10, n = 1u << log2n;
+    const uint32_t pixels[3][2] = {{0, 0}, {5, 3}, {640, 480}};
+    for (uint32_t type : {SAMPLER_SOBOL, SAMPLER_PMJ02, SAMPLER_BLUE_NOISE}) {
+        for (auto &pixel : pixels) {
+            for (uint32_t dimension = 0; dimension < 12; ++dimension) {
+                std::vector<float> points(n);
+                for (uint32_t i = 0; i < n; ++i) points[i] = samplerGet1D(samplerInit(type, pixel[0], pixel[1], i, 42), dimension);
+                // One point per stratum, which blue noise dithering shifts by up to a stratum
+                double bound = (type == SAMPLER_BLUE_NOISE) ? 2.0 / n : 1.0 / n;
+                CHECK(starDiscrepancy(points) <= bound + 1e-6);
+            }
+            if (type == SAMPLER_BLUE_NOISE) continue;
+            for (uint32_t dimension : {0u, 2u, 4u, 6u}) {
+                std::vector<glm::vec2> points(n);
+                for (uint32_t i = 0; i < n; ++i) points[i] = samplerGet2D(samplerInit(type, pixel[0], pixel[1], i, 42), dimension);
+                // The third and fourth Sobol dimensions only form a (1,2) sequence
+                uint32_t t = (type == SAMPLER_SOBOL && (dimension & 3u) == 2) ? 1 : 0;
+                CHECK(isNet(points, log2n, t));
+            }
+        }
+    }
+
+    // Independent samples are only uniform on average
+    std::vector<float> points(n);
+    for (uint32_t i = 0; i < n; ++i) points[i] = samplerGet1D(samplerInit(SAMPLER_INDEPENDENT, 3, 3, i, 42), 5);
+    CHECK(starDiscrepancy(points) < .1);
+}
+
+static void testPixelsDecorrelated()
+{
+    // Neighbouring pixels must not share their sequence, or their noise would form visible patterns
+    for (uint32_t type : {SAMPLER_SOBOL, SAMPLER_PMJ02, SAMPLER_BLUE_NOISE}) {
+        std::vector<float> firstSamples;
+        for (uint32_t y = 0; y < 8; ++y)
+            for (uint32_t x = 0; x < 8; ++x)
+                firstSamples.push_back(samplerGet1D(samplerInit(type, x, y, 0, 7), 3));
+        std::sort(firstSamples.begin(), firstSamples.end());
+        CHECK(std::unique(firstSamples.begin(), firstSamples.end()) == firstSamples.end());
+        CHECK(starDiscrepancy(firstSamples) < .25);
+    }
+}
+
+int main()
+{
+    testDeterminism();
+    testStratification();
+    testPixelsDecorrelated();
+    return checkResult();
+}
@@ -0,0 +1,240 @@
+// Saves a small scene and loads it back, checking that names, ids, the transform hierarchy, materials,
+// instances and point radii survive the round trip, and that truncated files, files with duplicate names
+// and files with dangling references are rejected before the current scene is cleared.
+
+#include "components.h"
+#include "scene_file.h"
+#include "entity_instances.h"
+
+#include "check.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace nvisii;
+
+static const char* scenePath = "scene_file_test.nvscene";
+static const char* corruptPath = "scene_file_test_corrupt.nvscene";
+
+static std::vector<uint8_t> readFile(const char* path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const char* path, const std::vector<uint8_t> &bytes)
+{
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char*)bytes.data(), bytes.size());
+}
+
+/* @returns the records of one section of a scene file held in bytes */
+template<class Record>
+static Record* getRecords(std::vector<uint8_t> &bytes, SceneFileSectionType type, uint32_t &count)
+{
+    auto sections = (const SceneFileSection*)(bytes.data() + sizeof(SceneFileHeader));
+    count = sections[type].count;
+    return (Record*)(bytes.data() + sections[type].offset);
+}
+
+/* Builds a scene with a gap in the material ids, a parented transform, a textured material, an instanced entity and a point cloud */
+static void createScene()
+{
+    Material::create("gap");
+    Transform* parent = Transform::create("parent", glm::vec3(2.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f, 2.f, 3.f));
+    Transform* child = Transform::create("child", glm::vec3(1.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+    child->setParent(parent);
+
+    std::vector<float> texels = {1.f, 0.f, 0.f, 1.f, 0.f, 1.f, 0.f, 1.f, 0.f, 0.f, 1.f, 1.f, .5f, .5f, .5f, 1.f};
+    Texture* checker = Texture::createFromData("checker", 2, 2, texels.data(), uint32_t(texels.size()), true, true);
+    Material* red = Material::create("red", glm::vec3(.9f, .1f, .1f), .3f, .7f);
+    red->setBaseColorTexture(checker);
+    Material* blue = Material::create("blue", glm::vec3(.1f, .1f, .9f), .8f);
+    Material::remove("gap");
+
+    Mesh* triangle = Mesh::createFromData("triangle", {0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f, 0.f}, 3,
+        {}, 3, {}, 4, {}, 2, {0, 1, 2});
+    std::vector<float> points = {0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f};
+    std::vector<float> radii = {.1f, .2f, .3f, .4f};
+    Mesh* cloud = Mesh::createPointCloud("points", points.data(), uint32_t(points.size()), radii.data(), uint32_t(radii.size()));
+
+    Entity* instanced = Entity::create("triangle", child, red, triangle);
+    std::vector<float> transforms = {
+        1.f, 0.f, 0.f, 0.f,  0.f, 1.f, 0.f, 0.f,  0.f, 0.f, 1.f, 0.f,
+        1.f, 0.f, 0.f, 5.f,  0.f, 1.f, 0.f, 0.f,  0.f, 0.f, 1.f, 0.f};
+    std::vector<int32_t> materialIDs = {-1, blue->getId()};
+    instanced->setInstances(transforms.data(), uint32_t(transforms.size()), materialIDs.data(), uint32_t(materialIDs.size()));
+    Entity::create("points", parent, blue, cloud);
+    Entity::create("lamp", parent, red, triangle, Light::createFromRGB("lamp", glm::vec3(1.f, .5f, .25f), 3.f));
+}
+
+/* What the checks compare, captured by name so that it can be taken before saving and after loading */
+struct SceneSummary {
+    std::map<std::string, int32_t> ids;
+    std::map<std::string, std::string> bindings;
+    glm::mat4 childToWorld;
+    std::vector<glm::vec4> texels;
+    std::vector<float> materialValues;
+    std::vector<std::array<float, 3>> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<float> radii;
+    std::vector<float> instanceTransforms;
+    std::vector<int32_t> instanceMaterials;
+    glm::vec3 lightColor;
+    float lightIntensity;
+};
+
+static SceneSummary summarize()
+{
+    SceneSummary summary;
+    for (const char* name : {"triangle", "points", "lamp"}) {
+        Entity* entity = Entity::get(name);
+        CHECK(entity != nullptr);
+        if (!entity) return summary;
+        summary.ids[std::string("entity ") + name] = entity->getId();
+        summary.bindings[name] = entity->getTransform()->getName() + " " + entity->getMaterial()->getName()
+            + " " + entity->getMesh()->getName() + " " + (entity->getLight() ? entity->getLight()->getName() : "");
+    }
+    for (const char* name : {"parent", "child"}) summary.ids[std::string("transform ") + name] = Transform::get(name)->getId();
+    for (const char* name : {"red", "blue"}) summary.ids[std::string("material ") + name] = Material::get(name)->getId();
+    for (const char* name : {"triangle", "points"}) summary.ids[std::string("mesh ") + name] = Mesh::get(name)->getId();
+    summary.ids["texture checker"] = Texture::get("checker")->getId();
+    summary.ids["light lamp"] = Light::get("lamp")->getId();
+    summary.ids["red texture"] = Material::getFrontStruct()[Material::get("red")->getId()].base_color_texture_id;
+
+    Transform* child = Transform::get("child");
+    summary.bindings["child parent"] = child->getParent() ? child->getParent()->getName() : "";
+    for (Transform* t : Transform::get("parent")->getChildren()) summary.bindings["parent children"] += t->getName() + " ";
+    summary.childToWorld = child->getLocalToWorldMatrix();
+
+    summary.texels = Texture::get("checker")->getFloatTexels();
+    for (const char* name : {"red", "blue"}) {
+        Material* m = Material::get(name);
+        glm::vec3 color = m->getBaseColor();
+        summary.materialValues.insert(summary.materialValues.end(), {color.r, color.g, color.b, m->getRoughness(), m->getMetallic()});
+    }
+    summary.vertices = Mesh::get("triangle")->getVertices();
+    summary.indices = Mesh::get("triangle")->getTriangleIndices();
+    summary.radii = Mesh::get("points")->getRadii();
+
+    auto &instances = Entity::getFrontInstances()[Entity::get("triangle")->getId()];
+    CHECK(instances != nullptr);
+    if (instances) {
+        summary.instanceTransforms = instances->transforms;
+        summary.instanceMaterials = instances->materialIDs;
+    }
+    summary.lightColor = Light::get("lamp")->getColor();
+    summary.lightIntensity = Light::get("lamp")->getIntensity();
+    return summary;
+}
+
+static void checkEqual(const SceneSummary &a, const SceneSummary &b)
+{
+    CHECK(a.ids == b.ids);
+    CHECK(a.bindings == b.bindings);
+    CHECK(a.childToWorld == b.childToWorld);
+    CHECK(a.texels == b.texels);
+    CHECK(a.materialValues == b.materialValues);
+    CHECK(a.vertices == b.vertices);
+    CHECK(a.indices == b.indices);
+    CHECK(a.radii == b.radii);
+    CHECK(a.instanceTransforms == b.instanceTransforms);
+    CHECK(a.instanceMaterials == b.instanceMaterials);
+    CHECK(a.lightColor == b.lightColor);
+    CHECK(a.lightIntensity == b.lightIntensity);
+}
+
+static void testRoundTrip()
+{
+    clearComponents();
+    createScene();
+    SceneSummary saved = summarize();
+    CHECK(saved.ids["material red"] == 1);
+    CHECK(saved.bindings["child parent"] == "parent");
+    CHECK(saved.radii.size() == 4);
+    CHECK(saved.instanceMaterials.size() == 2);
+    saveScene(scenePath);
+
+    // Loading replaces whatever is there, including components the file does not have
+    clearComponents();
+    Entity::create("stale");
+    Material::create("blue");
+    loadScene(scenePath);
+    CHECK(Entity::get("stale") == nullptr);
+    checkEqual(summarize(), saved);
+}
+
+/* Writes bytes to a file, which loading must reject while leaving the current scene as it was */
+static void checkRejected(const std::vector<uint8_t> &bytes, const char* what)
+{
+    writeFile(corruptPath, bytes);
+    SceneSummary before = summarize();
+    bool rejected = false;
+    try { loadScene(corruptPath); }
+    catch (std::runtime_error &) { rejected = true; }
+    CHECK(rejected);
+    if (!rejected) fprintf(stderr, "a scene file with %s was loaded\n", what);
+    CHECK(Entity::get("sentinel") != nullptr);
+    checkEqual(summarize(), before);
+}
+
+static void testRejected()
+{
+    clearComponents();
+    loadScene(scenePath);
+    Entity::create("sentinel");
+    const std::vector<uint8_t> good = readFile(scenePath);
+    uint32_t count;
+
+    std::vector<uint8_t> bytes = good;
+    bytes.resize(bytes.size() / 2);
+    checkRejected(bytes, "half of its bytes");
+    bytes.resize(sizeof(SceneFileHeader) / 2);
+    checkRejected(bytes, "half a header");
+
+    bytes = good;
+    auto materials = getRecords<SceneFileMaterial>(bytes, SCENE_FILE_MATERIALS, count);
+    CHECK(count == 2);
+    materials[1].component.nameOffset = materials[0].component.nameOffset;
+    materials[1].component.nameLength = materials[0].component.nameLength;
+    checkRejected(bytes, "two materials of the same name");
+
+    bytes = good;
+    auto entities = getRecords<SceneFileEntity>(bytes, SCENE_FILE_ENTITIES, count);
+    entities[0].data.material_id = 63;
+    checkRejected(bytes, "an entity using a missing material");
+
+    bytes = good;
+    auto transforms = getRecords<SceneFileTransform>(bytes, SCENE_FILE_TRANSFORMS, count);
+    for (uint32_t i = 0; i < count; ++i) transforms[i].parent = 62;
+    checkRejected(bytes, "a transform with a missing parent");
+
+    // The instance material ids follow the instance matrices in the data section
+    bytes = good;
+    entities = getRecords<SceneFileEntity>(bytes, SCENE_FILE_ENTITIES, count);
+    auto sections = (const SceneFileSection*)(bytes.data() + sizeof(SceneFileHeader));
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!entities[i].hasInstances) continue;
+        uint64_t offset = sections[SCENE_FILE_DATA].offset + entities[i].instanceDataOffset + uint64_t(entities[i].numInstances) * 12 * sizeof(float);
+        int32_t missing = 61;
+        memcpy(bytes.data() + offset + sizeof(int32_t), &missing, sizeof(int32_t));
+    }
+    checkRejected(bytes, "an instance using a missing material");
+
+    // The untouched file still loads
+    loadScene(scenePath);
+    CHECK(Entity::get("sentinel") == nullptr);
+    CHECK(Entity::get("triangle") != nullptr);
+
+    std::remove(scenePath);
+    std::remove(corruptPath);
+}
+
+int main()
+{
+    initializeComponents();
+    testRoundTrip();
+    testRejected();
+    return checkResult();
+}
@@ -0,0 +1,225 @@
+// Checks the three step StaticFactory::create on a small factory of its own: builds and publishes which
+// throw release their reservation, reserved items stay invisible to get, an item removed while being built
+// is not published even when a later create reuses its location, and concurrent creates on a thread pool
+// leave the lookup table and the items consistent.
+
+#include <nvisii/utilities/static_factory.h>
+#include <nvisii/utilities/thread_pool.h>
+
+#include "check.h"
+
+class Widget : public StaticFactory {
+    public:
+    Widget() {}
+    Widget(std::string name, uint32_t id) { initialized = true; this->name = name; this->id = id; }
+    std::string toString() override { return "Widget " + name; }
+    bool isInitialized() const { return initialized; }
+    bool isReserved() const { return reservation != 0; }
+    int value = 0;
+};
+
+static const uint32_t maxWidgets = 64;
+static Widget widgets[maxWidgets];
+static std::map<std::string, uint32_t> lookupTable;
+static std::shared_ptr<std::recursive_mutex> widgetMutex = std::make_shared<std::recursive_mutex>();
+
+static Widget *createWidget(std::string name, std::function<int()> build,
+    std::function<void(Widget*, int&)> publish = [] (Widget *widget, int &value) { widget->value = value; })
+{
+    return StaticFactory::create<Widget, int>(widgetMutex, name, "Widget", lookupTable, widgets, maxWidgets, build, publish);
+}
+
+static Widget *getWidget(std::string name)
+{
+    return StaticFactory::get(widgetMutex, name, "Widget", lookupTable, widgets, maxWidgets);
+}
+
+static Widget *getWidget(uint32_t id)
+{
+    return StaticFactory::get(widgetMutex, id, "Widget", lookupTable, widgets, maxWidgets);
+}
+
+static void removeWidget(std::string name)
+{
+    StaticFactory::remove(widgetMutex, name, "Widget", lookupTable, widgets, maxWidgets);
+}
+
+/* @returns true if f throws a runtime error whose message contains the given text */
+static bool throwsWith(std::function<void()> f, std::string text)
+{
+    try { f(); }
+    catch (std::runtime_error &e) { return std::string(e.what()).find(text) != std::string::npos; }
+    return false;
+}
+
+static void clearWidgets()
+{
+    for (auto &widget : widgets) widget = Widget();
+    lookupTable.clear();
+}
+
+/* A location which is neither initialized nor reserved, and so can be handed out again */
+static bool isFree(uint32_t id)
+{
+    return !widgets[id].isInitialized() && !widgets[id].isReserved();
+}
+
+static void testCreate()
+{
+    clearWidgets();
+    Widget *widget = createWidget("a", [] () { return 7; });
+    CHECK(widget == &widgets[0]);
+    CHECK(widget->getName() == "a");
+    CHECK(widget->getId() == 0);
+    CHECK(widget->value == 7);
+    CHECK(widget->isInitialized());
+    CHECK(!widget->isReserved());
+    CHECK(getWidget("a") == widget);
+    CHECK(getWidget(0u) == widget);
+    CHECK(throwsWith([] () { createWidget("a", [] () { return 1; }); }, "already exists"));
+}
+
+static void testBuildThrows()
+{
+    clearWidgets();
+    CHECK(throwsWith([] () { createWidget("a", [] () -> int { throw std::runtime_error("Error: unreadable"); }); }, "unreadable"));
+    CHECK(lookupTable.empty());
+    CHECK(isFree(0));
+
+    // Both the name and the location can be taken again
+    Widget *widget = createWidget("a", [] () { return 3; });
+    CHECK(widget == &widgets[0]);
+    CHECK(widget->value == 3);
+}
+
+static void testPublishThrows()
+{
+    clearWidgets();
+    CHECK(throwsWith([] () {
+        createWidget("a", [] () { return 1; }, [] (Widget *widget, int &) {
+            widget->value = 1;
+            throw std::runtime_error("Error: upload failed");
+        });
+    }, "upload failed"));
+    CHECK(lookupTable.empty());
+    CHECK(isFree(0));
+    CHECK(widgets[0].value == 0);
+    CHECK(getWidget("a") == nullptr);
+    CHECK(getWidget(0u) == nullptr);
+}
+
+static void testReservedInvisible()
+{
+    clearWidgets();
+    Widget *other = nullptr;
+    Widget *widget = createWidget("a", [&] () {
+        // Reserved, but neither visible nor available to other creates
+        CHECK(widgets[0].isReserved());
+        CHECK(getWidget("a") == nullptr);
+        CHECK(getWidget(0u) == nullptr);
+        CHECK(throwsWith([] () { createWidget("a", [] () { return 1; }); }, "already exists"));
+        other = createWidget("b", [] () { return 2; });
+        return 1;
+    });
+    CHECK(widget == &widgets[0]);
+    CHECK(other == &widgets[1]);
+    CHECK(getWidget("a") == widget);
+    CHECK(getWidget("b") == other);
+    CHECK(other->value == 2);
+}
+
+static void testRemovedWhileBuilding()
+{
+    clearWidgets();
+    bool published = false;
+    CHECK(throwsWith([&] () {
+        createWidget("a", [] () { removeWidget("a"); return 1; }, [&] (Widget *, int &) { published = true; });
+    }, "was removed while being created"));
+    CHECK(!published);
+    CHECK(lookupTable.empty());
+    CHECK(isFree(0));
+}
+
+static void testSlotReused()
+{
+    clearWidgets();
+    Widget *reused = nullptr;
+    CHECK(throwsWith([&] () {
+        createWidget("a", [&] () {
+            removeWidget("a");
+            reused = createWidget("b", [] () { return 2; });
+            return 1;
+        });
+    }, "was removed while being created"));
+
+    // The later create took the location, and the failed one must not release it
+    CHECK(reused == &widgets[0]);
+    CHECK(getWidget("b") == reused);
+    CHECK(getWidget("a") == nullptr);
+    CHECK(reused->isInitialized());
+    CHECK(reused->getName() == "b");
+    CHECK(reused->value == 2);
+    CHECK(lookupTable.size() == 1);
+}
+
+static void testConcurrentCreates()
+{
+    clearWidgets();
+    const uint32_t numNames = 48, numTasks = 192;
+    std::atomic<uint32_t> created(0), duplicates(0), failedBuilds(0), others(0);
+    ThreadPool pool(4);
+    std::vector<std::future<void>> futures;
+    for (uint32_t i = 0; i < numTasks; ++i) {
+        futures.push_back(pool.submit([&, i] () {
+            uint32_t key = i % numNames;
+            try {
+                createWidget("widget " + std::to_string(key), [i, key] () {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    if (i % 5 == 0) throw std::runtime_error("Error: build failed");
+                    return int(key);
+                });
+                created++;
+            } catch (std::runtime_error &e) {
+                std::string message = e.what();
+                if (message.find("already exists") != std::string::npos) duplicates++;
+                else if (message.find("build failed") != std::string::npos) failedBuilds++;
+                else others++;
+            }
+        }));
+    }
+    for (auto &future : futures) pool.wait(future);
+
+    CHECK(created + duplicates + failedBuilds == numTasks);
+    CHECK(others == 0);
+    CHECK(failedBuilds > 0);
+    CHECK(created == lookupTable.size());
+    CHECK(created <= numNames);
+
+    // Every name leads to a published item of that name, and no location is left reserved
+    uint32_t initialized = 0;
+    for (uint32_t id = 0; id < maxWidgets; ++id) {
+        CHECK(!widgets[id].isReserved());
+        if (widgets[id].isInitialized()) initialized++;
+    }
+    CHECK(initialized == lookupTable.size());
+    for (auto &entry : lookupTable) {
+        Widget *widget = getWidget(entry.first);
+        CHECK(widget != nullptr);
+        if (!widget) continue;
+        CHECK(widget->getName() == entry.first);
+        CHECK(widget->getId() == int32_t(entry.second));
+        CHECK("widget " + std::to_string(widget->value) == entry.first);
+    }
+}
+
+int main()
+{
+    testCreate();
+    testBuildThrows();
+    testPublishThrows();
+    testReservedInvisible();
+    testRemovedWhileBuilding();
+    testSlotReused();
+    testConcurrentCreates();
+    return checkResult();
+}
@@ -0,0 +1,130 @@
+// Checks temporal accumulation on synthetic buffers: history must be blended by sample count, follow
+// the motion vectors, be rejected where the surface changed, and reduce noise over a static sequence.
+
+#include <nvisii/utilities/temporal_accumulation.h>
+
+#include "check.h"
+
+#include <random>
+
+static const int width = 8, height = 6;
+
+static std::vector<glm::vec4> fill(glm::vec4 value) { return std::vector<glm::vec4>(width * height, value); }
+
+/* Each pixel's color encodes its coordinates, to tell where reprojected history came from */
+static std::vector<glm::vec4> gradient(float samples)
+{
+    std::vector<glm::vec4> colors(width * height);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            colors[y * width + x] = glm::vec4(float(x), float(y), 1.f, samples);
+    return colors;
+}
+
+static void testBlending()
+{
+    auto samples = fill(glm::vec4(1.f, 0.f, 0.f, 1.f));
+    auto guides = fill(glm::vec4(0.f, 0.f, 5.f, 3.f));
+    auto history = fill(glm::vec4(0.f, 1.f, 0.f, 4.f));
+    std::vector<glm::vec4> result(width * height), newHistory(width * height);
+
+    // Without history, the frame is passed through
+    temporalAccumulate(width, height, samples.data(), guides.data(), nullptr, nullptr, 1.f, 16.f, .1f, result.data(), newHistory.data());
+    CHECK(result[10] == glm::vec4(1.f, 0.f, 0.f, 1.f));
+    CHECK(newHistory[10] == glm::vec4(1.f, 0.f, 0.f, 1.f));
+
+    // Blended by sample count, one new sample against four in the history
+    temporalAccumulate(width, height, samples.data(), guides.data(), history.data(), guides.data(), 1.f, 16.f, .1f, result.data(), newHistory.data());
+    CHECK_NEAR(result[10].r, .2f, 1e-6);
+    CHECK_NEAR(result[10].g, .8f, 1e-6);
+    CHECK(result[10].a == 1.f);
+    CHECK_NEAR(newHistory[10].a, 5.f, 1e-6);
+
+    // The history's weight is capped, so that old frames fade out
+    temporalAccumulate(width, height, samples.data(), guides.data(), history.data(), guides.data(), 1.f, 2.f, .1f, result.data(), newHistory.data());
+    CHECK_NEAR(result[10].r, 1.f / 3.f, 1e-6);
+    CHECK_NEAR(newHistory[10].a, 3.f, 1e-6);
+}
+
+static void testReprojection()
+{
+    auto samples = fill(glm::vec4(0.f));
+    auto history = gradient(1.f);
+    auto historyGuides = fill(glm::vec4(0.f, 0.f, 5.f, 3.f));
+
+    // Surfaces moved one pixel right and one pixel up since the previous frame
+    auto guides = fill(glm::vec4(1.f / width, 1.f / height, 5.f, 3.f));
+    glm::vec4 c = temporalAccumulatePixel(4, 3, width, height, samples.data(), guides.data(), history.data(), historyGuides.data(), 1.f, 16.f, .1f);
+    CHECK_NEAR(c.r * 2.f, 3.f, 1e-5);
+    CHECK_NEAR(c.g * 2.f, 2.f, 1e-5);
+
+    // Half a pixel of motion filters between the two neighbouring history pixels
+    guides = fill(glm::vec4(.5f / width, 0.f, 5.f, 3.f));
+    c = temporalAccumulatePixel(4, 3, width, height, samples.data(), guides.data(), history.data(), historyGuides.data(), 1.f, 16.f, .1f);
+    CHECK_NEAR(c.r * 2.f, 3.5f, 1e-5);
+
+    // Surfaces which came from outside the frame have no history
+    guides = fill(glm::vec4(-2.f, 0.f, 5.f, 3.f));
+    c = temporalAccumulatePixel(4, 3, width, height, samples.data(), guides.data(), history.data(), historyGuides.data(), 1.f, 16.f, .1f);
+    CHECK(c == glm::vec4(0.f, 0.f, 0.f, 1.f));
+}
+
+static void testRejection()
+{
+    auto samples = fill(glm::vec4(1.f, 1.f, 1.f, 1.f));
+    auto history = fill(glm::vec4(0.f, 0.f, 0.f, 8.f));
+    auto guides = fill(glm::vec4(0.f, 0.f, 5.f, 3.f));
+
+    // Another entity was seen there in the previous frame
+    auto historyGuides = fill(glm::vec4(0.f, 0.f, 5.f, 4.f));
+    glm::vec4 c = temporalAccumulatePixel(2, 2, width, height, samples.data(), guides.data(), history.data(), historyGuides.data(), 1.f, 16.f, .1f);
+    CHECK(c == glm::vec4(1.f, 1.f, 1.f, 1.f));
+
+    // The same entity, but a surface further back which is now occluded
+    historyGuides = fill(glm::vec4(0.f, 0.f, 7.f, 3.f));
+    c = temporalAccumulatePixel(2, 2, width, height, samples.data(), guides.data(), history.data(), historyGuides.data(), 1.f, 16.f, .1f);
+    CHECK(c == glm::vec4(1.f, 1.f, 1.f, 1.f));
+
+    // Within the depth tolerance
+    historyGuides = fill(glm::vec4(0.f, 0.f, 5.2f, 3.f));
+    c = temporalAccumulatePixel(2, 2, width, height, samples.data(), guides.data(), history.data(), historyGuides.data(), 1.f, 16.f, .1f);
+    CHECK_NEAR(c.a, 9.f, 1e-5);
+
+    // Camera rays which missed have no depth to compare
+    guides = fill(glm::vec4(0.f, 0.f, 0.f, -1.f));
+    historyGuides = fill(glm::vec4(0.f, 0.f, 100.f, -1.f));
+    c = temporalAccumulatePixel(2, 2, width, height, samples.data(), guides.data(), history.data(), historyGuides.data(), 1.f, 16.f, .1f);
+    CHECK_NEAR(c.a, 9.f, 1e-5);
+}
+
+static void testNoiseReduction()
+{
+    // A static noisy sequence converges towards its mean
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    auto guides = fill(glm::vec4(0.f, 0.f, 5.f, 3.f));
+    std::vector<glm::vec4> history(width * height), historyGuides = guides, result(width * height), newHistory(width * height);
+    double firstError = 0.0, lastError = 0.0;
+    for (int frame = 0; frame < 32; ++frame) {
+        std::vector<glm::vec4> samples(width * height);
+        for (auto &s : samples) s = glm::vec4(uniform(rng));
+        temporalAccumulate(width, height, samples.data(), guides.data(), (frame > 0) ? history.data() : nullptr, historyGuides.data(),
+            1.f, 64.f, .1f, result.data(), newHistory.data());
+        history.swap(newHistory);
+        double error = 0.0;
+        for (auto &r : result) error += (r.r - .5) * (r.r - .5);
+        if (frame == 0) firstError = error;
+        lastError = error;
+    }
+    CHECK(lastError < firstError / 10.0);
+    CHECK_NEAR(history[0].a, 32.f, 1e-4);
+}
+
+int main()
+{
+    testBlending();
+    testReprojection();
+    testRejection();
+    testNoiseReduction();
+    return checkResult();
+}
@@ -0,0 +1,349 @@
+// Bakes meshes and textures ahead of time, so that loading them at render time does no processing.
+//
+// Meshes are imported, welded across all of their sub meshes, given normals and tangents, and written
+// as .nvmesh files (see nvisii/utilities/baked_mesh.h). Textures are decoded, given a full mip chain,
+// optionally block compressed, and written as .ktx or .dds files. Mesh::createFromFile and
+// Texture::createFromFile load both. Only nvisii_core is linked, so this runs on machines without a GPU.
+//
+// usage: nvisii_bake [--smooth-normals] [--linear] [--no-mips] [--compress] <input> <output> [<input> <output> ...]
+//
+//   --smooth-normals  replace the normals of meshes with smooth normals
+//   --linear          treat 8 bit textures as linear rather than sRGB (eg normal or roughness maps)
+//   --no-mips         only store the full resolution level of textures
+//   --compress        block compress 8 bit textures, as BC1 when opaque and BC3 otherwise. Linear textures
+//                     are only compressed in .ktx files, and stored uncompressed in .dds files.
+//
+// The output extension picks what is baked: .nvmesh for meshes, and .ktx or .dds for textures.
+
+#include <nvisii/nvisii.h>
+#include <nvisii/utilities/baked_mesh.h>
+
+#include <gli/gli.hpp>
+#include <glm/gtc/color_space.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace nvisii;
+
+struct BakeOptions {
+    bool smoothNormals = false;
+    bool linear = false;
+    bool mips = true;
+    bool compress = false;
+};
+
+static std::string getExtension(const std::string &path)
+{
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return "";
+    std::string extension = path.substr(dot);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    return extension;
+}
+
+static void bakeMesh(const std::string &input, const std::string &output, const BakeOptions &options)
+{
+    Mesh* imported = Mesh::createFromFile("imported", input);
+    auto vertices = imported->getVertices();
+    auto normals = imported->getNormals();
+    auto colors = imported->getColors();
+    auto texCoords = imported->getTexCoords();
+    auto indices = imported->getTriangleIndices();
+    Mesh::remove("imported");
+
+    // Unindex the triangles, so that createFromData welds identical vertices across all sub meshes,
+    // rather than only within each one. Triangles which collapse into a line or a point are dropped.
+    std::vector<float> positionData, normalData, colorData, texCoordData;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const uint32_t triangle[3] = {indices[i], indices[i + 1], indices[i + 2]};
+        if ((vertices[triangle[0]] == vertices[triangle[1]]) || (vertices[triangle[1]] == vertices[triangle[2]]) ||
+            (vertices[triangle[2]] == vertices[triangle[0]])) continue;
+        for (uint32_t v : triangle) {
+            positionData.insert(positionData.end(), {vertices[v][0], vertices[v][1], vertices[v][2]});
+            normalData.insert(normalData.end(), {normals[v].x, normals[v].y, normals[v].z});
+            if (!colors.empty()) colorData.insert(colorData.end(), {colors[v].r, colors[v].g, colors[v].b, colors[v].a});
+            texCoordData.insert(texCoordData.end(), {texCoords[v].x, texCoords[v].y});
+        }
+    }
+    if (positionData.empty()) throw std::runtime_error(std::string("Error: \"") + input + "\" has no triangles to bake");
+
+    // Without normals, createFromData generates smooth ones
+    if (options.smoothNormals) normalData.clear();
+
+    Mesh* welded = Mesh::createFromData("welded", positionData, 3, normalData, 3, colorData, 4, texCoordData, 2);
+    BakedMesh baked;
+    baked.positions = welded->getVertices();
+    baked.normals = welded->getNormals();
+    baked.tangents = welded->getTangents();
+    baked.colors = welded->getColors();
+    baked.texCoords = welded->getTexCoords();
+    baked.triangleIndices = welded->getTriangleIndices();
+    Mesh::remove("welded");
+
+    saveBakedMesh(output, baked);
+    std::cerr << input << ": " << vertices.size() << " vertices welded into " << baked.positions.size()
+              << ", " << baked.triangleIndices.size() / 3 << " triangles" << std::endl;
+}
+
+/* Halves a level of the mip chain with a box filter, clamping at its edges */
+static std::vector<glm::vec4> downsample(const std::vector<glm::vec4> &texels, uint32_t width, uint32_t height)
+{
+    uint32_t w = std::max(width / 2, 1u), h = std::max(height / 2, 1u);
+    std::vector<glm::vec4> result(w * h);
+    for (uint32_t y = 0; y < h; ++y) {
+        for (uint32_t x = 0; x < w; ++x) {
+            uint32_t x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            uint32_t y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+            result[y * w + x] = .25f * (texels[y0 * width + x0] + texels[y0 * width + x1] +
+                                        texels[y1 * width + x0] + texels[y1 * width + x1]);
+        }
+    }
+    return result;
+}
+
+static uint16_t toRGB565(glm::vec3 c)
+{
+    glm::ivec3 q = glm::ivec3(glm::round(glm::clamp(c, glm::vec3(0.f), glm::vec3(255.f)) * glm::vec3(31.f, 63.f, 31.f) / 255.f));
+    return uint16_t((q.r << 11) | (q.g << 5) | q.b);
+}
+
+static glm::vec3 fromRGB565(uint16_t c)
+{
+    uint32_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    return glm::vec3(float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)), float((b << 3) | (b >> 2)));
+}
+
+/*
+ * Writes the 8 byte color half of a BC1 or BC3 block. Endpoints are the extremes of the texels along
+ * their principal axis, pulled slightly inwards, and each texel takes the closest of the four colors
+ * interpolated between them.
+ */
+static void encodeColorBlock(const glm::u8vec4 texels[16], uint8_t* out)
+{
+    glm::vec3 colors[16], mean(0.f);
+    for (int i = 0; i < 16; ++i) mean += (colors[i] = glm::vec3(texels[i]));
+    mean /= 16.f;
+
+    // principal axis of the covariance, by power iteration
+    glm::mat3 covariance(0.f);
+    for (int i = 0; i < 16; ++i) covariance += glm::outerProduct(colors[i] - mean, colors[i] - mean);
+    glm::vec3 axis(1.f, 1.f, 1.f);
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 next = covariance * axis;
+        float length = glm::length(next);
+        if (length < 1e-6f) break;
+        axis = next / length;
+    }
+
+    float minT = 1e30f, maxT = -1e30f;
+    for (int i = 0; i < 16; ++i) {
+        float t = glm::dot(colors[i] - mean, axis);
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    float inset = (maxT - minT) / 16.f;
+    uint16_t c0 = toRGB565(mean + axis * (maxT - inset));
+    uint16_t c1 = toRGB565(mean + axis * (minT + inset));
+
+    // c0 > c1 selects the four color mode. Equal endpoints only need index 0.
+    uint32_t bits = 0;
+    if (c0 != c1) {
+        if (c0 < c1) std::swap(c0, c1);
+        glm::vec3 palette[4];
+        palette[0] = fromRGB565(c0);
+        palette[1] = fromRGB565(c1);
+        palette[2] = (2.f * palette[0] + palette[1]) / 3.f;
+        palette[3] = (palette[0] + 2.f * palette[1]) / 3.f;
+        for (int i = 0; i < 16; ++i) {
+            uint32_t best = 0;
+            float bestDistance = 1e30f;
+            for (uint32_t p = 0; p < 4; ++p) {
+                glm::vec3 d = colors[i] - palette[p];
+                float distance = glm::dot(d, d);
+                if (distance < bestDistance) { bestDistance = distance; best = p; }
+            }
+            bits |= best << (2 * i);
+        }
+    }
+    out[0] = uint8_t(c0); out[1] = uint8_t(c0 >> 8);
+    out[2] = uint8_t(c1); out[3] = uint8_t(c1 >> 8);
+    for (int i = 0; i < 4; ++i) out[4 + i] = uint8_t(bits >> (8 * i));
+}
+
+/* Writes the 8 byte alpha half of a BC3 block, in the mode which interpolates 6 values between the extremes */
+static void encodeAlphaBlock(const glm::u8vec4 texels[16], uint8_t* out)
+{
+    uint8_t a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; ++i) {
+        a0 = std::max(a0, texels[i].a);
+        a1 = std::min(a1, texels[i].a);
+    }
+
+    uint64_t bits = 0;
+    if (a0 != a1) {
+        float palette[8] = {float(a0), float(a1)};
+        for (int p = 1; p < 7; ++p) palette[p + 1] = ((7 - p) * float(a0) + p * float(a1)) / 7.f;
+        for (int i = 0; i < 16; ++i) {
+            uint64_t best = 0;
+            float bestDistance = 1e30f;
+            for (uint64_t p = 0; p < 8; ++p) {
+                float distance = std::abs(float(texels[i].a) - palette[p]);
+                if (distance < bestDistance) { bestDistance = distance; best = p; }
+            }
+            bits |= best << (3 * i);
+        }
+    }
+    out[0] = a0;
+    out[1] = a1;
+    for (int i = 0; i < 6; ++i) out[2 + i] = uint8_t(bits >> (8 * i));
+}
+
+/* Block compresses a level, whose rows run from top to bottom. Blocks past the edges repeat the edge texels. */
+static void compressLevel(const std::vector<glm::u8vec4> &texels, uint32_t width, uint32_t height, bool bc3, uint8_t* out)
+{
+    for (uint32_t by = 0; by < (height + 3) / 4; ++by) {
+        for (uint32_t bx = 0; bx < (width + 3) / 4; ++bx) {
+            glm::u8vec4 block[16];
+            for (uint32_t i = 0; i < 16; ++i) {
+                uint32_t x = std::min(bx * 4 + i % 4, width - 1), y = std::min(by * 4 + i / 4, height - 1);
+                block[i] = texels[y * width + x];
+            }
+            if (bc3) {
+                encodeAlphaBlock(block, out);
+                out += 8;
+            }
+            encodeColorBlock(block, out);
+            out += 8;
+        }
+    }
+}
+
+static void bakeTexture(const std::string &input, const std::string &output, const BakeOptions &options)
+{
+    Texture* texture = Texture::createFromFile("input", input, options.linear);
+    uint32_t width = texture->getWidth(), height = texture->getHeight();
+    bool hdr = texture->isHDR(), linear = texture->isLinear();
+    std::vector<glm::vec4> texels = texture->getFloatTexels();
+    std::vector<glm::u8vec4> byteTexels = hdr ? std::vector<glm::u8vec4>() : texture->getByteTexels();
+    Texture::remove("input");
+
+    // Filter in linear space, so that mips of sRGB textures keep their brightness
+    if (!linear) {
+        for (auto &t : texels) t = glm::vec4(glm::convertSRGBToLinear(glm::vec3(t)), t.a);
+    }
+
+    uint32_t numLevels = options.mips ? uint32_t(std::floor(std::log2(float(std::max(width, height))))) + 1 : 1;
+    std::vector<std::vector<glm::vec4>> levels = {texels};
+    for (uint32_t level = 1; level < numLevels; ++level) {
+        levels.push_back(downsample(levels.back(), std::max(width >> (level - 1), 1u), std::max(height >> (level - 1), 1u)));
+    }
+
+    bool opaque = std::all_of(texels.begin(), texels.end(), [](const glm::vec4 &t) { return t.a >= 1.f; });
+    bool compress = options.compress;
+    if (compress && hdr) {
+        std::cerr << input << ": HDR textures are stored uncompressed" << std::endl;
+        compress = false;
+    }
+    if (compress && (((width % 4) != 0) || ((height % 4) != 0))) {
+        std::cerr << input << ": only textures whose sides are multiples of 4 can be compressed, storing it uncompressed" << std::endl;
+        compress = false;
+    }
+    // The loader reads block compressed .dds textures as sRGB, since many tools mislabel them as linear.
+    // Only .ktx files are trusted to keep the linear formats, so linear .dds textures are stored uncompressed.
+    if (compress && linear && (getExtension(output) != ".ktx")) {
+        std::cerr << input << ": linear textures are only compressed in .ktx files, storing it uncompressed" << std::endl;
+        compress = false;
+    }
+    bool bc3 = !opaque;
+    gli::format format =
+        hdr ? gli::FORMAT_RGBA32_SFLOAT_PACK32 :
+        compress ? (bc3 ? (linear ? gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16 : gli::FORMAT_RGBA_DXT5_SRGB_BLOCK16)
+                        : (linear ? gli::FORMAT_RGBA_DXT1_UNORM_BLOCK8 : gli::FORMAT_RGBA_DXT1_SRGB_BLOCK8)) :
+        linear ? gli::FORMAT_RGBA8_UNORM_PACK8 : gli::FORMAT_RGBA8_SRGB_PACK8;
+
+    gli::texture2d baked(format, gli::extent2d(width, height), numLevels);
+    for (uint32_t level = 0; level < numLevels; ++level) {
+        uint32_t w = std::max(width >> level, 1u), h = std::max(height >> level, 1u);
+
+        // Texels are stored bottom row first, while KTX and DDS files start from the top row
+        std::vector<glm::vec4> flipped(w * h);
+        for (uint32_t y = 0; y < h; ++y) {
+            std::copy(levels[level].begin() + (h - 1 - y) * w, levels[level].begin() + (h - y) * w, flipped.begin() + y * w);
+        }
+
+        if (hdr) {
+            memcpy(baked.data(0, 0, level), flipped.data(), std::min(baked.size(level), flipped.size() * sizeof(glm::vec4)));
+            continue;
+        }
+
+        // The full resolution level keeps the original texels, rather than a round trip through linear space
+        std::vector<glm::u8vec4> bytes(w * h);
+        for (uint32_t y = 0; y < h; ++y) {
+            for (uint32_t x = 0; x < w; ++x) {
+                uint32_t i = y * w + x;
+                if (level == 0) { bytes[i] = byteTexels[(h - 1 - y) * w + x]; continue; }
+                glm::vec4 t = glm::clamp(flipped[i], glm::vec4(0.f), glm::vec4(1.f));
+                if (!linear) t = glm::vec4(glm::convertLinearToSRGB(glm::vec3(t)), t.a);
+                bytes[i] = glm::u8vec4(glm::round(t * 255.f));
+            }
+        }
+        if (compress) compressLevel(bytes, w, h, bc3, (uint8_t*)baked.data(0, 0, level));
+        else memcpy(baked.data(0, 0, level), bytes.data(), std::min(baked.size(level), bytes.size() * sizeof(glm::u8vec4)));
+    }
+
+    if (!gli::save(baked, output)) throw std::runtime_error(std::string("Error: unable to write \"") + output + "\"");
+    std::cerr << input << ": " << width << "x" << height << ", " << numLevels << " levels, "
+              << baked.size() << " bytes" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    BakeOptions options;
+    std::vector<std::string> paths;
+    bool valid = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--smooth-normals") options.smoothNormals = true;
+        else if (arg == "--linear") options.linear = true;
+        else if (arg == "--no-mips") options.mips = false;
+        else if (arg == "--compress") options.compress = true;
+        else if (arg.compare(0, 2, "--") == 0) valid = false;
+        else paths.push_back(arg);
+    }
+    if (!valid || paths.empty() || (paths.size() % 2) != 0) {
+        std::cerr << "usage: " << argv[0] << " [--smooth-normals] [--linear] [--no-mips] [--compress] "
+                  << "<input> <output> [<input> <output> ...]" << std::endl;
+        return 1;
+    }
+
+    // Only the component factories are needed, so the renderer itself is never started
+    const uint32_t maxComponents = 16;
+    Entity::initializeFactory(maxComponents);
+    Transform::initializeFactory(maxComponents);
+    Material::initializeFactory(maxComponents);
+    Mesh::initializeFactory(maxComponents);
+    Camera::initializeFactory(maxComponents);
+    Light::initializeFactory(maxComponents);
+    Texture::initializeFactory(maxComponents);
+    Volume::initializeFactory(maxComponents);
+
+    int failures = 0;
+    for (size_t i = 0; i < paths.size(); i += 2) {
+        const std::string &input = paths[i], &output = paths[i + 1];
+        std::string extension = getExtension(output);
+        try {
+            if (extension == ".nvmesh") bakeMesh(input, output, options);
+            else if (extension == ".ktx" || extension == ".dds") bakeTexture(input, output, options);
+            else throw std::runtime_error(std::string("Error: unable to bake \"") + output + "\", outputs must end in .nvmesh, .ktx or .dds");
+        } catch (std::exception &e) {
+            std::cerr << input << ": " << e.what() << std::endl;
+            failures++;
+        }
+    }
+    return failures ? 1 : 0;
+}